@@ -0,0 +1,2423 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Resolution of MSYS/Cygwin shebang scripts
+ * Note: See libshebang.h for the API
+ */
+
+
+/** Build instructions:
+
+    -DUNICODE = compiles 'unicode' version instead of 'ansi'
+    -DNOINDEX = disables persistent PATH index (%TEMP%\shebang.index)
+    -DNOSIMD = disables SSE2/AVX2 byte scanning (AVX2 needs -mavx2 or /arch:AVX2)
+    -DPIN_LAYER={clangarm64 | mingw32 | mingw64 | ucrt64 | clang32 | clang64 | msys |
+        cygwin} -DPIN_ROOT="dir" = pins POSIX layer and root instead of finding them on
+        PATH; root is then only checked for existence
+
+**/
+
+
+#if defined(UNICODE) && !defined(_UNICODE)
+#define _UNICODE
+#endif // UNICODE
+
+#define WIN32_LEAN_AND_MEAN
+#include <tchar.h>
+#include <windows.h>
+#include <shlwapi.h>
+#include <strsafe.h>
+#include "libshebang_int.h"
+
+
+#if !defined(__GNUC__)
+#pragma comment(lib, "shlwapi.lib")
+#endif // __GNUC__
+
+
+// vector byte scanning (not under AddressSanitizer: page safe loads may read past
+// the end of a buffer)
+#if !defined(NOSIMD) && !defined(__SANITIZE_ADDRESS__) && (defined(__SSE2__) \
+    || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <immintrin.h>
+#if defined(__AVX2__)
+typedef __m256i VEC;
+#define VEC_BYTES       32
+#define VEC_ALL         0xffffffffU
+#define vec_load(p)     _mm256_loadu_si256((const VEC*)(p))
+#define vec_store(p, v) _mm256_storeu_si256((VEC*)(p), (v))
+#define vec_set8(c)     _mm256_set1_epi8((char)(c))
+#define vec_set16(c)    _mm256_set1_epi16((short)(c))
+#define vec_eq8         _mm256_cmpeq_epi8
+#define vec_eq16        _mm256_cmpeq_epi16
+#define vec_or          _mm256_or_si256
+#define vec_blend(a, b, m)  _mm256_blendv_epi8((a), (b), (m))
+#define vec_mask(v)     ((unsigned)_mm256_movemask_epi8(v))
+#define vec_widen_store(pw, v)  (_mm256_storeu_si256((VEC*)(pw), \
+    _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v))), _mm256_storeu_si256( \
+    (VEC*)(pw) + 1, _mm256_cvtepu8_epi16(_mm256_extracti128_si256((v), 1))))
+#else
+typedef __m128i VEC;
+#define VEC_BYTES       16
+#define VEC_ALL         0xffffU
+#define vec_load(p)     _mm_loadu_si128((const VEC*)(p))
+#define vec_store(p, v) _mm_storeu_si128((VEC*)(p), (v))
+#define vec_set8(c)     _mm_set1_epi8((char)(c))
+#define vec_set16(c)    _mm_set1_epi16((short)(c))
+#define vec_eq8         _mm_cmpeq_epi8
+#define vec_eq16        _mm_cmpeq_epi16
+#define vec_or          _mm_or_si128
+#define vec_blend(a, b, m)  _mm_or_si128(_mm_andnot_si128((m), (a)), \
+    _mm_and_si128((m), (b)))
+#define vec_mask(v)     ((unsigned)_mm_movemask_epi8(v))
+#define vec_widen_store(pw, v)  (_mm_storeu_si128((VEC*)(pw), \
+    _mm_unpacklo_epi8((v), _mm_setzero_si128())), _mm_storeu_si128( \
+    (VEC*)(pw) + 1, _mm_unpackhi_epi8((v), _mm_setzero_si128())))
+#endif // __AVX2__
+#ifdef UNICODE
+#define vec_setT        vec_set16
+#define vec_eqT         vec_eq16
+#else
+#define vec_setT        vec_set8
+#define vec_eqT         vec_eq8
+#endif // UNICODE
+// vector load at p doesn't cross a page, so it can't fault if p[0] is readable
+#define PAGE_SAFE(p)    (((UINT_PTR)(p) & 4095) <= 4096 - VEC_BYTES)
+#endif // NOSIMD
+
+
+// our original name
+#define PROGRAM_NAME    "shebang"
+// macro to facilitate function call
+#define COUNT(a)        (sizeof(a) / sizeof(*a))
+#define COUNT1(a)       (COUNT(a) - 1)
+#define ARRAY(a)        (a), COUNT(a)
+#define ARRAY1(a)       (a), COUNT1(a)
+// latin letter test
+#define IS_LATIN(c)     (('A' <= (c) && (c) <= 'Z') || ('a' <= (c) && (c) <= 'z'))
+// FNV-1a hash prime; basis is in libshebang.h
+#define FNV_PRIME       0x100000001b3ULL
+
+
+// POSIX layer pinned at build time
+#if defined(PIN_LAYER)
+#if !defined(PIN_ROOT)
+#error -DPIN_LAYER requires -DPIN_ROOT.
+#endif // PIN_ROOT
+#define PIN_clangarm64  POSIX_CLANGARM64
+#define PIN_mingw32     POSIX_MINGW32
+#define PIN_mingw64     POSIX_MINGW64
+#define PIN_ucrt64      POSIX_UCRT64
+#define PIN_clang32     POSIX_CLANG32
+#define PIN_clang64     POSIX_CLANG64
+#define PIN_msys        POSIX_MSYS
+#define PIN_cygwin      POSIX_CYGWIN
+#define PIN_native      POSIX_NATIVE
+#define PIN_CONCAT2(_Token1, _Token2)   _Token1 ## _Token2
+#define PIN_CONCAT(_Token1, _Token2)    PIN_CONCAT2(_Token1, _Token2)
+#define PIN_SYS         PIN_CONCAT(PIN_, PIN_LAYER)
+// layer as a constant, so that code for other layers compiles away
+#define POSIX_SYS(ppx)  ((void)(ppx), PIN_SYS)
+#else
+#define POSIX_SYS(ppx)  ((ppx)->sys)
+#endif // PIN_LAYER
+
+
+#if defined(VEC_BYTES)
+// gets index of the lowest set bit
+static int first_bit(unsigned m)
+{
+#if defined(__GNUC__)
+    return __builtin_ctz(m);
+#else
+    int i = 0;
+    for ( ; !(m & 1); m >>= 1) ++i;
+    return i;
+#endif // __GNUC__
+}
+#endif // VEC_BYTES
+
+
+// internal implementation of memcmp()
+static int compare_bytes(const void* s1, const void* s2, size_t n)
+{
+    const unsigned char* p1 = s1;
+    const unsigned char* p2 = s2;
+
+    while (n) {
+#if defined(VEC_BYTES)
+        // note: s1 may be a shorter string, so never read past its page
+        if (n >= VEC_BYTES && PAGE_SAFE(p1) && PAGE_SAFE(p2)) {
+            unsigned m = vec_mask(vec_eq8(vec_load(p1), vec_load(p2))) ^ VEC_ALL;
+            if (m) {
+                int i = first_bit(m);
+                return (p1[i] - p2[i]);
+            }
+            p1 += VEC_BYTES;
+            p2 += VEC_BYTES;
+            n -= VEC_BYTES;
+            continue;
+        }
+#endif // VEC_BYTES
+        int b1 = *p1++;
+        int b2 = *p2++;
+        if (b1 != b2)
+            return (b1 - b2);
+        --n;
+    }
+
+    return 0;
+}
+
+
+// internal implementation of memset() to zero; CRT-free build must not import it,
+// so stores are volatile for the compiler not to make a call of the loop
+static void zero_bytes(void* p, size_t n)
+{
+    volatile ULONG_PTR* pul = p;
+    for ( ; n >= sizeof(*pul); n -= sizeof(*pul))
+        *pul++ = 0;
+    for (volatile BYTE* pb = (volatile BYTE*)pul; n; --n)
+        *pb++ = 0;
+}
+
+
+// internal implementation of memcpy(); same as above
+static void copy_bytes(void* pTo, const void* pFrom, size_t n)
+{
+    volatile BYTE* p1 = pTo;
+    const BYTE* p2 = pFrom;
+    for ( ; n; --n)
+        *p1++ = *p2++;
+}
+
+
+// finds first NUL, CR or LF in a buffer; returns its size if none
+static size_t find_eol(const char* p, size_t n)
+{
+    size_t i = 0;
+
+#if defined(VEC_BYTES)
+    VEC vNul = vec_set8('\0'), vCR = vec_set8('\r'), vLF = vec_set8('\n');
+    for ( ; i + VEC_BYTES <= n; i += VEC_BYTES) {
+        VEC v = vec_load(p + i);
+        unsigned m = vec_mask(vec_or(vec_or(vec_eq8(v, vNul), vec_eq8(v, vCR)),
+            vec_eq8(v, vLF)));
+        if (m)
+            return i + (size_t)first_bit(m);
+    }
+#endif // VEC_BYTES
+
+    for ( ; i < n && p[i] && p[i] != '\r' && p[i] != '\n'; ++i) ;
+    return i;
+}
+
+
+// replaces all occurences of a byte in a buffer
+static void replace_byte(char* p, size_t n, char cTo, char cFrom)
+{
+    size_t i = 0;
+
+#if defined(VEC_BYTES)
+    VEC vTo = vec_set8(cTo), vFrom = vec_set8(cFrom);
+    for ( ; i + VEC_BYTES <= n; i += VEC_BYTES) {
+        VEC v = vec_load(p + i);
+        vec_store(p + i, vec_blend(v, vTo, vec_eq8(v, vFrom)));
+    }
+#endif // VEC_BYTES
+
+    for ( ; i < n; ++i)
+        if (p[i] == cFrom)
+            p[i] = cTo;
+}
+
+
+// decodes UTF-8 string to UTF-16 rejecting malformed input; returns number of
+// chars written including terminator or zero on error
+static size_t decode_utf8(WCHAR* pwTo, size_t cchTo, const char* src,
+    DWORD* pdwErrorCode)
+{
+    const unsigned char* cp = (const unsigned char*)src;
+    size_t cch = 0;
+
+#if defined(VEC_BYTES)
+    VEC vNul = vec_set8('\0');
+#endif // VEC_BYTES
+
+    for (;;) {
+#if defined(VEC_BYTES)
+        // ASCII fast path: widen whole vector, keep it up to high bit or terminator
+        if (*cp < 0x80 && cchTo - cch >= VEC_BYTES && PAGE_SAFE(cp)) {
+            VEC v = vec_load(cp);
+            unsigned m = vec_mask(v) | vec_mask(vec_eq8(v, vNul));
+            unsigned i = m ? first_bit(m) : VEC_BYTES;
+            vec_widen_store(pwTo + cch, v);
+            cp += i;
+            cch += i;
+            if (!m)
+                continue;
+        } else
+#endif // VEC_BYTES
+        // ASCII run but the terminator
+        for ( ; *cp - 1U < 0x7f && cch < cchTo; ++cp)
+            pwTo[cch++] = *cp;
+
+        // lead byte: payload bits, number of trailing bytes and min value
+        unsigned c = *cp++, n = 0, min = 0;
+        if (c >= 0xc2 && c <= 0xdf)
+            c &= 0x1f, n = 1;
+        else if (c >= 0xe0 && c <= 0xef)
+            c &= 0x0f, n = 2, min = 0x800;
+        else if (c >= 0xf0 && c <= 0xf4)
+            c &= 0x07, n = 3, min = 0x10000;
+        else if (c >= 0x80)
+            goto malformed;
+
+        // trailing bytes; terminator is not one of them
+        for ( ; n; --n, ++cp) {
+            if ((*cp & 0xc0) != 0x80)
+                goto malformed;
+            c = (c << 6) | (*cp & 0x3f);
+        }
+        if (c < min || (c >= 0xd800 && c <= 0xdfff) || c > 0x10ffff)
+            goto malformed;
+
+        // one or two UTF-16 chars
+        if (cch + (c >= 0x10000) >= cchTo) {
+            *pdwErrorCode = ERROR_INSUFFICIENT_BUFFER;
+            return 0;
+        }
+        if (c >= 0x10000) {
+            c -= 0x10000;
+            pwTo[cch++] = (WCHAR)(0xd800 | (c >> 10));
+            c = 0xdc00 | (c & 0x3ff);
+        }
+        pwTo[cch++] = (WCHAR)c;
+        if (!c)
+            return cch;
+    }
+
+malformed:
+    *pdwErrorCode = ERROR_NO_UNICODE_TRANSLATION;
+    return 0;
+}
+
+
+// concats TCHAR string with UTF-8 string
+static BOOL concat_with_utf8(PTSTR pszDest, size_t cchDest, const char* src)
+{
+    size_t cnt;
+    if (FAILED(StringCchLength(pszDest, cchDest, &cnt)))
+        return FALSE;
+    pszDest += cnt;
+    cchDest -= cnt;
+
+    DWORD dwErrorCode = ERROR_NO_UNICODE_TRANSLATION;
+#ifdef UNICODE
+    if (decode_utf8(pszDest, cchDest, src, &dwErrorCode))
+        return TRUE;
+#else
+    // ASCII is the same in any ANSI codepage
+    for (size_t i = 0; i < cchDest && (unsigned char)src[i] < 0x80; ++i)
+        if (!(pszDest[i] = src[i]))
+            return TRUE;
+
+    // note: destination is never longer than MAX_PATH
+    WCHAR tmp[MAX_PATH];
+    if (decode_utf8(tmp, cchDest < COUNT(tmp) ? cchDest : COUNT(tmp), src,
+        &dwErrorCode))
+        return (WideCharToMultiByte(CP_ACP, 0, tmp, -1, pszDest, (int)cchDest,
+            NULL, NULL) > 0);
+#endif // UNICODE
+
+    SetLastError(dwErrorCode);
+    return FALSE;
+}
+
+
+// replaces all occurences of a char in a string
+static void replace_char(PTSTR psz, TCHAR cTo, TCHAR cFrom)
+{
+#if defined(VEC_BYTES)
+    VEC vTo = vec_setT(cTo), vFrom = vec_setT(cFrom), vNul = vec_setT(0);
+#endif // VEC_BYTES
+
+    while (*psz) {
+#if defined(VEC_BYTES)
+        // whole vectors up to the one holding terminator
+        if (PAGE_SAFE(psz)) {
+            VEC v = vec_load(psz);
+            if (!vec_mask(vec_eqT(v, vNul))) {
+                vec_store(psz, vec_blend(v, vTo, vec_eqT(v, vFrom)));
+                psz += VEC_BYTES / sizeof(TCHAR);
+                continue;
+            }
+        }
+#endif // VEC_BYTES
+        if (*psz == cFrom)
+            *psz = cTo;
+        ++psz;
+    }
+}
+
+
+// hashes raw bytes
+ULONGLONG hash_bytes(ULONGLONG h, const void* p, size_t n)
+{
+    const unsigned char* cp = p;
+    while (n--)
+        h = (h ^ *cp++) * FNV_PRIME;
+    return h;
+}
+
+
+// hashes TCHAR string ignoring ASCII case
+ULONGLONG hash_string(ULONGLONG h, PCTSTR psz)
+{
+    for ( ; *psz; ++psz) {
+        TBYTE c = (TBYTE)*psz;
+        if ('a' <= c && c <= 'z')
+            c -= 'a' - 'A';
+        h = (h ^ c) * FNV_PRIME;
+    }
+    return h;
+}
+
+
+// quotes argument per MSVCRT rules if needed; returns number of chars required,
+// writes them unless pszTo is NULL
+static size_t quote_arg(PTSTR pszTo, PCTSTR pszArg, size_t cchArg)
+{
+    BOOL quote = !cchArg;
+    for (size_t i = 0; i < cchArg && !quote; ++i)
+        quote = (pszArg[i] == TEXT(' ') || pszArg[i] == TEXT('\t')
+            || pszArg[i] == TEXT('\n') || pszArg[i] == TEXT('\v')
+            || pszArg[i] == TEXT('"'));
+
+    size_t cch = 0;
+    if (!quote) {
+        for ( ; cch < cchArg; ++cch)
+            if (pszTo)
+                pszTo[cch] = pszArg[cch];
+        return cch;
+    }
+
+    // backslashes are doubled only before a quote, escaped quote or the end
+    if (pszTo)
+        pszTo[cch] = TEXT('"');
+    ++cch;
+    for (size_t i = 0; i <= cchArg; ++i) {
+        size_t n = 0;
+        for ( ; i < cchArg && pszArg[i] == TEXT('\\'); ++i)
+            ++n;
+        if (i == cchArg || pszArg[i] == TEXT('"'))
+            n = 2 * n + (i < cchArg);
+        for ( ; n; --n, ++cch)
+            if (pszTo)
+                pszTo[cch] = TEXT('\\');
+        if (pszTo)
+            pszTo[cch] = (i < cchArg) ? pszArg[i] : TEXT('"');
+        ++cch;
+    }
+    return cch;
+}
+
+
+// compares TCHAR chars with lower-case ASCII string ignoring case
+static BOOL match_ascii(PCTSTR psz, const char* lit, size_t cch)
+{
+    for ( ; cch; --cch) {
+        TBYTE c = (TBYTE)*psz++;
+        if ('A' <= c && c <= 'Z')
+            c += 'a' - 'A';
+        if (c != (TBYTE)*lit++)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+
+#if !defined(PIN_LAYER)
+// classifies PATH entry in a single backward pass; same as matching against
+// "*\msys*\<layer>\bin" for each MSYS layer and then "*\cygwin*\bin"
+static int match_root(PCTSTR psz, size_t cch, size_t* pcchRoot)
+{
+    // MSYS layer directories in POSIX_* order
+    static const struct {
+        const char* name;
+        size_t cch;
+    } sLayer[POSIX_CYGWIN] = {
+        { ARRAY1("clangarm64") },
+        { ARRAY1("mingw32") },
+        { ARRAY1("mingw64") },
+        { ARRAY1("ucrt64") },
+        { ARRAY1("clang32") },
+        { ARRAY1("clang64") },
+        { ARRAY1("usr") }
+    };
+
+    // *\bin
+    if (cch < COUNT1("\\bin")
+        || !match_ascii(psz + cch - COUNT1("\\bin"), ARRAY1("\\bin")))
+        return POSIX_UNKNOWN;
+    size_t end = cch - COUNT1("\\bin");
+
+    // find layer directory and look for \msys* before it or \cygwin* anywhere;
+    // note: no match can cross psz[end] as it is a backslash
+    size_t layer = end;
+    BOOL msys = FALSE, cygwin = FALSE;
+    for (size_t i = end; i--; ) {
+        if (psz[i] != TEXT('\\'))
+            continue;
+        if (layer == end)
+            layer = i;
+        else if (!msys)
+            msys = match_ascii(psz + i + 1, ARRAY1("msys"));
+        if (!cygwin)
+            cygwin = match_ascii(psz + i + 1, ARRAY1("cygwin"));
+    }
+
+    // MSYS layers take precedence over Cygwin
+    if (msys) {
+        for (int i = 0; i < (int)COUNT(sLayer); ++i) {
+            if (end - layer - 1 == sLayer[i].cch
+                && match_ascii(psz + layer + 1, sLayer[i].name, sLayer[i].cch)) {
+                *pcchRoot = layer;
+                return i;
+            }
+        }
+    }
+    if (cygwin) {
+        *pcchRoot = end;
+        return POSIX_CYGWIN;
+    }
+
+    return POSIX_UNKNOWN;
+}
+
+
+// takes POSIX root from PATH entry unless found already
+static void find_root(POSIX* ppx, PCTSTR pszEntry, size_t cch)
+{
+    size_t cchRoot;
+    if (ppx->sys == POSIX_UNKNOWN
+        && (ppx->sys = match_root(pszEntry, cch, &cchRoot)) != POSIX_UNKNOWN)
+        StringCchCopyN(ARRAY(ppx->root), pszEntry, cchRoot);
+}
+#else
+#define find_root(ppx, pszEntry, cch)   ((void)(ppx))
+#endif // PIN_LAYER
+
+
+// gets process environment block: it's copied once on first use and then shared
+PCTSTR get_env_block(void)
+{
+    static PTSTR volatile pszEnv;
+
+    // note: no need to free environment block before exit
+    PTSTR psz = pszEnv;
+    if (!psz && (psz = GetEnvironmentStrings()) != NULL) {
+        // prefetch thread may race us here; the loser frees its copy
+        PTSTR pszOld = InterlockedCompareExchangePointer((PVOID volatile*)&pszEnv, psz,
+            NULL);
+        if (pszOld) {
+            FreeEnvironmentStrings(psz);
+            psz = pszOld;
+        }
+    }
+    return psz;
+}
+
+
+// gets variable value from the process environment block;
+// name is lower-case ASCII followed by '='
+PCTSTR get_env(const char* pszName, size_t cchName)
+{
+    for (PCTSTR psz = get_env_block(); psz && *psz; psz += lstrlen(psz) + 1)
+        if (match_ascii(psz, pszName, cchName))
+            return psz + cchName;
+
+    return NULL;
+}
+
+
+// gets shebang.ini path next to our executable
+BOOL get_ini_path(PTSTR pszIni, size_t cchIni)
+{
+    return GetModuleFileName(NULL, pszIni, (DWORD)cchIni) < cchIni
+        && PathRemoveFileSpec(pszIni) && PathAppend(pszIni, TEXT(PROGRAM_NAME ".ini"));
+}
+
+
+// hashes settings that resolution depends on: pinned layer and root, shebang.ini
+// path and modification time
+ULONGLONG hash_settings(ULONGLONG h)
+{
+#if defined(PIN_LAYER)
+    h = hash_bytes(hash_string(h, TEXT(PIN_ROOT)), &(int){PIN_SYS}, sizeof(int));
+#endif // PIN_LAYER
+    TCHAR szIni[MAX_PATH];
+    WIN32_FILE_ATTRIBUTE_DATA fad;
+    if (get_ini_path(ARRAY(szIni))) {
+        h = hash_string(h, szIni);
+        if (GetFileAttributesEx(szIni, GetFileExInfoStandard, &fad))
+            h = hash_bytes(h, &fad.ftLastWriteTime, sizeof(FILETIME));
+    }
+    return h;
+}
+
+
+// gets next PATH entry in place, skipping empty ones; returns 0 at the end
+static size_t next_path(PCTSTR* ppsz, PCTSTR* ppszEntry)
+{
+    PCTSTR cp = *ppsz;
+
+    while (*cp) {
+        // entry ends at the first unquoted semicolon
+        PCTSTR start = cp;
+        BOOL quoted = FALSE;
+        for ( ; *cp && (quoted || *cp != TEXT(';')); ++cp)
+            if (*cp == TEXT('"'))
+                quoted = !quoted;
+        size_t cch = (size_t)(cp - start);
+        if (*cp)
+            ++cp; // skip separator
+
+        // strip enclosing quotes
+        if (cch >= 2 && start[0] == TEXT('"') && start[cch - 1] == TEXT('"')) {
+            ++start;
+            cch -= 2;
+        }
+
+        if (cch) {
+            *ppsz = cp;
+            *ppszEntry = start;
+            return cch;
+        }
+    }
+
+    *ppsz = cp;
+    return 0;
+}
+
+
+// makes file name from PATH entry dropping any quotes
+static BOOL make_probe_path(PTSTR pszTo, size_t cchTo, PCTSTR pszDir, size_t cchDir,
+    PCTSTR pszName)
+{
+    size_t cch = 0;
+    for ( ; cchDir; ++pszDir, --cchDir) {
+        if (*pszDir == TEXT('"'))
+            continue;
+        if (cch + 1 >= cchTo)
+            return FALSE;
+        pszTo[cch++] = *pszDir;
+    }
+    pszTo[cch] = TEXT('\0');
+    return (cch && PathAppend(pszTo, pszName));
+}
+
+
+// checks if directory contains the file (but not a subdirectory)
+static BOOL probe_dir(PTSTR pszTo, size_t cchTo, PCTSTR pszDir, size_t cchDir,
+    PCTSTR pszName)
+{
+    if (!make_probe_path(pszTo, cchTo, pszDir, cchDir, pszName))
+        return FALSE;
+
+    DWORD dwAttr = GetFileAttributes(pszTo);
+    return (dwAttr != INVALID_FILE_ATTRIBUTES && !(dwAttr & FILE_ATTRIBUTE_DIRECTORY));
+}
+
+
+// gets directories PathFindOnPath searches before PATH
+#define SYSTEM_DIRS     3
+static void get_system_dirs(TCHAR achDir[SYSTEM_DIRS][MAX_PATH])
+{
+    if (!GetSystemDirectory(achDir[0], MAX_PATH))
+        achDir[0][0] = TEXT('\0');
+    if (!GetWindowsDirectory(achDir[2], MAX_PATH)
+        || FAILED(StringCchCopy(achDir[1], MAX_PATH, achDir[2]))
+        || !PathAppend(achDir[1], TEXT("System")))
+        achDir[1][0] = achDir[2][0] = TEXT('\0');
+}
+
+
+#if !defined(NOINDEX)
+// PATH index geometry
+#define INDEX_MAGIC     0x53490002UL    // "SI" + version
+#define INDEX_DIRS      256
+#define INDEX_NAMES     65536
+#define INDEX_TTL       1000            // ms a checked directory is trusted for
+#define FILETIME_NONE(ft)   (!(ft).dwLowDateTime && !(ft).dwHighDateTime)
+
+// indexed directory
+typedef struct {
+    ULONGLONG hash;             // hash of directory name; zero if slot is free
+    LONGLONG volatile checked;  // tick count when modification time was checked
+    FILETIME ft;                // directory modification time; zero if none
+    DWORD gen;                  // generation of its names; zero if not indexed
+} INDEX_DIR;
+
+// indexed file name
+typedef struct {
+    ULONGLONG hash;             // hash of file name; zero if slot is free
+    WORD dir;                   // directory slot
+    DWORD gen;                  // stale unless matches directory generation
+} INDEX_NAME;
+
+// memory-mapped index file: open addressing hash tables
+typedef struct {
+    DWORD magic;                // INDEX_MAGIC
+    DWORD used;                 // name slots taken, stale ones included
+    DWORD gen;                  // last generation issued
+    INDEX_DIR dir[INDEX_DIRS];
+    INDEX_NAME name[INDEX_NAMES];
+} INDEX_FILE;
+
+// persistent PATH index
+typedef struct shebang_index {
+    HANDLE hFile;
+    INDEX_FILE* pif;            // NULL if not available
+    BOOL recent;                // a miss relied on directory checked earlier
+    BOOL recheck;               // check every directory regardless of time
+    BOOL shared;                // shared lock is held till the scan ends
+} INDEX;
+
+// index lookup results
+enum { INDEX_MISSING, INDEX_FOUND, INDEX_RECENT, INDEX_UNKNOWN, INDEX_STALE };
+
+
+// hashes file name ignoring case
+static ULONGLONG hash_name(PCTSTR pszName)
+{
+    TCHAR tmp[MAX_PATH];
+    StringCchCopy(ARRAY(tmp), pszName);
+    DWORD cch = CharUpperBuff(tmp, (DWORD)lstrlen(tmp));
+    return hash_bytes(FNV_BASIS, tmp, cch * sizeof(TCHAR)) | 1; // never zero
+}
+
+
+// opens persistent PATH index once per context; returns NULL if not available
+static INDEX* open_index(SHEBANG* psb)
+{
+    INDEX* pidx = psb->pidx;
+    if (pidx)
+        return pidx->pif ? pidx : NULL;
+    if (!(pidx = psb->pidx = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(INDEX))))
+        return NULL;
+
+    // map index file from %TEMP%
+    TCHAR tmp[MAX_PATH];
+    if (!GetTempPath(COUNT(tmp), tmp)
+        || FAILED(StringCchCat(ARRAY(tmp), TEXT(PROGRAM_NAME ".index"))))
+        return NULL;
+    pidx->hFile = CreateFile(tmp, GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    if (pidx->hFile == INVALID_HANDLE_VALUE)
+        return NULL;
+    HANDLE hMap = CreateFileMapping(pidx->hFile, NULL, PAGE_READWRITE, 0,
+        sizeof(INDEX_FILE), NULL);
+    if (hMap) {
+        pidx->pif = MapViewOfFile(hMap, FILE_MAP_WRITE, 0, 0, 0);
+        CloseHandle(hMap); // view keeps mapping alive
+    }
+
+    return pidx->pif ? pidx : NULL;
+}
+
+
+// closes persistent PATH index
+static void close_index(INDEX* pidx)
+{
+    if (pidx->pif)
+        UnmapViewOfFile(pidx->pif);
+    if (pidx->hFile && pidx->hFile != INVALID_HANDLE_VALUE)
+        CloseHandle(pidx->hFile);
+    HeapFree(GetProcessHeap(), 0, pidx);
+}
+
+
+// empties index keeping generations unique
+static void index_reset(INDEX_FILE* pif)
+{
+    DWORD gen = pif->gen;
+    zero_bytes(pif, sizeof(*pif));
+    pif->magic = INDEX_MAGIC;
+    pif->gen = gen;
+}
+
+
+// finds directory slot, optionally taking a free one; -1 if there is none
+static int index_find_dir(INDEX_FILE* pif, ULONGLONG hDir, BOOL add)
+{
+    int d = (int)(hDir % INDEX_DIRS);
+    for (int n = 0; n < INDEX_DIRS; ++n, d = (d + 1) % INDEX_DIRS) {
+        if (!pif->dir[d].hash) {
+            if (!add)
+                break;
+            pif->dir[d].hash = hDir; // not indexed yet
+        }
+        if (pif->dir[d].hash == hDir)
+            return d;
+    }
+    return -1;
+}
+
+
+// adds file name to directory; FALSE if table is full
+static BOOL index_add(INDEX_FILE* pif, int d, PCTSTR pszName)
+{
+    ULONGLONG hName = hash_name(pszName);
+    DWORD i = (DWORD)(hName % INDEX_NAMES);
+    for ( ; pif->name[i].hash; i = (i + 1) % INDEX_NAMES)
+        if (pif->name[i].gen != pif->dir[pif->name[i].dir].gen)
+            break; // reuse stale slot
+
+    if (!pif->name[i].hash && ++pif->used > INDEX_NAMES / 4 * 3)
+        return FALSE;
+    pif->name[i].hash = hName;
+    pif->name[i].dir = (WORD)d;
+    pif->name[i].gen = pif->dir[d].gen;
+    return TRUE;
+}
+
+
+// indexes directory files under new generation; FALSE if table is full
+static BOOL index_rebuild(INDEX_FILE* pif, int d, PCTSTR pszDir)
+{
+    pif->dir[d].gen = ++pif->gen; // old names become stale
+
+    TCHAR tmp[MAX_PATH];
+    WIN32_FIND_DATA fd;
+    HANDLE hFind;
+    if (FAILED(StringCchCopy(ARRAY(tmp), pszDir)) || !PathAppend(tmp, TEXT("*"))
+        || (hFind = FindFirstFile(tmp, &fd)) == INVALID_HANDLE_VALUE)
+        return TRUE; // nothing to add
+
+    BOOL ok = TRUE;
+    do {
+        if (!(fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+            ok = index_add(pif, d, fd.cFileName);
+    } while (ok && FindNextFile(hFind, &fd));
+    FindClose(hFind);
+
+    return ok;
+}
+
+
+// looks file up in directory index, checking modification time unless it was
+// checked recently; returns INDEX_STALE if index must be updated, which is only
+// done with update set
+static int index_lookup(INDEX* pidx, PCTSTR pszDir, ULONGLONG hDir, ULONGLONG hName,
+    BOOL update)
+{
+    INDEX_FILE* pif = pidx->pif;
+    int d = (pif->magic == INDEX_MAGIC) ? index_find_dir(pif, hDir, update) : -1;
+    if (d < 0) {
+        if (!update)
+            return INDEX_STALE;
+        index_reset(pif);
+        d = index_find_dir(pif, hDir, TRUE);
+    }
+
+    // note: readers share the lock, so check time is stored atomically
+    LONGLONG now = (LONGLONG)GetTickCount64();
+    BOOL checked = pidx->recheck || (ULONGLONG)(now - pif->dir[d].checked) >= INDEX_TTL;
+    if (checked) {
+        WIN32_FILE_ATTRIBUTE_DATA fad;
+        if (!GetFileAttributesEx(pszDir, GetFileExInfoStandard, &fad)
+            || !(fad.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+            fad.ftLastWriteTime = (FILETIME){0}; // no directory, no files
+        if (compare_bytes(&fad.ftLastWriteTime, &pif->dir[d].ft, sizeof(FILETIME))) {
+            if (!update)
+                return INDEX_STALE;
+            if (FILETIME_NONE(fad.ftLastWriteTime))
+                pif->dir[d].gen = 0;
+            else if (!index_rebuild(pif, d, pszDir)) {
+                // start over; give up if directory alone won't fit
+                index_reset(pif);
+                d = index_find_dir(pif, hDir, TRUE);
+                if (!index_rebuild(pif, d, pszDir)) {
+                    index_reset(pif);
+                    d = index_find_dir(pif, hDir, TRUE);
+                }
+            }
+            pif->dir[d].ft = fad.ftLastWriteTime;
+        }
+        InterlockedExchange64(&pif->dir[d].checked, now);
+    }
+
+    if (!pif->dir[d].gen) {
+        if (!FILETIME_NONE(pif->dir[d].ft))
+            return INDEX_UNKNOWN; // too big, remembered until modified
+    } else {
+        for (DWORD i = (DWORD)(hName % INDEX_NAMES); pif->name[i].hash;
+            i = (i + 1) % INDEX_NAMES)
+            if (pif->name[i].hash == hName && pif->name[i].dir == d
+                && pif->name[i].gen == pif->dir[d].gen)
+                return checked ? INDEX_FOUND : INDEX_RECENT;
+    }
+
+    if (!checked)
+        pidx->recent = TRUE;
+    return INDEX_MISSING;
+}
+
+
+// drops shared lock held for the scan
+static void index_unlock(INDEX* pidx)
+{
+    OVERLAPPED ov = {0};
+    if (pidx->shared)
+        UnlockFileEx(pidx->hFile, 0, sizeof(INDEX_FILE), 0, &ov);
+    pidx->shared = FALSE;
+}
+
+
+// checks if directory contains the file using persistent PATH index
+static BOOL index_probe(SHEBANG* psb, PTSTR pszTo, size_t cchTo, PCTSTR pszDir,
+    size_t cchDir, PCTSTR pszName)
+{
+    INDEX* pidx = open_index(psb);
+    if (!pidx)
+        return probe_dir(pszTo, cchTo, pszDir, cchDir, pszName);
+
+    TCHAR szDir[MAX_PATH];
+    if (!make_probe_path(pszTo, cchTo, pszDir, cchDir, pszName)
+        || FAILED(StringCchCopy(ARRAY(szDir), pszTo)) || !PathRemoveFileSpec(szDir))
+        return FALSE;
+    ULONGLONG hDir = hash_name(szDir), hName = hash_name(pszName);
+
+    // lookups share the lock, held across the scan to save a pair of system calls
+    // per directory; it is taken exclusively only to update index
+    int found = INDEX_UNKNOWN;
+    OVERLAPPED ov = {0};
+    if (pidx->shared || (pidx->shared = LockFileEx(pidx->hFile, 0, 0,
+        sizeof(INDEX_FILE), 0, &ov)))
+        found = index_lookup(pidx, szDir, hDir, hName, FALSE);
+    if (found == INDEX_STALE) {
+        index_unlock(pidx);
+        found = INDEX_UNKNOWN;
+        if (LockFileEx(pidx->hFile, LOCKFILE_EXCLUSIVE_LOCK, 0, sizeof(INDEX_FILE), 0,
+            &ov)) {
+            found = index_lookup(pidx, szDir, hDir, hName, TRUE);
+            UnlockFileEx(pidx->hFile, 0, sizeof(INDEX_FILE), 0, &ov);
+        }
+    }
+
+    // file found in directory not checked just now may be gone since; slow disk
+    // must not hold up index updates
+    if (found == INDEX_RECENT || found == INDEX_UNKNOWN) {
+        index_unlock(pidx);
+        return probe_dir(pszTo, cchTo, pszDir, cchDir, pszName);
+    }
+    return (found == INDEX_FOUND);
+}
+
+
+// ends a scan and sets index to check every directory for a rescan; returns FALSE
+// if no miss relied on earlier check, so that rescan won't change anything
+static BOOL index_recheck(SHEBANG* psb, BOOL on)
+{
+    INDEX* pidx = psb->pidx;
+    if (pidx)
+        index_unlock(pidx);
+    if (!pidx || (on && !pidx->recent))
+        return FALSE;
+    pidx->recent = FALSE;
+    pidx->recheck = on;
+    return TRUE;
+}
+#else
+#define index_probe(psb, ...)   ((void)(psb), probe_dir(__VA_ARGS__))
+#define close_index(pidx)       ((void)(pidx))
+
+// no index, nothing to recheck
+static BOOL index_recheck(SHEBANG* psb, BOOL on)
+{
+    (void)psb;
+    (void)on;
+    return FALSE;
+}
+#endif // NOINDEX
+
+
+// probe job states
+enum { PROBE_PENDING, PROBE_RUNNING, PROBE_FOUND, PROBE_MISSING, PROBE_SKIPPED };
+
+// checks if directory contains the file
+typedef BOOL (*PROBE_FUNC)(PTSTR, size_t, PCTSTR, size_t, PCTSTR);
+
+// directory probe job
+typedef struct {
+    PCTSTR pszDir;
+    size_t cchDir;
+    volatile LONG state;
+} PROBE;
+
+// parallel probe pool; stuck workers may outlive find_posix, so the last one to
+// drop its reference frees it
+typedef struct {
+    PROBE_FUNC pfn;
+    volatile LONG refs;     // caller and running workers
+    volatile LONG next;     // next job to claim
+    volatile LONG best;     // lowest job found so far; workers stop past it
+    LONG cnt;               // number of jobs
+    HANDLE hEvent;          // signaled whenever a job completes
+    TCHAR szName[MAX_PATH];
+    TCHAR achDir[SYSTEM_DIRS][MAX_PATH];
+    PROBE job[];
+} PROBE_POOL;
+
+
+// runs a claimed probe job
+static void run_probe(PROBE_POOL* pp, LONG i)
+{
+    TCHAR tmp[MAX_PATH];
+    BOOL found = pp->pfn(ARRAY(tmp), pp->job[i].pszDir, pp->job[i].cchDir, pp->szName);
+
+    // job skipped meanwhile as too slow is no match any more
+    if (InterlockedCompareExchange(&pp->job[i].state, found ? PROBE_FOUND
+        : PROBE_MISSING, PROBE_RUNNING) != PROBE_RUNNING)
+        found = FALSE;
+
+    // lower best match
+    for (LONG best; found && (best = pp->best) > i; )
+        if (InterlockedCompareExchange(&pp->best, i, best) == best)
+            break;
+
+    SetEvent(pp->hEvent);
+}
+
+
+// drops a reference to probe pool; the last one frees it
+static void release_pool(PROBE_POOL* pp)
+{
+    if (InterlockedDecrement(&pp->refs) == 0) {
+        if (pp->hEvent)
+            CloseHandle(pp->hEvent);
+        HeapFree(GetProcessHeap(), 0, pp);
+    }
+}
+
+
+// claims and runs probe jobs in order
+static DWORD WINAPI probe_worker(LPVOID pv)
+{
+    PROBE_POOL* pp = pv;
+
+    for (LONG i; (i = InterlockedIncrement(&pp->next) - 1) < pp->cnt && i < pp->best; )
+        if (InterlockedCompareExchange(&pp->job[i].state, PROBE_RUNNING, PROBE_PENDING)
+            == PROBE_PENDING)
+            run_probe(pp, i);
+
+    release_pool(pp);
+    return 0;
+}
+
+
+// starts one more worker; returns FALSE on failure
+static BOOL start_worker(PROBE_POOL* pp)
+{
+    InterlockedIncrement(&pp->refs);
+    HANDLE hThread = CreateThread(NULL, 0, probe_worker, pp, 0, NULL);
+    if (!hThread) {
+        InterlockedDecrement(&pp->refs); // caller still holds it
+        return FALSE;
+    }
+    CloseHandle(hThread);
+    return TRUE;
+}
+
+
+// probes all directories with a bounded thread pool; returns lowest index of the
+// directory containing the file, skipping those slower than dwTimeout ms (if any);
+// pool is held by the caller, who releases it after
+static LONG probe_parallel(PROBE_POOL* pp, int nThreads, DWORD dwTimeout)
+{
+    pp->refs = 1;
+    pp->next = 0;
+    pp->best = pp->cnt;
+    if (!(pp->hEvent = CreateEvent(NULL, FALSE, FALSE, NULL)))
+        nThreads = 0; // nothing to wait for, do it ourselves
+
+    // start workers
+    int cnt = 0;
+    for ( ; cnt < nThreads && cnt < pp->cnt && start_worker(pp); ++cnt) ;
+
+    // take results in order
+    LONG i = 0;
+    DWORD dwWaitStart = GetTickCount();
+    while (i < pp->cnt) {
+        LONG state = pp->job[i].state;
+        if (state == PROBE_FOUND)
+            break;
+        if (state != PROBE_MISSING) {
+            // wait for workers
+            DWORD dwElapsed = GetTickCount() - dwWaitStart;
+            if (cnt && (!dwTimeout || dwElapsed < dwTimeout)) {
+                WaitForSingleObject(pp->hEvent, dwTimeout ? dwTimeout - dwElapsed
+                    : INFINITE);
+                continue;
+            }
+
+            // not started in time, run it here
+            if (state == PROBE_PENDING) {
+                if (InterlockedCompareExchange(&pp->job[i].state, PROBE_RUNNING,
+                    PROBE_PENDING) == PROBE_PENDING)
+                    run_probe(pp, i);
+                else // just started by worker
+                    dwWaitStart = GetTickCount();
+                continue;
+            }
+
+            // too slow: skip it unless just done and replace stuck worker
+            if (InterlockedCompareExchange(&pp->job[i].state, PROBE_SKIPPED,
+                PROBE_RUNNING) != PROBE_RUNNING)
+                continue;
+            if (cnt < 2 * nThreads && start_worker(pp))
+                ++cnt;
+        }
+
+        // try next one
+        ++i;
+        dwWaitStart = GetTickCount();
+    }
+
+    // cancel outstanding jobs
+    InterlockedExchange(&pp->best, -1);
+    return i;
+}
+
+
+// finds POSIX installation and the script probing directories in parallel
+static BOOL find_posix_parallel(POSIX* ppx, PCTSTR pszName, PTSTR pszScript,
+    size_t cchScript, PCTSTR pszProbe)
+{
+    // count jobs: system directories and PATH entries
+    PCTSTR pszPATH = get_env(ARRAY1("path=")), pszEntry;
+    LONG cnt = SYSTEM_DIRS;
+    for (PCTSTR psz = pszPATH; psz && next_path(&psz, &pszEntry); ++cnt) ;
+
+    PROBE_POOL* pp = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(PROBE_POOL) + cnt * sizeof(PROBE));
+    if (!pp)
+        return FALSE;
+    if (FAILED(StringCchCopy(ARRAY(pp->szName), pszName))) {
+        HeapFree(GetProcessHeap(), 0, pp);
+        return FALSE;
+    }
+    pp->pfn = probe_dir;
+
+    // system directories go first
+    get_system_dirs(pp->achDir);
+    for (int i = 0; i < SYSTEM_DIRS; ++i) {
+        pp->job[pp->cnt].pszDir = pp->achDir[i];
+        pp->job[pp->cnt++].cchDir = (size_t)lstrlen(pp->achDir[i]);
+    }
+
+    // then PATH; find first path matching one of the patterns on the way
+    size_t cch;
+    while (pszPATH && pp->cnt < cnt && (cch = next_path(&pszPATH, &pszEntry))) {
+        find_root(ppx, pszEntry, cch);
+        pp->job[pp->cnt].pszDir = pszEntry;
+        pp->job[pp->cnt++].cchDir = cch;
+    }
+
+    // SHEBANG_PROBE=threads[,timeout]
+    PCTSTR pszTimeout = StrChr(pszProbe, TEXT(','));
+    LONG i = probe_parallel(pp, StrToInt(pszProbe),
+        pszTimeout ? (DWORD)StrToInt(pszTimeout + 1) : 0);
+    BOOL found = (i < pp->cnt && make_probe_path(pszScript, cchScript,
+        pp->job[i].pszDir, pp->job[i].cchDir, pszName));
+    release_pool(pp);
+    return found;
+}
+
+
+// finds active MSYS/Cygwin installation unless known already and the script by
+// scanning PATH once
+static BOOL find_posix(SHEBANG* psb, PCTSTR pszName, PTSTR pszScript,
+    size_t cchScript)
+{
+    // nothing found yet
+    BOOL found = FALSE;
+
+    // optional parallel mode
+    PCTSTR pszProbe = get_env(ARRAY1("shebang_probe="));
+    if (pszProbe && StrToInt(pszProbe) > 1)
+        return find_posix_parallel(&psb->px, pszName, pszScript, cchScript,
+            pszProbe);
+
+    // misses may rely on directories checked a moment ago; if nothing is found,
+    // scan again checking all of them
+    TCHAR achDir[SYSTEM_DIRS][MAX_PATH];
+    get_system_dirs(achDir);
+    index_recheck(psb, FALSE);
+    do {
+        // same as PathFindOnPath: system directories go before PATH
+        for (int i = 0; i < (int)COUNT(achDir) && !found; ++i)
+            found = index_probe(psb, pszScript, cchScript, achDir[i],
+                lstrlen(achDir[i]), pszName);
+
+        // find first path matching one of the patterns and first path with the
+        // script
+        PCTSTR pszPATH = get_env(ARRAY1("path=")), pszEntry;
+        size_t cch;
+        while (pszPATH && (cch = next_path(&pszPATH, &pszEntry))) {
+            find_root(&psb->px, pszEntry, cch);
+            if (!found)
+                found = index_probe(psb, pszScript, cchScript, pszEntry, cch, pszName);
+
+            if (found && psb->px.sys != POSIX_UNKNOWN)
+                break; // early exit
+        }
+    } while (!found && index_recheck(psb, TRUE));
+    index_recheck(psb, FALSE);
+
+    return found;
+}
+
+
+// compares variable names ignoring case, same order as in environment block
+static int compare_names(PCTSTR psz1, PCTSTR psz2)
+{
+    for (size_t i = 0; ; ++i) {
+        TBYTE c1 = (TBYTE)psz1[i];
+        TBYTE c2 = (TBYTE)psz2[i];
+        if (i && c1 == '=')
+            c1 = '\0'; // name ends at '=' but "=C:" is a name too
+        if (i && c2 == '=')
+            c2 = '\0';
+        if ('a' <= c1 && c1 <= 'z')
+            c1 -= 'a' - 'A';
+        if ('a' <= c2 && c2 <= 'z')
+            c2 -= 'a' - 'A';
+        if (c1 != c2 || !c1)
+            return (c1 - c2);
+    }
+}
+
+
+// appends NAME=value (or NAME alone to remove variable) to the list
+static BOOL add_env(PTSTR* ppsz, size_t* pcch, PCTSTR pszName, PCTSTR pszValue)
+{
+    if (FAILED(StringCchCopyEx(*ppsz, *pcch, pszName, ppsz, pcch, 0))
+        || (pszValue && (FAILED(StringCchCatEx(*ppsz, *pcch, TEXT("="), ppsz, pcch, 0))
+            || FAILED(StringCchCatEx(*ppsz, *pcch, pszValue, ppsz, pcch, 0))))
+        || *pcch < 2)
+        return FALSE;
+
+    *++*ppsz = TEXT('\0'); // list terminator
+    --*pcch;
+    return TRUE;
+}
+
+
+// runtime configuration from shebang.ini, saved in %TEMP% until it is modified;
+// followed by [environment] and [interpreters] lines, each ending with extra NUL
+#define CONFIG_MAGIC    (0x53430000UL | sizeof(TCHAR)) // "SC" + char size
+#define CONFIG_MAX      (1024 * 1024)
+typedef struct shebang_config {
+    DWORD magic;                // CONFIG_MAGIC
+    DWORD cb;                   // total size
+    ULONGLONG hash;             // hash of what follows
+    ULONGLONG hIni;             // hash of shebang.ini name
+    FILETIME ftIni;             // shebang.ini modification time
+    DWORD cbIni;                // shebang.ini size
+    int sys;                    // [posix] layer or POSIX_UNKNOWN
+    TCHAR root[MAX_PATH];       // [posix] root
+    DWORD cchEnv;               // [environment] chars without extra NUL
+    DWORD cchSubst;             // [interpreters] chars without extra NUL
+} CONFIG;
+// NAME=value lines and interpreter rules
+#define CONFIG_ENV(pc)      ((PCTSTR)((pc) + 1))
+#define CONFIG_SUBST(pc)    (CONFIG_ENV(pc) + (pc)->cchEnv + 1)
+
+
+// gets shebang.ini section lines; free them with HeapFree
+static PTSTR get_ini_section(PCTSTR pszIni, PCTSTR pszSection, DWORD* pcch)
+{
+    HANDLE hHeap = GetProcessHeap();
+    for (DWORD cchBuf = 1024; ; cchBuf *= 2) {
+        PTSTR pszBuf = HeapAlloc(hHeap, 0, cchBuf * sizeof(TCHAR));
+        if (!pszBuf)
+            return NULL;
+        *pcch = GetPrivateProfileSection(pszSection, pszBuf, cchBuf, pszIni);
+        if (*pcch < cchBuf - 2)
+            return pszBuf; // fits
+        HeapFree(hHeap, 0, pszBuf);
+    }
+}
+
+
+// parses shebang.ini into configuration; free it with HeapFree
+static CONFIG* parse_config(PCTSTR pszIni)
+{
+    // MSYSTEM values
+    static const char* const pcLayer[POSIX_COUNT] = {
+        "clangarm64", "mingw32", "mingw64", "ucrt64", "clang32", "clang64", "msys",
+        "cygwin", "native"
+    };
+
+    HANDLE hHeap = GetProcessHeap();
+    DWORD cchEnv = 0, cchSubst = 0;
+    PTSTR pszEnv = get_ini_section(pszIni, TEXT("environment"), &cchEnv);
+    PTSTR pszSubst = get_ini_section(pszIni, TEXT("interpreters"), &cchSubst);
+    DWORD cb = sizeof(CONFIG) + (cchEnv + cchSubst + 2) * sizeof(TCHAR);
+    CONFIG* pc = (pszEnv && pszSubst && cb <= CONFIG_MAX) ?
+        HeapAlloc(hHeap, HEAP_ZERO_MEMORY, cb) : NULL;
+    if (pc) {
+        pc->magic = CONFIG_MAGIC;
+        pc->cb = cb;
+        pc->cchEnv = cchEnv;
+        pc->cchSubst = cchSubst;
+        copy_bytes((PTSTR)CONFIG_ENV(pc), pszEnv, cchEnv * sizeof(TCHAR));
+        copy_bytes((PTSTR)CONFIG_SUBST(pc), pszSubst, cchSubst * sizeof(TCHAR));
+
+        // both layer and root pin POSIX installation
+        TCHAR szLayer[16];
+        DWORD cch = GetPrivateProfileString(TEXT("posix"), TEXT("layer"), TEXT(""),
+            ARRAY(szLayer), pszIni);
+        pc->sys = POSIX_UNKNOWN;
+        for (int i = 0; i < POSIX_COUNT && pc->sys == POSIX_UNKNOWN; ++i)
+            if (cch == (DWORD)lstrlenA(pcLayer[i])
+                && match_ascii(szLayer, pcLayer[i], cch))
+                pc->sys = i;
+        if (!GetPrivateProfileString(TEXT("posix"), TEXT("root"), TEXT(""),
+            ARRAY(pc->root), pszIni))
+            pc->sys = POSIX_UNKNOWN;
+    }
+
+    HeapFree(hHeap, 0, pszEnv);
+    HeapFree(hHeap, 0, pszSubst);
+    return pc;
+}
+
+
+// empty configuration
+static const struct {
+    CONFIG cfg;
+    TCHAR lines[2];
+} noConfig = { .cfg = { .sys = POSIX_UNKNOWN } };
+
+
+// loads runtime configuration; empty if there is no shebang.ini, else free it with
+// HeapFree
+static const CONFIG* load_config(void)
+{
+    const CONFIG* pcfg = &noConfig.cfg;
+    TCHAR szIni[MAX_PATH];
+    WIN32_FILE_ATTRIBUTE_DATA fad;
+    if (!get_ini_path(ARRAY(szIni))
+        || !GetFileAttributesEx(szIni, GetFileExInfoStandard, &fad)
+        || (fad.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+        return pcfg;
+    ULONGLONG hIni = hash_string(FNV_BASIS, szIni);
+
+    // try saved one
+    HANDLE hHeap = GetProcessHeap();
+    TCHAR tmp[MAX_PATH];
+    CONFIG* pc = NULL;
+    DWORD cb = 0;
+    if (!GetTempPath(COUNT(tmp), tmp)
+        || FAILED(StringCchCat(ARRAY(tmp), TEXT(PROGRAM_NAME ".config"))))
+        tmp[0] = TEXT('\0');
+    HANDLE hFile = CreateFile(tmp, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile != INVALID_HANDLE_VALUE) {
+        DWORD cbFile = GetFileSize(hFile, NULL);
+        if (cbFile >= sizeof(CONFIG) && cbFile <= CONFIG_MAX
+            && (pc = HeapAlloc(hHeap, 0, cbFile)))
+            ReadFile(hFile, pc, cbFile, &cb, NULL);
+        CloseHandle(hFile);
+    }
+    if (pc && cb >= sizeof(CONFIG) && pc->magic == CONFIG_MAGIC && pc->cb == cb
+        && pc->hash == hash_bytes(FNV_BASIS, &pc->hash + 1, cb - sizeof(DWORD) * 2
+            - sizeof(ULONGLONG))
+        && pc->cchEnv <= cb / sizeof(TCHAR) && pc->cchSubst <= cb / sizeof(TCHAR)
+        && sizeof(CONFIG) + (pc->cchEnv + pc->cchSubst + 2) * sizeof(TCHAR) == cb
+        && pc->hIni == hIni && pc->cbIni == fad.nFileSizeLow
+        && !CompareFileTime(&pc->ftIni, &fad.ftLastWriteTime))
+        return pc;
+    HeapFree(hHeap, 0, pc);
+
+    // parse and save it
+    if (!(pc = parse_config(szIni)))
+        return pcfg;
+    pc->hIni = hIni;
+    pc->ftIni = fad.ftLastWriteTime;
+    pc->cbIni = fad.nFileSizeLow;
+    pc->hash = hash_bytes(FNV_BASIS, &pc->hash + 1, pc->cb - sizeof(DWORD) * 2
+        - sizeof(ULONGLONG));
+    hFile = CreateFile(tmp, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile != INVALID_HANDLE_VALUE) {
+        WriteFile(hFile, pc, pc->cb, &cb, NULL);
+        CloseHandle(hFile);
+    }
+    return pc;
+}
+
+
+// checks if configuration sets or removes the variable
+static BOOL config_has_env(const CONFIG* pc, PCTSTR pszName)
+{
+    for (PCTSTR psz = CONFIG_ENV(pc); *psz; psz += lstrlen(psz) + 1)
+        if (!compare_names(psz, pszName))
+            return TRUE;
+
+    return FALSE;
+}
+
+
+// host name saved across launches
+#define HOST_MAGIC      (0x53480000UL | sizeof(TCHAR)) // "SH" + char size
+typedef struct {
+    DWORD magic;                // HOST_MAGIC
+    ULONGLONG boot;             // boot time in seconds
+    TCHAR szHost[256];
+} HOST;
+
+
+// gets host name; saved in %TEMP% until reboot as its lookup may stall
+static BOOL get_hostname(PTSTR pszHost, size_t cchHost)
+{
+    // note: boot time drifts on GetTickCount() wrap, that's merely a cache miss
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    ULONGLONG boot = (((ULONGLONG)ft.dwHighDateTime << 32 | ft.dwLowDateTime)
+        / 10000 - GetTickCount()) / 1000;
+
+    // try saved one
+    TCHAR tmp[MAX_PATH];
+    HOST host;
+    DWORD cb = 0;
+    if (!GetTempPath(COUNT(tmp), tmp)
+        || FAILED(StringCchCat(ARRAY(tmp), TEXT(PROGRAM_NAME ".host"))))
+        tmp[0] = TEXT('\0');
+    HANDLE hFile = CreateFile(tmp, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile != INVALID_HANDLE_VALUE) {
+        ReadFile(hFile, &host, sizeof(host), &cb, NULL);
+        CloseHandle(hFile);
+    }
+    if (cb == sizeof(host) && host.magic == HOST_MAGIC
+        && host.boot + 2 >= boot && host.boot <= boot + 2) // clock jitter
+        return SUCCEEDED(StringCchCopyN(pszHost, cchHost, ARRAY(host.szHost)));
+
+    // ask system and save it
+    host = (HOST){ .magic = HOST_MAGIC, .boot = boot };
+    if (!GetComputerNameEx(ComputerNameDnsHostname, host.szHost,
+        &(DWORD){COUNT(host.szHost)}))
+        return FALSE;
+    hFile = CreateFile(tmp, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile != INVALID_HANDLE_VALUE) {
+        WriteFile(hFile, &host, sizeof(host), &cb, NULL);
+        CloseHandle(hFile);
+    }
+    return SUCCEEDED(StringCchCopy(pszHost, cchHost, host.szHost));
+}
+
+
+// loads configuration, then host name unless it won't be needed; the two are
+// waited for separately: script lookup needs the former, environment the latter
+static DWORD WINAPI prefetch_worker(LPVOID pv)
+{
+    SHEBANG* psb = pv;
+    const CONFIG* pcfg = psb->pcfg = load_config();
+    SetEvent(psb->hConfigReady);
+    if (!get_env(ARRAY1("hostname=")) && !config_has_env(pcfg, TEXT("HOSTNAME")))
+        psb->host = get_hostname(ARRAY(psb->szHost));
+    return 0;
+}
+
+
+// waits for all background startup work, so its results can be used
+static void join_prefetch(SHEBANG* psb)
+{
+    if (psb->hPrefetch) {
+        WaitForSingleObject(psb->hPrefetch, INFINITE);
+        CloseHandle(psb->hPrefetch);
+        CloseHandle(psb->hConfigReady);
+        psb->hPrefetch = psb->hConfigReady = NULL;
+    }
+}
+
+
+// gets runtime configuration, loading it once per context; prefetch is waited
+// for the configuration only
+static const CONFIG* get_config(SHEBANG* psb)
+{
+    if (psb->hConfigReady)
+        WaitForSingleObject(psb->hConfigReady, INFINITE);
+    if (!psb->pcfg)
+        psb->pcfg = load_config();
+    return psb->pcfg;
+}
+
+
+// makes MSYS/Cygwin environment variables list
+static BOOL get_posix_env(SHEBANG* psb, const POSIX* ppx, PTSTR* ppsz, size_t* pcch)
+{
+    // MSYS names and POSIX prefixes
+    static PCTSTR const pszMSYS[POSIX_COUNT][2] = {
+        { TEXT("CLANGARM64"),   TEXT("/clangarm64") },
+        { TEXT("MINGW32"),      TEXT("/mingw32") },
+        { TEXT("MINGW64"),      TEXT("/mingw64") },
+        { TEXT("UCRT64"),       TEXT("/ucrt64") },
+        { TEXT("CLANG32"),      TEXT("/clang32") },
+        { TEXT("CLANG64"),      TEXT("/clang64") },
+        { TEXT("MSYS"),         TEXT("/usr") },
+        { NULL,                 NULL },
+        { NULL,                 NULL }
+    };
+
+    // native host environment is left as is
+    int sys = POSIX_SYS(ppx);
+    if (sys == POSIX_NATIVE)
+        return TRUE;
+
+    // MSYSTEM, MSYSTEM_PREFIX and MINGW_PREFIX
+    if (!add_env(ppsz, pcch, TEXT("MSYSTEM"), pszMSYS[sys][0])
+        || !add_env(ppsz, pcch, TEXT("MSYSTEM_PREFIX"), pszMSYS[sys][1])
+        || !add_env(ppsz, pcch, TEXT("MINGW_PREFIX"),
+            sys == POSIX_MSYS ? NULL : pszMSYS[sys][1]))
+        return FALSE;
+
+    // USER and HOSTNAME unless already set or configured
+    const CONFIG* pcfg = get_config(psb);
+    TCHAR tmp[256]; // max
+    if (!get_env(ARRAY1("user=")) && !config_has_env(pcfg, TEXT("USER"))
+        && GetEnvironmentVariable(TEXT("USERNAME"), ARRAY(tmp))
+        && !add_env(ppsz, pcch, TEXT("USER"), tmp))
+        return FALSE;
+    // note: host name is looked up once per context, maybe by prefetch
+    join_prefetch(psb);
+    if (!get_env(ARRAY1("hostname=")) && !config_has_env(pcfg, TEXT("HOSTNAME"))
+        && (psb->host || (psb->host = get_hostname(ARRAY(psb->szHost))))
+        && !add_env(ppsz, pcch, TEXT("HOSTNAME"), psb->szHost))
+        return FALSE;
+
+    return TRUE;
+}
+
+
+// makes sorted environment block in one allocation merging the current one with
+// NAME=value list; NAME alone removes variable; later entries win
+PTSTR shebang_env_block(PCTSTR pszBlock, PCTSTR pszList)
+{
+    // count entries and chars
+    size_t cnt = 0, cch = 1;
+    for (PCTSTR psz = pszBlock; psz && *psz; psz += lstrlen(psz) + 1, ++cnt)
+        cch += (size_t)lstrlen(psz) + 1;
+    for (PCTSTR psz = pszList; *psz; psz += lstrlen(psz) + 1, ++cnt)
+        cch += (size_t)lstrlen(psz) + 1;
+
+    // entry pointers go after the block
+    size_t cbBlock = (cch * sizeof(TCHAR) + sizeof(PCTSTR) - 1)
+        & ~(sizeof(PCTSTR) - 1); // pointer aligned
+    PTSTR pszOut = HeapAlloc(GetProcessHeap(), 0, cbBlock + cnt * sizeof(PCTSTR));
+    if (!pszOut)
+        return NULL;
+    PCTSTR* ppsz = (PCTSTR*)((BYTE*)pszOut + cbBlock);
+    cnt = 0;
+    for (PCTSTR psz = pszBlock; psz && *psz; psz += lstrlen(psz) + 1)
+        ppsz[cnt++] = psz;
+    for (PCTSTR psz = pszList; *psz; psz += lstrlen(psz) + 1)
+        ppsz[cnt++] = psz;
+
+    // stable insertion sort: current block is mostly sorted already
+    for (size_t i = 1; i < cnt; ++i) {
+        PCTSTR psz = ppsz[i];
+        size_t j = i;
+        for ( ; j && compare_names(ppsz[j - 1], psz) > 0; --j)
+            ppsz[j] = ppsz[j - 1];
+        ppsz[j] = psz;
+    }
+
+    // copy out last one of each name
+    PTSTR pc = pszOut;
+    for (size_t i = 0; i < cnt; ++i) {
+        if (i + 1 < cnt && !compare_names(ppsz[i], ppsz[i + 1]))
+            continue; // overridden
+        PCTSTR psz = ppsz[i];
+        if (!StrChr(psz + 1, TEXT('=')))
+            continue; // removed
+        while ((*pc++ = *psz++)) ;
+    }
+    *pc = TEXT('\0');
+
+    return pszOut;
+}
+
+
+// gets <root>\etc\fstab name and modification time (zero if none)
+static BOOL get_fstab(const POSIX* ppx, PTSTR pszFstab, size_t cchFstab, FILETIME* pft)
+{
+    WIN32_FILE_ATTRIBUTE_DATA fad;
+
+    *pft = (FILETIME){0};
+    if (FAILED(StringCchCopy(pszFstab, cchFstab, ppx->root))
+        || !PathAppend(pszFstab, TEXT("etc\\fstab")))
+        return FALSE;
+    if (GetFileAttributesEx(pszFstab, GetFileExInfoStandard, &fad))
+        *pft = fad.ftLastWriteTime;
+    return TRUE;
+}
+
+
+// gets next fstab field in place, decoding octal escapes such as \040
+static char* next_field(char** pcp)
+{
+    char* cp = *pcp;
+    while (*cp == ' ' || *cp == '\t') ++cp;
+    if (!*cp || *cp == '#')
+        return NULL;
+
+    char *field = cp, *out = cp;
+    for ( ; *cp && *cp != ' ' && *cp != '\t'; ++cp) {
+        if (cp[0] == '\\' && '0' <= cp[1] && cp[1] <= '3'
+            && '0' <= cp[2] && cp[2] <= '7' && '0' <= cp[3] && cp[3] <= '7') {
+            *out++ = (char)((cp[1] - '0') << 6 | (cp[2] - '0') << 3 | (cp[3] - '0'));
+            cp += 3;
+        } else {
+            *out++ = *cp;
+        }
+    }
+    *pcp = *cp ? cp + 1 : cp;
+    *out = '\0';
+    return field;
+}
+
+
+// parses <root>\etc\fstab into mount table sorted by mount point length, longest
+// first; returns number of mounts
+static int parse_fstab(SHEBANG* psb, PCTSTR pszFstab)
+{
+    // read whole file
+    HANDLE hFile = CreateFile(pszFstab, GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return 0;
+    HANDLE hHeap = GetProcessHeap();
+    DWORD cb = GetFileSize(hFile, NULL);
+    char* buf = (cb != INVALID_FILE_SIZE) ? HeapAlloc(hHeap, 0, cb + 1) : NULL;
+    if (!(psb->pcFstab = buf) || !ReadFile(hFile, buf, cb, &cb, NULL))
+        cb = 0;
+    CloseHandle(hFile);
+    if (!cb)
+        return 0;
+    buf[cb] = '\0';
+
+    // at most one mount per line
+    int max = 1;
+    for (DWORD i = 0; i < cb; ++i) {
+        if (buf[i] == '\n' || buf[i] == '\r') {
+            buf[i] = '\0';
+            ++max;
+        }
+    }
+    MOUNT* pm = HeapAlloc(hHeap, 0, max * sizeof(MOUNT));
+    if (!(psb->pm = pm))
+        return 0;
+
+    // <win path> <mount point> <type> ...; fields get NULs, so next line is taken
+    // first
+    for (char *cp = buf, *end = buf + cb, *next; cp < end; cp = next) {
+        next = cp + lstrlenA(cp) + 1;
+        char* win = next_field(&cp);
+        char* posix = win ? next_field(&cp) : NULL;
+        char* type = posix ? next_field(&cp) : NULL;
+        if (!type || *posix != '/')
+            continue;
+
+        // only Win paths are mounted: "none" goes with cygdrive prefix (handled by
+        // convert_path), usertemp and such
+        BOOL unc = (win[0] == '/' || win[0] == '\\')
+            && (win[1] == '/' || win[1] == '\\');
+        if (!unc && !(IS_LATIN(win[0]) && win[1] == ':'))
+            continue;
+        if (!compare_bytes(type, ARRAY("cygdrive"))
+            || !compare_bytes(type, ARRAY("usertemp")))
+            continue;
+
+        // strip trailing slashes; root itself comes from PATH
+        size_t cch = (size_t)lstrlenA(posix);
+        while (cch > 1 && posix[cch - 1] == '/')
+            posix[--cch] = '\0';
+        if (cch < 2)
+            continue;
+
+        // insert keeping longer mount points first
+        int i = psb->cntMount++;
+        for ( ; i > 0 && pm[i - 1].cch < cch; --i)
+            pm[i] = pm[i - 1];
+        pm[i] = (MOUNT){ .win = win, .posix = posix, .cch = cch };
+    }
+
+    return psb->cntMount;
+}
+
+
+// compiled mount table saved across launches
+#define MOUNTS_MAGIC    0x534d0001UL    // "SM" + version
+#define MOUNTS_MAX      (1024 * 1024)
+typedef struct {
+    DWORD magic;                // MOUNTS_MAGIC
+    DWORD cb;                   // total size
+    ULONGLONG hash;             // hash of the rest
+    ULONGLONG hFstab;           // hash of fstab name
+    FILETIME ftFstab;           // fstab modification time
+    DWORD cbFstab;              // fstab size
+    DWORD cnt;                  // number of mount points
+} MOUNTS;
+// mount point and native path pairs, longest mount point first
+#define MOUNTS_TEXT(pms)    ((char*)((pms) + 1))
+#define MOUNTS_HASH(pms)    hash_bytes(FNV_BASIS, &(pms)->hash + 1, (pms)->cb \
+    - sizeof(DWORD) * 2 - sizeof(ULONGLONG))
+
+
+// takes mount table saved for the same fstab
+static BOOL read_mounts(SHEBANG* psb, PCTSTR pszMounts, const MOUNTS* pkey)
+{
+    HANDLE hFile = CreateFile(pszMounts, GENERIC_READ, FILE_SHARE_READ
+        | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return FALSE;
+    HANDLE hHeap = GetProcessHeap();
+    DWORD cb = GetFileSize(hFile, NULL);
+    MOUNTS* pms = (cb > sizeof(MOUNTS) && cb <= MOUNTS_MAX) ?
+        HeapAlloc(hHeap, 0, cb) : NULL;
+    if (pms && !ReadFile(hFile, pms, cb, &cb, NULL))
+        cb = 0;
+    CloseHandle(hFile);
+
+    // text must end with extra NUL, so each string does
+    char* cp = pms ? MOUNTS_TEXT(pms) : NULL;
+    char* end = (char*)pms + cb;
+    MOUNT* pm = NULL;
+    if (pms && cb > sizeof(MOUNTS) && end[-1] == '\0' && pms->magic == MOUNTS_MAGIC
+        && pms->cb == cb && pms->hash == MOUNTS_HASH(pms)
+        && pms->hFstab == pkey->hFstab && pms->cbFstab == pkey->cbFstab
+        && !CompareFileTime(&pms->ftFstab, &pkey->ftFstab)
+        && pms->cnt <= (DWORD)(end - cp) / 2
+        && (!pms->cnt || (pm = HeapAlloc(hHeap, 0, pms->cnt * sizeof(MOUNT))))) {
+        DWORD i = 0;
+        for ( ; i < pms->cnt && cp < end; ++i) {
+            pm[i].posix = cp;
+            pm[i].cch = (size_t)lstrlenA(cp);
+            cp += pm[i].cch + 1;
+            if (cp >= end)
+                break;
+            pm[i].win = cp;
+            cp += lstrlenA(cp) + 1;
+        }
+        if (i == pms->cnt && cp < end) {
+            psb->pm = pm;
+            psb->pcFstab = (char*)pms;
+            return TRUE;
+        }
+    }
+
+    if (pm)
+        HeapFree(hHeap, 0, pm);
+    if (pms)
+        HeapFree(hHeap, 0, pms);
+    return FALSE;
+}
+
+
+// saves mount table for next launches
+static void write_mounts(const SHEBANG* psb, PCTSTR pszMounts, const MOUNTS* pkey)
+{
+    DWORD cb = sizeof(MOUNTS) + 1; // extra NUL
+    for (int i = 0; i < psb->cntMount; ++i)
+        cb += (DWORD)(psb->pm[i].cch + lstrlenA(psb->pm[i].win) + 2);
+    MOUNTS* pms = (cb <= MOUNTS_MAX) ? HeapAlloc(GetProcessHeap(), 0, cb) : NULL;
+    if (!pms)
+        return;
+
+    *pms = *pkey;
+    pms->magic = MOUNTS_MAGIC;
+    pms->cb = cb;
+    pms->cnt = (DWORD)psb->cntMount;
+    char* cp = MOUNTS_TEXT(pms);
+    for (int i = 0; i < psb->cntMount; ++i) {
+        for (const char* src = psb->pm[i].posix; (*cp++ = *src++); ) ;
+        for (const char* src = psb->pm[i].win; (*cp++ = *src++); ) ;
+    }
+    *cp = '\0';
+    pms->hash = MOUNTS_HASH(pms);
+
+    HANDLE hFile = CreateFile(pszMounts, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile != INVALID_HANDLE_VALUE) {
+        WriteFile(hFile, pms, cb, &cb, NULL);
+        CloseHandle(hFile);
+    }
+    HeapFree(GetProcessHeap(), 0, pms);
+}
+
+
+// loads mount table once per context: compiled one is kept in %TEMP% until fstab
+// changes; returns number of mounts
+static int load_fstab(SHEBANG* psb)
+{
+    if (psb->cntMount >= 0)
+        return psb->cntMount; // loaded once
+    psb->cntMount = 0;
+    if (POSIX_SYS(&psb->px) == POSIX_NATIVE)
+        return 0; // host mounts on its own
+
+    TCHAR szFstab[MAX_PATH], szMounts[MAX_PATH];
+    WIN32_FILE_ATTRIBUTE_DATA fad;
+    FILETIME ft;
+    if (!get_fstab(&psb->px, ARRAY(szFstab), &ft)
+        || !GetFileAttributesEx(szFstab, GetFileExInfoStandard, &fad))
+        return 0;
+    MOUNTS key = {
+        .hFstab = hash_string(FNV_BASIS, szFstab),
+        .ftFstab = fad.ftLastWriteTime,
+        .cbFstab = fad.nFileSizeLow
+    };
+
+    // try saved one
+    if (!GetTempPath(COUNT(szMounts), szMounts)
+        || FAILED(StringCchCat(ARRAY(szMounts), TEXT(PROGRAM_NAME ".mounts"))))
+        return parse_fstab(psb, szFstab);
+    if (read_mounts(psb, szMounts, &key))
+        return psb->cntMount = (int)((MOUNTS*)psb->pcFstab)->cnt;
+
+    // parse and save it
+    parse_fstab(psb, szFstab);
+    if (psb->pm)
+        write_mounts(psb, szMounts, &key);
+    return psb->cntMount;
+}
+
+
+// finds longest fstab mount point prefixing POSIX path
+static const MOUNT* find_mount(SHEBANG* psb, const char* from)
+{
+    int cnt = load_fstab(psb);
+    const MOUNT* pm = psb->pm;
+
+    for (int i = 0; i < cnt; ++i, ++pm)
+        if (!compare_bytes(from, pm->posix, pm->cch)
+            && (from[pm->cch] == '/' || from[pm->cch] == '\0'))
+            return pm;
+
+    return NULL;
+}
+
+
+// converts POSIX path to native path
+static BOOL convert_path(PTSTR pszTo, size_t cchTo, SHEBANG* psb, const char* from)
+{
+    TCHAR tmp[MAX_PATH];
+    const MOUNT* m;
+
+    if (*from == '\\' || (IS_LATIN(from[0]) && from[1] == ':')) { // Win path
+        tmp[0] = TEXT('\0');
+    } else if (*from == '/' && POSIX_SYS(&psb->px) == POSIX_NATIVE) { // host path
+        StringCchCopy(ARRAY(tmp), psb->px.root);
+    } else if (*from == '/' && (m = find_mount(psb, from)) != NULL) { // mounted
+        tmp[0] = TEXT('\0');
+        if (!concat_with_utf8(ARRAY(tmp), m->win))
+            return FALSE;
+        from += m->cch;
+    } else if (*from == '/') { // POSIX path
+        ++from;
+
+        // skip over cygdrive/
+        if (!compare_bytes(from, ARRAY1("cygdrive/")))
+            from += COUNT1("cygdrive/");
+
+        // substitute: /c --> c:
+        if (IS_LATIN(from[0]) && from[1] == '/') {
+            tmp[0] = (TCHAR)from[0];
+            tmp[1] = TEXT(':');
+            tmp[2] = TEXT('/');
+            tmp[3] = TEXT('\0');
+            from += COUNT1("c/");
+        } else {
+            // start from POSIX root
+            StringCchCopy(ARRAY(tmp), psb->px.root);
+            StringCchCat(ARRAY(tmp), TEXT("/"));
+
+            if (POSIX_SYS(&psb->px) == POSIX_CYGWIN) {
+                // /usr/bin --> /bin
+                if (!compare_bytes(from, ARRAY1("usr/bin/"))) {
+                    StringCchCat(ARRAY(tmp), TEXT("bin/"));
+                    from += COUNT1("usr/bin/");
+                }
+            }  else {
+                // /bin --> /usr/bin
+                if (!compare_bytes(from, ARRAY1("bin/"))) {
+                    StringCchCat(ARRAY(tmp), TEXT("usr/bin/"));
+                    from += COUNT1("bin/");
+                }
+            }
+        }
+    } else { // relative path
+        GetCurrentDirectory(COUNT(tmp), tmp);
+        StringCchCat(ARRAY(tmp), TEXT("/"));
+    }
+
+    // add the rest
+    if (!concat_with_utf8(ARRAY(tmp), from))
+        return FALSE;
+
+    // apply native separators and .exe extension
+    replace_char(tmp, TEXT('\\'), TEXT('/')); // to Win separators
+    if (POSIX_SYS(&psb->px) != POSIX_NATIVE)
+        PathAddExtension(tmp, NULL); // note: PathCchAddExtension is for Win 8+ only
+
+    // check if file exists
+    if (!PathFileExists(tmp))
+        return FALSE;
+
+    // executable name containing spaces should be enquoted for security reasons
+    PathQuoteSpaces(tmp);
+
+    // copy out result
+    return SUCCEEDED(StringCchCopy(pszTo, cchTo, tmp));
+}
+
+
+// parses a shebang line
+static BOOL parse_line(char* line, size_t cnt, const char** ppc1, const char** ppc2)
+{
+    char* cp;
+
+    // #!
+    if (cnt < 2 || *line++ != '#' || *line++ != '!')
+        return FALSE;
+    cnt -= 2;
+
+    // break at a newline, convert tabs to spaces
+    size_t eol = find_eol(line, cnt);
+    if (eol == cnt || line[eol] == '\0') // no newline or unexpected end of string
+        return FALSE;
+    line[eol] = '\0';
+    replace_byte(line, eol, ' ', '\t');
+
+    // skip leading spaces
+    for (cp = line; *cp == ' '; ++cp) ;
+    if (*cp == '\0') // shell not found
+        return FALSE;
+
+    // store pointer to shell name
+    *ppc1 = cp;
+
+    // skip until next space
+    while (*cp && *cp != ' ') ++cp;
+
+    if (*cp == ' ') {
+        // have args
+        *cp++ = '\0';
+        *ppc2 = cp;
+    } else {
+        // no args
+        *ppc2 = NULL;
+    }
+
+    return TRUE;
+}
+
+
+// checks if shell is env
+static BOOL is_env(const char* pszShell)
+{
+    const char* base = pszShell;
+    for ( ; *pszShell; ++pszShell)
+        if (*pszShell == '/')
+            base = pszShell + 1;
+    return (base != pszShell && !compare_bytes(base, ARRAY("env")));
+}
+
+
+// parses "[-S] [NAME=value]... prog" from env shebang args; outputs program
+// and NAME=value list; returns pointer past program or NULL
+static const char* parse_env(const char* cp, char* pszProg, size_t cchProg,
+    PTSTR pszEnv, size_t cchEnv)
+{
+    size_t cch, cchUsed = 0;
+
+    // empty list
+    if (cchEnv < 2)
+        return NULL;
+    pszEnv[0] = TEXT('\0');
+
+    // quotes, escapes and ${VAR} are left up to env, which splits them its way
+    for (const char* pc = cp; pc && *pc; ++pc)
+        if (*pc == '"' || *pc == '\'' || *pc == '\\' || *pc == '$')
+            return NULL;
+
+    for (;;) {
+        // get next word
+        while (cp && *cp == ' ') ++cp;
+        if (!cp || !*cp) // no program
+            return NULL;
+        for (cch = 0; cp[cch] && cp[cch] != ' '; ++cch) ;
+
+        if (*cp == '-') {
+            // -S[string] or --split-string=string: rest of line is split anyway
+            if (cp[1] == 'S')
+                cp += COUNT1("-S");
+            else if (cch >= COUNT1("--split-string=")
+                && !compare_bytes(cp, ARRAY1("--split-string=")))
+                cp += COUNT1("--split-string=");
+            else // other options are up to env
+                return NULL;
+            continue;
+        }
+
+        // copy out word
+        if (FAILED(StringCchCopyNA(pszProg, cchProg, cp, cch)))
+            return NULL;
+        cp += cch;
+
+        // got program unless NAME=value
+        size_t i;
+        for (i = 0; pszProg[i] && pszProg[i] != '='; ++i) ;
+        if (!pszProg[i])
+            return cp;
+        if (!i || !concat_with_utf8(pszEnv + cchUsed, cchEnv - cchUsed - 1, pszProg))
+            return NULL;
+        cchUsed += (size_t)lstrlen(pszEnv + cchUsed) + 1;
+        pszEnv[cchUsed] = TEXT('\0');
+    }
+}
+
+
+// resolves "#!/usr/bin/env ..." without running env; outputs shell name and
+// NAME=value list, moves *ppcArgs to program args
+static BOOL resolve_env(PTSTR pszShellName, size_t cchShellName, PTSTR pszEnv,
+    size_t cchEnv, SHEBANG* psb, const char** ppcArgs)
+{
+    char prog[MAX_PATH];
+    const char* cp = parse_env(*ppcArgs, ARRAY(prog), pszEnv, cchEnv);
+    BOOL found = FALSE;
+
+    // look for program on PATH unless it is a path itself
+    TCHAR szProg[MAX_PATH] = TEXT("");
+    BOOL path = FALSE;
+    for (const char* pc = prog; cp && *pc; ++pc)
+        if (*pc == '/')
+            path = TRUE;
+    if (cp && !path && concat_with_utf8(ARRAY(szProg), prog)
+        && (POSIX_SYS(&psb->px) == POSIX_NATIVE
+            || SUCCEEDED(StringCchCat(ARRAY(szProg), TEXT(".exe"))))) {
+        index_recheck(psb, FALSE);
+        do {
+            PCTSTR pszPATH = get_env(ARRAY1("path=")), pszEntry;
+            size_t cch;
+            while (!found && pszPATH && (cch = next_path(&pszPATH, &pszEntry)))
+                found = index_probe(psb, pszShellName, cchShellName, pszEntry, cch,
+                    szProg);
+        } while (!found && index_recheck(psb, TRUE)); // as in find_posix
+        index_recheck(psb, FALSE);
+        if (found)
+            PathQuoteSpaces(pszShellName);
+    }
+
+    // else look under POSIX root
+    if (cp && !found) {
+        char from[MAX_PATH] = "/usr/bin/";
+        found = SUCCEEDED(path ? StringCchCopyA(ARRAY(from), prog)
+            : StringCchCatA(ARRAY(from), prog))
+            && convert_path(pszShellName, cchShellName, psb, from);
+    }
+
+    if (!found) {
+        // leave it up to env
+        pszEnv[0] = TEXT('\0');
+        return FALSE;
+    }
+
+    // skip to program args
+    while (*cp == ' ') ++cp;
+    *ppcArgs = *cp ? cp : NULL;
+    return TRUE;
+}
+
+
+// interpreter substitution rule: "from [spec]=to [args]"
+typedef struct shebang_subst {
+    const char* from;   // shebang interpreter
+    const char* spec;   // pattern for shebang args or NULL
+    const char* to;     // preferred interpreter
+    const char* args;   // args replacement or NULL
+} SUBST;
+
+
+// terminates first word of a string; returns the rest or NULL
+static char* split_word(char* cp)
+{
+    while (*cp && *cp != ' ') ++cp;
+    if (!*cp)
+        return NULL;
+    *cp++ = '\0';
+    while (*cp == ' ') ++cp;
+    return *cp ? cp : NULL;
+}
+
+
+// loads substitution rules once per context: SHEBANG_SUBST=rule;rule... goes
+// before [interpreters] section of shebang.ini; returns number of rules
+static int load_subst(SHEBANG* psb, const SUBST** pps)
+{
+    *pps = psb->ps;
+    if (psb->cntSubst >= 0)
+        return psb->cntSubst; // parsed once
+    psb->cntSubst = 0;
+
+    // read both sources into a single buffer
+    HANDLE hHeap = GetProcessHeap();
+    const CONFIG* pcfg = get_config(psb);
+    DWORD cchEnv = GetEnvironmentVariable(TEXT("SHEBANG_SUBST"), NULL, 0);
+    DWORD cchIni = pcfg->cchSubst;
+    PTSTR pszBuf = HeapAlloc(hHeap, 0, (cchEnv + cchIni + 1) * sizeof(TCHAR));
+    if (!pszBuf)
+        return 0;
+    copy_bytes(pszBuf + cchEnv, CONFIG_SUBST(pcfg), cchIni * sizeof(TCHAR));
+    if (cchEnv) {
+        if (GetEnvironmentVariable(TEXT("SHEBANG_SUBST"), pszBuf, cchEnv) != cchEnv - 1)
+            zero_bytes(pszBuf, cchEnv * sizeof(TCHAR));
+        replace_char(pszBuf, TEXT('\0'), TEXT(';')); // split rules
+    }
+
+    // convert to UTF-8 to match against shebang line
+    int cb = (int)(cchEnv + cchIni);
+    char* buf = cb ? HeapAlloc(hHeap, 0, (size_t)cb * 3 + 1) : NULL;
+    if (!(psb->pcSubst = buf)) {
+        HeapFree(hHeap, 0, pszBuf);
+        return 0;
+    }
+#ifdef UNICODE
+    cb = WideCharToMultiByte(CP_UTF8, 0, pszBuf, cb, buf, cb * 3, NULL, NULL);
+#else
+    // note: ANSI build takes rules in ACP
+    copy_bytes(buf, pszBuf, (size_t)cb);
+#endif // UNICODE
+    buf[cb] = '\0';
+    HeapFree(hHeap, 0, pszBuf);
+
+    // count rules and parse them in place
+    int max = 0;
+    for (int i = 0; i < cb; ++i)
+        if (buf[i] == '=')
+            ++max;
+    SUBST* ps;
+    int cnt = 0;
+    if (!max || !(*pps = psb->ps = ps = HeapAlloc(hHeap, 0, max * sizeof(SUBST))))
+        return 0;
+    for (char *cp = buf, *end = buf + cb; cp < end; ) {
+        char* line = cp;
+        while (cp < end && *cp) ++cp;
+        ++cp; // next line
+
+        // from [spec]=to [args]
+        char* eq = line;
+        while (*eq && *eq != '=') ++eq;
+        if (!*eq)
+            continue;
+        for (char* cp1 = eq; cp1 > line && cp1[-1] == ' '; *--cp1 = '\0') ;
+        *eq++ = '\0';
+        while (*line == ' ') ++line;
+        while (*eq == ' ') ++eq;
+        if (!*line || !*eq)
+            continue;
+        ps[cnt].from = line;
+        ps[cnt].spec = split_word(line);
+        ps[cnt].to = eq;
+        ps[cnt].args = split_word(eq);
+        ++cnt;
+    }
+
+    return psb->cntSubst = cnt;
+}
+
+
+// applies first matching substitution that exists on disk
+static BOOL subst_shell(PTSTR pszShellName, size_t cchShellName, SHEBANG* psb,
+    const char* pc1, const char** ppc2)
+{
+    const SUBST* ps;
+    int cnt = load_subst(psb, &ps);
+
+    for (int i = 0; i < cnt; ++i, ++ps) {
+        if (lstrcmpA(ps->from, pc1)
+            || (ps->spec && !PathMatchSpecA(*ppc2 ? *ppc2 : "", ps->spec)))
+            continue;
+        if (convert_path(pszShellName, cchShellName, psb, ps->to)) {
+            if (ps->args)
+                *ppc2 = ps->args;
+            return TRUE;
+        }
+    }
+
+    return FALSE; // fall back to original
+}
+
+
+// appends shebang args to the command as they are: the shell splits them per
+// MSVCRT rules, so quotes in them group words
+static BOOL append_utf8_args(PTSTR pszCmd, size_t cchCmd, const char* args)
+{
+    return SUCCEEDED(StringCchCat(pszCmd, cchCmd, TEXT(" ")))
+        && concat_with_utf8(pszCmd, cchCmd, args);
+}
+
+
+// checks if file is a shell script
+static BOOL can_shebang(PCTSTR pszScriptName, PTSTR pszShellName, size_t cchShellName,
+    PTSTR pszEnv, size_t cchEnv, SHEBANG* psb, PDWORD pdwErrorCode)
+{
+    // open script file
+    HANDLE hScriptFile = CreateFile(pszScriptName, GENERIC_READ, FILE_SHARE_READ,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hScriptFile == INVALID_HANDLE_VALUE) {
+        *pdwErrorCode = GetLastError();
+        return FALSE;
+    }
+
+    BOOL shebang = FALSE;
+    // shebang line can't be longer than the shell command
+    char buf[MAX_PATH];
+    DWORD cb;
+    const char *pc1, *pc2;
+    if (!ReadFile(hScriptFile, buf, (DWORD)(cchShellName < sizeof(buf) ? cchShellName
+        : sizeof(buf)), &cb, NULL)) {
+        // cannot read file
+        *pdwErrorCode = GetLastError();
+    } else if (!parse_line(buf, (size_t)cb, &pc1, &pc2)) {
+        // not a script
+        *pdwErrorCode = ERROR_BAD_FORMAT;
+    } else if (!subst_shell(pszShellName, cchShellName, psb, pc1, &pc2)
+        && !(is_env(pc1) && resolve_env(pszShellName, cchShellName, pszEnv, cchEnv,
+            psb, &pc2))
+        && !convert_path(pszShellName, cchShellName, psb, pc1)) {
+        // invalid shell
+        *pdwErrorCode = ERROR_PATH_NOT_FOUND;
+    } else {
+        // process shebang args if any
+        shebang = !pc2 || append_utf8_args(pszShellName, cchShellName, pc2);
+        if (!shebang) // invalid shebang args
+            *pdwErrorCode = ERROR_BAD_ARGUMENTS;
+    }
+
+    CloseHandle(hScriptFile);
+    return shebang;
+}
+
+
+// initializes resolution context
+void shebang_init(SHEBANG* psb)
+{
+    zero_bytes(psb, sizeof(*psb));
+    psb->cntMount = psb->cntSubst = -1;
+#if defined(PIN_LAYER)
+    // pinned root is only checked for existence
+    if (SUCCEEDED(StringCchCopy(ARRAY(psb->px.root), TEXT(PIN_ROOT)))
+        && PathIsDirectory(psb->px.root))
+        psb->px.sys = PIN_SYS;
+    else
+        psb->px.sys = POSIX_UNKNOWN;
+#else
+    psb->px.sys = POSIX_UNKNOWN;
+#endif // PIN_LAYER
+}
+
+
+// releases memory held by resolution context
+void shebang_free(SHEBANG* psb)
+{
+    HANDLE hHeap = GetProcessHeap();
+    join_prefetch(psb);
+    if (psb->pm)
+        HeapFree(hHeap, 0, psb->pm);
+    if (psb->pcFstab)
+        HeapFree(hHeap, 0, psb->pcFstab);
+    if (psb->pcfg && psb->pcfg != &noConfig.cfg)
+        HeapFree(hHeap, 0, (CONFIG*)psb->pcfg);
+    if (psb->ps)
+        HeapFree(hHeap, 0, (SUBST*)psb->ps);
+    if (psb->pcSubst)
+        HeapFree(hHeap, 0, psb->pcSubst);
+    if (psb->pidx)
+        close_index(psb->pidx);
+    psb->pm = NULL;
+    psb->cntMount = -1;
+    psb->pcFstab = NULL;
+    psb->pcfg = NULL;
+    psb->ps = NULL;
+    psb->cntSubst = -1;
+    psb->pcSubst = NULL;
+    psb->pidx = NULL;
+}
+
+
+// starts loading shebang.ini and host name in background; any use of them waits
+// for it, so the results are the same as without it
+void shebang_prefetch(SHEBANG* psb)
+{
+    if (psb->hPrefetch || psb->pcfg
+        || !(psb->hConfigReady = CreateEvent(NULL, TRUE, FALSE, NULL)))
+        return;
+
+    // note: worker only needs a small stack
+    if (!(psb->hPrefetch = CreateThread(NULL, 64 * 1024, prefetch_worker, psb,
+        STACK_SIZE_PARAM_IS_A_RESERVATION, NULL))) {
+        CloseHandle(psb->hConfigReady);
+        psb->hConfigReady = NULL;
+    }
+}
+
+
+// finds POSIX root (once per context) and the script on PATH
+DWORD shebang_find(SHEBANG* psb, RESOLVED* pr, PCTSTR pszName)
+{
+#if !defined(PIN_LAYER)
+    // root pinned by shebang.ini is only checked for existence; PATH is then
+    // searched for the script only
+    const CONFIG* pcfg;
+    if (psb->px.sys == POSIX_UNKNOWN && (pcfg = get_config(psb))->sys != POSIX_UNKNOWN
+        && PathIsDirectory(pcfg->root)) {
+        psb->px.sys = pcfg->sys;
+        StringCchCopy(ARRAY(psb->px.root), pcfg->root);
+    }
+#endif // PIN_LAYER
+
+    BOOL found = find_posix(psb, pszName, ARRAY(pr->szScript));
+#if !defined(_WIN32)
+    // no MSYS/Cygwin on PATH of POSIX host: its own shells run the script
+    if (psb->px.sys == POSIX_UNKNOWN) {
+        psb->px.sys = POSIX_NATIVE;
+        StringCchCopy(ARRAY(psb->px.root), TEXT("C:")); // "/" in native form
+    }
+#endif // _WIN32
+    pr->px = psb->px;
+    if (psb->px.sys == POSIX_UNKNOWN)
+        return ERROR_INVALID_ENVIRONMENT;
+    return found ? ERROR_SUCCESS : ERROR_FILE_NOT_FOUND;
+}
+
+
+// parses shebang line of the script found and resolves its shell
+DWORD shebang_parse(SHEBANG* psb, RESOLVED* pr)
+{
+    DWORD dwErrorCode;
+
+    // can she bang?
+    pr->szEnv[0] = TEXT('\0');
+    if (!can_shebang(pr->szScript, ARRAY(pr->szShellCmd), ARRAY(pr->szEnv), psb,
+        &dwErrorCode))
+        return dwErrorCode;
+
+    // remember script and mount table identity
+    WIN32_FILE_ATTRIBUTE_DATA fad;
+    TCHAR tmp[MAX_PATH];
+    if (!GetFileAttributesEx(pr->szScript, GetFileExInfoStandard, &fad))
+        return GetLastError();
+    pr->cbScript = fad.nFileSizeLow;
+    pr->ftScript = fad.ftLastWriteTime;
+    get_fstab(&pr->px, ARRAY(tmp), &pr->ftFstab);
+
+    return ERROR_SUCCESS;
+}
+
+
+// finds script on PATH and resolves its shell
+DWORD shebang_resolve(SHEBANG* psb, RESOLVED* pr, PCTSTR pszName)
+{
+    DWORD dwErrorCode = shebang_find(psb, pr, pszName);
+    return dwErrorCode ? dwErrorCode : shebang_parse(psb, pr);
+}
+
+
+// checks if resolved script is unchanged and its shell still exists
+BOOL shebang_check(const RESOLVED* pr)
+{
+    WIN32_FILE_ATTRIBUTE_DATA fad;
+    if (!GetFileAttributesEx(pr->szScript, GetFileExInfoStandard, &fad)
+        || fad.nFileSizeLow != pr->cbScript
+        || compare_bytes(&fad.ftLastWriteTime, &pr->ftScript, sizeof(FILETIME)))
+        return FALSE;
+
+    // mount table must be unchanged
+    TCHAR tmp[MAX_PATH];
+    FILETIME ft;
+    if (!get_fstab(&pr->px, ARRAY(tmp), &ft)
+        || compare_bytes(&ft, &pr->ftFstab, sizeof(FILETIME)))
+        return FALSE;
+
+    // shell must still exist
+    StringCchCopy(ARRAY(tmp), pr->szShellCmd);
+    PathRemoveArgs(tmp);
+    PathUnquoteSpaces(tmp);
+    return PathFileExists(tmp);
+}
+
+
+// makes command line from resolution and raw args; returns number of chars
+// required including terminator, writes them unless pszTo is NULL
+size_t shebang_cmdline(PTSTR pszTo, const RESOLVED* pr, PCTSTR pszRawArgs)
+{
+    size_t cch = 0;
+
+    // shell is quoted already, shebang args go as written
+    for ( ; pr->szShellCmd[cch]; ++cch)
+        if (pszTo)
+            pszTo[cch] = pr->szShellCmd[cch];
+
+    // space + script name prepared for passing onto the shell
+    TCHAR szScript[MAX_PATH];
+    StringCchCopy(ARRAY(szScript), pr->szScript);
+    replace_char(szScript, TEXT('/'), TEXT('\\')); // to POSIX separators
+    if (pszTo)
+        pszTo[cch] = TEXT(' ');
+    ++cch;
+    cch += quote_arg(pszTo ? pszTo + cch : NULL, szScript, (size_t)lstrlen(szScript));
+
+    // space + our args
+    if (pszRawArgs && *pszRawArgs) {
+        if (pszTo)
+            pszTo[cch] = TEXT(' ');
+        ++cch;
+        for ( ; *pszRawArgs; ++pszRawArgs, ++cch)
+            if (pszTo)
+                pszTo[cch] = *pszRawArgs;
+    }
+
+    if (pszTo)
+        pszTo[cch] = TEXT('\0');
+    return cch + 1;
+}
+
+
+// makes NAME=value list of environment overrides: POSIX variables, then env
+// shebang assignments
+BOOL shebang_env(SHEBANG* psb, const RESOLVED* pr, PTSTR pszList, size_t cchList)
+{
+    if (cchList < 2)
+        return FALSE;
+    pszList[0] = TEXT('\0');
+
+    if (!get_posix_env(psb, &pr->px, &pszList, &cchList))
+        return FALSE;
+    for (PCTSTR psz = CONFIG_ENV(get_config(psb)); *psz; psz += lstrlen(psz) + 1)
+        if (!add_env(&pszList, &cchList, psz, NULL))
+            return FALSE;
+    for (PCTSTR psz = pr->szEnv; *psz; psz += lstrlen(psz) + 1)
+        if (!add_env(&pszList, &cchList, psz, NULL))
+            return FALSE;
+
+    return TRUE;
+}
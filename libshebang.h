@@ -0,0 +1,99 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Resolution of MSYS/Cygwin shebang scripts
+ * Note: Build with the same -DUNICODE setting as libshebang.c
+ */
+
+
+#ifndef LIBSHEBANG_H
+#define LIBSHEBANG_H
+
+#include <windows.h>
+
+
+// known POSIX layers
+typedef struct {
+    enum {
+        POSIX_UNKNOWN = -1,
+        POSIX_CLANGARM64,   // CLANGARM64
+        POSIX_MINGW32,      // MINGW32
+        POSIX_MINGW64,      // MINGW64
+        POSIX_UCRT64,       // UCRT64
+        POSIX_CLANG32,      // CLANG32
+        POSIX_CLANG64,      // CLANG64
+        POSIX_MSYS,         // MSYS
+        POSIX_CYGWIN,       // Cygwin
+        POSIX_NATIVE,       // host's own, in builds for POSIX hosts
+        POSIX_COUNT
+    } sys;
+    TCHAR root[MAX_PATH];
+} POSIX;
+
+
+// fstab mount point
+typedef struct {
+    const char* win;    // native path
+    const char* posix;  // mount point without trailing slash
+    size_t cch;         // mount point length
+} MOUNT;
+
+
+// resolution context; queries through the same context share POSIX root, mount
+// table, configuration and PATH index; contexts are independent of each other,
+// but each one is used by a single thread at a time
+typedef struct {
+    POSIX px;                   // POSIX layer and root, found by first query
+    MOUNT* pm;                  // <root>\etc\fstab mount points, longest first
+    int cntMount;               // number of mount points; -1 if not loaded yet
+    char* pcFstab;              // fstab text the mount points refer to
+    const struct shebang_config* pcfg;  // shebang.ini; NULL if not loaded yet
+    const struct shebang_subst* ps;     // interpreter substitution rules
+    int cntSubst;               // number of rules; -1 if not loaded yet
+    char* pcSubst;              // rule text the rules refer to
+    struct shebang_index* pidx; // persistent PATH index; NULL if not opened yet
+    HANDLE hPrefetch;           // background worker; NULL if not started or joined
+    HANDLE hConfigReady;        // set by the worker once pcfg is loaded
+    BOOL host;                  // szHost is valid
+    TCHAR szHost[256];          // host name
+} SHEBANG;
+
+
+// resolved launch parameters
+typedef struct {
+    POSIX px;                   // POSIX layer and root
+    FILETIME ftScript;          // script file modification time
+    DWORD cbScript;             // script file size
+    FILETIME ftFstab;           // fstab modification time
+    TCHAR szScript[MAX_PATH];   // full script name
+    TCHAR szShellCmd[MAX_PATH]; // shell + shebang args
+    TCHAR szEnv[MAX_PATH];      // NAME=value list from env shebang
+} RESOLVED;
+
+
+// initializes resolution context
+void shebang_init(SHEBANG* psb);
+// releases memory held by resolution context
+void shebang_free(SHEBANG* psb);
+// starts loading shebang.ini and host name in background; results are the same
+// as without it
+void shebang_prefetch(SHEBANG* psb);
+// finds POSIX root (once per context) and the script on PATH
+DWORD shebang_find(SHEBANG* psb, RESOLVED* pr, PCTSTR pszName);
+// parses shebang line of the script found and resolves its shell
+DWORD shebang_parse(SHEBANG* psb, RESOLVED* pr);
+// finds script on PATH and resolves its shell
+DWORD shebang_resolve(SHEBANG* psb, RESOLVED* pr, PCTSTR pszName);
+// checks if resolved script is unchanged and its shell still exists
+BOOL shebang_check(const RESOLVED* pr);
+// makes command line from resolution and raw args; returns number of chars
+// required including terminator, writes them unless pszTo is NULL
+size_t shebang_cmdline(PTSTR pszTo, const RESOLVED* pr, PCTSTR pszRawArgs);
+// makes NAME=value list of environment overrides: POSIX variables, then env
+// shebang assignments; NAME alone means removal
+BOOL shebang_env(SHEBANG* psb, const RESOLVED* pr, PTSTR pszList, size_t cchList);
+// makes sorted environment block merging the current one with NAME=value list;
+// free it with HeapFree(GetProcessHeap(), ...)
+PTSTR shebang_env_block(PCTSTR pszBlock, PCTSTR pszList);
+
+#endif // LIBSHEBANG_H
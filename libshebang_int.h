@@ -0,0 +1,32 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: libshebang internals shared with the launcher; not part of the API
+ * Note: Build with the same -DUNICODE setting as libshebang.c
+ */
+
+
+#ifndef LIBSHEBANG_INT_H
+#define LIBSHEBANG_INT_H
+
+#include "libshebang.h"
+
+
+// FNV-1a hash seed
+#define FNV_BASIS       0xcbf29ce484222325ULL
+// hashes raw bytes
+ULONGLONG hash_bytes(ULONGLONG h, const void* p, size_t n);
+// hashes TCHAR string ignoring ASCII case
+ULONGLONG hash_string(ULONGLONG h, PCTSTR psz);
+// gets process environment block, copied once on first use
+PCTSTR get_env_block(void);
+// gets variable value from the process environment block;
+// name is lower-case ASCII followed by '='
+PCTSTR get_env(const char* pszName, size_t cchName);
+// gets shebang.ini path next to our executable
+BOOL get_ini_path(PTSTR pszIni, size_t cchIni);
+// hashes build and shebang.ini settings, so that results of different setups
+// differ in hash
+ULONGLONG hash_settings(ULONGLONG h);
+
+#endif // LIBSHEBANG_INT_H
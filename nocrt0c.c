@@ -176,65 +176,71 @@ __asm__(
 
 
 #if (ARGV_type == ARGV_builtin)
-typedef struct {
-    int argc;       // inout; if argc <= 0 then argv[] and pchBuf[] are unused
-    _TCHAR** argv;  // pointers to arguments
-    size_t cchBuf;  // inout
-    _TCHAR* pchBuf; // buffer for arguments
-} ARGS;
-
-static void parse_args(const _TCHAR* pszCmdLine, ARGS* pArgs)
+// worst case sizes for the command line of cch chars: all args are single chars
+#define ARGV_MAX(cch)   (((cch) + 1) / 2 + 2)   // incl. program name and NULL
+#define CHARS_MAX(cch)  ((cch) + 1)
+
+// splits command line in a single pass following msvcrt.dll rules:
+// - program name ends at the next quote if quoted, else at the first blank
+// - 2n backslashes + quote = n backslashes + begin/end of quoted part
+// - 2n+1 backslashes + quote = n backslashes + literal quote
+// - backslashes not followed by quote are literal
+// - two quotes in a quoted part = literal quote, quoted part ends
+static int parse_args(const _TCHAR* pcin, _TCHAR** argv, _TCHAR* pcout)
 {
     int argc = 0;
-    size_t cchBuf = 0;
-    _TCHAR* pcout = pArgs->pchBuf;
 
-    for (const _TCHAR* pcin = pszCmdLine; *pcin; ++argc) {
-        // skip spaces
-        while (*pcin == _T(' ')) ++pcin;
+    // get program name
+    argv[argc++] = pcout;
+    if (*pcin == _T('"')) {
+        while (*++pcin && *pcin != _T('"'))
+            *pcout++ = *pcin;
+        if (*pcin)
+            ++pcin;
+    } else {
+        while (*pcin && *pcin != _T(' ') && *pcin != _T('\t'))
+            *pcout++ = *pcin++;
+    }
+    *pcout++ = _T('\0');
+
+    for (;;) {
+        // skip blanks
+        while (*pcin == _T(' ') || *pcin == _T('\t')) ++pcin;
         if (!*pcin)
             break;
 
         // get arg
-        const _TCHAR* cp_start;
-        size_t cnt = 0;
-        if (*pcin == _T('"') || *pcin == _T('\'')) {
-            // quoted arg
-            _TCHAR delim = *pcin++;
-            cp_start = pcin;
-            while (*pcin && *pcin != delim) ++pcin, ++cnt;
-            if (*pcin == delim)
-                ++pcin;
-        } else {
-            // unquoted arg
-            cp_start = pcin;
-            while (*pcin && *pcin != _T(' ')) ++pcin, ++cnt;
-        }
-
-        // need (cnt + 1) chars more
-        cchBuf += cnt + 1;
-
-        // should we store it?
-        if (pArgs->argc > 0) {
-            // check for buffer overflow
-            if (argc >= pArgs->argc || cchBuf > pArgs->cchBuf) {
-                cchBuf -= cnt + 1; // failed to store the last arg
-                break;
+        argv[argc++] = pcout;
+        int quoted = 0;
+        while (*pcin && (quoted || (*pcin != _T(' ') && *pcin != _T('\t')))) {
+            size_t n = 0;
+            while (*pcin == _T('\\')) ++pcin, ++n;
+            if (*pcin == _T('"')) {
+                for (size_t i = n / 2; i; --i)
+                    *pcout++ = _T('\\');
+                if (n & 1) {
+                    *pcout++ = *pcin++;
+                } else if (quoted && pcin[1] == _T('"')) {
+                    *pcout++ = _T('"');
+                    pcin += 2;
+                    quoted = 0;
+                } else {
+                    quoted = !quoted;
+                    ++pcin;
+                }
+            } else {
+                for ( ; n; --n)
+                    *pcout++ = _T('\\');
+                if (*pcin && (quoted || (*pcin != _T(' ') && *pcin != _T('\t'))))
+                    *pcout++ = *pcin++;
             }
-
-            // store arg
-            // note: do not use memcpy() to prevent import from msvcrt.dll
-            pArgs->argv[argc] = pcout;
-            if (cnt) do {
-                *pcout++ = *cp_start++;
-            } while (--cnt);
-            *pcout++ = _T('\0');
         }
+        *pcout++ = _T('\0');
     }
 
-    // output counters
-    pArgs->argc = argc;
-    pArgs->cchBuf = cchBuf;
+    // append NULL
+    argv[argc] = NULL;
+    return argc;
 }
 #endif // ARGV_builtin
 
@@ -245,29 +251,16 @@ void _tmainCRTStartup(void)
 #if (ARGV_type == ARGV_builtin)
     // get command line
     _TCHAR* pszCmdLine = GetCommandLine();
+    size_t cch = 0;
+    while (pszCmdLine[cch]) ++cch;
 
-    // count args
-    ARGS args;
-    args.argc = 0;
-    parse_args(pszCmdLine, &args);
+    // reserve space for argv[] followed by args
+    _TCHAR** argv = _alloca(ARGV_MAX(cch) * sizeof(_TCHAR*)
+        + CHARS_MAX(cch) * sizeof(_TCHAR));
 
-    //assert(args.argc > 0);
-    //assert(args.cchBuf > 0);
-
-    // reserve space
-    _TCHAR** ptr_buf = _alloca((args.argc + 1) * sizeof(_TCHAR*));
-    _TCHAR* char_buf = _alloca(args.cchBuf * sizeof(_TCHAR));
-
-    // get args
-    args.argv = ptr_buf;
-    args.pchBuf = char_buf;
-    parse_args(pszCmdLine, &args);
-
-    // append NULL
-    args.argv[args.argc] = NULL;
-
-    // invoke main and exit
-    ExitProcess(_tmain(args.argc, args.argv));
+    // get args, invoke main and exit
+    int argc = parse_args(pszCmdLine, argv, (_TCHAR*)(argv + ARGV_MAX(cch)));
+    ExitProcess(_tmain(argc, argv));
 
 #elif (ARGV_type == ARGV_msvcrt)
     int argc;
@@ -0,0 +1,30 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Win32 subset over POSIX: process status
+ * Note: Peak sizes are taken from /proc/self/status
+ */
+
+
+#ifndef POSIX_PSAPI_H
+#define POSIX_PSAPI_H
+
+#include "windows.h"
+
+typedef struct {
+    DWORD cb;
+    DWORD PageFaultCount;
+    SIZE_T PeakWorkingSetSize;
+    SIZE_T WorkingSetSize;
+    SIZE_T QuotaPeakPagedPoolUsage;
+    SIZE_T QuotaPagedPoolUsage;
+    SIZE_T QuotaPeakNonPagedPoolUsage;
+    SIZE_T QuotaNonPagedPoolUsage;
+    SIZE_T PagefileUsage;
+    SIZE_T PeakPagefileUsage;
+} PROCESS_MEMORY_COUNTERS;
+
+BOOL K32GetProcessMemoryInfo(HANDLE Process, PROCESS_MEMORY_COUNTERS* ppsmemCounters,
+    DWORD cb);
+
+#endif // POSIX_PSAPI_H
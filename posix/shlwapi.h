@@ -0,0 +1,35 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Win32 subset over POSIX: light-weight utility functions
+ * Note: Path functions take both '\' and '/' as separators
+ */
+
+
+#ifndef POSIX_SHLWAPI_H
+#define POSIX_SHLWAPI_H
+
+#include "windows.h"
+
+int StrToInt(LPCTSTR pszSrc);
+int StrCmpI(LPCTSTR psz1, LPCTSTR psz2);
+int StrCmpNI(LPCTSTR psz1, LPCTSTR psz2, int nChar);
+LPTSTR StrChr(LPCTSTR pszStart, TCHAR wMatch);
+int wnsprintf(LPTSTR pszDest, int cchDest, LPCTSTR pszFmt, ...);
+
+BOOL PathAppend(LPTSTR pszPath, LPCTSTR pszMore);
+BOOL PathAddExtension(LPTSTR pszPath, LPCTSTR pszExt);
+BOOL PathFileExists(LPCTSTR pszPath);
+LPTSTR PathFindFileName(LPCTSTR pszPath);
+LPTSTR PathGetArgs(LPCTSTR pszPath);
+BOOL PathIsDirectory(LPCTSTR pszPath);
+BOOL PathMatchSpec(LPCTSTR pszFile, LPCTSTR pszSpec);
+BOOL PathQuoteSpaces(LPTSTR lpsz);
+void PathRemoveArgs(LPTSTR pszPath);
+void PathRemoveExtension(LPTSTR pszPath);
+BOOL PathRemoveFileSpec(LPTSTR pszPath);
+void PathStripPath(LPTSTR pszPath);
+void PathUnquoteSpaces(LPTSTR lpsz);
+#define PathMatchSpecA  PathMatchSpec
+
+#endif // POSIX_SHLWAPI_H
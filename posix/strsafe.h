@@ -0,0 +1,33 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Win32 subset over POSIX: safe string functions
+ * Note: 'ansi' only; A-suffixed names are the same functions
+ */
+
+
+#ifndef POSIX_STRSAFE_H
+#define POSIX_STRSAFE_H
+
+#include "windows.h"
+
+#define S_OK                            ((HRESULT)0)
+#define STRSAFE_E_INSUFFICIENT_BUFFER   ((HRESULT)0x8007007aU)
+#define STRSAFE_E_INVALID_PARAMETER     ((HRESULT)0x80070057U)
+#define SUCCEEDED(hr)                   (((HRESULT)(hr)) >= 0)
+#define FAILED(hr)                      (((HRESULT)(hr)) < 0)
+
+HRESULT StringCchLength(LPCTSTR psz, size_t cchMax, size_t* pcchLength);
+HRESULT StringCchCopy(LPTSTR pszDest, size_t cchDest, LPCTSTR pszSrc);
+HRESULT StringCchCopyN(LPTSTR pszDest, size_t cchDest, LPCTSTR pszSrc,
+    size_t cchToCopy);
+HRESULT StringCchCopyEx(LPTSTR pszDest, size_t cchDest, LPCTSTR pszSrc,
+    LPTSTR* ppszDestEnd, size_t* pcchRemaining, DWORD dwFlags);
+HRESULT StringCchCat(LPTSTR pszDest, size_t cchDest, LPCTSTR pszSrc);
+HRESULT StringCchCatEx(LPTSTR pszDest, size_t cchDest, LPCTSTR pszSrc,
+    LPTSTR* ppszDestEnd, size_t* pcchRemaining, DWORD dwFlags);
+#define StringCchCopyA  StringCchCopy
+#define StringCchCopyNA StringCchCopyN
+#define StringCchCatA   StringCchCat
+
+#endif // POSIX_STRSAFE_H
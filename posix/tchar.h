@@ -0,0 +1,17 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Win32 subset over POSIX: generic-text mappings
+ * Note: 'ansi' only
+ */
+
+
+#ifndef POSIX_TCHAR_H
+#define POSIX_TCHAR_H
+
+#include "windows.h"
+
+#define _T(s)           s
+#define _tmain          main
+
+#endif // POSIX_TCHAR_H
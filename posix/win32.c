@@ -0,0 +1,2328 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Win32 subset over POSIX, so that shebang builds and runs on Linux
+ * Note: Needs glibc 2.29+ (OFD locks, posix_spawn with chdir)
+ */
+
+
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "windows.h"
+#include "psapi.h"
+#include "shlwapi.h"
+#include "strsafe.h"
+
+
+extern char** environ;
+
+// macro to facilitate function call
+#define COUNT(a)        (sizeof(a) / sizeof(*a))
+#define ARRAY(a)        (a), COUNT(a)
+// path separators
+#define IS_SEP(c)       ((c) == '\\' || (c) == '/')
+#define IS_LATIN(c)     (('A' <= (c) && (c) <= 'Z') || ('a' <= (c) && (c) <= 'z'))
+// FILETIME of the Unix epoch
+#define EPOCH_FT        116444736000000000ULL
+
+
+#if defined(POSIX_TEST)
+// test knobs
+unsigned posixStatDelay;
+const char* posixStatPrefix;
+unsigned posixHostDelay;
+volatile LONG posixStatCount;
+#endif // POSIX_TEST
+
+static __thread DWORD lastError;
+static char* pszCommandLine;
+
+
+// kernel object behind a HANDLE
+typedef struct {
+    enum { OBJ_FILE = 1, OBJ_MAPPING, OBJ_FIND, OBJ_EVENT, OBJ_THREAD, OBJ_PROCESS,
+        OBJ_NONE } type;
+    int refs;                   // handle and worker thread, if any
+    int fd;                     // file and mapping
+    BOOL reg;                   // regular file: reads are not short
+    BOOL std;                   // standard handle: never closed
+    BOOL signaled;              // waitable object state
+    BOOL manual;                // event is not reset by a wait
+    DWORD code;                 // thread or process exit code
+    pid_t pid;                  // process
+    SIZE_T size;                // mapping size
+    DIR* dir;                   // directory being listed
+    char spec[MAX_PATH];        // file name pattern
+    char path[PATH_MAX];        // directory path with trailing slash
+    LPTHREAD_START_ROUTINE pfn; // thread routine and its parameter
+    LPVOID pv;
+} OBJECT;
+
+// all waitable objects change state under a single lock
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t changed;
+
+// standard handles
+static OBJECT stdObject[3] = {
+    { .type = OBJ_FILE, .fd = 0, .std = TRUE },
+    { .type = OBJ_FILE, .fd = 1, .std = TRUE },
+    { .type = OBJ_FILE, .fd = 2, .std = TRUE }
+};
+
+// mapped views and their sizes
+static struct {
+    void* p;
+    size_t cb;
+} views[64];
+
+
+// sets last error from errno
+static void set_errno_error(void)
+{
+    switch (errno) {
+    case 0:             lastError = ERROR_SUCCESS; break;
+    case ENOENT:        lastError = ERROR_FILE_NOT_FOUND; break;
+    case ENOTDIR:       lastError = ERROR_PATH_NOT_FOUND; break;
+    case EACCES:
+    case EPERM:
+    case EISDIR:
+    case EROFS:         lastError = ERROR_ACCESS_DENIED; break;
+    case EBADF:         lastError = ERROR_INVALID_HANDLE; break;
+    case ENOMEM:        lastError = ERROR_NOT_ENOUGH_MEMORY; break;
+    case ENOEXEC:       lastError = ERROR_BAD_EXE_FORMAT; break;
+    case EEXIST:        lastError = ERROR_FILE_EXISTS; break;
+    case ENOSPC:        lastError = ERROR_DISK_FULL; break;
+    case E2BIG:
+    case ENAMETOOLONG:  lastError = ERROR_FILENAME_EXCED_RANGE; break;
+    case ELOOP:         lastError = ERROR_CANT_RESOLVE_FILENAME; break;
+    case EPIPE:         lastError = ERROR_BROKEN_PIPE; break;
+    default:            lastError = ERROR_INVALID_PARAMETER; break;
+    }
+}
+
+
+// converts native path to POSIX one: drive is dropped, separators are flipped
+BOOL posix_path(char* pszTo, size_t cchTo, LPCTSTR pszFrom)
+{
+    size_t cch = 0;
+    if (IS_LATIN(pszFrom[0]) && pszFrom[1] == ':') {
+        pszFrom += 2;
+        if (!IS_SEP(*pszFrom) && cchTo > 1)
+            pszTo[cch++] = '/'; // no current directory per drive
+    }
+    for ( ; *pszFrom; ++pszFrom) {
+        if (cch + 1 >= cchTo) {
+            lastError = ERROR_FILENAME_EXCED_RANGE;
+            return FALSE;
+        }
+        pszTo[cch++] = (*pszFrom == '\\') ? '/' : *pszFrom;
+    }
+    if (cchTo)
+        pszTo[cch] = '\0';
+    return (cchTo > 0);
+}
+
+
+// converts POSIX path to native one: absolute paths go to drive C:
+static BOOL native_path(char* pszTo, size_t cchTo, const char* pszFrom)
+{
+    size_t cch = 0;
+    if (*pszFrom == '/') {
+        if (cchTo < 3)
+            return FALSE;
+        pszTo[cch++] = 'C';
+        pszTo[cch++] = ':';
+    }
+    for ( ; *pszFrom; ++pszFrom) {
+        if (cch + 1 >= cchTo)
+            return FALSE;
+        pszTo[cch++] = (*pszFrom == '/') ? '\\' : *pszFrom;
+    }
+    pszTo[cch] = '\0';
+    return TRUE;
+}
+
+
+// converts PATH value between POSIX and native lists; free it with free()
+static char* convert_list(const char* pszList, BOOL native)
+{
+    size_t cb = strlen(pszList) * 2 + 3;
+    char* buf = malloc(cb);
+    if (!buf)
+        return NULL;
+
+    size_t cch = 0;
+    for (const char* cp = pszList; ; ) {
+        // entry ends at separator; native ones may be quoted
+        char entry[PATH_MAX];
+        size_t n = 0;
+        BOOL quoted = FALSE;
+        for ( ; *cp && (quoted || *cp != (native ? ':' : ';')); ++cp) {
+            if (!native && *cp == '"')
+                quoted = !quoted;
+            else if (n + 1 < sizeof(entry))
+                entry[n++] = *cp;
+        }
+        entry[n] = '\0';
+
+        if (cch)
+            buf[cch++] = native ? ';' : ':';
+        if (!(native ? native_path(buf + cch, cb - cch, entry)
+            : posix_path(buf + cch, cb - cch, entry))) {
+            free(buf);
+            return NULL;
+        }
+        cch += strlen(buf + cch);
+        if (!*cp++)
+            break;
+    }
+    buf[cch] = '\0';
+    return buf;
+}
+
+
+// checks if environment entry is PATH
+static BOOL is_path_var(const char* psz)
+{
+    return !strncasecmp(psz, "PATH=", 5);
+}
+
+
+#if defined(POSIX_TEST)
+// counts and delays file system query as configured
+static void touch_path(const char* pszPath)
+{
+    InterlockedIncrement(&posixStatCount);
+    if (posixStatDelay && (!posixStatPrefix
+        || !strncmp(pszPath, posixStatPrefix, strlen(posixStatPrefix)))) {
+        struct timespec ts = { posixStatDelay / 1000000,
+            (long)(posixStatDelay % 1000000) * 1000 };
+        while (nanosleep(&ts, &ts) && errno == EINTR) ;
+    }
+}
+#else
+#define touch_path(pszPath)     ((void)(pszPath))
+#endif // POSIX_TEST
+
+
+// gets file status by native path, as file attribute queries do
+static BOOL stat_path(LPCTSTR pszPath, struct stat* pst)
+{
+    char tmp[PATH_MAX];
+    if (!posix_path(ARRAY(tmp), pszPath))
+        return FALSE;
+    touch_path(tmp);
+    if (stat(tmp, pst)) {
+        set_errno_error();
+        return FALSE;
+    }
+    return TRUE;
+}
+
+
+// converts time to FILETIME
+static FILETIME to_filetime(const struct timespec* pts)
+{
+    ULONGLONG t = (ULONGLONG)pts->tv_sec * 10000000 + (ULONGLONG)pts->tv_nsec / 100
+        + EPOCH_FT;
+    return (FILETIME){ (DWORD)t, (DWORD)(t >> 32) };
+}
+
+
+// makes file attributes from file mode
+static DWORD to_attributes(mode_t mode)
+{
+    return S_ISDIR(mode) ? FILE_ATTRIBUTE_DIRECTORY : FILE_ATTRIBUTE_ARCHIVE;
+}
+
+
+// allocates handle of given type
+static OBJECT* new_object(int type, int refs)
+{
+    OBJECT* po = calloc(1, sizeof(OBJECT));
+    if (!po) {
+        lastError = ERROR_NOT_ENOUGH_MEMORY;
+        return NULL;
+    }
+    po->type = type;
+    po->refs = refs;
+    po->fd = -1;
+    return po;
+}
+
+
+// drops reference to waitable object, freeing it with the last one
+static void release_object(OBJECT* po)
+{
+    pthread_mutex_lock(&lock);
+    BOOL last = !--po->refs;
+    pthread_mutex_unlock(&lock);
+    if (last)
+        free(po);
+}
+
+
+// signals waitable object
+static void signal_object(OBJECT* po, DWORD dwCode)
+{
+    pthread_mutex_lock(&lock);
+    po->code = dwCode;
+    po->signaled = TRUE;
+    pthread_cond_broadcast(&changed);
+    pthread_mutex_unlock(&lock);
+}
+
+
+// quotes argument per MSVCRT rules into buffer at *pcch
+static BOOL quote_to(char* buf, size_t cb, size_t* pcch, const char* arg)
+{
+    size_t cch = *pcch;
+    BOOL quote = !*arg || strpbrk(arg, " \t\n\v\"");
+    if (cch + 2 * strlen(arg) + 4 > cb)
+        return FALSE;
+
+    if (cch)
+        buf[cch++] = ' ';
+    if (!quote) {
+        while (*arg)
+            buf[cch++] = *arg++;
+    } else {
+        buf[cch++] = '"';
+        for (;;) {
+            size_t n = 0;
+            for ( ; *arg == '\\'; ++arg)
+                ++n;
+            if (!*arg || *arg == '"')
+                n = 2 * n + (*arg == '"');
+            for ( ; n; --n)
+                buf[cch++] = '\\';
+            if (!*arg)
+                break;
+            buf[cch++] = *arg++;
+        }
+        buf[cch++] = '"';
+    }
+    buf[cch] = '\0';
+    *pcch = cch;
+    return TRUE;
+}
+
+
+// splits command line per MSVCRT rules; argv[] and strings go into one
+// allocation, free it with free()
+static char** split_cmdline(const char* pszCmdLine)
+{
+    size_t cch = strlen(pszCmdLine);
+    char** argv = malloc((cch / 2 + 2) * sizeof(char*) + cch + 1);
+    if (!argv)
+        return NULL;
+    char* out = (char*)(argv + cch / 2 + 2);
+    const char* cp = pszCmdLine;
+    int argc = 0;
+
+    // program name: no escapes at all
+    argv[argc++] = out;
+    char end = (*cp == '"') ? *cp++ : '\0';
+    for ( ; *cp && (end ? *cp != end : (*cp != ' ' && *cp != '\t')); )
+        *out++ = *cp++;
+    if (end && *cp)
+        ++cp;
+    *out++ = '\0';
+
+    // args: quotes may start and end anywhere within an arg
+    enum { BLANK, PLAIN, QUOTED } state = BLANK;
+    size_t slashes = 0;
+    for ( ; ; ++cp) {
+        char c = *cp;
+        if (c == '\\') {
+            ++slashes;
+            continue;
+        }
+        if (state == BLANK && c && c != ' ' && c != '\t') {
+            argv[argc++] = out;
+            state = PLAIN;
+        }
+        if (c == '"') {
+            for ( ; slashes >= 2; slashes -= 2)
+                *out++ = '\\';
+            if (slashes) {
+                *out++ = '"';
+                slashes = 0;
+            } else if (state == QUOTED && cp[1] == '"') {
+                *out++ = '"';
+                ++cp;
+                state = PLAIN;
+            } else {
+                state = (state == QUOTED) ? PLAIN : QUOTED;
+            }
+            continue;
+        }
+        for ( ; slashes; --slashes)
+            *out++ = '\\';
+        if (!c || (state == PLAIN && (c == ' ' || c == '\t'))) {
+            if (state != BLANK)
+                *out++ = '\0';
+            state = BLANK;
+            if (!c)
+                break;
+        } else if (state != BLANK) {
+            *out++ = c;
+        }
+    }
+
+    argv[argc] = NULL;
+    return argv;
+}
+
+
+// makes argv[] for command line converting native paths and envp[] for
+// environment block converting PATH; free them with free()
+static BOOL make_exec_args(LPCTSTR pszCmdLine, LPCTSTR pszEnv, char*** pargv,
+    char*** penvp)
+{
+    *pargv = *penvp = NULL;
+    char** argv = split_cmdline(pszCmdLine);
+    if (!argv) {
+        lastError = ERROR_NOT_ENOUGH_MEMORY;
+        return FALSE;
+    }
+
+    // as MSYS runtime does for POSIX programs, drive-rooted args become POSIX paths
+    // in place: they only get shorter
+    for (char** pp = argv; *pp; ++pp)
+        if (IS_LATIN((*pp)[0]) && (*pp)[1] == ':' && IS_SEP((*pp)[2]))
+            posix_path(*pp, strlen(*pp) + 1, *pp);
+
+    // environment block strings are copied with PATH converted back
+    size_t cnt = 0, cb = 0;
+    const char* psz;
+    for (psz = pszEnv; psz && *psz; psz += strlen(psz) + 1, ++cnt)
+        cb += strlen(psz) * 2 + 3;
+    char** envp = environ;
+    if (pszEnv) {
+        if (!(envp = malloc((cnt + 1) * sizeof(char*) + cb))) {
+            free(argv);
+            lastError = ERROR_NOT_ENOUGH_MEMORY;
+            return FALSE;
+        }
+        char* out = (char*)(envp + cnt + 1);
+        cnt = 0;
+        for (psz = pszEnv; *psz; psz += strlen(psz) + 1) {
+            envp[cnt++] = out;
+            char* list;
+            if (is_path_var(psz) && (list = convert_list(psz + 5, FALSE))) {
+                out += sprintf(out, "PATH=%s", list) + 1;
+                free(list);
+            } else {
+                out = stpcpy(out, psz) + 1;
+            }
+        }
+        envp[cnt] = NULL;
+    }
+
+    *pargv = argv;
+    *penvp = envp;
+    return TRUE;
+}
+
+
+// captures command line from argv[] on startup; glibc passes it to constructors
+__attribute__((constructor))
+static void init_layer(int argc, char** argv)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&changed, &attr);
+    pthread_condattr_destroy(&attr);
+
+    size_t cb = 1;
+    for (int i = 0; i < argc; ++i)
+        cb += strlen(argv[i]) * 2 + 4;
+    size_t cch = 0;
+    if ((pszCommandLine = malloc(cb)) != NULL) {
+        pszCommandLine[0] = '\0';
+        for (int i = 0; i < argc; ++i)
+            quote_to(pszCommandLine, cb, &cch, argv[i]);
+    }
+
+#if defined(POSIX_TEST)
+    // POSIX_STAT_DELAY=us[,prefix] and POSIX_HOST_DELAY=us
+    const char* psz = getenv("POSIX_STAT_DELAY");
+    if (psz) {
+        posixStatDelay = (unsigned)strtoul(psz, NULL, 10);
+        if ((psz = strchr(psz, ',')) != NULL && psz[1])
+            posixStatPrefix = psz + 1;
+    }
+    if ((psz = getenv("POSIX_HOST_DELAY")) != NULL)
+        posixHostDelay = (unsigned)strtoul(psz, NULL, 10);
+#endif // POSIX_TEST
+}
+
+
+//
+// errors
+//
+DWORD GetLastError(void)
+{
+    return lastError;
+}
+
+
+void SetLastError(DWORD dwErrCode)
+{
+    lastError = dwErrCode;
+}
+
+
+DWORD FormatMessage(DWORD dwFlags, LPCVOID lpSource, DWORD dwMessageId,
+    DWORD dwLanguageId, LPTSTR lpBuffer, DWORD nSize, void* Arguments)
+{
+    static const struct {
+        DWORD code;
+        const char* text;
+    } sMsg[] = {
+        { ERROR_SUCCESS, "The operation completed successfully." },
+        { ERROR_FILE_NOT_FOUND, "The system cannot find the file specified." },
+        { ERROR_PATH_NOT_FOUND, "The system cannot find the path specified." },
+        { ERROR_ACCESS_DENIED, "Access is denied." },
+        { ERROR_INVALID_HANDLE, "The handle is invalid." },
+        { ERROR_NOT_ENOUGH_MEMORY,
+            "Not enough memory resources are available to process this command." },
+        { ERROR_INVALID_ENVIRONMENT, "The environment is incorrect." },
+        { ERROR_BAD_FORMAT,
+            "An attempt was made to load a program with an incorrect format." },
+        { ERROR_FILE_EXISTS, "The file exists." },
+        { ERROR_INVALID_PARAMETER, "The parameter is incorrect." },
+        { ERROR_BROKEN_PIPE, "The pipe has been ended." },
+        { ERROR_DISK_FULL, "There is not enough space on the disk." },
+        { ERROR_INSUFFICIENT_BUFFER,
+            "The data area passed to a system call is too small." },
+        { ERROR_BAD_ARGUMENTS, "One or more arguments are not correct." },
+        { ERROR_ALREADY_EXISTS,
+            "Cannot create a file when that file already exists." },
+        { ERROR_BAD_EXE_FORMAT, "%1 is not a valid Win32 application." },
+        { ERROR_ENVVAR_NOT_FOUND,
+            "The system could not find the environment option that was entered." },
+        { ERROR_FILENAME_EXCED_RANGE, "The filename or extension is too long." },
+        { ERROR_NO_UNICODE_TRANSLATION, "No mapping for the Unicode character exists "
+            "in the target multi-byte code page." },
+        { ERROR_CANCELLED, "The operation was canceled by the user." },
+        { ERROR_CANT_RESOLVE_FILENAME,
+            "The name of the file cannot be resolved by the system." }
+    };
+    (void)lpSource;
+    (void)dwLanguageId;
+    (void)Arguments;
+
+    for (size_t i = 0; i < COUNT(sMsg); ++i) {
+        if (sMsg[i].code != dwMessageId)
+            continue;
+        size_t cch = strlen(sMsg[i].text) + 2;
+        if (dwFlags & FORMAT_MESSAGE_ALLOCATE_BUFFER) {
+            if (!(*(char**)lpBuffer = malloc(cch + 1))) {
+                lastError = ERROR_NOT_ENOUGH_MEMORY;
+                return 0;
+            }
+            lpBuffer = *(char**)lpBuffer;
+        } else if (cch >= nSize) {
+            lastError = ERROR_INSUFFICIENT_BUFFER;
+            return 0;
+        }
+        sprintf(lpBuffer, "%s\r\n", sMsg[i].text);
+        return (DWORD)cch;
+    }
+
+    lastError = 317; // ERROR_MR_MID_NOT_FOUND
+    return 0;
+}
+
+
+//
+// memory
+//
+HANDLE GetProcessHeap(void)
+{
+    static int heap;
+    return &heap;
+}
+
+
+LPVOID HeapAlloc(HANDLE hHeap, DWORD dwFlags, SIZE_T dwBytes)
+{
+    (void)hHeap;
+    if (!dwBytes)
+        dwBytes = 1;
+    return (dwFlags & HEAP_ZERO_MEMORY) ? calloc(1, dwBytes) : malloc(dwBytes);
+}
+
+
+BOOL HeapFree(HANDLE hHeap, DWORD dwFlags, LPVOID lpMem)
+{
+    (void)hHeap;
+    (void)dwFlags;
+    free(lpMem);
+    return TRUE;
+}
+
+
+SIZE_T HeapCompact(HANDLE hHeap, DWORD dwFlags)
+{
+    (void)hHeap;
+    (void)dwFlags;
+    malloc_trim(0);
+    return 0;
+}
+
+
+//
+// handles and files
+//
+BOOL CloseHandle(HANDLE hObject)
+{
+    OBJECT* po = hObject;
+    if (!po || hObject == INVALID_HANDLE_VALUE || po->std) {
+        lastError = ERROR_INVALID_HANDLE;
+        return (po && po->std);
+    }
+
+    switch (po->type) {
+    case OBJ_FILE:
+    case OBJ_MAPPING:
+        close(po->fd);
+        free(po);
+        break;
+    case OBJ_FIND:
+        closedir(po->dir);
+        free(po);
+        break;
+    default:
+        release_object(po);
+        break;
+    }
+    return TRUE;
+}
+
+
+BOOL DuplicateHandle(HANDLE hSourceProcessHandle, HANDLE hSourceHandle,
+    HANDLE hTargetProcessHandle, HANDLE* lpTargetHandle, DWORD dwDesiredAccess,
+    BOOL bInheritHandle, DWORD dwOptions)
+{
+    (void)hSourceProcessHandle;
+    (void)hTargetProcessHandle;
+    (void)dwDesiredAccess;
+    (void)bInheritHandle;
+    (void)dwOptions;
+
+    // note: only files; every descriptor is close-on-exec, child gets its standard
+    // handles from STARTUPINFO
+    const OBJECT* ps = hSourceHandle;
+    OBJECT* po;
+    if (ps->type != OBJ_FILE) {
+        lastError = ERROR_NOT_SUPPORTED;
+        return FALSE;
+    }
+    if (!(po = new_object(OBJ_FILE, 1)))
+        return FALSE;
+    if ((po->fd = fcntl(ps->fd, F_DUPFD_CLOEXEC, 3)) < 0) {
+        set_errno_error();
+        free(po);
+        return FALSE;
+    }
+    po->reg = ps->reg;
+    *lpTargetHandle = po;
+    return TRUE;
+}
+
+
+HANDLE GetStdHandle(DWORD nStdHandle)
+{
+    switch (nStdHandle) {
+    case STD_INPUT_HANDLE:  return &stdObject[0];
+    case STD_OUTPUT_HANDLE: return &stdObject[1];
+    case STD_ERROR_HANDLE:  return &stdObject[2];
+    default:                return INVALID_HANDLE_VALUE;
+    }
+}
+
+
+HANDLE CreateFile(LPCTSTR lpFileName, DWORD dwDesiredAccess, DWORD dwShareMode,
+    LPSECURITY_ATTRIBUTES lpSecurityAttributes, DWORD dwCreationDisposition,
+    DWORD dwFlagsAndAttributes, HANDLE hTemplateFile)
+{
+    (void)dwShareMode; // note: no sharing modes in POSIX
+    (void)lpSecurityAttributes;
+    (void)hTemplateFile;
+
+    char tmp[PATH_MAX];
+    if (!posix_path(ARRAY(tmp), lpFileName))
+        return INVALID_HANDLE_VALUE;
+
+    int flags = O_CLOEXEC;
+    BOOL write = (dwDesiredAccess & (GENERIC_WRITE | FILE_APPEND_DATA)) != 0;
+    if (dwDesiredAccess & GENERIC_READ)
+        flags |= write ? O_RDWR : O_RDONLY;
+    else
+        flags |= write ? O_WRONLY : O_RDONLY;
+    if ((dwDesiredAccess & FILE_APPEND_DATA) && !(dwDesiredAccess & GENERIC_WRITE))
+        flags |= O_APPEND;
+    switch (dwCreationDisposition) {
+    case CREATE_NEW:        flags |= O_CREAT | O_EXCL; break;
+    case CREATE_ALWAYS:     flags |= O_CREAT | O_TRUNC; break;
+    case OPEN_ALWAYS:       flags |= O_CREAT; break;
+    case TRUNCATE_EXISTING: flags |= O_TRUNC; break;
+    }
+
+    OBJECT* po = new_object(OBJ_FILE, 1);
+    struct stat st;
+    if (!po)
+        return INVALID_HANDLE_VALUE;
+    if ((po->fd = open(tmp, flags, 0666)) < 0 || fstat(po->fd, &st)) {
+        set_errno_error();
+        if (po->fd >= 0)
+            close(po->fd);
+        free(po);
+        return INVALID_HANDLE_VALUE;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        close(po->fd);
+        free(po);
+        lastError = ERROR_ACCESS_DENIED;
+        return INVALID_HANDLE_VALUE;
+    }
+    po->reg = S_ISREG(st.st_mode);
+    if (dwFlagsAndAttributes & FILE_FLAG_DELETE_ON_CLOSE)
+        unlink(tmp); // gone as soon as closed
+    lastError = ERROR_SUCCESS;
+    return po;
+}
+
+
+BOOL ReadFile(HANDLE hFile, LPVOID lpBuffer, DWORD nNumberOfBytesToRead,
+    LPDWORD lpNumberOfBytesRead, LPOVERLAPPED lpOverlapped)
+{
+    (void)lpOverlapped;
+    const OBJECT* po = hFile;
+    DWORD cb = 0;
+    while (cb < nNumberOfBytesToRead) {
+        ssize_t n = read(po->fd, (char*)lpBuffer + cb, nNumberOfBytesToRead - cb);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0) {
+            set_errno_error();
+            *lpNumberOfBytesRead = cb;
+            return FALSE;
+        }
+        cb += (DWORD)n;
+        if (!n || !po->reg)
+            break; // end of file or whatever pipe has
+    }
+    *lpNumberOfBytesRead = cb;
+    return TRUE;
+}
+
+
+BOOL WriteFile(HANDLE hFile, LPCVOID lpBuffer, DWORD nNumberOfBytesToWrite,
+    LPDWORD lpNumberOfBytesWritten, LPOVERLAPPED lpOverlapped)
+{
+    (void)lpOverlapped;
+    const OBJECT* po = hFile;
+    DWORD cb = 0;
+    while (cb < nNumberOfBytesToWrite) {
+        ssize_t n = write(po->fd, (const char*)lpBuffer + cb,
+            nNumberOfBytesToWrite - cb);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            set_errno_error();
+            *lpNumberOfBytesWritten = cb;
+            return FALSE;
+        }
+        cb += (DWORD)n;
+    }
+    *lpNumberOfBytesWritten = cb;
+    return TRUE;
+}
+
+
+DWORD SetFilePointer(HANDLE hFile, LONG lDistanceToMove, LONG* lpDistanceToMoveHigh,
+    DWORD dwMoveMethod)
+{
+    const OBJECT* po = hFile;
+    off_t off = lpDistanceToMoveHigh ? (off_t)((ULONGLONG)(DWORD)*lpDistanceToMoveHigh
+        << 32 | (DWORD)lDistanceToMove) : (off_t)lDistanceToMove;
+    int whence = (dwMoveMethod == FILE_END) ? SEEK_END
+        : (dwMoveMethod == FILE_CURRENT) ? SEEK_CUR : SEEK_SET;
+    if ((off = lseek(po->fd, off, whence)) < 0) {
+        set_errno_error();
+        return INVALID_SET_FILE_POINTER;
+    }
+    if (lpDistanceToMoveHigh)
+        *lpDistanceToMoveHigh = (LONG)((ULONGLONG)off >> 32);
+    lastError = ERROR_SUCCESS;
+    return (DWORD)off;
+}
+
+
+DWORD GetFileSize(HANDLE hFile, LPDWORD lpFileSizeHigh)
+{
+    const OBJECT* po = hFile;
+    struct stat st;
+    if (fstat(po->fd, &st)) {
+        set_errno_error();
+        return INVALID_FILE_SIZE;
+    }
+    if (lpFileSizeHigh)
+        *lpFileSizeHigh = (DWORD)((ULONGLONG)st.st_size >> 32);
+    return (DWORD)st.st_size;
+}
+
+
+// locks or unlocks byte range with open file description lock, which belongs to
+// the handle just like Win32 one
+static BOOL lock_range(HANDLE hFile, short type, BOOL wait, DWORD dwLow, DWORD dwHigh,
+    const OVERLAPPED* pov)
+{
+    const OBJECT* po = hFile;
+    struct flock fl = {
+        .l_type = type,
+        .l_whence = SEEK_SET,
+        .l_start = (off_t)((ULONGLONG)pov->OffsetHigh << 32 | pov->Offset),
+        .l_len = (off_t)((ULONGLONG)dwHigh << 32 | dwLow)
+    };
+    int r, cmd = wait ? F_OFD_SETLKW : F_OFD_SETLK;
+    while ((r = fcntl(po->fd, cmd, &fl)) && errno == EINTR) ;
+    if (r) {
+        set_errno_error();
+        return FALSE;
+    }
+    return TRUE;
+}
+
+
+BOOL LockFileEx(HANDLE hFile, DWORD dwFlags, DWORD dwReserved,
+    DWORD nNumberOfBytesToLockLow, DWORD nNumberOfBytesToLockHigh,
+    LPOVERLAPPED lpOverlapped)
+{
+    (void)dwReserved;
+    return lock_range(hFile, (dwFlags & LOCKFILE_EXCLUSIVE_LOCK) ? F_WRLCK : F_RDLCK,
+        !(dwFlags & LOCKFILE_FAIL_IMMEDIATELY), nNumberOfBytesToLockLow,
+        nNumberOfBytesToLockHigh, lpOverlapped);
+}
+
+
+BOOL UnlockFileEx(HANDLE hFile, DWORD dwReserved, DWORD nNumberOfBytesToUnlockLow,
+    DWORD nNumberOfBytesToUnlockHigh, LPOVERLAPPED lpOverlapped)
+{
+    (void)dwReserved;
+    return lock_range(hFile, F_UNLCK, FALSE, nNumberOfBytesToUnlockLow,
+        nNumberOfBytesToUnlockHigh, lpOverlapped);
+}
+
+
+HANDLE CreateFileMapping(HANDLE hFile, LPSECURITY_ATTRIBUTES lpAttributes,
+    DWORD flProtect, DWORD dwMaximumSizeHigh, DWORD dwMaximumSizeLow, LPCTSTR lpName)
+{
+    (void)lpAttributes;
+    (void)lpName;
+    const OBJECT* pf = hFile;
+    struct stat st;
+    off_t size = (off_t)((ULONGLONG)dwMaximumSizeHigh << 32 | dwMaximumSizeLow);
+    if (fstat(pf->fd, &st)) {
+        set_errno_error();
+        return NULL;
+    }
+
+    // file grows up to the mapping size as in Win32
+    if (!size)
+        size = st.st_size;
+    if (!size || (st.st_size < size && (flProtect != PAGE_READWRITE
+        || ftruncate(pf->fd, size)))) {
+        if (size)
+            set_errno_error();
+        else
+            lastError = ERROR_INVALID_PARAMETER;
+        return NULL;
+    }
+
+    OBJECT* po = new_object(OBJ_MAPPING, 1);
+    if (!po)
+        return NULL;
+    if ((po->fd = fcntl(pf->fd, F_DUPFD_CLOEXEC, 3)) < 0) {
+        set_errno_error();
+        free(po);
+        return NULL;
+    }
+    po->size = (SIZE_T)size;
+    po->reg = (flProtect == PAGE_READWRITE);
+    return po;
+}
+
+
+LPVOID MapViewOfFile(HANDLE hFileMappingObject, DWORD dwDesiredAccess,
+    DWORD dwFileOffsetHigh, DWORD dwFileOffsetLow, SIZE_T dwNumberOfBytesToMap)
+{
+    const OBJECT* po = hFileMappingObject;
+    off_t off = (off_t)((ULONGLONG)dwFileOffsetHigh << 32 | dwFileOffsetLow);
+    size_t cb = dwNumberOfBytesToMap ? dwNumberOfBytesToMap : po->size - (size_t)off;
+    int prot = PROT_READ | ((dwDesiredAccess & FILE_MAP_WRITE) ? PROT_WRITE : 0);
+    void* p = mmap(NULL, cb, prot, MAP_SHARED, po->fd, off);
+    if (p == MAP_FAILED) {
+        set_errno_error();
+        return NULL;
+    }
+
+    // remember size to unmap
+    pthread_mutex_lock(&lock);
+    size_t i = 0;
+    while (i < COUNT(views) && views[i].p)
+        ++i;
+    if (i < COUNT(views)) {
+        views[i].p = p;
+        views[i].cb = cb;
+    }
+    pthread_mutex_unlock(&lock);
+    if (i == COUNT(views)) {
+        munmap(p, cb);
+        lastError = ERROR_NOT_ENOUGH_MEMORY;
+        return NULL;
+    }
+    return p;
+}
+
+
+BOOL UnmapViewOfFile(LPCVOID lpBaseAddress)
+{
+    size_t cb = 0;
+    pthread_mutex_lock(&lock);
+    for (size_t i = 0; i < COUNT(views); ++i) {
+        if (views[i].p == lpBaseAddress) {
+            cb = views[i].cb;
+            views[i].p = NULL;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    if (!cb || munmap((void*)lpBaseAddress, cb)) {
+        lastError = ERROR_INVALID_PARAMETER;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+
+BOOL CopyFile(LPCTSTR lpExistingFileName, LPCTSTR lpNewFileName, BOOL bFailIfExists)
+{
+    char szFrom[PATH_MAX], szTo[PATH_MAX];
+    if (!posix_path(ARRAY(szFrom), lpExistingFileName)
+        || !posix_path(ARRAY(szTo), lpNewFileName))
+        return FALSE;
+
+    // contents, mode and modification time
+    struct stat st;
+    int fdFrom = open(szFrom, O_RDONLY | O_CLOEXEC), fdTo = -1;
+    BOOL ok = fdFrom >= 0 && !fstat(fdFrom, &st)
+        && (fdTo = open(szTo, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC
+            | (bFailIfExists ? O_EXCL : 0), st.st_mode & 07777)) >= 0;
+    char buf[65536];
+    ssize_t n;
+    while (ok && (n = read(fdFrom, buf, sizeof(buf))) != 0)
+        ok = n > 0 && write(fdTo, buf, (size_t)n) == n;
+    ok = ok && !fchmod(fdTo, st.st_mode & 07777)
+        && !futimens(fdTo, (struct timespec[2]){ st.st_atim, st.st_mtim });
+    if (!ok)
+        set_errno_error();
+    if (fdFrom >= 0)
+        close(fdFrom);
+    if (fdTo >= 0)
+        close(fdTo);
+    return ok;
+}
+
+
+DWORD GetFileAttributes(LPCTSTR lpFileName)
+{
+    struct stat st;
+    return stat_path(lpFileName, &st) ? to_attributes(st.st_mode)
+        : INVALID_FILE_ATTRIBUTES;
+}
+
+
+BOOL GetFileAttributesEx(LPCTSTR lpFileName, GET_FILEEX_INFO_LEVELS fInfoLevelId,
+    LPVOID lpFileInformation)
+{
+    (void)fInfoLevelId;
+    struct stat st;
+    if (!stat_path(lpFileName, &st))
+        return FALSE;
+
+    WIN32_FILE_ATTRIBUTE_DATA* pfad = lpFileInformation;
+    pfad->dwFileAttributes = to_attributes(st.st_mode);
+    pfad->ftCreationTime = to_filetime(&st.st_ctim);
+    pfad->ftLastAccessTime = to_filetime(&st.st_atim);
+    pfad->ftLastWriteTime = to_filetime(&st.st_mtim);
+    pfad->nFileSizeHigh = (DWORD)((ULONGLONG)st.st_size >> 32);
+    pfad->nFileSizeLow = (DWORD)st.st_size;
+    return TRUE;
+}
+
+
+// fills next directory entry matching the pattern; note: only attributes and
+// name, which is all Win32 listing is used for here
+static BOOL next_entry(OBJECT* po, WIN32_FIND_DATA* pfd)
+{
+    struct dirent* pde;
+    while ((pde = readdir(po->dir)) != NULL) {
+        if (!PathMatchSpec(pde->d_name, po->spec)
+            || strlen(pde->d_name) >= sizeof(pfd->cFileName))
+            continue;
+        BOOL dir = (pde->d_type == DT_DIR);
+        struct stat st;
+        if (pde->d_type == DT_LNK || pde->d_type == DT_UNKNOWN)
+            dir = !fstatat(dirfd(po->dir), pde->d_name, &st, 0) && S_ISDIR(st.st_mode);
+        ZeroMemory(pfd, sizeof(*pfd));
+        pfd->dwFileAttributes = dir ? FILE_ATTRIBUTE_DIRECTORY : FILE_ATTRIBUTE_ARCHIVE;
+        strcpy(pfd->cFileName, pde->d_name);
+        return TRUE;
+    }
+    lastError = 18; // ERROR_NO_MORE_FILES
+    return FALSE;
+}
+
+
+HANDLE FindFirstFile(LPCTSTR lpFileName, WIN32_FIND_DATA* lpFindFileData)
+{
+    OBJECT* po = new_object(OBJ_FIND, 1);
+    if (!po)
+        return INVALID_HANDLE_VALUE;
+
+    // dir\spec
+    if (!posix_path(ARRAY(po->path), lpFileName)) {
+        free(po);
+        return INVALID_HANDLE_VALUE;
+    }
+    char* name = strrchr(po->path, '/');
+    name = name ? name + 1 : po->path;
+    StringCchCopy(ARRAY(po->spec), name);
+    *name = '\0';
+
+    touch_path(po->path);
+    if (!(po->dir = opendir(*po->path ? po->path : "."))) {
+        set_errno_error();
+        free(po);
+        return INVALID_HANDLE_VALUE;
+    }
+    if (!next_entry(po, lpFindFileData)) {
+        closedir(po->dir);
+        free(po);
+        lastError = ERROR_FILE_NOT_FOUND;
+        return INVALID_HANDLE_VALUE;
+    }
+    return po;
+}
+
+
+BOOL FindNextFile(HANDLE hFindFile, WIN32_FIND_DATA* lpFindFileData)
+{
+    return next_entry(hFindFile, lpFindFileData);
+}
+
+
+BOOL FindClose(HANDLE hFindFile)
+{
+    return CloseHandle(hFindFile);
+}
+
+
+LONG CompareFileTime(const FILETIME* lpFileTime1, const FILETIME* lpFileTime2)
+{
+    ULONGLONG t1 = (ULONGLONG)lpFileTime1->dwHighDateTime << 32
+        | lpFileTime1->dwLowDateTime;
+    ULONGLONG t2 = (ULONGLONG)lpFileTime2->dwHighDateTime << 32
+        | lpFileTime2->dwLowDateTime;
+    return (t1 > t2) - (t1 < t2);
+}
+
+
+// copies native form of POSIX path with optional trailing separator
+static DWORD copy_native(LPTSTR lpBuffer, DWORD nBufferLength, const char* pszPath,
+    BOOL slash)
+{
+    char tmp[PATH_MAX + 2];
+    if (!native_path(tmp, sizeof(tmp) - 1, pszPath))
+        return 0;
+    size_t cch = strlen(tmp);
+    if (slash && (!cch || tmp[cch - 1] != '\\')) {
+        tmp[cch++] = '\\';
+        tmp[cch] = '\0';
+    }
+    if (cch >= nBufferLength)
+        return (DWORD)cch + 1; // required size
+    memcpy(lpBuffer, tmp, cch + 1);
+    return (DWORD)cch;
+}
+
+
+DWORD GetTempPath(DWORD nBufferLength, LPTSTR lpBuffer)
+{
+    const char* psz = getenv("TMPDIR");
+    return copy_native(lpBuffer, nBufferLength, psz && *psz ? psz : "/tmp", TRUE);
+}
+
+
+UINT GetTempFileName(LPCTSTR lpPathName, LPCTSTR lpPrefixString, UINT uUnique,
+    LPTSTR lpTempFileName)
+{
+    (void)uUnique;
+    char tmp[PATH_MAX];
+    size_t cch;
+    if (!posix_path(ARRAY(tmp), lpPathName))
+        return 0;
+    cch = strlen(tmp);
+    if (cch && tmp[cch - 1] == '/')
+        tmp[--cch] = '\0';
+    if ((size_t)snprintf(tmp + cch, sizeof(tmp) - cch, "/%.3sXXXXXX.tmp",
+        lpPrefixString) >= sizeof(tmp) - cch) {
+        lastError = ERROR_FILENAME_EXCED_RANGE;
+        return 0;
+    }
+    int fd = mkstemps(tmp, 4);
+    if (fd < 0) {
+        set_errno_error();
+        return 0;
+    }
+    close(fd);
+    if (copy_native(lpTempFileName, MAX_PATH, tmp, FALSE) >= MAX_PATH) {
+        unlink(tmp);
+        lastError = ERROR_FILENAME_EXCED_RANGE;
+        return 0;
+    }
+    return (UINT)fd + 1;
+}
+
+
+DWORD GetCurrentDirectory(DWORD nBufferLength, LPTSTR lpBuffer)
+{
+    char tmp[PATH_MAX];
+    if (!getcwd(ARRAY(tmp))) {
+        set_errno_error();
+        return 0;
+    }
+    return copy_native(lpBuffer, nBufferLength, tmp, FALSE);
+}
+
+
+// note: there are no system directories searched before PATH
+UINT GetSystemDirectory(LPTSTR lpBuffer, UINT uSize)
+{
+    if (uSize)
+        lpBuffer[0] = '\0';
+    lastError = ERROR_PATH_NOT_FOUND;
+    return 0;
+}
+
+
+UINT GetWindowsDirectory(LPTSTR lpBuffer, UINT uSize)
+{
+    return GetSystemDirectory(lpBuffer, uSize);
+}
+
+
+DWORD GetModuleFileName(HMODULE hModule, LPTSTR lpFilename, DWORD nSize)
+{
+    (void)hModule;
+    char tmp[PATH_MAX];
+    ssize_t n = readlink("/proc/self/exe", tmp, sizeof(tmp) - 1);
+    if (n < 0) {
+        set_errno_error();
+        return 0;
+    }
+    tmp[n] = '\0';
+
+    // truncated name has no terminator in Windows XP, but it has one here
+    DWORD cch = copy_native(lpFilename, nSize, tmp, FALSE);
+    if (cch >= nSize && nSize) {
+        char full[PATH_MAX + 2];
+        native_path(ARRAY(full), tmp);
+        memcpy(lpFilename, full, nSize - 1);
+        lpFilename[nSize - 1] = '\0';
+        lastError = ERROR_INSUFFICIENT_BUFFER;
+        return nSize;
+    }
+    return cch;
+}
+
+
+// reads ini file into memory; free it with free()
+static char* read_ini(LPCTSTR lpFileName)
+{
+    HANDLE hFile = CreateFile(lpFileName, GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return NULL;
+    DWORD cb = GetFileSize(hFile, NULL);
+    char* buf = (cb != INVALID_FILE_SIZE) ? malloc(cb + 1) : NULL;
+    if (buf && !ReadFile(hFile, buf, cb, &cb, NULL)) {
+        free(buf);
+        buf = NULL;
+    }
+    CloseHandle(hFile);
+    if (buf)
+        buf[cb] = '\0';
+    return buf;
+}
+
+
+// gets next ini line in place with surrounding blanks removed
+static char* next_ini_line(char** pcp)
+{
+    char* line = *pcp;
+    if (!*line)
+        return NULL;
+    char* end = line + strcspn(line, "\r\n");
+    *pcp = end + strspn(end, "\r\n");
+    *end = '\0';
+    while (*line == ' ' || *line == '\t')
+        ++line;
+    while (end > line && (end[-1] == ' ' || end[-1] == '\t'))
+        *--end = '\0';
+    return line;
+}
+
+
+// finds section lines in ini text; returns text after [section] line
+static char* find_section(char* text, LPCTSTR lpAppName)
+{
+    size_t cch = strlen(lpAppName);
+    for (char *cp = text, *line; (line = next_ini_line(&cp)) != NULL; )
+        if (line[0] == '[' && !strncasecmp(line + 1, lpAppName, cch)
+            && line[cch + 1] == ']')
+            return cp;
+    return NULL;
+}
+
+
+DWORD GetPrivateProfileSection(LPCTSTR lpAppName, LPTSTR lpReturnedString,
+    DWORD nSize, LPCTSTR lpFileName)
+{
+    char* text = read_ini(lpFileName);
+    char* cp = text ? find_section(text, lpAppName) : NULL;
+    DWORD cch = 0;
+    BOOL full = FALSE;
+    if (nSize < 2) {
+        free(text);
+        return 0;
+    }
+
+    // key=value lines up to the next section; comments are dropped
+    for (char* line; cp && !full && (line = next_ini_line(&cp)) != NULL; ) {
+        if (line[0] == '[')
+            break;
+        if (!line[0] || line[0] == ';')
+            continue;
+        size_t n = strlen(line) + 1;
+        if (cch + n + 1 > nSize) {
+            n = cch < nSize - 2 ? nSize - 2 - cch : 0; // truncated as in Win32
+            full = TRUE;
+        }
+        memcpy(lpReturnedString + cch, line, n);
+        cch += (DWORD)n;
+    }
+    if (full) {
+        lpReturnedString[nSize - 2] = lpReturnedString[nSize - 1] = '\0';
+        cch = nSize - 2;
+    } else {
+        lpReturnedString[cch] = '\0';
+        if (!cch)
+            lpReturnedString[1] = '\0';
+    }
+    free(text);
+    return full ? cch : (cch ? cch : 0);
+}
+
+
+DWORD GetPrivateProfileString(LPCTSTR lpAppName, LPCTSTR lpKeyName,
+    LPCTSTR lpDefault, LPTSTR lpReturnedString, DWORD nSize, LPCTSTR lpFileName)
+{
+    char* text = read_ini(lpFileName);
+    char* cp = text ? find_section(text, lpAppName) : NULL;
+    const char* value = lpDefault ? lpDefault : "";
+    size_t cchKey = strlen(lpKeyName);
+    for (char* line; cp && (line = next_ini_line(&cp)) != NULL && line[0] != '['; ) {
+        char* eq = strchr(line, '=');
+        if (!eq)
+            continue;
+        char* end = eq;
+        while (end > line && (end[-1] == ' ' || end[-1] == '\t'))
+            --end;
+        if ((size_t)(end - line) != cchKey || strncasecmp(line, lpKeyName, cchKey))
+            continue;
+        for (value = eq + 1; *value == ' ' || *value == '\t'; ++value) ;
+        size_t cch = strlen(value);
+        if (cch >= 2 && (value[0] == '"' || value[0] == '\'')
+            && value[cch - 1] == value[0]) {
+            ((char*)value)[cch - 1] = '\0';
+            ++value;
+        }
+        break;
+    }
+
+    DWORD cch = 0;
+    if (nSize) {
+        for ( ; value[cch] && cch + 1 < nSize; ++cch)
+            lpReturnedString[cch] = value[cch];
+        lpReturnedString[cch] = '\0';
+    }
+    free(text);
+    return cch;
+}
+
+
+//
+// environment and system
+//
+LPTSTR GetCommandLine(void)
+{
+    return pszCommandLine ? pszCommandLine : "";
+}
+
+
+DWORD GetEnvironmentVariable(LPCTSTR lpName, LPTSTR lpBuffer, DWORD nSize)
+{
+    size_t cchName = strlen(lpName);
+    for (char** pp = environ; *pp; ++pp) {
+        if (strncasecmp(*pp, lpName, cchName) || (*pp)[cchName] != '=')
+            continue;
+
+        // PATH is seen as native list
+        const char* value = *pp + cchName + 1;
+        char* list = is_path_var(*pp) ? convert_list(value, TRUE) : NULL;
+        if (list)
+            value = list;
+        size_t cch = strlen(value);
+        DWORD dw = (DWORD)cch;
+        if (cch >= nSize)
+            dw = (DWORD)cch + 1; // required size
+        else
+            memcpy(lpBuffer, value, cch + 1);
+        free(list);
+        lastError = ERROR_SUCCESS;
+        return dw;
+    }
+
+    lastError = ERROR_ENVVAR_NOT_FOUND;
+    return 0;
+}
+
+
+LPTSTR GetEnvironmentStrings(void)
+{
+    size_t cb = 1;
+    for (char** pp = environ; *pp; ++pp)
+        cb += strlen(*pp) * 2 + 3;
+    char* block = malloc(cb);
+    if (!block)
+        return NULL;
+
+    char* out = block;
+    for (char** pp = environ; *pp; ++pp) {
+        char* list;
+        if (is_path_var(*pp) && (list = convert_list(*pp + 5, TRUE))) {
+            out += sprintf(out, "%.4s=%s", *pp, list) + 1;
+            free(list);
+        } else {
+            out = stpcpy(out, *pp) + 1;
+        }
+    }
+    *out = '\0';
+    return block;
+}
+
+
+BOOL FreeEnvironmentStrings(LPTSTR penv)
+{
+    free(penv);
+    return TRUE;
+}
+
+
+BOOL GetComputerNameEx(COMPUTER_NAME_FORMAT NameType, LPTSTR lpBuffer, LPDWORD nSize)
+{
+    (void)NameType;
+    char tmp[256];
+#if defined(POSIX_TEST)
+    if (posixHostDelay) {
+        struct timespec ts = { posixHostDelay / 1000000,
+            (long)(posixHostDelay % 1000000) * 1000 };
+        while (nanosleep(&ts, &ts) && errno == EINTR) ;
+    }
+#endif // POSIX_TEST
+    if (gethostname(tmp, sizeof(tmp) - 1)) {
+        set_errno_error();
+        return FALSE;
+    }
+    tmp[sizeof(tmp) - 1] = '\0';
+    tmp[strcspn(tmp, ".")] = '\0'; // DNS host name has no domain
+
+    size_t cch = strlen(tmp);
+    if (cch >= *nSize) {
+        *nSize = (DWORD)cch + 1;
+        lastError = 234; // ERROR_MORE_DATA
+        return FALSE;
+    }
+    memcpy(lpBuffer, tmp, cch + 1);
+    *nSize = (DWORD)cch;
+    return TRUE;
+}
+
+
+void GetSystemInfo(SYSTEM_INFO* lpSystemInfo)
+{
+    ZeroMemory(lpSystemInfo, sizeof(*lpSystemInfo));
+    lpSystemInfo->dwPageSize = (DWORD)sysconf(_SC_PAGESIZE);
+    lpSystemInfo->dwAllocationGranularity = lpSystemInfo->dwPageSize;
+    lpSystemInfo->dwNumberOfProcessors = (DWORD)sysconf(_SC_NPROCESSORS_ONLN);
+}
+
+
+void GetSystemTimeAsFileTime(FILETIME* lpSystemTimeAsFileTime)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    *lpSystemTimeAsFileTime = to_filetime(&ts);
+}
+
+
+// note: both count from boot, sleep time included
+ULONGLONG GetTickCount64(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return (ULONGLONG)ts.tv_sec * 1000 + (ULONGLONG)ts.tv_nsec / 1000000;
+}
+
+
+DWORD GetTickCount(void)
+{
+    return (DWORD)GetTickCount64();
+}
+
+
+BOOL QueryPerformanceCounter(LARGE_INTEGER* lpPerformanceCount)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    lpPerformanceCount->QuadPart = (LONGLONG)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    return TRUE;
+}
+
+
+BOOL QueryPerformanceFrequency(LARGE_INTEGER* lpFrequency)
+{
+    lpFrequency->QuadPart = 1000000000;
+    return TRUE;
+}
+
+
+// gets kB value from /proc/self/status
+static SIZE_T get_status_kb(const char* pszName)
+{
+    char buf[4096];
+    int fd = open("/proc/self/status", O_RDONLY | O_CLOEXEC);
+    ssize_t n = (fd >= 0) ? read(fd, buf, sizeof(buf) - 1) : -1;
+    if (fd >= 0)
+        close(fd);
+    if (n <= 0)
+        return 0;
+    buf[n] = '\0';
+    const char* cp = strstr(buf, pszName);
+    return cp ? (SIZE_T)strtoul(cp + strlen(pszName), NULL, 10) : 0;
+}
+
+
+// thread stack: top and committed size; the main thread stack grows up to its
+// high-water mark, others are measured at the current depth
+void* NtCurrentTeb(void)
+{
+    static __thread NT_TIB tib;
+    pthread_attr_t attr;
+    void* addr;
+    size_t cb;
+    if (!pthread_getattr_np(pthread_self(), &attr)) {
+        pthread_attr_getstack(&attr, &addr, &cb);
+        pthread_attr_destroy(&attr);
+        tib.StackBase = (char*)addr + cb;
+        cb = (getpid() == gettid()) ? get_status_kb("VmStk:") * 1024
+            : (size_t)((char*)tib.StackBase - (char*)&attr);
+        tib.StackLimit = (char*)tib.StackBase - cb;
+    }
+    return &tib;
+}
+
+
+BOOL K32GetProcessMemoryInfo(HANDLE Process, PROCESS_MEMORY_COUNTERS* ppsmemCounters,
+    DWORD cb)
+{
+    (void)Process;
+    ZeroMemory(ppsmemCounters, cb);
+    ppsmemCounters->cb = cb;
+    ppsmemCounters->PeakWorkingSetSize = get_status_kb("VmHWM:") * 1024;
+    ppsmemCounters->WorkingSetSize = get_status_kb("VmRSS:") * 1024;
+    ppsmemCounters->PeakPagefileUsage = get_status_kb("VmPeak:") * 1024;
+    ppsmemCounters->PagefileUsage = get_status_kb("VmSize:") * 1024;
+    return ppsmemCounters->PeakWorkingSetSize != 0;
+}
+
+
+//
+// processes and threads
+//
+__declspec(noreturn) void ExitProcess(UINT uExitCode)
+{
+    exit((int)uExitCode);
+}
+
+
+HANDLE GetCurrentProcess(void)
+{
+    return (HANDLE)(LONG_PTR)-1;
+}
+
+
+DWORD GetCurrentProcessId(void)
+{
+    return (DWORD)getpid();
+}
+
+
+BOOL GetProcessTimes(HANDLE hProcess, FILETIME* lpCreationTime,
+    FILETIME* lpExitTime, FILETIME* lpKernelTime, FILETIME* lpUserTime)
+{
+    (void)hProcess;
+    char buf[1024];
+    int fd = open("/proc/self/stat", O_RDONLY | O_CLOEXEC);
+    ssize_t n = (fd >= 0) ? read(fd, buf, sizeof(buf) - 1) : -1;
+    if (fd >= 0)
+        close(fd);
+    if (n <= 0) {
+        lastError = ERROR_NOT_SUPPORTED;
+        return FALSE;
+    }
+    buf[n] = '\0';
+
+    // field 22 counts clock ticks from boot; fields after the name have no spaces
+    const char* cp = strrchr(buf, ')');
+    for (int i = 2; cp && i < 22; ++i)
+        cp = strchr(cp + 1, ' ');
+    if (!cp) {
+        lastError = ERROR_NOT_SUPPORTED;
+        return FALSE;
+    }
+    ULONGLONG ticks = strtoull(cp + 1, NULL, 10), hz = (ULONGLONG)sysconf(_SC_CLK_TCK);
+    struct timespec now, boot;
+    clock_gettime(CLOCK_REALTIME, &now);
+    clock_gettime(CLOCK_BOOTTIME, &boot);
+    ULONGLONG t = ((ULONGLONG)now.tv_sec * 1000000000 + (ULONGLONG)now.tv_nsec)
+        - ((ULONGLONG)boot.tv_sec * 1000000000 + (ULONGLONG)boot.tv_nsec)
+        + ticks * (1000000000 / hz);
+    struct timespec ts = { (time_t)(t / 1000000000), (long)(t % 1000000000) };
+    *lpCreationTime = to_filetime(&ts);
+    *lpExitTime = *lpKernelTime = *lpUserTime = (FILETIME){0, 0};
+    return TRUE;
+}
+
+
+// note: no working set to trim
+BOOL SetProcessWorkingSetSize(HANDLE hProcess, SIZE_T dwMinimumWorkingSetSize,
+    SIZE_T dwMaximumWorkingSetSize)
+{
+    (void)hProcess;
+    (void)dwMinimumWorkingSetSize;
+    (void)dwMaximumWorkingSetSize;
+    return TRUE;
+}
+
+
+// waits for child process and signals its handle; killed one exits with 128 + signal
+// as in POSIX shell
+static void* reap_process(void* pv)
+{
+    OBJECT* po = pv;
+    int status;
+    while (waitpid(po->pid, &status, 0) < 0 && errno == EINTR) ;
+    signal_object(po, WIFEXITED(status) ? (DWORD)WEXITSTATUS(status)
+        : WIFSIGNALED(status) ? 128 + (DWORD)WTERMSIG(status) : 1);
+    release_object(po);
+    return NULL;
+}
+
+
+// starts detached thread with a small stack
+static BOOL start_thread(void* (*pfn)(void*), void* pv, size_t cb)
+{
+    pthread_attr_t attr;
+    pthread_t tid;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_attr_setstacksize(&attr, cb < 256 * 1024 ? 256 * 1024 : cb);
+    int r = pthread_create(&tid, &attr, pfn, pv);
+    pthread_attr_destroy(&attr);
+    if (r) {
+        errno = r;
+        set_errno_error();
+        return FALSE;
+    }
+    return TRUE;
+}
+
+
+// note: drive-rooted args become POSIX paths as if MSYS runtime started the child;
+// ignored Ctrl+C is inherited while handlers are not, same as in Win32
+BOOL CreateProcess(LPCTSTR lpApplicationName, LPTSTR lpCommandLine,
+    LPSECURITY_ATTRIBUTES lpProcessAttributes, LPSECURITY_ATTRIBUTES lpThreadAttributes,
+    BOOL bInheritHandles, DWORD dwCreationFlags, LPVOID lpEnvironment,
+    LPCTSTR lpCurrentDirectory, LPSTARTUPINFO lpStartupInfo,
+    LPPROCESS_INFORMATION lpProcessInformation)
+{
+    (void)lpApplicationName;
+    (void)lpProcessAttributes;
+    (void)lpThreadAttributes;
+    (void)bInheritHandles;
+    (void)dwCreationFlags;
+
+    char** argv;
+    char** envp;
+    char szDir[PATH_MAX];
+    if ((lpCurrentDirectory && !posix_path(ARRAY(szDir), lpCurrentDirectory))
+        || !make_exec_args(lpCommandLine, lpEnvironment, &argv, &envp))
+        return FALSE;
+
+    // standard handles go to 0, 1 and 2; the rest is close-on-exec
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    if (lpStartupInfo->dwFlags & STARTF_USESTDHANDLES) {
+        const HANDLE ah[3] = { lpStartupInfo->hStdInput, lpStartupInfo->hStdOutput,
+            lpStartupInfo->hStdError };
+        for (int i = 0; i < 3; ++i)
+            if (ah[i] && ah[i] != INVALID_HANDLE_VALUE)
+                posix_spawn_file_actions_adddup2(&fa, ((const OBJECT*)ah[i])->fd, i);
+    }
+    if (lpCurrentDirectory)
+        posix_spawn_file_actions_addchdir_np(&fa, szDir);
+
+    OBJECT* po = new_object(OBJ_PROCESS, 2);
+    OBJECT* pt = new_object(OBJ_NONE, 1);
+    int r = (po && pt) ? (strchr(argv[0], '/')
+        ? posix_spawn(&po->pid, argv[0], &fa, NULL, argv, envp)
+        : posix_spawnp(&po->pid, argv[0], &fa, NULL, argv, envp)) : ENOMEM;
+    posix_spawn_file_actions_destroy(&fa);
+    free(argv);
+    if (envp != environ)
+        free(envp);
+    if (r || !start_thread(reap_process, po, 0)) {
+        if (r) {
+            errno = r;
+            set_errno_error();
+        }
+        free(po);
+        free(pt);
+        return FALSE;
+    }
+
+    lpProcessInformation->hProcess = po;
+    lpProcessInformation->hThread = pt;
+    lpProcessInformation->dwProcessId = (DWORD)po->pid;
+    lpProcessInformation->dwThreadId = (DWORD)po->pid;
+    return TRUE;
+}
+
+
+DWORD posix_exec(LPCTSTR lpCommandLine, LPCTSTR lpEnvironment)
+{
+    char** argv;
+    char** envp;
+    if (!make_exec_args(lpCommandLine, lpEnvironment, &argv, &envp))
+        return lastError;
+    if (strchr(argv[0], '/'))
+        execve(argv[0], argv, envp);
+    else
+        execvpe(argv[0], argv, envp);
+    set_errno_error();
+    free(argv);
+    if (envp != environ)
+        free(envp);
+    return lastError;
+}
+
+
+BOOL GetExitCodeProcess(HANDLE hProcess, LPDWORD lpExitCode)
+{
+    const OBJECT* po = hProcess;
+    pthread_mutex_lock(&lock);
+    *lpExitCode = po->signaled ? po->code : STILL_ACTIVE;
+    pthread_mutex_unlock(&lock);
+    return TRUE;
+}
+
+
+BOOL GetExitCodeThread(HANDLE hThread, LPDWORD lpExitCode)
+{
+    return GetExitCodeProcess(hThread, lpExitCode);
+}
+
+
+// runs thread routine and signals its handle
+static void* run_thread(void* pv)
+{
+    OBJECT* po = pv;
+    signal_object(po, po->pfn(po->pv));
+    release_object(po);
+    return NULL;
+}
+
+
+HANDLE CreateThread(LPSECURITY_ATTRIBUTES lpThreadAttributes, SIZE_T dwStackSize,
+    LPTHREAD_START_ROUTINE lpStartAddress, LPVOID lpParameter, DWORD dwCreationFlags,
+    LPDWORD lpThreadId)
+{
+    (void)lpThreadAttributes;
+    (void)dwCreationFlags;
+    OBJECT* po = new_object(OBJ_THREAD, 2);
+    if (!po)
+        return NULL;
+    po->pfn = lpStartAddress;
+    po->pv = lpParameter;
+    if (!start_thread(run_thread, po, dwStackSize)) {
+        free(po);
+        return NULL;
+    }
+    if (lpThreadId)
+        *lpThreadId = 0;
+    return po;
+}
+
+
+HANDLE CreateEvent(LPSECURITY_ATTRIBUTES lpEventAttributes, BOOL bManualReset,
+    BOOL bInitialState, LPCTSTR lpName)
+{
+    (void)lpEventAttributes;
+    (void)lpName;
+    OBJECT* po = new_object(OBJ_EVENT, 1);
+    if (po) {
+        po->manual = bManualReset;
+        po->signaled = bInitialState;
+    }
+    return po;
+}
+
+
+BOOL SetEvent(HANDLE hEvent)
+{
+    signal_object(hEvent, 0);
+    return TRUE;
+}
+
+
+DWORD WaitForMultipleObjects(DWORD nCount, const HANDLE* lpHandles, BOOL bWaitAll,
+    DWORD dwMilliseconds)
+{
+    for (DWORD i = 0; i < nCount; ++i) {
+        const OBJECT* po = lpHandles[i];
+        if (!po || lpHandles[i] == INVALID_HANDLE_VALUE || (po->type != OBJ_EVENT
+            && po->type != OBJ_THREAD && po->type != OBJ_PROCESS)) {
+            lastError = ERROR_INVALID_HANDLE;
+            return WAIT_FAILED;
+        }
+    }
+    if (!nCount || nCount > MAXIMUM_WAIT_OBJECTS) {
+        lastError = ERROR_INVALID_PARAMETER;
+        return WAIT_FAILED;
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    if (dwMilliseconds != INFINITE) {
+        deadline.tv_sec += dwMilliseconds / 1000;
+        deadline.tv_nsec += (long)(dwMilliseconds % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            ++deadline.tv_sec;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    DWORD dw = WAIT_TIMEOUT;
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        // first signaled one, or all of them
+        DWORD i = 0, cnt = 0;
+        for (DWORD k = nCount; k--; )
+            if (((OBJECT*)lpHandles[k])->signaled)
+                ++cnt, i = k;
+        if (bWaitAll ? cnt == nCount : cnt > 0) {
+            for (DWORD k = bWaitAll ? 0 : i; k < (bWaitAll ? nCount : i + 1); ++k) {
+                OBJECT* po = lpHandles[k];
+                if (po->type == OBJ_EVENT && !po->manual)
+                    po->signaled = FALSE;
+            }
+            dw = WAIT_OBJECT_0 + (bWaitAll ? 0 : i);
+            break;
+        }
+        if (!dwMilliseconds || (dwMilliseconds == INFINITE
+            ? pthread_cond_wait(&changed, &lock)
+            : pthread_cond_timedwait(&changed, &lock, &deadline)) == ETIMEDOUT)
+            break;
+    }
+    pthread_mutex_unlock(&lock);
+    return dw;
+}
+
+
+DWORD WaitForSingleObject(HANDLE hHandle, DWORD dwMilliseconds)
+{
+    return WaitForMultipleObjects(1, &hHandle, FALSE, dwMilliseconds);
+}
+
+
+//
+// console
+//
+static PHANDLER_ROUTINE ctrlHandler[8];
+static int ctrlHandlers;
+
+
+// passes Ctrl+C (SIGINT) and Ctrl+Break (SIGQUIT) to handlers, last added first;
+// default action if none of them takes it
+static void on_ctrl(int sig)
+{
+    DWORD dwCtrlType = (sig == SIGINT) ? CTRL_C_EVENT : CTRL_BREAK_EVENT;
+    for (int i = ctrlHandlers; i--; )
+        if (ctrlHandler[i](dwCtrlType))
+            return;
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+
+BOOL SetConsoleCtrlHandler(PHANDLER_ROUTINE HandlerRoutine, BOOL Add)
+{
+    // NULL routine ignores Ctrl+C, which children inherit
+    if (!HandlerRoutine) {
+        signal(SIGINT, Add ? SIG_IGN : SIG_DFL);
+        return TRUE;
+    }
+
+    if (Add) {
+        if (ctrlHandlers == (int)COUNT(ctrlHandler)) {
+            lastError = ERROR_NOT_ENOUGH_MEMORY;
+            return FALSE;
+        }
+        ctrlHandler[ctrlHandlers++] = HandlerRoutine;
+    } else {
+        int i = ctrlHandlers;
+        while (i-- && ctrlHandler[i] != HandlerRoutine) ;
+        if (i < 0) {
+            lastError = ERROR_INVALID_PARAMETER;
+            return FALSE;
+        }
+        memmove(ctrlHandler + i, ctrlHandler + i + 1,
+            (size_t)(--ctrlHandlers - i) * sizeof(*ctrlHandler));
+    }
+
+    struct sigaction sa = { .sa_handler = ctrlHandlers ? on_ctrl : SIG_DFL,
+        .sa_flags = SA_RESTART };
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGQUIT, &sa, NULL);
+    return TRUE;
+}
+
+
+BOOL GetConsoleMode(HANDLE hConsoleHandle, LPDWORD lpMode)
+{
+    const OBJECT* po = hConsoleHandle;
+    *lpMode = 0;
+    return (po->type == OBJ_FILE && isatty(po->fd));
+}
+
+
+BOOL WriteConsole(HANDLE hConsoleOutput, const void* lpBuffer,
+    DWORD nNumberOfCharsToWrite, LPDWORD lpNumberOfCharsWritten, LPVOID lpReserved)
+{
+    (void)lpReserved;
+    return WriteFile(hConsoleOutput, lpBuffer, nNumberOfCharsToWrite,
+        lpNumberOfCharsWritten, NULL);
+}
+
+
+BOOL SetConsoleOutputCP(UINT wCodePageID)
+{
+    return (wCodePageID == CP_UTF8);
+}
+
+
+UINT GetACP(void)
+{
+    return CP_UTF8;
+}
+
+
+//
+// strings
+//
+int MultiByteToWideChar(UINT CodePage, DWORD dwFlags, LPCSTR lpMultiByteStr,
+    int cbMultiByte, LPWSTR lpWideCharStr, int cchWideChar)
+{
+    (void)CodePage; // note: ACP is UTF-8
+    (void)dwFlags;
+    const unsigned char* cp = (const unsigned char*)lpMultiByteStr;
+    const unsigned char* end = cp + (cbMultiByte < 0 ? strlen(lpMultiByteStr) + 1
+        : (size_t)cbMultiByte);
+    int cch = 0;
+
+    while (cp < end) {
+        // malformed sequence is replaced with U+FFFD
+        unsigned c = *cp++, n = 0, min = 0;
+        if (c >= 0xc2 && c <= 0xdf)
+            c &= 0x1f, n = 1;
+        else if (c >= 0xe0 && c <= 0xef)
+            c &= 0x0f, n = 2, min = 0x800;
+        else if (c >= 0xf0 && c <= 0xf4)
+            c &= 0x07, n = 3, min = 0x10000;
+        else if (c >= 0x80)
+            c = 0xfffd;
+        for ( ; n && cp < end && (*cp & 0xc0) == 0x80; --n)
+            c = (c << 6) | (*cp++ & 0x3f);
+        if (n || c < min || (c >= 0xd800 && c <= 0xdfff) || c > 0x10ffff)
+            c = 0xfffd;
+
+        int w = (c >= 0x10000) ? 2 : 1;
+        if (cchWideChar) {
+            if (cch + w > cchWideChar) {
+                lastError = ERROR_INSUFFICIENT_BUFFER;
+                return 0;
+            }
+            if (w == 2) {
+                lpWideCharStr[cch] = (WCHAR)(0xd800 | ((c - 0x10000) >> 10));
+                c = 0xdc00 | (c & 0x3ff);
+            }
+            lpWideCharStr[cch + w - 1] = (WCHAR)c;
+        }
+        cch += w;
+    }
+    return cch;
+}
+
+
+int WideCharToMultiByte(UINT CodePage, DWORD dwFlags, LPCWSTR lpWideCharStr,
+    int cchWideChar, LPSTR lpMultiByteStr, int cbMultiByte, LPCSTR lpDefaultChar,
+    BOOL* lpUsedDefaultChar)
+{
+    (void)CodePage; // note: ACP is UTF-8
+    (void)dwFlags;
+    (void)lpDefaultChar;
+    if (lpUsedDefaultChar)
+        *lpUsedDefaultChar = FALSE;
+    size_t cchIn = (size_t)cchWideChar;
+    if (cchWideChar < 0)
+        for (cchIn = 0; lpWideCharStr[cchIn++]; ) ;
+    int cb = 0;
+
+    for (size_t i = 0; i < cchIn; ++i) {
+        // lone surrogate is replaced with U+FFFD
+        unsigned c = lpWideCharStr[i];
+        if (c >= 0xd800 && c <= 0xdbff && i + 1 < cchIn
+            && lpWideCharStr[i + 1] >= 0xdc00 && lpWideCharStr[i + 1] <= 0xdfff)
+            c = 0x10000 + ((c - 0xd800) << 10) + (lpWideCharStr[++i] - 0xdc00u);
+        else if (c >= 0xd800 && c <= 0xdfff)
+            c = 0xfffd;
+
+        char tmp[4];
+        int n = 0;
+        if (c < 0x80) {
+            tmp[n++] = (char)c;
+        } else if (c < 0x800) {
+            tmp[n++] = (char)(0xc0 | c >> 6);
+            tmp[n++] = (char)(0x80 | (c & 0x3f));
+        } else if (c < 0x10000) {
+            tmp[n++] = (char)(0xe0 | c >> 12);
+            tmp[n++] = (char)(0x80 | (c >> 6 & 0x3f));
+            tmp[n++] = (char)(0x80 | (c & 0x3f));
+        } else {
+            tmp[n++] = (char)(0xf0 | c >> 18);
+            tmp[n++] = (char)(0x80 | (c >> 12 & 0x3f));
+            tmp[n++] = (char)(0x80 | (c >> 6 & 0x3f));
+            tmp[n++] = (char)(0x80 | (c & 0x3f));
+        }
+        if (cbMultiByte) {
+            if (cb + n > cbMultiByte) {
+                lastError = ERROR_INSUFFICIENT_BUFFER;
+                return 0;
+            }
+            memcpy(lpMultiByteStr + cb, tmp, (size_t)n);
+        }
+        cb += n;
+    }
+    return cb;
+}
+
+
+// note: ASCII case only
+int CompareString(LCID Locale, DWORD dwCmpFlags, LPCTSTR lpString1, int cchCount1,
+    LPCTSTR lpString2, int cchCount2)
+{
+    (void)Locale;
+    size_t n1 = cchCount1 < 0 ? strlen(lpString1) : (size_t)cchCount1;
+    size_t n2 = cchCount2 < 0 ? strlen(lpString2) : (size_t)cchCount2;
+    for (size_t i = 0; ; ++i) {
+        int c1 = i < n1 ? (unsigned char)lpString1[i] : -1;
+        int c2 = i < n2 ? (unsigned char)lpString2[i] : -1;
+        if ((dwCmpFlags & NORM_IGNORECASE) && c1 >= 0 && c2 >= 0) {
+            c1 = tolower(c1);
+            c2 = tolower(c2);
+        }
+        if (c1 != c2)
+            return c1 < c2 ? CSTR_LESS_THAN : CSTR_GREATER_THAN;
+        if (c1 < 0)
+            return CSTR_EQUAL;
+    }
+}
+
+
+DWORD CharUpperBuff(LPTSTR lpsz, DWORD cchLength)
+{
+    for (DWORD i = 0; i < cchLength; ++i)
+        if ('a' <= lpsz[i] && lpsz[i] <= 'z')
+            lpsz[i] -= 'a' - 'A';
+    return cchLength;
+}
+
+
+int lstrlen(LPCTSTR lpString)
+{
+    return lpString ? (int)strlen(lpString) : 0;
+}
+
+
+int lstrcmp(LPCTSTR lpString1, LPCTSTR lpString2)
+{
+    return strcmp(lpString1, lpString2);
+}
+
+
+HRESULT StringCchLength(LPCTSTR psz, size_t cchMax, size_t* pcchLength)
+{
+    size_t cch = psz ? strnlen(psz, cchMax) : cchMax;
+    if (cch == cchMax) {
+        if (pcchLength)
+            *pcchLength = 0;
+        return STRSAFE_E_INVALID_PARAMETER;
+    }
+    if (pcchLength)
+        *pcchLength = cch;
+    return S_OK;
+}
+
+
+HRESULT StringCchCopyEx(LPTSTR pszDest, size_t cchDest, LPCTSTR pszSrc,
+    LPTSTR* ppszDestEnd, size_t* pcchRemaining, DWORD dwFlags)
+{
+    (void)dwFlags;
+    if (!cchDest)
+        return STRSAFE_E_INVALID_PARAMETER;
+    size_t cch = 0;
+    for ( ; pszSrc[cch] && cch + 1 < cchDest; ++cch)
+        pszDest[cch] = pszSrc[cch];
+    pszDest[cch] = '\0';
+    if (ppszDestEnd)
+        *ppszDestEnd = pszDest + cch;
+    if (pcchRemaining)
+        *pcchRemaining = cchDest - cch;
+    return pszSrc[cch] ? STRSAFE_E_INSUFFICIENT_BUFFER : S_OK;
+}
+
+
+HRESULT StringCchCopy(LPTSTR pszDest, size_t cchDest, LPCTSTR pszSrc)
+{
+    return StringCchCopyEx(pszDest, cchDest, pszSrc, NULL, NULL, 0);
+}
+
+
+HRESULT StringCchCopyN(LPTSTR pszDest, size_t cchDest, LPCTSTR pszSrc,
+    size_t cchToCopy)
+{
+    if (!cchDest)
+        return STRSAFE_E_INVALID_PARAMETER;
+    size_t cch = 0;
+    for ( ; cch < cchToCopy && pszSrc[cch] && cch + 1 < cchDest; ++cch)
+        pszDest[cch] = pszSrc[cch];
+    pszDest[cch] = '\0';
+    return (cch < cchToCopy && pszSrc[cch]) ? STRSAFE_E_INSUFFICIENT_BUFFER : S_OK;
+}
+
+
+HRESULT StringCchCatEx(LPTSTR pszDest, size_t cchDest, LPCTSTR pszSrc,
+    LPTSTR* ppszDestEnd, size_t* pcchRemaining, DWORD dwFlags)
+{
+    size_t cch;
+    HRESULT hr = StringCchLength(pszDest, cchDest, &cch);
+    if (FAILED(hr))
+        return hr;
+    return StringCchCopyEx(pszDest + cch, cchDest - cch, pszSrc, ppszDestEnd,
+        pcchRemaining, dwFlags);
+}
+
+
+HRESULT StringCchCat(LPTSTR pszDest, size_t cchDest, LPCTSTR pszSrc)
+{
+    return StringCchCatEx(pszDest, cchDest, pszSrc, NULL, NULL, 0);
+}
+
+
+//
+// light-weight utility functions
+//
+int StrToInt(LPCTSTR pszSrc)
+{
+    BOOL neg = (*pszSrc == '-');
+    int n = 0;
+    for (pszSrc += neg; '0' <= *pszSrc && *pszSrc <= '9'; ++pszSrc)
+        n = n * 10 + (*pszSrc - '0');
+    return neg ? -n : n;
+}
+
+
+int StrCmpI(LPCTSTR psz1, LPCTSTR psz2)
+{
+    return strcasecmp(psz1, psz2);
+}
+
+
+int StrCmpNI(LPCTSTR psz1, LPCTSTR psz2, int nChar)
+{
+    return strncasecmp(psz1, psz2, (size_t)nChar);
+}
+
+
+LPTSTR StrChr(LPCTSTR pszStart, TCHAR wMatch)
+{
+    return wMatch ? strchr(pszStart, wMatch) : NULL;
+}
+
+
+// note: long is 32-bit in Win32, so 'l' size prefix is dropped
+int wnsprintf(LPTSTR pszDest, int cchDest, LPCTSTR pszFmt, ...)
+{
+    char fmt[256];
+    size_t cch = 0;
+    for (const char* cp = pszFmt; *cp && cch + 1 < sizeof(fmt); ++cp) {
+        if (*cp == 'l' && cp > pszFmt && cp[1] != 'l' && cp[-1] != 'l') {
+            const char* pc = cp;
+            while (pc > pszFmt && pc[-1] != '%' && strchr("-+ #0123456789.", pc[-1]))
+                --pc;
+            if (pc > pszFmt && pc[-1] == '%')
+                continue;
+        }
+        fmt[cch++] = *cp;
+    }
+    fmt[cch] = '\0';
+
+    va_list va;
+    va_start(va, pszFmt);
+    int n = vsnprintf(pszDest, (size_t)cchDest, fmt, va);
+    va_end(va);
+    return (n < 0 || n >= cchDest) ? cchDest - 1 : n;
+}
+
+
+BOOL PathAppend(LPTSTR pszPath, LPCTSTR pszMore)
+{
+    while (IS_SEP(*pszMore))
+        ++pszMore;
+    size_t cch = strlen(pszPath), cchMore = strlen(pszMore);
+    BOOL sep = cch && !IS_SEP(pszPath[cch - 1]);
+    if (cch + sep + cchMore >= MAX_PATH) {
+        lastError = ERROR_FILENAME_EXCED_RANGE;
+        return FALSE;
+    }
+    if (sep)
+        pszPath[cch++] = '\\';
+    memcpy(pszPath + cch, pszMore, cchMore + 1);
+    return TRUE;
+}
+
+
+BOOL PathAddExtension(LPTSTR pszPath, LPCTSTR pszExt)
+{
+    if (strchr(PathFindFileName(pszPath), '.'))
+        return FALSE;
+    if (!pszExt)
+        pszExt = ".exe";
+    if (strlen(pszPath) + strlen(pszExt) >= MAX_PATH)
+        return FALSE;
+    strcat(pszPath, pszExt);
+    return TRUE;
+}
+
+
+BOOL PathFileExists(LPCTSTR pszPath)
+{
+    struct stat st;
+    return stat_path(pszPath, &st);
+}
+
+
+LPTSTR PathFindFileName(LPCTSTR pszPath)
+{
+    const char* name = pszPath;
+    for (const char* cp = pszPath; *cp; ++cp)
+        if ((IS_SEP(*cp) || *cp == ':') && cp[1] && !IS_SEP(cp[1]))
+            name = cp + 1;
+    return (LPTSTR)name;
+}
+
+
+LPTSTR PathGetArgs(LPCTSTR pszPath)
+{
+    BOOL quoted = FALSE;
+    for ( ; *pszPath; ++pszPath) {
+        if (*pszPath == '"')
+            quoted = !quoted;
+        else if (*pszPath == ' ' && !quoted)
+            return (LPTSTR)pszPath + 1;
+    }
+    return (LPTSTR)pszPath;
+}
+
+
+BOOL PathIsDirectory(LPCTSTR pszPath)
+{
+    struct stat st;
+    return stat_path(pszPath, &st) && S_ISDIR(st.st_mode);
+}
+
+
+// matches name against wildcard pattern ignoring case
+static BOOL match_spec(const char* name, const char* spec, size_t cchSpec)
+{
+    const char* star = NULL;
+    const char* back = NULL;
+    size_t i = 0;
+    while (*name) {
+        if (i < cchSpec && spec[i] == '*') {
+            star = spec + ++i;
+            back = name;
+        } else if (i < cchSpec && (spec[i] == '?'
+            || tolower((unsigned char)spec[i]) == tolower((unsigned char)*name))) {
+            ++i;
+            ++name;
+        } else if (star) {
+            i = (size_t)(star - spec);
+            name = ++back;
+        } else {
+            return FALSE;
+        }
+    }
+    while (i < cchSpec && spec[i] == '*')
+        ++i;
+    return (i == cchSpec);
+}
+
+
+BOOL PathMatchSpec(LPCTSTR pszFile, LPCTSTR pszSpec)
+{
+    // "*.*" matches any name; several patterns are separated by semicolons
+    for (const char* cp = pszSpec; *cp; ) {
+        while (*cp == ' ')
+            ++cp;
+        size_t cch = strcspn(cp, ";");
+        if ((cch == 3 && !memcmp(cp, "*.*", 3)) || match_spec(pszFile, cp, cch))
+            return TRUE;
+        cp += cch + (cp[cch] == ';');
+    }
+    return FALSE;
+}
+
+
+BOOL PathQuoteSpaces(LPTSTR lpsz)
+{
+    size_t cch = strlen(lpsz);
+    if (!strchr(lpsz, ' ') || cch + 2 >= MAX_PATH)
+        return FALSE;
+    memmove(lpsz + 1, lpsz, cch);
+    lpsz[0] = lpsz[cch + 1] = '"';
+    lpsz[cch + 2] = '\0';
+    return TRUE;
+}
+
+
+void PathRemoveArgs(LPTSTR pszPath)
+{
+    char* args = PathGetArgs(pszPath);
+    if (*args)
+        args[-1] = '\0';
+    else if (args > pszPath && args[-1] == ' ')
+        args[-1] = '\0';
+}
+
+
+void PathRemoveExtension(LPTSTR pszPath)
+{
+    char* dot = strrchr(PathFindFileName(pszPath), '.');
+    if (dot)
+        *dot = '\0';
+}
+
+
+BOOL PathRemoveFileSpec(LPTSTR pszPath)
+{
+    // keep root: "C:\", "\" or "C:"
+    char* root = pszPath;
+    if (IS_LATIN(root[0]) && root[1] == ':')
+        root += 2;
+    if (IS_SEP(*root))
+        ++root;
+
+    char* sep = NULL;
+    for (char* cp = root; *cp; ++cp)
+        if (IS_SEP(*cp))
+            sep = cp;
+    char* end = sep ? sep : root;
+    BOOL removed = (*end != '\0');
+    *end = '\0';
+    return removed;
+}
+
+
+void PathStripPath(LPTSTR pszPath)
+{
+    char* name = PathFindFileName(pszPath);
+    memmove(pszPath, name, strlen(name) + 1);
+}
+
+
+void PathUnquoteSpaces(LPTSTR lpsz)
+{
+    size_t cch = strlen(lpsz);
+    if (cch >= 2 && lpsz[0] == '"' && lpsz[cch - 1] == '"') {
+        memmove(lpsz, lpsz + 1, cch - 2);
+        lpsz[cch - 2] = '\0';
+    }
+}
@@ -0,0 +1,435 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Win32 subset over POSIX, so that shebang builds and runs on Linux
+ * Note: 'ansi' only, paths are mapped as C:\dir\file <--> /dir/file
+ */
+
+
+#ifndef POSIX_WINDOWS_H
+#define POSIX_WINDOWS_H
+
+#if defined(UNICODE) || defined(_UNICODE)
+#error POSIX platform layer is 'ansi' only.
+#endif // UNICODE
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+
+// calling conventions and attributes mean nothing here
+#define WINAPI
+#define __cdecl
+#define __stdcall
+#define __declspec(x)   __declspec_##x
+#define __declspec_noreturn     __attribute__((noreturn))
+#define __declspec_dllimport
+
+
+// LLP64 types: long is 32-bit on Windows
+typedef int BOOL;
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef uint32_t DWORD, *PDWORD, *LPDWORD;
+typedef int32_t LONG;
+typedef uint32_t ULONG;
+typedef int INT;
+typedef unsigned UINT;
+typedef int64_t LONGLONG;
+typedef uint64_t ULONGLONG;
+typedef intptr_t LONG_PTR, INT_PTR;
+typedef uintptr_t ULONG_PTR, UINT_PTR, DWORD_PTR;
+typedef size_t SIZE_T;
+typedef int32_t HRESULT;
+typedef void *PVOID, *LPVOID;
+typedef const void* LPCVOID;
+typedef void* HANDLE;
+typedef HANDLE HMODULE;
+typedef DWORD LCID;
+
+typedef char CHAR, TCHAR, _TCHAR;
+typedef unsigned char TBYTE;
+typedef unsigned short WCHAR;
+typedef char *PSTR, *LPSTR, *PTSTR, *LPTSTR;
+typedef const char *PCSTR, *LPCSTR, *PCTSTR, *LPCTSTR;
+typedef WCHAR *PWSTR, *LPWSTR;
+typedef const WCHAR *PCWSTR, *LPCWSTR;
+
+#define TRUE            1
+#define FALSE           0
+#define TEXT(s)         s
+#define MAX_PATH        260
+#define INFINITE        0xffffffffU
+
+typedef struct {
+    DWORD dwLowDateTime;
+    DWORD dwHighDateTime;
+} FILETIME;
+
+typedef union {
+    __extension__ struct {
+        DWORD LowPart;
+        LONG HighPart;
+    };
+    LONGLONG QuadPart;
+} LARGE_INTEGER;
+
+typedef union {
+    __extension__ struct {
+        DWORD LowPart;
+        DWORD HighPart;
+    };
+    ULONGLONG QuadPart;
+} ULARGE_INTEGER;
+
+#define ZeroMemory(p, cb)       memset((p), 0, (cb))
+#define CopyMemory(d, s, cb)    memcpy((d), (s), (cb))
+
+
+// errors
+#define ERROR_SUCCESS                   0
+#define ERROR_FILE_NOT_FOUND            2
+#define ERROR_PATH_NOT_FOUND            3
+#define ERROR_ACCESS_DENIED             5
+#define ERROR_INVALID_HANDLE            6
+#define ERROR_NOT_ENOUGH_MEMORY         8
+#define ERROR_INVALID_ENVIRONMENT       10
+#define ERROR_BAD_FORMAT                11
+#define ERROR_HANDLE_EOF                38
+#define ERROR_NOT_SUPPORTED             50
+#define ERROR_FILE_EXISTS               80
+#define ERROR_INVALID_PARAMETER         87
+#define ERROR_BROKEN_PIPE               109
+#define ERROR_DISK_FULL                 112
+#define ERROR_INSUFFICIENT_BUFFER       122
+#define ERROR_BAD_ARGUMENTS             160
+#define ERROR_ALREADY_EXISTS            183
+#define ERROR_BAD_EXE_FORMAT            193
+#define ERROR_ENVVAR_NOT_FOUND          203
+#define ERROR_FILENAME_EXCED_RANGE      206
+#define ERROR_NO_UNICODE_TRANSLATION    1113
+#define ERROR_CANCELLED                 1223
+#define ERROR_CANT_RESOLVE_FILENAME     1921
+
+DWORD GetLastError(void);
+void SetLastError(DWORD dwErrCode);
+
+#define FORMAT_MESSAGE_ALLOCATE_BUFFER  0x100
+#define FORMAT_MESSAGE_IGNORE_INSERTS   0x200
+#define FORMAT_MESSAGE_FROM_SYSTEM      0x1000
+#define LANG_NEUTRAL                    0
+#define SUBLANG_DEFAULT                 1
+#define MAKELANGID(p, s)                ((((WORD)(s)) << 10) | (WORD)(p))
+DWORD FormatMessage(DWORD dwFlags, LPCVOID lpSource, DWORD dwMessageId,
+    DWORD dwLanguageId, LPTSTR lpBuffer, DWORD nSize, void* Arguments);
+
+
+// memory
+#define HEAP_ZERO_MEMORY    0x8
+HANDLE GetProcessHeap(void);
+LPVOID HeapAlloc(HANDLE hHeap, DWORD dwFlags, SIZE_T dwBytes);
+BOOL HeapFree(HANDLE hHeap, DWORD dwFlags, LPVOID lpMem);
+SIZE_T HeapCompact(HANDLE hHeap, DWORD dwFlags);
+
+
+// handles and files
+#define INVALID_HANDLE_VALUE        ((HANDLE)(LONG_PTR)-1)
+#define INVALID_FILE_ATTRIBUTES     ((DWORD)-1)
+#define INVALID_FILE_SIZE           ((DWORD)-1)
+#define INVALID_SET_FILE_POINTER    ((DWORD)-1)
+#define GENERIC_READ                0x80000000U
+#define GENERIC_WRITE               0x40000000U
+#define FILE_APPEND_DATA            0x4
+#define FILE_SHARE_READ             0x1
+#define FILE_SHARE_WRITE            0x2
+#define FILE_SHARE_DELETE           0x4
+#define CREATE_NEW                  1
+#define CREATE_ALWAYS               2
+#define OPEN_EXISTING               3
+#define OPEN_ALWAYS                 4
+#define TRUNCATE_EXISTING           5
+#define FILE_ATTRIBUTE_DIRECTORY    0x10
+#define FILE_ATTRIBUTE_ARCHIVE      0x20
+#define FILE_ATTRIBUTE_NORMAL       0x80
+#define FILE_ATTRIBUTE_TEMPORARY    0x100
+#define FILE_FLAG_DELETE_ON_CLOSE   0x04000000U
+#define FILE_BEGIN                  0
+#define FILE_CURRENT                1
+#define FILE_END                    2
+#define LOCKFILE_FAIL_IMMEDIATELY   0x1
+#define LOCKFILE_EXCLUSIVE_LOCK     0x2
+#define PAGE_READONLY               0x2
+#define PAGE_READWRITE              0x4
+#define FILE_MAP_WRITE              0x2
+#define FILE_MAP_READ               0x4
+#define DUPLICATE_SAME_ACCESS       0x2
+#define STD_INPUT_HANDLE            ((DWORD)-10)
+#define STD_OUTPUT_HANDLE           ((DWORD)-11)
+#define STD_ERROR_HANDLE            ((DWORD)-12)
+
+typedef struct {
+    DWORD nLength;
+    LPVOID lpSecurityDescriptor;
+    BOOL bInheritHandle;
+} SECURITY_ATTRIBUTES, *LPSECURITY_ATTRIBUTES;
+
+typedef struct {
+    ULONG_PTR Internal;
+    ULONG_PTR InternalHigh;
+    DWORD Offset;
+    DWORD OffsetHigh;
+    HANDLE hEvent;
+} OVERLAPPED, *LPOVERLAPPED;
+
+typedef enum { GetFileExInfoStandard } GET_FILEEX_INFO_LEVELS;
+
+typedef struct {
+    DWORD dwFileAttributes;
+    FILETIME ftCreationTime;
+    FILETIME ftLastAccessTime;
+    FILETIME ftLastWriteTime;
+    DWORD nFileSizeHigh;
+    DWORD nFileSizeLow;
+} WIN32_FILE_ATTRIBUTE_DATA;
+
+typedef struct {
+    DWORD dwFileAttributes;
+    FILETIME ftCreationTime;
+    FILETIME ftLastAccessTime;
+    FILETIME ftLastWriteTime;
+    DWORD nFileSizeHigh;
+    DWORD nFileSizeLow;
+    DWORD dwReserved0;
+    DWORD dwReserved1;
+    CHAR cFileName[MAX_PATH];
+    CHAR cAlternateFileName[14];
+} WIN32_FIND_DATA;
+
+BOOL CloseHandle(HANDLE hObject);
+BOOL DuplicateHandle(HANDLE hSourceProcessHandle, HANDLE hSourceHandle,
+    HANDLE hTargetProcessHandle, HANDLE* lpTargetHandle, DWORD dwDesiredAccess,
+    BOOL bInheritHandle, DWORD dwOptions);
+HANDLE GetStdHandle(DWORD nStdHandle);
+HANDLE CreateFile(LPCTSTR lpFileName, DWORD dwDesiredAccess, DWORD dwShareMode,
+    LPSECURITY_ATTRIBUTES lpSecurityAttributes, DWORD dwCreationDisposition,
+    DWORD dwFlagsAndAttributes, HANDLE hTemplateFile);
+BOOL ReadFile(HANDLE hFile, LPVOID lpBuffer, DWORD nNumberOfBytesToRead,
+    LPDWORD lpNumberOfBytesRead, LPOVERLAPPED lpOverlapped);
+BOOL WriteFile(HANDLE hFile, LPCVOID lpBuffer, DWORD nNumberOfBytesToWrite,
+    LPDWORD lpNumberOfBytesWritten, LPOVERLAPPED lpOverlapped);
+DWORD SetFilePointer(HANDLE hFile, LONG lDistanceToMove, LONG* lpDistanceToMoveHigh,
+    DWORD dwMoveMethod);
+DWORD GetFileSize(HANDLE hFile, LPDWORD lpFileSizeHigh);
+BOOL LockFileEx(HANDLE hFile, DWORD dwFlags, DWORD dwReserved,
+    DWORD nNumberOfBytesToLockLow, DWORD nNumberOfBytesToLockHigh,
+    LPOVERLAPPED lpOverlapped);
+BOOL UnlockFileEx(HANDLE hFile, DWORD dwReserved, DWORD nNumberOfBytesToUnlockLow,
+    DWORD nNumberOfBytesToUnlockHigh, LPOVERLAPPED lpOverlapped);
+HANDLE CreateFileMapping(HANDLE hFile, LPSECURITY_ATTRIBUTES lpAttributes,
+    DWORD flProtect, DWORD dwMaximumSizeHigh, DWORD dwMaximumSizeLow, LPCTSTR lpName);
+LPVOID MapViewOfFile(HANDLE hFileMappingObject, DWORD dwDesiredAccess,
+    DWORD dwFileOffsetHigh, DWORD dwFileOffsetLow, SIZE_T dwNumberOfBytesToMap);
+BOOL UnmapViewOfFile(LPCVOID lpBaseAddress);
+BOOL CopyFile(LPCTSTR lpExistingFileName, LPCTSTR lpNewFileName, BOOL bFailIfExists);
+DWORD GetFileAttributes(LPCTSTR lpFileName);
+BOOL GetFileAttributesEx(LPCTSTR lpFileName, GET_FILEEX_INFO_LEVELS fInfoLevelId,
+    LPVOID lpFileInformation);
+HANDLE FindFirstFile(LPCTSTR lpFileName, WIN32_FIND_DATA* lpFindFileData);
+BOOL FindNextFile(HANDLE hFindFile, WIN32_FIND_DATA* lpFindFileData);
+BOOL FindClose(HANDLE hFindFile);
+LONG CompareFileTime(const FILETIME* lpFileTime1, const FILETIME* lpFileTime2);
+DWORD GetTempPath(DWORD nBufferLength, LPTSTR lpBuffer);
+UINT GetTempFileName(LPCTSTR lpPathName, LPCTSTR lpPrefixString, UINT uUnique,
+    LPTSTR lpTempFileName);
+DWORD GetCurrentDirectory(DWORD nBufferLength, LPTSTR lpBuffer);
+UINT GetSystemDirectory(LPTSTR lpBuffer, UINT uSize);
+UINT GetWindowsDirectory(LPTSTR lpBuffer, UINT uSize);
+DWORD GetModuleFileName(HMODULE hModule, LPTSTR lpFilename, DWORD nSize);
+DWORD GetPrivateProfileSection(LPCTSTR lpAppName, LPTSTR lpReturnedString,
+    DWORD nSize, LPCTSTR lpFileName);
+DWORD GetPrivateProfileString(LPCTSTR lpAppName, LPCTSTR lpKeyName,
+    LPCTSTR lpDefault, LPTSTR lpReturnedString, DWORD nSize, LPCTSTR lpFileName);
+
+
+// environment and system
+typedef enum { ComputerNameDnsHostname = 1 } COMPUTER_NAME_FORMAT;
+
+typedef struct {
+    WORD wProcessorArchitecture;
+    WORD wReserved;
+    DWORD dwPageSize;
+    LPVOID lpMinimumApplicationAddress;
+    LPVOID lpMaximumApplicationAddress;
+    DWORD_PTR dwActiveProcessorMask;
+    DWORD dwNumberOfProcessors;
+    DWORD dwProcessorType;
+    DWORD dwAllocationGranularity;
+    WORD wProcessorLevel;
+    WORD wProcessorRevision;
+} SYSTEM_INFO;
+
+typedef struct {
+    void* ExceptionList;
+    PVOID StackBase;
+    PVOID StackLimit;
+} NT_TIB;
+
+LPTSTR GetCommandLine(void);
+DWORD GetEnvironmentVariable(LPCTSTR lpName, LPTSTR lpBuffer, DWORD nSize);
+LPTSTR GetEnvironmentStrings(void);
+BOOL FreeEnvironmentStrings(LPTSTR penv);
+BOOL GetComputerNameEx(COMPUTER_NAME_FORMAT NameType, LPTSTR lpBuffer, LPDWORD nSize);
+void GetSystemInfo(SYSTEM_INFO* lpSystemInfo);
+void GetSystemTimeAsFileTime(FILETIME* lpSystemTimeAsFileTime);
+DWORD GetTickCount(void);
+ULONGLONG GetTickCount64(void);
+BOOL QueryPerformanceCounter(LARGE_INTEGER* lpPerformanceCount);
+BOOL QueryPerformanceFrequency(LARGE_INTEGER* lpFrequency);
+void* NtCurrentTeb(void);
+
+
+// processes and threads
+#define WAIT_OBJECT_0                       0
+#define WAIT_TIMEOUT                        0x102
+#define WAIT_FAILED                         ((DWORD)-1)
+#define MAXIMUM_WAIT_OBJECTS                64
+#define STILL_ACTIVE                        259
+#define STACK_SIZE_PARAM_IS_A_RESERVATION   0x10000
+#define CREATE_UNICODE_ENVIRONMENT          0x400
+#define STARTF_USESTDHANDLES                0x100
+
+typedef DWORD (WINAPI *LPTHREAD_START_ROUTINE)(LPVOID lpThreadParameter);
+typedef BOOL (WINAPI *PHANDLER_ROUTINE)(DWORD dwCtrlType);
+
+typedef struct {
+    DWORD cb;
+    LPTSTR lpReserved;
+    LPTSTR lpDesktop;
+    LPTSTR lpTitle;
+    DWORD dwX, dwY, dwXSize, dwYSize;
+    DWORD dwXCountChars, dwYCountChars;
+    DWORD dwFillAttribute;
+    DWORD dwFlags;
+    WORD wShowWindow;
+    WORD cbReserved2;
+    BYTE* lpReserved2;
+    HANDLE hStdInput;
+    HANDLE hStdOutput;
+    HANDLE hStdError;
+} STARTUPINFO, *LPSTARTUPINFO;
+
+typedef struct {
+    HANDLE hProcess;
+    HANDLE hThread;
+    DWORD dwProcessId;
+    DWORD dwThreadId;
+} PROCESS_INFORMATION, *LPPROCESS_INFORMATION;
+
+__declspec(noreturn) void ExitProcess(UINT uExitCode);
+HANDLE GetCurrentProcess(void);
+DWORD GetCurrentProcessId(void);
+BOOL GetProcessTimes(HANDLE hProcess, FILETIME* lpCreationTime,
+    FILETIME* lpExitTime, FILETIME* lpKernelTime, FILETIME* lpUserTime);
+BOOL SetProcessWorkingSetSize(HANDLE hProcess, SIZE_T dwMinimumWorkingSetSize,
+    SIZE_T dwMaximumWorkingSetSize);
+BOOL CreateProcess(LPCTSTR lpApplicationName, LPTSTR lpCommandLine,
+    LPSECURITY_ATTRIBUTES lpProcessAttributes, LPSECURITY_ATTRIBUTES lpThreadAttributes,
+    BOOL bInheritHandles, DWORD dwCreationFlags, LPVOID lpEnvironment,
+    LPCTSTR lpCurrentDirectory, LPSTARTUPINFO lpStartupInfo,
+    LPPROCESS_INFORMATION lpProcessInformation);
+BOOL GetExitCodeProcess(HANDLE hProcess, LPDWORD lpExitCode);
+BOOL GetExitCodeThread(HANDLE hThread, LPDWORD lpExitCode);
+HANDLE CreateThread(LPSECURITY_ATTRIBUTES lpThreadAttributes, SIZE_T dwStackSize,
+    LPTHREAD_START_ROUTINE lpStartAddress, LPVOID lpParameter, DWORD dwCreationFlags,
+    LPDWORD lpThreadId);
+HANDLE CreateEvent(LPSECURITY_ATTRIBUTES lpEventAttributes, BOOL bManualReset,
+    BOOL bInitialState, LPCTSTR lpName);
+BOOL SetEvent(HANDLE hEvent);
+DWORD WaitForSingleObject(HANDLE hHandle, DWORD dwMilliseconds);
+DWORD WaitForMultipleObjects(DWORD nCount, const HANDLE* lpHandles, BOOL bWaitAll,
+    DWORD dwMilliseconds);
+
+#define ATOMIC_SEQ      __ATOMIC_SEQ_CST
+static inline LONG InterlockedIncrement(LONG volatile* p)
+{
+    return __atomic_add_fetch(p, 1, ATOMIC_SEQ);
+}
+static inline LONG InterlockedDecrement(LONG volatile* p)
+{
+    return __atomic_sub_fetch(p, 1, ATOMIC_SEQ);
+}
+static inline LONG InterlockedExchange(LONG volatile* p, LONG v)
+{
+    return __atomic_exchange_n(p, v, ATOMIC_SEQ);
+}
+static inline LONGLONG InterlockedExchange64(LONGLONG volatile* p, LONGLONG v)
+{
+    return __atomic_exchange_n(p, v, ATOMIC_SEQ);
+}
+static inline LONG InterlockedCompareExchange(LONG volatile* p, LONG v, LONG c)
+{
+    __atomic_compare_exchange_n(p, &c, v, 0, ATOMIC_SEQ, ATOMIC_SEQ);
+    return c;
+}
+static inline PVOID InterlockedCompareExchangePointer(PVOID volatile* p, PVOID v,
+    PVOID c)
+{
+    __atomic_compare_exchange_n(p, &c, v, 0, ATOMIC_SEQ, ATOMIC_SEQ);
+    return c;
+}
+
+
+// console
+#define CP_ACP              0
+#define CP_UTF8             65001
+#define CTRL_C_EVENT        0
+#define CTRL_BREAK_EVENT    1
+
+BOOL SetConsoleCtrlHandler(PHANDLER_ROUTINE HandlerRoutine, BOOL Add);
+BOOL GetConsoleMode(HANDLE hConsoleHandle, LPDWORD lpMode);
+BOOL WriteConsole(HANDLE hConsoleOutput, const void* lpBuffer,
+    DWORD nNumberOfCharsToWrite, LPDWORD lpNumberOfCharsWritten, LPVOID lpReserved);
+BOOL SetConsoleOutputCP(UINT wCodePageID);
+UINT GetACP(void);
+
+
+// strings: ACP is UTF-8
+#define LOCALE_USER_DEFAULT 0x400
+#define NORM_IGNORECASE     0x1
+#define CSTR_LESS_THAN      1
+#define CSTR_EQUAL          2
+#define CSTR_GREATER_THAN   3
+
+int MultiByteToWideChar(UINT CodePage, DWORD dwFlags, LPCSTR lpMultiByteStr,
+    int cbMultiByte, LPWSTR lpWideCharStr, int cchWideChar);
+int WideCharToMultiByte(UINT CodePage, DWORD dwFlags, LPCWSTR lpWideCharStr,
+    int cchWideChar, LPSTR lpMultiByteStr, int cbMultiByte, LPCSTR lpDefaultChar,
+    BOOL* lpUsedDefaultChar);
+int CompareString(LCID Locale, DWORD dwCmpFlags, LPCTSTR lpString1, int cchCount1,
+    LPCTSTR lpString2, int cchCount2);
+DWORD CharUpperBuff(LPTSTR lpsz, DWORD cchLength);
+int lstrlen(LPCTSTR lpString);
+int lstrcmp(LPCTSTR lpString1, LPCTSTR lpString2);
+#define lstrlenA    lstrlen
+#define lstrcmpA    lstrcmp
+
+
+// POSIX extensions: test knobs and exec() for the launcher
+#if defined(POSIX_TEST)
+// delays file attribute queries and directory reads under the prefix (any path if
+// NULL), and host name lookup, by microseconds; set from POSIX_STAT_DELAY=us[,prefix]
+// and POSIX_HOST_DELAY=us on startup
+extern unsigned posixStatDelay;
+extern const char* posixStatPrefix;
+extern unsigned posixHostDelay;
+// file attribute queries and directory reads made so far
+extern volatile LONG posixStatCount;
+#endif // POSIX_TEST
+// replaces the process with command line and environment block as CreateProcess()
+// takes them; returns error code on failure
+DWORD posix_exec(LPCTSTR lpCommandLine, LPCTSTR lpEnvironment);
+// converts native path to POSIX one; FALSE if it doesn't fit
+BOOL posix_path(char* pszTo, size_t cchTo, LPCTSTR pszFrom);
+
+#endif // POSIX_WINDOWS_H
@@ -6,6 +6,15 @@
  */
 
 
+/** Build instructions:
+
+    -DUNICODE = compiles 'unicode' version instead of 'ansi'
+    -DNOCACHE = disables persistent resolution cache (%TEMP%\shebang.cache)
+    -DNOTRACE = disables startup tracing (SHEBANG_TRACE=file)
+
+**/
+
+
 #if defined(UNICODE) && !defined(_UNICODE)
 #define _UNICODE
 #endif // UNICODE
@@ -15,6 +24,8 @@
 #include <windows.h>
 #include <shlwapi.h>
 #include <strsafe.h>
+#include <psapi.h>
+#include "libshebang_int.h"
 
 
 #if !defined(__GNUC__)
@@ -29,299 +40,434 @@
 #define COUNT1(a)       (COUNT(a) - 1)
 #define ARRAY(a)        (a), COUNT(a)
 #define ARRAY1(a)       (a), COUNT1(a)
-// latin letter test
-#define IS_LATIN(c)     (('A' <= (c) && (c) <= 'Z') || ('a' <= (c) && (c) <= 'z'))
 
 
-// known POSIX layers
+#if !defined(NOTRACE)
+// startup phases, each one is marked at its end
+enum {
+    TRACE_START,        // entry point
+    TRACE_LOOKUP,       // embedded or cached resolution looked up
+    TRACE_FIND,         // POSIX root and script found on PATH
+    TRACE_SHEBANG,      // shebang line parsed and shell resolved
+    TRACE_CMDLINE,      // command line made
+    TRACE_ENV,          // environment block made
+    TRACE_SPAWN,        // shell process created
+    TRACE_WAIT,         // shell process exited
+    TRACE_COUNT
+};
+
+// launch trace; off unless SHEBANG_TRACE names output file
+static struct {
+    PCTSTR pszFile;
+    const RESOLVED* pr;         // resolution if any
+    const char* pcSource;       // where resolution came from
+    FILETIME ftStart;           // wall clock at entry point
+    LARGE_INTEGER t[TRACE_COUNT];
+} trace;
+
+#define TRACE(phase)    (trace.pszFile ? \
+    (void)QueryPerformanceCounter(&trace.t[phase]) : (void)0)
+#define TRACE_RESOLVED(r, source) (trace.pr = (r), trace.pcSource = (source))
+
+// JSON line being made
 typedef struct {
-    enum {
-        POSIX_UNKNOWN = -1,
-        POSIX_CLANGARM64,   // CLANGARM64
-        POSIX_MINGW32,      // MINGW32
-        POSIX_MINGW64,      // MINGW64
-        POSIX_UCRT64,       // UCRT64
-        POSIX_CLANG32,      // CLANG32
-        POSIX_CLANG64,      // CLANG64
-        POSIX_MSYS,         // MSYS
-        POSIX_CYGWIN,       // Cygwin
-        POSIX_COUNT
-    } sys;
-    TCHAR root[MAX_PATH];
-} POSIX;
-
-
-// internal implementation of memcmp()
-int compare_bytes(const void* s1, const void* s2, size_t n)
+    size_t len;
+    char buf[4096];
+} JSON;
+
+
+// starts tracing if requested
+void trace_start(void)
 {
-    const unsigned char* p1 = s1;
-    const unsigned char* p2 = s2;
+    // only the length is asked for: no copy of the environment unless tracing
+    if (GetEnvironmentVariable(TEXT("SHEBANG_TRACE"), NULL, 0) > 1
+        && (trace.pszFile = get_env(ARRAY1("shebang_trace=")))) {
+        GetSystemTimeAsFileTime(&trace.ftStart);
+        TRACE(TRACE_START);
+    }
+}
 
-    do {
-        int b1 = *p1++;
-        int b2 = *p2++;
-        if (b1 != b2)
-            return (b1 - b2);
-    } while (--n);
 
-    return 0;
+// appends raw ASCII
+void put_raw(JSON* pj, const char* s)
+{
+    while (*s && pj->len < sizeof(pj->buf))
+        pj->buf[pj->len++] = *s++;
 }
 
 
-// concats TCHAR string with UTF-8 string
-BOOL concat_with_utf8(PTSTR pszDest, size_t cchDest, const char* src)
+// appends unsigned number
+void put_uint(JSON* pj, ULONGLONG n)
 {
-    size_t cnt;
-    if (FAILED(StringCchLength(pszDest, cchDest, &cnt)))
-        return FALSE;
+    char tmp[21];
+    char* cp = tmp + COUNT1(tmp);
+    *cp = '\0';
+    do *--cp = (char)('0' + n % 10); while (n /= 10);
+    put_raw(pj, cp);
+}
 
+
+// appends string value as UTF-8 with JSON escapes
+void put_text(JSON* pj, PCTSTR psz)
+{
+    char tmp[MAX_PATH * 3];
 #ifdef UNICODE
-    return (MultiByteToWideChar(CP_UTF8, 0, src, -1, pszDest + cnt, cchDest - cnt) > 0);
+    if (WideCharToMultiByte(CP_UTF8, 0, psz, -1, ARRAY(tmp), NULL, NULL) <= 0)
+        tmp[0] = '\0';
 #else
-    wchar_t tmp[cchDest - cnt]; // VLA
-    return (MultiByteToWideChar(CP_UTF8, 0, src, -1, tmp, cchDest - cnt) > 0
-        && WideCharToMultiByte(CP_ACP, 0, tmp, -1, pszDest + cnt, cchDest - cnt,
-            NULL, NULL) > 0);
+    WCHAR w[MAX_PATH];
+    if (MultiByteToWideChar(CP_ACP, 0, psz, -1, ARRAY(w)) <= 0
+        || WideCharToMultiByte(CP_UTF8, 0, w, -1, ARRAY(tmp), NULL, NULL) <= 0)
+        tmp[0] = '\0';
 #endif // UNICODE
-}
 
-
-// replaces all occurences of a char in a string
-void replace_char(PTSTR psz, TCHAR cTo, TCHAR cFrom)
-{
-    for ( ; *psz; ++psz)
-        if (*psz == cFrom)
-            *psz = cTo;
+    put_raw(pj, "\"");
+    for (const unsigned char* cp = (const unsigned char*)tmp; *cp; ++cp) {
+        char esc[7] = { '\\', (char)*cp, '\0' };
+        if (*cp < 0x20) {
+            esc[1] = 'u';
+            esc[2] = esc[3] = '0';
+            esc[4] = "0123456789abcdef"[*cp >> 4];
+            esc[5] = "0123456789abcdef"[*cp & 15];
+            esc[6] = '\0';
+        }
+        put_raw(pj, (*cp < 0x20 || *cp == '"' || *cp == '\\') ? esc : esc + 1);
+    }
+    put_raw(pj, "\"");
 }
 
 
-// finds active MSYS/Cygwin installation by scanning PATH
-void find_posix(POSIX* ppx)
+// appends one JSON line for this launch to the trace file
+void trace_write(DWORD dwErrorCode, DWORD dwExitCode)
 {
-    // root paths
-    static const struct {
-        PCTSTR spec;
-        size_t tail;
-    } sRoot[POSIX_COUNT] = {
-        { TEXT("*\\msys*\\clangarm64\\bin"),    COUNT1("\\clangarm64\\bin") },
-        { TEXT("*\\msys*\\mingw32\\bin"),       COUNT1("\\mingw32\\bin") },
-        { TEXT("*\\msys*\\mingw64\\bin"),       COUNT1("\\mingw64\\bin") },
-        { TEXT("*\\msys*\\ucrt64\\bin"),        COUNT1("\\ucrt64\\bin") },
-        { TEXT("*\\msys*\\clang32\\bin"),       COUNT1("\\clang32\\bin") },
-        { TEXT("*\\msys*\\clang64\\bin"),       COUNT1("\\clang64\\bin") },
-        { TEXT("*\\msys*\\usr\\bin"),           COUNT1("\\usr\\bin") },
-        { TEXT("*\\cygwin*\\bin"),              COUNT1("\\bin") }
+    static const char* const pcPhase[TRACE_COUNT] = {
+        "load", "lookup", "find", "shebang", "cmdline", "env", "spawn", "wait"
+    };
+    static const char* const pcPOSIX[POSIX_COUNT] = {
+        "clangarm64", "mingw32", "mingw64", "ucrt64", "clang32", "clang64", "msys",
+        "cygwin", "native"
     };
 
-    // nothing found yet
-    ppx->sys = POSIX_UNKNOWN;
-
-    // get PATH
-    TCHAR achPATH[4096]; // max
-    size_t cchPATH = (size_t)GetEnvironmentVariable(TEXT("PATH"), ARRAY(achPATH));
-    if (!cchPATH || cchPATH > COUNT(achPATH))
-        return; // unexpected error
-
-    ++cchPATH; // count null-terminating character
-    replace_char(achPATH, TEXT('\0'), TEXT(';')); // split PATH
-
-    // find first path matching one of the patterns
-    size_t cch;
-    for (TCHAR* cp = achPATH; cchPATH; cp += cch + 1, cchPATH -= cch + 1) {
-        if (FAILED(StringCchLength(cp, cchPATH, &cch)))
-            break; // unexpected error
-
-        for (int i = 0; i < POSIX_COUNT; ++i) {
-            if (PathMatchSpec(cp, sRoot[i].spec)) {
-                ppx->sys = i;
-                StringCchCopyN(ARRAY(ppx->root), cp, cch - sRoot[i].tail);
-                return;
-            }
-        }
+    PCTSTR pszFile = trace.pszFile;
+    if (!pszFile)
+        return;
+    trace.pszFile = NULL; // once
+
+    // header: start time as Unix ms, process and launch outcome
+    JSON j;
+    j.len = 0;
+    ULARGE_INTEGER u = {{ trace.ftStart.dwLowDateTime, trace.ftStart.dwHighDateTime }};
+    PCTSTR pszPATH = get_env(ARRAY1("path="));
+    put_raw(&j, "{\"time\":");
+    put_uint(&j, (u.QuadPart - 116444736000000000ULL) / 10000);
+    put_raw(&j, ",\"pid\":");
+    put_uint(&j, GetCurrentProcessId());
+    put_raw(&j, ",\"error\":");
+    put_uint(&j, dwErrorCode);
+    put_raw(&j, ",\"exit\":");
+    put_uint(&j, dwExitCode);
+    put_raw(&j, ",\"path_len\":");
+    put_uint(&j, pszPATH ? (ULONGLONG)lstrlen(pszPATH) : 0);
+    if (trace.pr) {
+        put_raw(&j, ",\"source\":\"");
+        put_raw(&j, trace.pcSource);
+        put_raw(&j, "\",\"posix\":\"");
+        put_raw(&j, trace.pr->px.sys >= 0 ? pcPOSIX[trace.pr->px.sys] : "unknown");
+        put_raw(&j, "\",\"script\":");
+        put_text(&j, trace.pr->szScript);
+        put_raw(&j, ",\"shell\":");
+        put_text(&j, trace.pr->szShellCmd);
+    }
+
+    // peak bytes: committed stack of this thread (incl. tracing itself), private
+    // memory and working set of the process
+    const NT_TIB* ptib = (const NT_TIB*)NtCurrentTeb();
+    PROCESS_MEMORY_COUNTERS pmc;
+    put_raw(&j, ",\"mem\":{\"stack\":");
+    put_uint(&j, (ULONGLONG)((const BYTE*)ptib->StackBase
+        - (const BYTE*)ptib->StackLimit));
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        put_raw(&j, ",\"commit\":");
+        put_uint(&j, pmc.PeakPagefileUsage);
+        put_raw(&j, ",\"ws\":");
+        put_uint(&j, pmc.PeakWorkingSetSize);
+    }
+    put_raw(&j, "}");
+
+    // phase durations in us; "load" is from process creation to entry point
+    LARGE_INTEGER freq;
+    FILETIME ftCreate, ft;
+    QueryPerformanceFrequency(&freq);
+    put_raw(&j, ",\"us\":{");
+    if (GetProcessTimes(GetCurrentProcess(), &ftCreate, &ft, &ft, &ft)) {
+        ULARGE_INTEGER c = {{ ftCreate.dwLowDateTime, ftCreate.dwHighDateTime }};
+        put_raw(&j, "\"load\":");
+        put_uint(&j, u.QuadPart > c.QuadPart ? (u.QuadPart - c.QuadPart) / 10 : 0);
+    }
+    for (int i = TRACE_START + 1, prev = TRACE_START; i < TRACE_COUNT; ++i) {
+        if (!trace.t[i].QuadPart)
+            continue; // skipped
+        put_raw(&j, ",\"");
+        put_raw(&j, pcPhase[i]);
+        put_raw(&j, "\":");
+        put_uint(&j, (ULONGLONG)(trace.t[i].QuadPart - trace.t[prev].QuadPart)
+            * 1000000 / (ULONGLONG)freq.QuadPart);
+        prev = i;
+    }
+    put_raw(&j, "}}\n");
+
+    // appends are atomic, so concurrent launches don't mix lines
+    HANDLE hFile = CreateFile(pszFile, FILE_APPEND_DATA,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile != INVALID_HANDLE_VALUE) {
+        WriteFile(hFile, j.buf, (DWORD)j.len, &(DWORD){0}, NULL);
+        CloseHandle(hFile);
     }
 }
+#else
+#define TRACE(phase)                ((void)0)
+#define TRACE_RESOLVED(r, source)   ((void)0)
+#define trace_start()               ((void)0)
+#define trace_write(dwErrorCode, dwExitCode)    ((void)0)
+#endif // NOTRACE
 
 
-// sets some of MSYS/Cygwin environment variables
-void setup_posix_env(POSIX* ppx)
+// finds script on PATH and resolves its shell
+DWORD resolve_script(SHEBANG* psb, RESOLVED* pr, PCTSTR pszName)
 {
-    // MSYS names and POSIX prefixes
-    static PCTSTR const pszMSYS[POSIX_COUNT][2] = {
-        { TEXT("CLANGARM64"),   TEXT("/clangarm64") },
-        { TEXT("MINGW32"),      TEXT("/mingw32") },
-        { TEXT("MINGW64"),      TEXT("/mingw64") },
-        { TEXT("UCRT64"),       TEXT("/ucrt64") },
-        { TEXT("CLANG32"),      TEXT("/clang32") },
-        { TEXT("CLANG64"),      TEXT("/clang64") },
-        { TEXT("MSYS"),         TEXT("/usr") },
-        { NULL,                 NULL }
-    };
+    // find POSIX root and matching shell script on PATH
+    DWORD dwErrorCode = shebang_find(psb, pr, pszName);
+    TRACE(TRACE_FIND);
+    if (dwErrorCode != ERROR_SUCCESS)
+        return dwErrorCode;
 
-    // set MSYSTEM, MSYSTEM_PREFIX and MINGW_PREFIX
-    SetEnvironmentVariable(TEXT("MSYSTEM"), pszMSYS[ppx->sys][0]);
-    SetEnvironmentVariable(TEXT("MSYSTEM_PREFIX"), pszMSYS[ppx->sys][1]);
-    SetEnvironmentVariable(TEXT("MINGW_PREFIX"),
-        ppx->sys == POSIX_MSYS ? NULL : pszMSYS[ppx->sys][1]);
-
-    // set USER and HOSTNAME
-    TCHAR tmp[256]; // max
-    if (GetEnvironmentVariable(TEXT("USERNAME"), ARRAY(tmp)))
-        SetEnvironmentVariable(TEXT("USER"), tmp);
-    if (GetComputerNameEx(ComputerNameDnsHostname, tmp, &(DWORD){COUNT(tmp)}))
-        SetEnvironmentVariable(TEXT("HOSTNAME"), tmp);
+    // can she bang?
+    dwErrorCode = shebang_parse(psb, pr);
+    TRACE(TRACE_SHEBANG);
+    return dwErrorCode;
 }
 
 
-// converts POSIX path to native path
-BOOL convert_path(PTSTR pszTo, size_t cchTo, POSIX* ppx, const char* from)
+// trailer appended to installed copies
+#define TRAILER_MAGIC   (0x53425400UL | sizeof(TCHAR)) // "SBT" + char size
+typedef struct {
+    RESOLVED r;
+    ULONGLONG hash;             // hash of r
+    DWORD cb;                   // sizeof(TRAILER)
+    DWORD magic;                // TRAILER_MAGIC
+} TRAILER;
+
+
+// fills trailer with the resolution
+void make_trailer(TRAILER* ptr, const RESOLVED* pr)
 {
-    TCHAR tmp[MAX_PATH];
+    *ptr = (TRAILER){ .r = *pr, .cb = sizeof(TRAILER), .magic = TRAILER_MAGIC };
+    ptr->hash = hash_bytes(FNV_BASIS, &ptr->r, sizeof(ptr->r));
+}
 
-    if (*from == '\\' || (IS_LATIN(from[0]) && from[1] == ':')) { // Win path
-        tmp[0] = TEXT('\0');
-    } else if (*from == '/') { // POSIX path
-        ++from;
-
-        // skip over cygdrive/
-        if (!compare_bytes(from, ARRAY1("cygdrive/")))
-            from += COUNT1("cygdrive/");
-
-        // substitute: /c --> c:
-        if (IS_LATIN(from[0]) && from[1] == '/') {
-            tmp[0] = (TCHAR)from[0];
-            tmp[1] = TEXT(':');
-            tmp[2] = TEXT('/');
-            tmp[3] = TEXT('\0');
-            from += COUNT1("c/");
-        } else {
-            // start from POSIX root
-            StringCchCopy(ARRAY(tmp), ppx->root);
-            StringCchCat(ARRAY(tmp), TEXT("/"));
-
-            if (ppx->sys == POSIX_CYGWIN) {
-                // /usr/bin --> /bin
-                if (!compare_bytes(from, ARRAY1("usr/bin/"))) {
-                    StringCchCat(ARRAY(tmp), TEXT("bin/"));
-                    from += COUNT1("usr/bin/");
-                }
-            }  else {
-                // /bin --> /usr/bin
-                if (!compare_bytes(from, ARRAY1("bin/"))) {
-                    StringCchCat(ARRAY(tmp), TEXT("usr/bin/"));
-                    from += COUNT1("bin/");
-                }
-            }
-        }
-    } else { // relative path
-        GetCurrentDirectory(COUNT(tmp), tmp);
-        StringCchCat(ARRAY(tmp), TEXT("/"));
-    }
 
-    // add the rest
-    if (!concat_with_utf8(ARRAY(tmp), from))
+// checks trailer of cb bytes read from executable file for the script name
+BOOL check_trailer(const TRAILER* ptr, DWORD cb, PCTSTR pszName)
+{
+    return (cb == sizeof(*ptr) && ptr->magic == TRAILER_MAGIC && ptr->cb == sizeof(*ptr)
+        && ptr->hash == hash_bytes(FNV_BASIS, &ptr->r, sizeof(ptr->r))
+        && !StrCmpI(PathFindFileName(ptr->r.szScript), pszName)
+        && shebang_check(&ptr->r));
+}
+
+
+// reads resolution embedded into executable file for the script name
+BOOL read_trailer(PCTSTR pszModule, PCTSTR pszName, RESOLVED* pr)
+{
+    HANDLE hFile = CreateFile(pszModule, GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
         return FALSE;
 
-    // apply native separators and .exe extension
-    replace_char(tmp, TEXT('\\'), TEXT('/')); // to Win separators
-    PathAddExtension(tmp, NULL); // note: PathCchAddExtension is for Win 8+ only
+    TRAILER tr;
+    DWORD cb = 0;
+    if (SetFilePointer(hFile, -(LONG)sizeof(tr), NULL, FILE_END)
+        != INVALID_SET_FILE_POINTER)
+        ReadFile(hFile, &tr, sizeof(tr), &cb, NULL);
+    CloseHandle(hFile);
 
-    // check if file exists
-    if (!PathFileExists(tmp))
+    if (!check_trailer(&tr, cb, pszName))
         return FALSE;
 
-    // executable name containing spaces should be enquoted for security reasons
-    PathQuoteSpaces(tmp);
+    *pr = tr.r;
+    return TRUE;
+}
+
+
+// makes a copy of ourselves with embedded resolution for the script
+DWORD install_copy(SHEBANG* psb, PCTSTR pszModule, PCTSTR pszName)
+{
+    RESOLVED r = {0};
+    DWORD dwErrorCode = resolve_script(psb, &r, pszName);
+    if (dwErrorCode != ERROR_SUCCESS)
+        return dwErrorCode;
+    TRAILER tr;
+    make_trailer(&tr, &r);
+
+    // <our dir>\<name>.exe
+    TCHAR szTarget[MAX_PATH];
+    StringCchCopy(ARRAY(szTarget), pszModule);
+    PathRemoveFileSpec(szTarget);
+    if (!PathAppend(szTarget, pszName)
+        || FAILED(StringCchCat(ARRAY(szTarget), TEXT(".exe"))))
+        return ERROR_FILENAME_EXCED_RANGE;
+
+    // copy and append trailer
+    if (!CopyFile(pszModule, szTarget, FALSE))
+        return GetLastError();
+    HANDLE hFile = CreateFile(szTarget, GENERIC_WRITE, 0, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return GetLastError();
+    DWORD cb;
+    if (SetFilePointer(hFile, 0, NULL, FILE_END) == INVALID_SET_FILE_POINTER
+        || !WriteFile(hFile, &tr, sizeof(tr), &cb, NULL))
+        dwErrorCode = GetLastError();
+    CloseHandle(hFile);
+
+    return dwErrorCode;
+}
+
+
+#if !defined(NOCACHE)
+// resolution cache geometry
+#define CACHE_MAGIC     (0x53430000UL | sizeof(CACHE_ENTRY)) // "SC" + entry size
+#define CACHE_BUCKETS   128
+#define CACHE_WAYS      4
+
+// resolution cache entry
+typedef struct {
+    DWORD magic;                // CACHE_MAGIC if entry is valid
+    ULONGLONG hash;             // hash of script name, PATH and current directory
+    RESOLVED r;
+} CACHE_ENTRY;
+
+// memory-mapped resolution cache
+typedef struct {
+    HANDLE hFile;
+    CACHE_ENTRY (*bucket)[CACHE_WAYS];
+    ULONGLONG hash;
+} CACHE;
+
 
-    // copy out result
-    return SUCCEEDED(StringCchCopy(pszTo, cchTo, tmp));
+// locks cache bucket for reading or writing
+BOOL lock_bucket(CACHE* pc, DWORD dwFlags, OVERLAPPED* pov)
+{
+    *pov = (OVERLAPPED){0};
+    pov->Offset = (DWORD)(pc->hash % CACHE_BUCKETS * sizeof(*pc->bucket));
+    return LockFileEx(pc->hFile, dwFlags, 0, sizeof(*pc->bucket), 0, pov);
 }
 
 
-// parses a shebang line
-BOOL parse_line(char* line, size_t cnt, const char** ppc1, const char** ppc2)
+// opens persistent resolution cache and computes lookup key
+BOOL open_cache(CACHE* pc, PCTSTR pszName)
 {
-    char* cp;
+    pc->hFile = INVALID_HANDLE_VALUE;
+    pc->bucket = NULL;
 
-    // #!
-    if (cnt < 2 || *line++ != '#' || *line++ != '!')
+    // key: script name, PATH, current directory, substitution rules, pinned POSIX
+    // layer and shebang.ini
+    TCHAR tmp[MAX_PATH];
+    PCTSTR pszPATH = get_env(ARRAY1("path="));
+    PCTSTR pszSubst = get_env(ARRAY1("shebang_subst="));
+    if (!pszPATH || !GetCurrentDirectory(COUNT(tmp), tmp))
         return FALSE;
-    cnt -= 2;
-
-    // convert tabs to spaces, break at a newline
-    for (cp = line; cnt; ++cp, --cnt) {
-        if (*cp == '\0') // unexpected end of string
-            return FALSE;
-        if (*cp == '\n' || *cp == '\r') {
-            *cp = '\0';
-            break;
-        }
-        if (*cp == '\t')
-            *cp = ' ';
-    }
-    if (!cnt) // no newline
+    pc->hash = hash_string(hash_string(hash_string(FNV_BASIS, pszName), pszPATH), tmp);
+    if (pszSubst)
+        pc->hash = hash_string(pc->hash, pszSubst);
+    pc->hash = hash_settings(pc->hash);
+
+    // map cache file from %TEMP%
+    if (!GetTempPath(COUNT(tmp), tmp)
+        || FAILED(StringCchCat(ARRAY(tmp), TEXT(PROGRAM_NAME ".cache"))))
         return FALSE;
-
-    // skip leading spaces
-    for (cp = line; *cp == ' '; ++cp) ;
-    if (*cp == '\0') // shell not found
+    pc->hFile = CreateFile(tmp, GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    if (pc->hFile == INVALID_HANDLE_VALUE)
         return FALSE;
+    HANDLE hMap = CreateFileMapping(pc->hFile, NULL, PAGE_READWRITE, 0,
+        CACHE_BUCKETS * sizeof(*pc->bucket), NULL);
+    if (hMap) {
+        pc->bucket = MapViewOfFile(hMap, FILE_MAP_WRITE, 0, 0, 0);
+        CloseHandle(hMap); // view keeps mapping alive
+    }
+
+    return (pc->bucket != NULL);
+}
 
-    // store pointer to shell name
-    *ppc1 = cp;
 
-    // skip until next space
-    while (*cp && *cp != ' ') ++cp;
+// gets cached resolution for the script
+BOOL cache_lookup(CACHE* pc, RESOLVED* pr, PCTSTR pszName)
+{
+    if (!open_cache(pc, pszName))
+        return FALSE;
 
-    if (*cp == ' ') {
-        // have args
-        *cp++ = '\0';
-        *ppc2 = cp;
-    } else {
-        // no args
-        *ppc2 = NULL;
+    // copy out matching entry under shared lock
+    CACHE_ENTRY ce = {0};
+    OVERLAPPED ov;
+    if (!lock_bucket(pc, 0, &ov))
+        return FALSE;
+    CACHE_ENTRY* pce = pc->bucket[pc->hash % CACHE_BUCKETS];
+    for (int i = 0; i < CACHE_WAYS; ++i, ++pce) {
+        if (pce->magic == CACHE_MAGIC && pce->hash == pc->hash
+            && !StrCmpI(PathFindFileName(pce->r.szScript), pszName)) {
+            ce = *pce;
+            break;
+        }
     }
+    UnlockFileEx(pc->hFile, 0, sizeof(*pc->bucket), 0, &ov);
 
+    if (ce.magic != CACHE_MAGIC || !shebang_check(&ce.r))
+        return FALSE;
+
+    *pr = ce.r;
     return TRUE;
 }
 
 
-// checks if file is a shell script
-BOOL can_shebang(PCTSTR pszScriptName, PTSTR pszShellName, size_t cchShellName,
-    POSIX* ppx, PDWORD pdwErrorCode)
+// stores resolution into cache
+void cache_store(CACHE* pc, const RESOLVED* pr)
 {
-    // open script file
-    HANDLE hScriptFile = CreateFile(pszScriptName, GENERIC_READ, FILE_SHARE_READ,
-        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-    if (hScriptFile == INVALID_HANDLE_VALUE) {
-        *pdwErrorCode = GetLastError();
-        return FALSE;
+    if (!pc->bucket)
+        return;
+
+    // replace matching, empty or pseudo-random entry under exclusive lock
+    OVERLAPPED ov;
+    if (!lock_bucket(pc, LOCKFILE_EXCLUSIVE_LOCK, &ov))
+        return;
+    CACHE_ENTRY* pce = pc->bucket[pc->hash % CACHE_BUCKETS];
+    int way = (int)(GetTickCount() % CACHE_WAYS);
+    for (int i = 0; i < CACHE_WAYS; ++i) {
+        if (pce[i].magic != CACHE_MAGIC || (pce[i].hash == pc->hash
+            && !StrCmpI(PathFindFileName(pce[i].r.szScript),
+                PathFindFileName(pr->szScript)))) {
+            way = i;
+            break;
+        }
     }
+    pce[way] = (CACHE_ENTRY){ .magic = CACHE_MAGIC, .hash = pc->hash, .r = *pr };
+    UnlockFileEx(pc->hFile, 0, sizeof(*pc->bucket), 0, &ov);
+}
+#else
+typedef int CACHE;
+#define cache_lookup(pc, pr, pszName)   ((void)(pc), FALSE)
+#define cache_store(pc, pr)             ((void)(pc))
+#endif // NOCACHE
 
-    BOOL shebang = FALSE;
-    char buf[cchShellName]; // VLA
-    DWORD cb;
-    const char *pc1, *pc2;
-    if (!ReadFile(hScriptFile, buf, (DWORD)cchShellName, &cb, NULL)) {
-        // cannot read file
-        *pdwErrorCode = GetLastError();
-    } else if (!parse_line(buf, (size_t)cb, &pc1, &pc2)) {
-        // not a script
-        *pdwErrorCode = ERROR_BAD_FORMAT;
-    } else if (!convert_path(pszShellName, cchShellName, ppx, pc1)) {
-        // invalid shell
-        *pdwErrorCode = ERROR_PATH_NOT_FOUND;
-    } else {
-        // process shebang args if any
-        shebang = pc2 ? (
-            SUCCEEDED(StringCchCat(pszShellName, cchShellName, TEXT(" "))) &&
-            concat_with_utf8(pszShellName, cchShellName, pc2)
-        ) : TRUE;
-        if (!shebang) // invalid shebang args
-            *pdwErrorCode = ERROR_BAD_ARGUMENTS;
-    }
 
-    CloseHandle(hScriptFile);
-    return shebang;
+// leaves console interrupts up to the shell, so we don't quit while it runs
+BOOL WINAPI ignore_ctrl(DWORD dwCtrlType)
+{
+    (void)dwCtrlType;
+    return TRUE;
 }
 
 
@@ -342,14 +488,343 @@ void print_error_and_exit(DWORD dwErrorCode)
         // no need to free memory before exit
         //HeapFree(GetProcessHeap(), 0, pszErrorText);
     }
+    trace_write(dwErrorCode, dwErrorCode);
     ExitProcess(dwErrorCode);
 }
 
 
+// batch job
+typedef struct {
+    PTSTR pszName;              // script name
+    PTSTR pszArgs;              // raw args
+    HANDLE hProcess;            // running shell
+    HANDLE hOutput;             // captured output if ordered
+    DWORD dwExitCode;           // shell exit code or our error code
+    BOOL spawned;               // shell was started
+    BOOL done;                  // finished or failed to start
+    LARGE_INTEGER tStart, tEnd;
+} JOB;
+
+// resolution shared by jobs running the same script
+typedef struct {
+    PCTSTR pszName;
+    DWORD dwErrorCode;
+    RESOLVED r;
+    PTSTR pszEnvBlock;
+} BATCH_RES;
+
+// batch state
+typedef struct {
+    SHEBANG sb;                 // context shared by all resolutions
+    PCTSTR pszEnvStrings;       // our environment
+    JOB* pj;
+    int cnt;
+    BATCH_RES* pr;
+    int cntRes;
+} BATCH;
+
+// set by Ctrl+C or Ctrl+Break during batch run
+static volatile LONG batchStop;
+
+
+// stops starting new batch jobs; running ones get interrupted by console itself
+BOOL WINAPI stop_batch(DWORD dwCtrlType)
+{
+    (void)dwCtrlType;
+    InterlockedExchange(&batchStop, TRUE);
+    return TRUE;
+}
+
+
+// writes text to console or redirected handle (UTF-8 in 'unicode' version)
+void write_text(HANDLE h, PCTSTR psz, int cch)
+{
+    DWORD cb;
+    if (GetConsoleMode(h, &cb)) {
+        WriteConsole(h, psz, (DWORD)cch, &cb, NULL);
+        return;
+    }
+#ifdef UNICODE
+    char tmp[1024 * 3];
+    cch = WideCharToMultiByte(CP_UTF8, 0, psz, cch, ARRAY(tmp), NULL, NULL);
+    WriteFile(h, tmp, (DWORD)cch, &cb, NULL);
+#else
+    WriteFile(h, psz, (DWORD)cch, &cb, NULL);
+#endif // UNICODE
+}
+
+
+// reads job file: one "name [args]" per line, blank and #-lines skipped
+BOOL read_jobs(BATCH* pb, PCTSTR pszFile)
+{
+    HANDLE hFile = CreateFile(pszFile, GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return FALSE;
+    HANDLE hHeap = GetProcessHeap();
+    DWORD cb = GetFileSize(hFile, NULL);
+    char* buf = (cb != INVALID_FILE_SIZE) ? HeapAlloc(hHeap, 0, cb + 1) : NULL;
+    BOOL ok = buf && ReadFile(hFile, buf, cb, &cb, NULL);
+    CloseHandle(hFile);
+    if (!ok)
+        return FALSE;
+    buf[cb] = '\0';
+
+    // note: no need to free memory before exit
+#ifdef UNICODE
+    int cch = cb ? MultiByteToWideChar(CP_UTF8, 0, buf, (int)cb, NULL, 0) : 0;
+    PTSTR psz = HeapAlloc(hHeap, 0, ((size_t)cch + 1) * sizeof(TCHAR));
+    if (!psz)
+        return FALSE;
+    MultiByteToWideChar(CP_UTF8, 0, buf, (int)cb, psz, cch);
+    psz[cch] = TEXT('\0');
+#else
+    int cch = (int)cb;
+    PTSTR psz = buf;
+#endif // UNICODE
+
+    // at most one job per line
+    int max = 1;
+    for (int i = 0; i < cch; ++i) {
+        if (psz[i] == TEXT('\n') || psz[i] == TEXT('\r')) {
+            psz[i] = TEXT('\0');
+            ++max;
+        }
+    }
+    if (!(pb->pj = HeapAlloc(hHeap, HEAP_ZERO_MEMORY, max * sizeof(JOB)))
+        || !(pb->pr = HeapAlloc(hHeap, HEAP_ZERO_MEMORY, max * sizeof(BATCH_RES))))
+        return FALSE;
+
+    for (PTSTR line = psz, end = psz + cch, next; line < end; line = next) {
+        next = line + lstrlen(line) + 1; // before line is split in place
+        while (*line == TEXT(' ') || *line == TEXT('\t')) ++line;
+        if (!*line || *line == TEXT('#'))
+            continue;
+        JOB* pj = &pb->pj[pb->cnt++];
+        pj->pszArgs = PathGetArgs(line);
+        pj->pszName = line;
+        PathRemoveArgs(line);
+        PathUnquoteSpaces(line);
+    }
+
+    return TRUE;
+}
+
+
+// finds or makes resolution for the job script
+BATCH_RES* get_batch_res(BATCH* pb, PCTSTR pszName)
+{
+    for (int i = 0; i < pb->cntRes; ++i)
+        if (!StrCmpI(pb->pr[i].pszName, pszName))
+            return &pb->pr[i];
+
+    BATCH_RES* pr = &pb->pr[pb->cntRes++];
+    pr->pszName = pszName;
+    pr->r.szScript[0] = pr->r.szShellCmd[0] = TEXT('\0');
+    if (!(pr->dwErrorCode = shebang_resolve(&pb->sb, &pr->r, pszName))) {
+        TCHAR szVars[1024];
+        if (!shebang_env(&pb->sb, &pr->r, ARRAY(szVars)))
+            pr->dwErrorCode = ERROR_INSUFFICIENT_BUFFER;
+        else if (!(pr->pszEnvBlock = shebang_env_block(pb->pszEnvStrings, szVars)))
+            pr->dwErrorCode = ERROR_NOT_ENOUGH_MEMORY;
+    }
+    return pr;
+}
+
+
+// starts job shell, capturing its output if asked to; returns error code
+DWORD start_job(BATCH* pb, JOB* pj, BOOL ordered)
+{
+    BATCH_RES* pr = get_batch_res(pb, pj->pszName);
+    if (pr->dwErrorCode)
+        return pr->dwErrorCode;
+
+    // command line
+    HANDLE hHeap = GetProcessHeap();
+    size_t cchCmdLine = shebang_cmdline(NULL, &pr->r, pj->pszArgs);
+    if (cchCmdLine > 32767) // max
+        return ERROR_FILENAME_EXCED_RANGE;
+    PTSTR pszCmdLine = HeapAlloc(hHeap, 0, cchCmdLine * sizeof(TCHAR));
+    if (!pszCmdLine)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    shebang_cmdline(pszCmdLine, &pr->r, pj->pszArgs);
+
+    // stdout and stderr go to a temporary file, only the child's copy is
+    // inheritable: no other job may get it
+    STARTUPINFO si = { .cb = sizeof(STARTUPINFO) };
+    HANDLE hChild = NULL;
+    if (ordered) {
+        TCHAR szDir[MAX_PATH], szFile[MAX_PATH];
+        if (!GetTempPath(COUNT(szDir), szDir)
+            || !GetTempFileName(szDir, TEXT("sb"), 0, szFile))
+            return GetLastError();
+        pj->hOutput = CreateFile(szFile, GENERIC_READ | GENERIC_WRITE,
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, CREATE_ALWAYS,
+            FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+        if (pj->hOutput == INVALID_HANDLE_VALUE) {
+            pj->hOutput = NULL;
+            return GetLastError();
+        }
+        if (!DuplicateHandle(GetCurrentProcess(), pj->hOutput, GetCurrentProcess(),
+            &hChild, 0, TRUE, DUPLICATE_SAME_ACCESS))
+            return GetLastError();
+        si.dwFlags = STARTF_USESTDHANDLES;
+        si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+        si.hStdOutput = si.hStdError = hChild;
+    }
+
+    PROCESS_INFORMATION pi;
+#ifdef UNICODE
+    DWORD dwFlags = CREATE_UNICODE_ENVIRONMENT;
+#else
+    DWORD dwFlags = 0;
+#endif // UNICODE
+    QueryPerformanceCounter(&pj->tStart);
+    BOOL ok = CreateProcess(NULL, pszCmdLine, NULL, NULL, ordered, dwFlags,
+        pr->pszEnvBlock, NULL, &si, &pi);
+    DWORD dwErrorCode = ok ? ERROR_SUCCESS : GetLastError();
+    if (hChild)
+        CloseHandle(hChild);
+    HeapFree(hHeap, 0, pszCmdLine);
+    if (!ok)
+        return dwErrorCode;
+
+    CloseHandle(pi.hThread);
+    pj->hProcess = pi.hProcess;
+    pj->spawned = TRUE;
+    return ERROR_SUCCESS;
+}
+
+
+// copies captured job output to our stdout
+void flush_job(JOB* pj)
+{
+    if (!pj->hOutput)
+        return;
+
+    HANDLE hStdOut = GetStdHandle(STD_OUTPUT_HANDLE);
+    char buf[4096];
+    DWORD cb;
+    SetFilePointer(pj->hOutput, 0, NULL, FILE_BEGIN);
+    while (ReadFile(pj->hOutput, buf, sizeof(buf), &cb, NULL) && cb)
+        WriteFile(hStdOut, buf, cb, &cb, NULL);
+    CloseHandle(pj->hOutput); // deletes file
+    pj->hOutput = NULL;
+}
+
+
+// runs "--batch file [-j N] [-o]": jobs from file, at most N at once (number of
+// CPUs by default), -o keeps output in job order; reports exit code and time of
+// each job and returns exit code of the first failed one
+DWORD run_batch(PTSTR pszArgs)
+{
+    TCHAR szFile[MAX_PATH] = TEXT(""), tmp[MAX_PATH];
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    int nJobs = (int)si.dwNumberOfProcessors;
+    BOOL ordered = FALSE;
+    for (BOOL j = FALSE; *pszArgs; pszArgs = PathGetArgs(pszArgs)) {
+        while (*pszArgs == TEXT(' ')) ++pszArgs;
+        StringCchCopy(ARRAY(tmp), pszArgs);
+        PathRemoveArgs(tmp);
+        PathUnquoteSpaces(tmp);
+        if (j) {
+            nJobs = StrToInt(tmp);
+            j = FALSE;
+        } else if (!lstrcmp(tmp, TEXT("-j")))
+            j = TRUE;
+        else if (!lstrcmp(tmp, TEXT("-o")))
+            ordered = TRUE;
+        else if (*tmp)
+            StringCchCopy(ARRAY(szFile), tmp);
+    }
+    if (nJobs < 1)
+        nJobs = 1;
+    if (nJobs > MAXIMUM_WAIT_OBJECTS)
+        nJobs = MAXIMUM_WAIT_OBJECTS;
+
+    // note: no need to free memory and close handles before exit
+    BATCH b = { .pszEnvStrings = get_env_block() };
+    shebang_init(&b.sb);
+    if (!*szFile)
+        print_error_and_exit(ERROR_INVALID_PARAMETER);
+    SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+    if (!read_jobs(&b, szFile))
+        print_error_and_exit(GetLastError());
+
+    // work queue: start jobs in order while there's a free slot
+    HANDLE ah[MAXIMUM_WAIT_OBJECTS];
+    int ai[MAXIMUM_WAIT_OBJECTS];
+    int running = 0, next = 0, flushed = 0;
+    SetConsoleCtrlHandler(stop_batch, TRUE);
+    while ((next < b.cnt && !batchStop) || running) {
+        while (next < b.cnt && running < nJobs && !batchStop) {
+            JOB* pj = &b.pj[next];
+            if ((pj->dwExitCode = start_job(&b, pj, ordered)) != ERROR_SUCCESS) {
+                pj->done = TRUE;
+            } else {
+                ah[running] = pj->hProcess;
+                ai[running++] = next;
+            }
+            ++next;
+        }
+
+        // take any finished one
+        if (running) {
+            DWORD dw = WaitForMultipleObjects((DWORD)running, ah, FALSE, INFINITE);
+            if (dw >= WAIT_OBJECT_0 + (DWORD)running)
+                print_error_and_exit(GetLastError());
+            int k = (int)(dw - WAIT_OBJECT_0);
+            JOB* pj = &b.pj[ai[k]];
+            QueryPerformanceCounter(&pj->tEnd);
+            GetExitCodeProcess(pj->hProcess, &pj->dwExitCode);
+            CloseHandle(pj->hProcess);
+            pj->done = TRUE;
+            ah[k] = ah[--running];
+            ai[k] = ai[running];
+        }
+
+        // output of jobs done so far in order
+        for ( ; flushed < b.cnt && b.pj[flushed].done; ++flushed)
+            flush_job(&b.pj[flushed]);
+    }
+
+    // interrupted: the rest is never started
+    for ( ; next < b.cnt; ++next)
+        b.pj[next].dwExitCode = ERROR_CANCELLED;
+
+    // report: exit code, time in microseconds, script and args
+    HANDLE hStdErr = GetStdHandle(STD_ERROR_HANDLE);
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    DWORD dwResult = ERROR_SUCCESS;
+    for (int i = 0; i < b.cnt; ++i) {
+        JOB* pj = &b.pj[i];
+        TCHAR szLine[1024];
+        int cch = wnsprintf(ARRAY(szLine), TEXT("%-6s %10lu %12lu us  %s %s\r\n"),
+            !pj->spawned ? TEXT("error") : pj->dwExitCode ? TEXT("fail") : TEXT("ok"),
+            pj->dwExitCode, pj->spawned ? (DWORD)((pj->tEnd.QuadPart
+                - pj->tStart.QuadPart) * 1000000 / freq.QuadPart) : 0UL,
+            pj->pszName, pj->pszArgs);
+        if (cch > 0)
+            write_text(hStdErr, szLine, cch);
+        if (!dwResult)
+            dwResult = pj->dwExitCode;
+    }
+
+    return dwResult;
+}
+
+
 // application entry point
 int _tmain(void)
 {
     DWORD dwErrorCode;
+    trace_start();
+
+    // note: no need to free context before exit
+    SHEBANG sb;
+    shebang_init(&sb);
 
 #ifndef UNICODE
     // get rid of OEM codepage
@@ -357,76 +832,131 @@ int _tmain(void)
 #endif // UNICODE
 
     // find our basename
-    TCHAR szName[MAX_PATH];
-    GetModuleFileName(NULL, ARRAY(szName));
+    TCHAR szModule[MAX_PATH], szName[MAX_PATH];
+    GetModuleFileName(NULL, ARRAY(szModule));
+    StringCchCopy(ARRAY(szName), szModule);
     PathStripPath(szName);
     PathRemoveExtension(szName); // note: PathCchRemoveExtension is for Win 8+ only
 
     // check if we're renamed
     if (CompareString(LOCALE_USER_DEFAULT, NORM_IGNORECASE, szName, -1,
         TEXT(PROGRAM_NAME), -1) == CSTR_EQUAL) {
+        // shebang --batch file [-j N] [-o]
+        PTSTR pszArgs = PathGetArgs(GetCommandLine());
+        if (!StrCmpNI(pszArgs, ARRAY1(TEXT("--batch "))))
+            ExitProcess(run_batch(PathGetArgs(pszArgs)));
+
+        // shebang --install name...
+        if (!StrCmpNI(pszArgs, ARRAY1(TEXT("--install ")))) {
+            for (pszArgs = PathGetArgs(pszArgs); *pszArgs;
+                pszArgs = PathGetArgs(pszArgs)) {
+                while (*pszArgs == TEXT(' ')) ++pszArgs;
+                StringCchCopy(ARRAY(szName), pszArgs);
+                PathRemoveArgs(szName);
+                PathUnquoteSpaces(szName);
+                if (*szName && (dwErrorCode = install_copy(&sb, szModule, szName)))
+                    print_error_and_exit(dwErrorCode);
+            }
+            ExitProcess(ERROR_SUCCESS);
+        }
+
         WriteConsole(GetStdHandle(STD_ERROR_HANDLE), ARRAY1(TEXT(
 "Hello Windows(R) world! It\'s me, humble \'" PROGRAM_NAME "\' utility.\n\n"
 "I can help you to execute MSYS/Cygwin shell scripts from your native \'cmd\',\n"
 "but only if you already have it on your PATH.\n\n"
 "All you have to do is to rename or symlink me, so that I match the script you want.\n"
-"And, of course, please, make sure that we\'re both on the PATH too.\n\n"
+"And, of course, please, make sure that we\'re both on the PATH too.\n"
+"Or just run \'" PROGRAM_NAME " --install name\' to make such copy for you.\n"
+"To run many scripts at once, list them in a file and use\n"
+"\'" PROGRAM_NAME " --batch file [-j N] [-o]\'.\n\n"
 "Let\'s do it!\n\n"
             )), &(DWORD){0}, NULL);
         print_error_and_exit(ERROR_CANT_RESOLVE_FILENAME);
     }
 
-    // find POSIX root
-    POSIX px;
-    find_posix(&px);
-    if (px.sys == POSIX_UNKNOWN)
-        print_error_and_exit(ERROR_INVALID_ENVIRONMENT);
-
-    // find matching shell script on PATH
-    if (!PathFindOnPath(szName, NULL))
-        print_error_and_exit(ERROR_FILE_NOT_FOUND);
-
-    // can she bang?
-    TCHAR szShellCmd[MAX_PATH];
-    if (!can_shebang(szName, ARRAY(szShellCmd), &px, &dwErrorCode))
-        print_error_and_exit(dwErrorCode);
-
-    // prepare script name for passing onto the shell
-    PathQuoteSpaces(szName);
-    replace_char(szName, TEXT('/'), TEXT('\\')); // to POSIX separators
-
-    // make command line
-    TCHAR szCmdLine[32768]; // max
-    StringCchCopy(ARRAY(szCmdLine), szShellCmd);    // shell + shebang args
-    StringCchCat(ARRAY(szCmdLine), TEXT(" "));      // space
-    StringCchCat(ARRAY(szCmdLine), szName);         // script
-    PTSTR pszRawArgs = PathGetArgs(GetCommandLine());
-    if (pszRawArgs && *pszRawArgs) {
-        StringCchCat(ARRAY(szCmdLine), TEXT(" "));  // space
-        StringCchCat(ARRAY(szCmdLine), pszRawArgs); // our args
+    // optionally overlap environment setup with script lookup
+    if (get_env(ARRAY1("shebang_prefetch=")))
+        shebang_prefetch(&sb);
+
+    // take resolution embedded by --install, cached or find it out
+    RESOLVED r;
+    CACHE cache;
+    r.px.sys = POSIX_UNKNOWN;
+    r.szScript[0] = r.szShellCmd[0] = TEXT('\0');
+    BOOL embedded = read_trailer(szModule, szName, &r);
+    BOOL cached = !embedded && cache_lookup(&cache, &r, szName);
+    TRACE(TRACE_LOOKUP);
+    TRACE_RESOLVED(&r, embedded ? "trailer" : cached ? "cache" : "resolve");
+    if (!embedded && !cached) {
+        if ((dwErrorCode = resolve_script(&sb, &r, szName)))
+            print_error_and_exit(dwErrorCode);
+        cache_store(&cache, &r);
     }
 
-    // setup POSIX environment
-    setup_posix_env(&px);
-
+    // make command line: count chars, then fill
+    PTSTR pszRawArgs = PathGetArgs(GetCommandLine());
+    size_t cchCmdLine = shebang_cmdline(NULL, &r, pszRawArgs);
+    if (cchCmdLine > 32767) // max
+        print_error_and_exit(ERROR_FILENAME_EXCED_RANGE);
+    PTSTR pszCmdLine = HeapAlloc(GetProcessHeap(), 0, cchCmdLine * sizeof(TCHAR));
+    if (!pszCmdLine)
+        print_error_and_exit(ERROR_NOT_ENOUGH_MEMORY);
+    shebang_cmdline(pszCmdLine, &r, pszRawArgs);
+    TRACE(TRACE_CMDLINE);
+
+    // make environment: POSIX variables, then env shebang assignments
+    TCHAR szVars[1024];
+    if (!shebang_env(&sb, &r, ARRAY(szVars)))
+        print_error_and_exit(ERROR_INSUFFICIENT_BUFFER);
+    // note: no need to free environment blocks before exit
+    PTSTR pszEnvBlock = shebang_env_block(get_env_block(), szVars);
+    if (!pszEnvBlock)
+        print_error_and_exit(ERROR_NOT_ENOUGH_MEMORY);
+    TRACE(TRACE_ENV);
+
+#if !defined(_WIN32)
+    // POSIX host has exec(): the shell takes our place, so it gets signals and its
+    // exit code goes to our parent as is; trace is written before, while it runs
+    trace_write(ERROR_SUCCESS, STILL_ACTIVE);
+    print_error_and_exit(posix_exec(pszCmdLine, pszEnvBlock));
+#else
     // launch shell
     PROCESS_INFORMATION pi = {0};
-    if (!CreateProcess(NULL, szCmdLine, NULL, NULL, FALSE, 0, NULL, NULL,
+#ifdef UNICODE
+    DWORD dwFlags = CREATE_UNICODE_ENVIRONMENT;
+#else
+    DWORD dwFlags = 0;
+#endif // UNICODE
+    // note: handler routine is not inherited, unlike ignoring CTRL+C
+    SetConsoleCtrlHandler(ignore_ctrl, TRUE);
+    if (!CreateProcess(NULL, pszCmdLine, NULL, NULL, FALSE, dwFlags, pszEnvBlock, NULL,
         &(STARTUPINFO){.cb = sizeof(STARTUPINFO)}, &pi))
         print_error_and_exit(GetLastError());
-
-    // wait for the child and exit
+    TRACE(TRACE_SPAWN);
+
+    // there is no exec() in Win32, so stay as small as possible while waiting:
+    // drop what the shell doesn't need and give our pages back
+    HANDLE hHeap = GetProcessHeap();
+    CloseHandle(pi.hThread);
+    HeapFree(hHeap, 0, pszCmdLine);
+    HeapFree(hHeap, 0, pszEnvBlock);
+    HeapCompact(hHeap, 0);
+    SetProcessWorkingSetSize(GetCurrentProcess(), (SIZE_T)-1, (SIZE_T)-1);
+
+    // wait for the child and exit with its code
     WaitForSingleObject(pi.hProcess, INFINITE);
     GetExitCodeProcess(pi.hProcess, &dwErrorCode);
+    TRACE(TRACE_WAIT);
+    trace_write(ERROR_SUCCESS, dwErrorCode);
     // no need to close handles before exit
     //CloseHandle(pi.hProcess);
-    //CloseHandle(pi.hThread);
     return (int)dwErrorCode;
+#endif // _WIN32
 }
 
 
 // micro CRT startup code
-#if __has_include("nocrt0c.c")
+#if defined(_WIN32) && __has_include("nocrt0c.c")
 #define ARGV none
 #include "nocrt0c.c"
 #endif
@@ -0,0 +1,101 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Micro-benchmark timing and corpus files for tests run on Linux
+ * Note: Output is one line per benchmark, tab separated: name, calls, ns per call
+ *       and MB/s ('-' if no bytes); lines starting with '#' are comments
+ */
+
+
+#ifndef TESTS_BENCH_H
+#define TESTS_BENCH_H
+
+#include "util.h"
+#include <ctype.h>
+
+
+// corpus: lines of a text file, but comments starting with '# '; '\n', '\r', '\t'
+// and '\xHH' escapes allow any byte but NUL, other backslashes are literal
+typedef struct {
+    char** line;    // NUL-terminated lines
+    size_t* cch;    // their lengths
+    size_t cnt;     // number of lines
+    size_t cb;      // total length
+} CORPUS;
+
+
+// appends lines of a corpus file, unescaping them
+static inline void read_corpus(CORPUS* pc, const char* path)
+{
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        exit(1);
+    }
+
+    char buf[65536];
+    while (fgets(buf, sizeof(buf), f)) {
+        if (buf[0] == '#' && buf[1] == ' ')
+            continue;
+        size_t j = 0;
+        for (size_t i = 0; buf[i] && buf[i] != '\n'; ++i) {
+            unsigned x = 0;
+            if (buf[i] != '\\') {
+                buf[j++] = buf[i];
+            } else if (buf[i + 1] == 'n' || buf[i + 1] == 'r' || buf[i + 1] == 't') {
+                buf[j++] = (buf[++i] == 'n') ? '\n' : (buf[i] == 'r') ? '\r' : '\t';
+            } else if (buf[i + 1] == 'x' && isxdigit((unsigned char)buf[i + 2])
+                && isxdigit((unsigned char)buf[i + 3])
+                && sscanf(buf + i + 2, "%2x", &x) == 1 && x) {
+                buf[j++] = (char)x;
+                i += 3;
+            } else {
+                buf[j++] = buf[i];
+            }
+        }
+        buf[j] = '\0';
+        pc->line = realloc(pc->line, (pc->cnt + 1) * sizeof(char*));
+        pc->cch = realloc(pc->cch, (pc->cnt + 1) * sizeof(size_t));
+        pc->line[pc->cnt] = strdup(buf);
+        pc->cch[pc->cnt++] = j;
+        pc->cb += j;
+    }
+    fclose(f);
+}
+
+
+// runs body for at least BENCH_MS milliseconds (default 200) and prints result;
+// body is one round of calls passing over bytes
+typedef void (*BENCH_BODY)(void* pv);
+static volatile size_t bench_sink;  // results go here to stay alive
+static inline void bench(const char* name, BENCH_BODY body, void* pv, size_t calls,
+    size_t bytes)
+{
+    static int header;
+    if (!header++)
+        printf("# name\tcalls\tns/call\tMB/s\n");
+
+    if (!calls) {
+        printf("%s\t0\t-\t-\n", name);
+        return;
+    }
+
+    const char* ms = getenv("BENCH_MS");
+    double limit = (ms ? atof(ms) : 200) * 1e6, t0, t;
+    size_t rounds = 0;
+    body(pv); // warm up
+    t0 = now_ns();
+    do {
+        body(pv);
+        ++rounds;
+    } while ((t = now_ns() - t0) < limit);
+
+    printf("%s\t%zu\t%.1f\t", name, rounds * calls, t / (double)(rounds * calls));
+    if (bytes)
+        printf("%.1f\n", (double)(rounds * bytes) * 1e3 / t);
+    else
+        printf("-\n");
+    fflush(stdout);
+}
+
+#endif // TESTS_BENCH_H
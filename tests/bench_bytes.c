@@ -0,0 +1,160 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Micro-benchmarks of byte kernels on short random strings, on the same strings
+ *       ending at a page end and on 4K buffers
+ * Note: Built three times: with SSE2 (as by default), with -mavx2 and with -DNOSIMD;
+ *       strings are 8 to 64 bytes long at random alignments, as paths and shebang
+ *       lines are; next to a page end vector loads give way to the byte loops
+ */
+
+
+#include "bench.h"
+#include <sys/mman.h>
+#include "../libshebang.c"
+
+
+#define STRINGS     256
+#define LONG        4096
+
+#if defined(NOSIMD)
+#define VARIANT     "scalar"
+#elif defined(__AVX2__)
+#define VARIANT     "avx2"
+#else
+#define VARIANT     "sse2"
+#endif // NOSIMD
+
+// set of strings: copies to compare with and total length
+typedef struct {
+    char* psz[STRINGS];
+    char* pszCopy[STRINGS];
+    size_t cch[STRINGS];
+    size_t cb;
+} STRINGS_SET;
+static STRINGS_SET shorts, ends, longs;
+
+
+// compare_bytes() of equal strings
+static void run_compare(void* pv)
+{
+    STRINGS_SET* ps = pv;
+    for (int i = 0; i < STRINGS; ++i)
+        bench_sink += (size_t)compare_bytes(ps->psz[i], ps->pszCopy[i], ps->cch[i]);
+}
+
+
+// find_eol() over strings with no line end
+static void run_find_eol(void* pv)
+{
+    STRINGS_SET* ps = pv;
+    for (int i = 0; i < STRINGS; ++i)
+        bench_sink += find_eol(ps->psz[i], ps->cch[i]);
+}
+
+
+// replace_byte() over strings, back and forth
+static void run_replace_byte(void* pv)
+{
+    STRINGS_SET* ps = pv;
+    for (int i = 0; i < STRINGS; ++i) {
+        replace_byte(ps->psz[i], ps->cch[i], '\\', '/');
+        replace_byte(ps->psz[i], ps->cch[i], '/', '\\');
+    }
+}
+
+
+// replace_char() over strings, back and forth
+static void run_replace_char(void* pv)
+{
+    STRINGS_SET* ps = pv;
+    for (int i = 0; i < STRINGS; ++i) {
+        replace_char(ps->psz[i], '\\', '/');
+        replace_char(ps->psz[i], '/', '\\');
+    }
+}
+
+
+// fills string of path chars
+static void fill_path(char* psz, size_t cch)
+{
+    for (size_t i = 0; i < cch; ++i)
+        psz[i] = (i % 6 == 0) ? '/' : (char)('a' + rand() % 26);
+    psz[cch] = '\0';
+}
+
+
+// makes set of strings at given places
+static void make_set(STRINGS_SET* ps, char* (*place)(int i, size_t cch), size_t cchMin,
+    size_t cchMax)
+{
+    for (int i = 0; i < STRINGS; ++i) {
+        size_t cch = cchMin + (size_t)rand() % (cchMax - cchMin + 1);
+        ps->psz[i] = place(i, cch);
+        fill_path(ps->psz[i], cch);
+        ps->pszCopy[i] = strdup(ps->psz[i]);
+        ps->cch[i] = cch;
+        ps->cb += cch;
+    }
+}
+
+
+// string at random alignment
+static char* place_heap(int i, size_t cch)
+{
+    (void)i;
+    return (char*)malloc(cch + 64) + rand() % 64;
+}
+
+
+// string ending at a page followed by an unmapped one
+static char* place_page_end(int i, size_t cch)
+{
+    static char* pc;
+    static long cbPage;
+    if (!pc) {
+        cbPage = sysconf(_SC_PAGESIZE);
+        pc = mmap(NULL, 2 * STRINGS * cbPage, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        for (int k = 0; k < STRINGS; ++k)
+            mprotect(pc + (2 * k + 1) * cbPage, cbPage, PROT_NONE);
+    }
+    return pc + (2 * i + 1) * cbPage - cch - 1;
+}
+
+
+int main(void)
+{
+    static const struct {
+        const char* name;
+        STRINGS_SET* ps;
+    } sets[] = { { "short", &shorts }, { "page_end", &ends }, { "4k", &longs } };
+    static const struct {
+        const char* name;
+        BENCH_BODY body;
+        int passes;
+    } runs[] = {
+        { "compare_bytes", run_compare, 1 }, { "find_eol", run_find_eol, 1 },
+        { "replace_byte", run_replace_byte, 2 }, { "replace_char", run_replace_char, 2 }
+    };
+    char name[64];
+#if defined(__AVX2__)
+    if (!__builtin_cpu_supports("avx2")) {
+        printf("# no AVX2\n");
+        return 0;
+    }
+#endif // __AVX2__
+
+    srand(2014);
+    make_set(&shorts, place_heap, 8, 64);
+    make_set(&ends, place_page_end, 8, 64);
+    make_set(&longs, place_heap, LONG, LONG);
+
+    for (int r = 0; r < (int)COUNT(runs); ++r)
+        for (int s = 0; s < (int)COUNT(sets); ++s) {
+            snprintf(ARRAY(name), "%s/%s/" VARIANT, runs[r].name, sets[s].name);
+            bench(name, runs[r].body, sets[s].ps, STRINGS,
+                runs[r].passes * sets[s].ps->cb);
+        }
+    return 0;
+}
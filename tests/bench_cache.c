@@ -0,0 +1,80 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Micro-benchmarks of resolution cache: lookup that hits against the full
+ *       resolution it saves
+ * Note: PATH is 100 entries of 100 files each before the MSYS root, as on a loaded
+ *       developer box
+ */
+
+
+#include "bench.h"
+#define main shebang_main
+#include "../shebang.c"
+#undef main
+#include "../libshebang.c"
+
+
+#define DIRS        100
+#define FILES       100
+
+
+// full resolution, as on cache miss
+static void run_resolve(void* pv)
+{
+    SHEBANG sb;
+    RESOLVED r;
+    shebang_init(&sb);
+    bench_sink += resolve_script(&sb, &r, pv);
+    shebang_free(&sb);
+}
+
+
+// cache lookup, with the cache file opened and mapped each time as by launcher
+static void run_lookup(void* pv)
+{
+    CACHE c;
+    RESOLVED r;
+    bench_sink += cache_lookup(&c, &r, pv);
+    UnmapViewOfFile(c.bucket);
+    CloseHandle(c.hFile);
+}
+
+
+int main(void)
+{
+    char path[PATH_MAX];
+    static char szPATH[DIRS * 64];
+    size_t cch = 0;
+    make_tree();
+
+    for (int d = 0; d < DIRS; ++d) {
+        for (int f = 0; f < FILES; ++f)
+            make_file(tree_path(ARRAY(path), "f%d/f%05d.exe", d, f), "", 0644);
+        cch += (size_t)snprintf(szPATH + cch, sizeof(szPATH) - cch, "%s/f%d:",
+            szTree, d);
+    }
+    make_file(tree_path(ARRAY(path), "msys64/usr/bin/bash.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "scripts/script"), "#!/bin/bash -e\n", 0755);
+    snprintf(szPATH + cch, sizeof(szPATH) - cch, "%s/msys64/usr/bin:%s/scripts",
+        szTree, szTree);
+    setenv("PATH", szPATH, 1);
+    unsetenv("SHEBANG_SUBST");
+
+    // store once for lookups to hit
+    CACHE c;
+    RESOLVED r;
+    SHEBANG sb;
+    shebang_init(&sb);
+    if (cache_lookup(&c, &r, "script")
+        || resolve_script(&sb, &r, "script") != ERROR_SUCCESS) {
+        fprintf(stderr, "setup failed\n");
+        return 1;
+    }
+    cache_store(&c, &r);
+    shebang_free(&sb);
+
+    bench("resolve", run_resolve, "script", 1, 0);
+    bench("cache_lookup", run_lookup, "script", 1, 0);
+    return 0;
+}
@@ -0,0 +1,72 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Micro-benchmarks of command line building: quoting args, appending
+ *       shebang args and the whole line of shell, script and raw args
+ * Note: Args are the command lines of corpus/parse_args.txt
+ */
+
+
+#include "bench.h"
+#include "../libshebang.c"
+
+
+static CORPUS cmds;
+static RESOLVED r = {
+    .szScript = "C:\\msys64\\home\\user\\bin\\script",
+    .szShellCmd = "C:\\msys64\\usr\\bin\\bash.exe -e"
+};
+static char* pszRawArgs;
+static size_t cchRawArgs;
+
+
+// quote_arg() over each command line as a single arg
+static void run_quote_arg(void* pv)
+{
+    char buf[16384];
+    (void)pv;
+    for (size_t i = 0; i < cmds.cnt; ++i)
+        bench_sink += quote_arg(buf, cmds.line[i], cmds.cch[i]);
+}
+
+
+// append_utf8_args() of each command line as shebang args
+static void run_append_utf8_args(void* pv)
+{
+    char buf[MAX_PATH];
+    (void)pv;
+    for (size_t i = 0; i < cmds.cnt; ++i) {
+        strcpy(buf, "sh");
+        bench_sink += append_utf8_args(ARRAY(buf), cmds.line[i]);
+    }
+}
+
+
+// shebang_cmdline(): count, then fill, as the launcher does
+static void run_shebang_cmdline(void* pv)
+{
+    static char buf[32768];
+    (void)pv;
+    size_t cch = shebang_cmdline(NULL, &r, pszRawArgs);
+    bench_sink += shebang_cmdline(cch <= COUNT(buf) ? buf : NULL, &r, pszRawArgs);
+}
+
+
+int main(void)
+{
+    read_corpus(&cmds, "corpus/parse_args.txt");
+
+    // raw args: corpus lines joined up to about 30K chars
+    pszRawArgs = malloc(32768);
+    pszRawArgs[0] = '\0';
+    for (size_t i = 0; cchRawArgs + cmds.cch[i % cmds.cnt] + 2 < 30000; ++i) {
+        strcat(pszRawArgs + cchRawArgs, " ");
+        strcat(pszRawArgs + cchRawArgs, cmds.line[i % cmds.cnt]);
+        cchRawArgs += cmds.cch[i % cmds.cnt] + 1;
+    }
+
+    bench("quote_arg", run_quote_arg, NULL, cmds.cnt, cmds.cb);
+    bench("append_utf8_args", run_append_utf8_args, NULL, cmds.cnt, cmds.cb);
+    bench("shebang_cmdline", run_shebang_cmdline, NULL, 1, 2 * cchRawArgs);
+    return 0;
+}
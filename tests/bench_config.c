@@ -0,0 +1,64 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Micro-benchmarks of shebang.ini: its saved copy loaded, as by every launch,
+ *       against parsing it, as after it changes
+ * Note: Typical shebang.ini is a few lines, large one has 300 of them; runs from
+ *       a copy in the tree, as shebang.ini is next to the executable
+ */
+
+
+#include "bench.h"
+#include "../libshebang.c"
+
+
+// parses shebang.ini
+static void run_parse(void* pv)
+{
+    CONFIG* pc = parse_config(pv);
+    bench_sink += pc->cb;
+    HeapFree(GetProcessHeap(), 0, pc);
+}
+
+
+// loads saved configuration
+static void run_load(void* pv)
+{
+    const CONFIG* pc = load_config();
+    bench_sink += pc->cb;
+    HeapFree(GetProcessHeap(), 0, (CONFIG*)pc);
+    (void)pv;
+}
+
+
+int main(void)
+{
+    static char ini[300 * 64];
+    char path[PATH_MAX], root[PATH_MAX];
+    TCHAR szIni[MAX_PATH];
+    run_from_tree();
+    make_dir(tree_path(ARRAY(path), "msys64"));
+    native(ARRAY(root), path);
+    native(ARRAY(szIni), tree_path(ARRAY(path), "bin/shebang.ini"));
+
+    for (int large = 0; large <= 1; ++large) {
+        size_t cch = (size_t)snprintf(ARRAY(ini), "[posix]\nlayer=ucrt64\nroot=%s\n"
+            "[environment]\nCHERE_INVOKING=1\n[interpreters]\n"
+            "/usr/bin/python=/ucrt64/bin/python3\n", root);
+        for (int i = 0; large && i < 300; ++i)
+            cch += (size_t)snprintf(ini + cch, sizeof(ini) - cch,
+                "/usr/local/bin/tool%03d=/ucrt64/bin/tool%03d\n", i, i);
+        make_file(path, ini, 0644);
+        const CONFIG* pc = load_config(); // saves it
+        if (pc->sys != POSIX_UCRT64) {
+            fprintf(stderr, "bench_config: shebang.ini not parsed\n");
+            return 1;
+        }
+        HeapFree(GetProcessHeap(), 0, (CONFIG*)pc);
+
+        bench(large ? "parse_config/large" : "parse_config", run_parse, szIni, 1,
+            cch);
+        bench(large ? "load_config/large" : "load_config", run_load, NULL, 1, cch);
+    }
+    return 0;
+}
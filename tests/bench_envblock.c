@@ -0,0 +1,74 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Micro-benchmarks of child environment: merging the MSYS variables into the
+ *       current block, and host name saved against looked up
+ * Note: Blocks are sorted, as Win32 keeps them; host lookup is delayed by 5 ms, as
+ *       on a machine with slow DNS
+ */
+
+
+#include "bench.h"
+#include "../libshebang.c"
+
+
+#define HOST_US     5000
+
+static const int sizes[] = { 60, 1000 };
+static const char list[] = "MSYSTEM=UCRT64\0MSYSTEM_PREFIX=/ucrt64\0"
+    "MINGW_PREFIX=/ucrt64\0USER=user\0HOSTNAME=build01\0LANG=C\0";
+
+
+// shebang_env_block() of the block with the list
+static void run_block(void* pv)
+{
+    PTSTR psz = shebang_env_block(pv, list);
+    bench_sink += (size_t)psz[0];
+    HeapFree(GetProcessHeap(), 0, psz);
+}
+
+
+// get_hostname() as every launch does
+static void run_host(void* pv)
+{
+    TCHAR szHost[256];
+    (void)pv;
+    bench_sink += (size_t)get_hostname(ARRAY(szHost));
+}
+
+
+// GetComputerNameEx() alone
+static void run_lookup(void* pv)
+{
+    TCHAR szHost[256];
+    (void)pv;
+    bench_sink += (size_t)GetComputerNameEx(ComputerNameDnsHostname, szHost,
+        &(DWORD){COUNT(szHost)});
+}
+
+
+int main(void)
+{
+    char name[32];
+    make_tree();
+
+    for (int k = 0; k < (int)COUNT(sizes); ++k) {
+        // names spread over the alphabet, so the list lands all over the block
+        size_t cb = (size_t)sizes[k] * 64, cch = 0;
+        char* block = malloc(cb);
+        for (int i = 0; i < sizes[k]; ++i)
+            cch += (size_t)snprintf(block + cch, cb - cch, "%c%c_VAR%04d=value %d",
+                'A' + i * 26 / sizes[k], 'A' + i % 26, i, i) + 1;
+        block[cch++] = '\0';
+
+        snprintf(ARRAY(name), "shebang_env_block/%d", sizes[k]);
+        bench(name, run_block, block, 1, cch);
+        free(block);
+    }
+
+    posixHostDelay = HOST_US;
+    run_host(NULL); // save it
+    bench("get_hostname/saved", run_host, NULL, 1, 0);
+    bench("GetComputerNameEx", run_lookup, NULL, 1, 0);
+    return 0;
+}
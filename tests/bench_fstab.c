@@ -0,0 +1,106 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Micro-benchmarks of fstab mount table: parsing, taking the compiled one and
+ *       longest prefix lookup as the table grows
+ * Note: Mount points are nested /opt/pNN/... paths; lookups are half hits, half
+ *       misses, as from shebang lines
+ */
+
+
+#include "bench.h"
+#include "../libshebang.c"
+
+
+#define LOOKUPS     64
+
+static const int sizes[] = { 16, 256, 4096 };
+static char* from[LOOKUPS];
+
+
+// starts context over the MSYS root
+static void init_msys(SHEBANG* psb)
+{
+    char path[PATH_MAX];
+    shebang_init(psb);
+    psb->px.sys = POSIX_MSYS;
+    native(ARRAY(psb->px.root), tree_path(ARRAY(path), "msys64"));
+}
+
+
+// parse_fstab() from the file
+static void run_parse(void* pv)
+{
+    SHEBANG sb;
+    init_msys(&sb);
+    sb.cntMount = 0; // as load_fstab() does
+    bench_sink += (size_t)parse_fstab(&sb, pv);
+    shebang_free(&sb);
+}
+
+
+// load_fstab() taking the compiled table
+static void run_load(void* pv)
+{
+    SHEBANG sb;
+    (void)pv;
+    init_msys(&sb);
+    bench_sink += (size_t)load_fstab(&sb);
+    shebang_free(&sb);
+}
+
+
+// find_mount() for each path
+static void run_find(void* pv)
+{
+    for (int i = 0; i < LOOKUPS; ++i)
+        bench_sink += (size_t)find_mount(pv, from[i]);
+}
+
+
+int main(void)
+{
+    char path[PATH_MAX], fstab[PATH_MAX], name[32];
+    TCHAR szFstab[MAX_PATH];
+    make_tree();
+    tree_path(ARRAY(fstab), "msys64/etc/fstab");
+    native(ARRAY(szFstab), fstab);
+
+    srand(1);
+    for (int i = 0; i < LOOKUPS; ++i) {
+        snprintf(ARRAY(path), "/%s/p%02d/x/bin/tool", (i % 2) ? "usr" : "opt",
+            rand() % 16);
+        from[i] = strdup(path);
+    }
+
+    for (int k = 0; k < (int)COUNT(sizes); ++k) {
+        // write table; mount points get longer down the file
+        size_t cb = (size_t)sizes[k] * 64, cch = 0;
+        char* buf = malloc(cb);
+        for (int i = 0; i < sizes[k]; ++i)
+            cch += (size_t)snprintf(buf + cch, cb - cch,
+                "C:/tools/t%04d /opt/p%02d%s ntfs binary,noacl 0 0\n", i, i % 32,
+                (i / 32 % 2) ? "/x" : (i / 32 % 3) ? "/x/bin" : "");
+        make_file(fstab, buf, 0644);
+        free(buf);
+
+        // saved table stays until fstab changes
+        SHEBANG sb;
+        init_msys(&sb);
+        if (load_fstab(&sb) != sizes[k]) {
+            fprintf(stderr, "setup failed\n");
+            return 1;
+        }
+        snprintf(ARRAY(name), "parse_fstab/%d", sizes[k]);
+        bench(name, run_parse, szFstab, 1, cch);
+        snprintf(ARRAY(name), "load_fstab/%d", sizes[k]);
+        bench(name, run_load, NULL, 1, 0);
+        snprintf(ARRAY(name), "find_mount/%d", sizes[k]);
+        bench(name, run_find, &sb, LOOKUPS, 0);
+        shebang_free(&sb);
+    }
+
+    for (int i = 0; i < LOOKUPS; ++i)
+        free(from[i]);
+    return 0;
+}
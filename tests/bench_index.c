@@ -0,0 +1,75 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Micro-benchmarks of script lookup on a long PATH with persistent index, or
+ *       without it when built with -DNOINDEX
+ * Note: PATH is 100 directories of 20 files each, script in the last one; "slow"
+ *       rows add 20 us to every file system query, as on a network share
+ */
+
+
+#include "bench.h"
+#include "../libshebang.c"
+
+
+#define DIRS        100
+#define FILES       20
+#define SLOW_US     20
+
+#ifdef NOINDEX
+#define VARIANT     "noindex"
+#else
+#define VARIANT     "index"
+#endif // NOINDEX
+
+
+// resolution as done by every launch
+static void run_resolve(void* pv)
+{
+    SHEBANG sb;
+    RESOLVED r;
+    shebang_init(&sb);
+    bench_sink += shebang_resolve(&sb, &r, pv);
+    shebang_free(&sb);
+}
+
+
+// prints file system queries per launch
+static void count_stats(const char* name)
+{
+    LONG cnt = posixStatCount;
+    for (int i = 0; i < 100; ++i)
+        run_resolve("script");
+    printf("# %s: %.1f stats per call\n", name, (posixStatCount - cnt) / 100.0);
+}
+
+
+int main(void)
+{
+    static char szPATH[DIRS * 64 + 2 * PATH_MAX];
+    char path[PATH_MAX];
+    size_t cch = 0;
+    make_tree();
+
+    for (int d = 0; d < DIRS; ++d) {
+        for (int f = 0; f < FILES; ++f)
+            make_file(tree_path(ARRAY(path), "d%03d/f%02d.exe", d, f), "", 0755);
+        cch += (size_t)snprintf(szPATH + cch, sizeof(szPATH) - cch, "%s/d%03d:",
+            szTree, d);
+    }
+    make_file(tree_path(ARRAY(path), "msys64/usr/bin/bash.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "d%03d/script", DIRS - 1), "#!/bin/bash\n",
+        0755);
+    snprintf(szPATH + cch, sizeof(szPATH) - cch, "%s/msys64/usr/bin:/usr/bin:/bin",
+        szTree);
+    setenv("PATH", szPATH, 1);
+    unsetenv("SHEBANG_SUBST");
+    unsetenv("SHEBANG_PROBE");
+    run_resolve("script"); // index it
+
+    bench("resolve/" VARIANT, run_resolve, "script", 1, 0);
+    count_stats("resolve/" VARIANT);
+    posixStatDelay = SLOW_US;
+    bench("resolve/" VARIANT "/slow", run_resolve, "script", 1, 0);
+    return 0;
+}
@@ -0,0 +1,65 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Micro-benchmarks of PATH longer than 32K chars: tokenizing it, and finding
+ *       script at its end
+ * Note: PATH is 1000 filler entries, some quoted or empty, then MSYS root and script
+ */
+
+
+#include "bench.h"
+#include "../libshebang.c"
+
+
+#define FILLERS     1000
+
+static PCTSTR pszPATH;
+static size_t cchPATH;
+
+
+// next_path() over whole PATH
+static void run_next_path(void* pv)
+{
+    PCTSTR pszEntry;
+    (void)pv;
+    for (PCTSTR psz = pszPATH; next_path(&psz, &pszEntry); )
+        bench_sink += (size_t)*pszEntry;
+}
+
+
+// shebang_find() through fresh context, as by launcher
+static void run_find(void* pv)
+{
+    SHEBANG sb;
+    RESOLVED r;
+    shebang_init(&sb);
+    bench_sink += shebang_find(&sb, &r, pv);
+    shebang_free(&sb);
+}
+
+
+int main(void)
+{
+    char path[PATH_MAX];
+    make_tree();
+
+    make_file(tree_path(ARRAY(path), "msys64/usr/bin/sh.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "scripts/script"), "#!/bin/sh\n", 0755);
+    size_t cb = FILLERS * 64 + 3 * PATH_MAX, cch = 0;
+    char* psz = malloc(cb);
+    for (int i = 0; i < FILLERS; ++i) {
+        cch += (size_t)snprintf(psz + cch, cb - cch, (i % 10) ? "%s/filler/%05d:"
+            : "\"%s/filler dir/%05d\"::", szTree, i);
+        if (i % 2)
+            make_dir(tree_path(ARRAY(path), "filler/%05d", i));
+    }
+    snprintf(psz + cch, cb - cch, "%s/msys64/usr/bin:%s/scripts", szTree, szTree);
+    setenv("PATH", psz, 1);
+    free(psz);
+    pszPATH = get_env(ARRAY1("path="));
+    cchPATH = strlen(pszPATH);
+
+    bench("next_path", run_next_path, NULL, FILLERS + 2, cchPATH);
+    bench("shebang_find", run_find, "script", 1, cchPATH);
+    return 0;
+}
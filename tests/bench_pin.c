@@ -0,0 +1,81 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Micro-benchmarks of resolution by the generic build, which finds UCRT64 root
+ *       on PATH, or by the one pinned to it when built with -DPIN_LAYER=ucrt64
+ * Note: Both builds take the root from -DPIN_ROOT="C:/dir"; PATH is a typical
+ *       developer one with the script directory, then the MSYS2 ones at the end
+ */
+
+
+#include "bench.h"
+#include "../libshebang.c"
+
+
+#if defined(PIN_LAYER)
+#define VARIANT     "pinned"
+#else
+#define VARIANT     "generic"
+#endif // PIN_LAYER
+
+static const char* const dirs[] = {
+    "Windows/system32", "Windows", "Windows/System32/Wbem",
+    "Windows/System32/WindowsPowerShell/v1.0", "Program Files/Git/cmd",
+    "Program Files/nodejs", "Users/user/AppData/Local/Programs/Python/Python312",
+    "Users/user/AppData/Local/Microsoft/WindowsApps", "Users/user/.cargo/bin",
+    "Users/user/bin"
+};
+static RESOLVED r;
+
+
+// resolution as done by every launch
+static void run_resolve(void* pv)
+{
+    SHEBANG sb;
+    shebang_init(&sb);
+    bench_sink += shebang_resolve(&sb, &r, pv);
+    shebang_free(&sb);
+}
+
+
+int main(void)
+{
+    static char szPATH[COUNT(dirs) * PATH_MAX + 2 * PATH_MAX];
+    const char* root = PIN_ROOT + COUNT1("C:"); // as native() makes it
+    char path[2 * PATH_MAX];
+    size_t cch = 0;
+    make_tree();
+
+    // root at fixed place, the rest in the tree
+    snprintf(ARRAY(path), "%s/ucrt64/bin/bash.exe", root);
+    make_file(path, "", 0755);
+    snprintf(ARRAY(path), "%s/usr/bin/bash.exe", root);
+    make_file(path, "", 0755);
+    for (int i = 0; i < (int)COUNT(dirs); ++i) {
+        make_dir(tree_path(ARRAY(path), "%s", dirs[i]));
+        cch += (size_t)snprintf(szPATH + cch, sizeof(szPATH) - cch, "%s:", path);
+    }
+    make_file(tree_path(ARRAY(path), "Users/user/bin/script"), "#!/bin/bash -e\n",
+        0755);
+    snprintf(szPATH + cch, sizeof(szPATH) - cch, "%s/ucrt64/bin:%s/usr/bin", root,
+        root);
+    setenv("PATH", szPATH, 1);
+    unsetenv("SHEBANG_SUBST");
+    unsetenv("SHEBANG_PROBE");
+
+    // both must resolve the same
+    run_resolve("script");
+    printf("# %s: %s\n", VARIANT, r.szShellCmd);
+    if (bench_sink || r.px.sys != POSIX_UCRT64) {
+        fprintf(stderr, "bench_pin: script not resolved to UCRT64\n");
+        return 1;
+    }
+
+    bench("resolve/" VARIANT, run_resolve, "script", 1, 0);
+    LONG cnt = posixStatCount;
+    for (int i = 0; i < 100; ++i)
+        run_resolve("script");
+    printf("# resolve/%s: %.1f stats per call\n", VARIANT,
+        (posixStatCount - cnt) / 100.0);
+    return 0;
+}
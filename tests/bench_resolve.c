@@ -0,0 +1,163 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Micro-benchmarks of resolution steps: shebang line, path conversion, byte
+ *       kernels and command line parsing
+ * Note: Inputs are corpus files in corpus/
+ */
+
+
+#include "bench.h"
+#include "../libshebang.c"
+#include <tchar.h>
+#include "parse_args.h"
+#include "ref_argv.h"
+
+
+static CORPUS lines, paths, cmds;
+static SHEBANG sb;
+static char* pcBig1;
+static char* pcBig2;
+static char* pcLong;
+
+#define BIG     65536
+
+
+// parse_line() over shebang lines
+static void run_parse_line(void* pv)
+{
+    char buf[4096];
+    const char* pc1;
+    const char* pc2;
+    (void)pv;
+    for (size_t i = 0; i < lines.cnt; ++i) {
+        memcpy(buf, lines.line[i], lines.cch[i]);
+        bench_sink += parse_line(buf, lines.cch[i], &pc1, &pc2);
+    }
+}
+
+
+// convert_path() over POSIX paths
+static void run_convert_path(void* pv)
+{
+    TCHAR sz[MAX_PATH];
+    (void)pv;
+    for (size_t i = 0; i < paths.cnt; ++i)
+        bench_sink += convert_path(ARRAY(sz), &sb, paths.line[i]);
+}
+
+
+// compare_bytes() over equal buffers
+static void run_compare_bytes(void* pv)
+{
+    (void)pv;
+    bench_sink += (size_t)compare_bytes(pcBig1, pcBig2, BIG);
+}
+
+
+// find_eol() over a buffer with no line end
+static void run_find_eol(void* pv)
+{
+    (void)pv;
+    bench_sink += find_eol(pcBig1, BIG);
+}
+
+
+// replace_byte() over a buffer, back and forth
+static void run_replace_byte(void* pv)
+{
+    (void)pv;
+    replace_byte(pcBig2, BIG, 'y', 'x');
+    replace_byte(pcBig2, BIG, 'x', 'y');
+}
+
+
+// replace_char() over paths
+static void run_replace_char(void* pv)
+{
+    char buf[4096];
+    (void)pv;
+    for (size_t i = 0; i < paths.cnt; ++i) {
+        memcpy(buf, paths.line[i], paths.cch[i] + 1);
+        replace_char(buf, '\\', '/');
+        bench_sink += (size_t)buf[0];
+    }
+}
+
+
+// parse_args() over command lines
+static void run_parse_args(void* pv)
+{
+    char* argv[4096];
+    char buf[8192];
+    (void)pv;
+    for (size_t i = 0; i < cmds.cnt; ++i)
+        bench_sink += (size_t)parse_args(cmds.line[i], argv, buf);
+}
+
+
+// parse_args() over a command line near the 32K limit
+static void run_parse_long(void* pv)
+{
+    static char* argv[ARGV_MAX(32768)];
+    static char buf[CHARS_MAX(32768)];
+    (void)pv;
+    bench_sink += (size_t)parse_args(pcLong, argv, buf);
+}
+
+
+// ref_parse_args() over command lines, for comparison
+static void run_ref_parse_args(void* pv)
+{
+    char* argv[4096];
+    char buf[8192];
+    (void)pv;
+    for (size_t i = 0; i < cmds.cnt; ++i)
+        bench_sink += (size_t)ref_parse_args(cmds.line[i], argv, buf);
+}
+
+
+int main(void)
+{
+    char path[PATH_MAX], tmp[2 * PATH_MAX];
+    make_tree();
+
+    // the same tree as fuzz_convert_path.c
+    make_file(tree_path(ARRAY(path), "msys64/usr/bin/sh.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "msys64/usr/bin/env"), "", 0755);
+    make_file(tree_path(ARRAY(path), "msys64/my dir/x.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "tools/bin/sh.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "c/sh.exe"), "", 0755);
+    snprintf(tmp, sizeof(tmp), "%s\\tools /opt/tool ntfs binary 0 0\n",
+        native(ARRAY(path), szTree));
+    make_file(tree_path(ARRAY(path), "msys64/etc/fstab"), tmp, 0644);
+    shebang_init(&sb);
+    sb.px.sys = POSIX_MSYS;
+    native(ARRAY(sb.px.root), tree_path(ARRAY(path), "msys64"));
+
+    read_corpus(&lines, "corpus/parse_line.txt");
+    read_corpus(&paths, "corpus/convert_path.txt");
+    read_corpus(&cmds, "corpus/parse_args.txt");
+    pcBig1 = malloc(BIG);
+    pcBig2 = malloc(BIG);
+    memset(pcBig1, 'x', BIG);
+    memset(pcBig2, 'x', BIG);
+    pcLong = malloc(32768);
+    size_t cch = (size_t)snprintf(pcLong, 32768, "\"C:\\Program Files\\prog.exe\"");
+    while (cch < 32768 - 64)
+        cch += (size_t)snprintf(pcLong + cch, 32768 - cch,
+            " C:\\dir\\file%zu.txt \"with blank\" a\\\\\\\"b", cch);
+
+    bench("parse_line", run_parse_line, NULL, lines.cnt, lines.cb);
+    bench("convert_path", run_convert_path, NULL, paths.cnt, paths.cb);
+    bench("compare_bytes", run_compare_bytes, NULL, 1, BIG);
+    bench("find_eol", run_find_eol, NULL, 1, BIG);
+    bench("replace_byte", run_replace_byte, NULL, 2, 2 * BIG);
+    bench("replace_char", run_replace_char, NULL, paths.cnt, paths.cb);
+    bench("parse_args", run_parse_args, NULL, cmds.cnt, cmds.cb);
+    bench("ref_parse_args", run_ref_parse_args, NULL, cmds.cnt, cmds.cb);
+    bench("parse_args/32K", run_parse_long, NULL, 1, strlen(pcLong));
+
+    shebang_free(&sb);
+    return 0;
+}
@@ -0,0 +1,69 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Micro-benchmarks of PATH entry classification: single backward pass
+ *       against the glob patterns it replaced
+ * Note: Entries are a typical developer PATH with MSYS2 ones at the end
+ */
+
+
+#include "bench.h"
+#include "../libshebang.c"
+
+
+static const char* const entries[] = {
+    "C:\\Windows\\system32", "C:\\Windows", "C:\\Windows\\System32\\Wbem",
+    "C:\\Windows\\System32\\WindowsPowerShell\\v1.0\\",
+    "C:\\Program Files\\Microsoft Visual Studio\\2022\\Community\\VC\\Tools\\MSVC\\"
+        "14.38.33130\\bin\\HostX64\\x64",
+    "C:\\Program Files\\NVIDIA GPU Computing Toolkit\\CUDA\\v12.3\\bin",
+    "C:\\Program Files\\NVIDIA GPU Computing Toolkit\\CUDA\\v12.3\\libnvvp",
+    "C:\\Program Files\\Git\\cmd", "C:\\Program Files\\nodejs\\",
+    "C:\\Users\\user\\AppData\\Local\\Programs\\Python\\Python312\\Scripts\\",
+    "C:\\Users\\user\\AppData\\Local\\Programs\\Python\\Python312\\",
+    "C:\\Users\\user\\AppData\\Local\\Microsoft\\WindowsApps",
+    "C:\\Users\\user\\.cargo\\bin", "C:\\tools\\cygwin64\\usr\\sbin",
+    "C:\\msys64\\ucrt64\\bin", "C:\\msys64\\usr\\bin"
+};
+static size_t cbEntries;
+
+// patterns it replaced, in POSIX_* order
+static const char* const spec[] = {
+    "*\\msys*\\clangarm64\\bin", "*\\msys*\\mingw32\\bin", "*\\msys*\\mingw64\\bin",
+    "*\\msys*\\ucrt64\\bin", "*\\msys*\\clang32\\bin", "*\\msys*\\clang64\\bin",
+    "*\\msys*\\usr\\bin", "*\\cygwin*\\bin"
+};
+
+
+// match_root() over entries
+static void run_match_root(void* pv)
+{
+    size_t cchRoot;
+    (void)pv;
+    for (int i = 0; i < (int)COUNT(entries); ++i)
+        bench_sink += (size_t)match_root(entries[i], strlen(entries[i]), &cchRoot);
+}
+
+
+// PathMatchSpec() against each pattern until one matches
+static void run_match_spec(void* pv)
+{
+    (void)pv;
+    for (int i = 0; i < (int)COUNT(entries); ++i)
+        for (int j = 0; j < (int)COUNT(spec); ++j)
+            if (PathMatchSpec(entries[i], spec[j])) {
+                bench_sink += (size_t)j;
+                break;
+            }
+}
+
+
+int main(void)
+{
+    for (int i = 0; i < (int)COUNT(entries); ++i)
+        cbEntries += strlen(entries[i]);
+
+    bench("match_root", run_match_root, NULL, COUNT(entries), cbEntries);
+    bench("PathMatchSpec", run_match_spec, NULL, COUNT(entries), cbEntries);
+    return 0;
+}
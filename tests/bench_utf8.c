@@ -0,0 +1,87 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Micro-benchmarks of UTF-8 decoding: decode_utf8() against the reference
+ *       decoder on ASCII paths, Cyrillic and CJK text, and concat_with_utf8() as
+ *       the ANSI build calls it
+ * Note: Built three times: with SSE2 (as by default), with -mavx2 and with -DNOSIMD
+ */
+
+
+#include "bench.h"
+#include "../libshebang.c"
+#include "ref_utf8.h"
+
+
+#define CALLS       256
+
+#if defined(NOSIMD)
+#define VARIANT     "scalar"
+#elif defined(__AVX2__)
+#define VARIANT     "avx2"
+#else
+#define VARIANT     "sse2"
+#endif // NOSIMD
+
+static const char* const texts[][2] = {
+    { "ascii", "/c/Program Files/Git/usr/bin/bash.exe --login -i" },
+    { "cyrillic", "/home/\xd0\xbf\xd0\xbe\xd0\xbb\xd1\x8c\xd0\xb7\xd0\xbe\xd0\xb2"
+        "\xd0\xb0\xd1\x82\xd0\xb5\xd0\xbb\xd1\x8c/bin/\xd1\x81\xd0\xba\xd1\x80\xd0"
+        "\xb8\xd0\xbf\xd1\x82" },
+    { "cjk", "/home/\xe7\x94\xa8\xe6\x88\xb7/\xe8\x84\x9a\xe6\x9c\xac/\xe5\xb7\xa5"
+        "\xe5\x85\xb7/\xe6\xb5\x8b\xe8\xaf\x95" }
+};
+
+
+// decode_utf8() of text, CALLS times
+static void run_decode(void* pv)
+{
+    WCHAR pw[MAX_PATH];
+    DWORD dwErrorCode;
+    for (int i = 0; i < CALLS; ++i)
+        bench_sink += decode_utf8(ARRAY(pw), pv, &dwErrorCode);
+}
+
+
+// ref_decode_utf8() of text, CALLS times
+static void run_ref_decode(void* pv)
+{
+    WCHAR pw[MAX_PATH];
+    for (int i = 0; i < CALLS; ++i)
+        bench_sink += ref_decode_utf8(pw, pv);
+}
+
+
+// concat_with_utf8() of text to an empty string, CALLS times
+static void run_concat(void* pv)
+{
+    TCHAR sz[MAX_PATH];
+    for (int i = 0; i < CALLS; ++i) {
+        sz[0] = TEXT('\0');
+        bench_sink += (size_t)concat_with_utf8(ARRAY(sz), pv);
+    }
+}
+
+
+int main(void)
+{
+    char name[64];
+#if defined(__AVX2__)
+    if (!__builtin_cpu_supports("avx2")) {
+        printf("# no AVX2\n");
+        return 0;
+    }
+#endif // __AVX2__
+
+    for (int i = 0; i < (int)COUNT(texts); ++i) {
+        void* pv = (void*)texts[i][1];
+        size_t cb = strlen(texts[i][1]);
+        snprintf(ARRAY(name), "decode_utf8/%s/" VARIANT, texts[i][0]);
+        bench(name, run_decode, pv, CALLS, CALLS * cb);
+        snprintf(ARRAY(name), "ref_decode_utf8/%s/" VARIANT, texts[i][0]);
+        bench(name, run_ref_decode, pv, CALLS, CALLS * cb);
+        snprintf(ARRAY(name), "concat_with_utf8/%s/" VARIANT, texts[i][0]);
+        bench(name, run_concat, pv, CALLS, CALLS * cb);
+    }
+    return 0;
+}
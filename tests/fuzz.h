@@ -0,0 +1,38 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Fuzz harness interface, the same as libFuzzer's
+ * Note: Link a harness with fuzz_main.c or build it with -fsanitize=fuzzer
+ */
+
+
+#ifndef TESTS_FUZZ_H
+#define TESTS_FUZZ_H
+
+#include "util.h"
+#include <stdint.h>
+
+
+// harness entry points: setup once, then called per input
+int LLVMFuzzerInitialize(int* pargc, char*** pargv);
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+
+// aborts on broken invariant, so that driver saves the input
+#define FUZZ_CHECK(cond) \
+    ((cond) ? (void)0 : (fprintf(stderr, "%s:%d: fuzz check failed: %s\n", \
+        __FILE__, __LINE__, #cond), abort()))
+
+
+// makes NUL-terminated copy of input; exactly sized for sanitizers to catch
+// overreads; free() it
+static inline char* fuzz_string(const uint8_t* data, size_t size)
+{
+    char* psz = malloc(size + 1);
+    if (size)
+        memcpy(psz, data, size);
+    psz[size] = '\0';
+    return psz;
+}
+
+#endif // TESTS_FUZZ_H
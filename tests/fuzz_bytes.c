@@ -0,0 +1,66 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Fuzz byte kernels against their obvious loops
+ * Note: Built without ASan, as it turns vector code off; the first input byte
+ *       chooses bytes to look for and the split point
+ */
+
+
+#include "fuzz.h"
+#include "../libshebang.c"
+
+
+int LLVMFuzzerInitialize(int* pargc, char*** pargv)
+{
+    (void)pargc;
+    (void)pargv;
+    return 0;
+}
+
+
+// sign of a number
+static int sign(int i)
+{
+    return (i > 0) - (i < 0);
+}
+
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    if (!size)
+        return 0;
+    unsigned sel = *data++;
+    --size;
+
+    // compare_bytes: halves of input, then input with itself
+    size_t half = size / 2;
+    FUZZ_CHECK(sign(compare_bytes(data, data + half, half))
+        == sign(memcmp(data, data + half, half)));
+    FUZZ_CHECK(compare_bytes(data, data, size) == 0);
+
+    // find_eol
+    size_t eol = 0;
+    while (eol < size && data[eol] && data[eol] != '\r' && data[eol] != '\n')
+        ++eol;
+    FUZZ_CHECK(find_eol((const char*)data, size) == eol);
+
+    // replace_byte: one of the input bytes with selector
+    char* p = malloc(size + 1);
+    char cFrom = size ? (char)data[sel % size] : '\0', cTo = (char)sel;
+    memcpy(p, data, size);
+    replace_byte(p, size, cTo, cFrom);
+    for (size_t i = 0; i < size; ++i)
+        FUZZ_CHECK(p[i] == ((char)data[i] == cFrom ? cTo : (char)data[i]));
+
+    // replace_char: up to the first NUL, as a string
+    memcpy(p, data, size);
+    p[size] = '\0';
+    cTo = cTo ? cTo : '?';
+    replace_char(p, cTo, cFrom);
+    for (size_t i = 0; i < size && data[i]; ++i)
+        FUZZ_CHECK(p[i] == (cFrom && (char)data[i] == cFrom ? cTo : (char)data[i]));
+
+    free(p);
+    return 0;
+}
@@ -0,0 +1,58 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Fuzz convert_path() over a synthetic MSYS tree with fstab mounts
+ * Note: A path converted must exist, have native separators only and be quoted iff
+ *       it has spaces
+ */
+
+
+#include "fuzz.h"
+#include "../libshebang.c"
+
+
+static SHEBANG sb;
+
+
+int LLVMFuzzerInitialize(int* pargc, char*** pargv)
+{
+    char path[PATH_MAX], root[PATH_MAX], tmp[3 * PATH_MAX];
+    (void)pargc;
+    (void)pargv;
+    make_tree();
+
+    make_file(tree_path(ARRAY(path), "msys64/usr/bin/sh.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "msys64/usr/bin/env"), "", 0755);
+    make_file(tree_path(ARRAY(path), "msys64/my dir/x.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "tools/bin/sh.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "c/sh.exe"), "", 0755);
+    snprintf(tmp, sizeof(tmp),
+        "# mounts\n%s\\tools /opt/tool ntfs binary 0 0\n"
+        "%s\\tools\\bin /opt/tool/bin2 ntfs binary 0 0\n"
+        "none /cygdrive cygdrive binary,posix=0,user 0 0\n",
+        native(ARRAY(root), szTree), root);
+    make_file(tree_path(ARRAY(path), "msys64/etc/fstab"), tmp, 0644);
+
+    shebang_init(&sb);
+    sb.px.sys = POSIX_MSYS;
+    native(ARRAY(sb.px.root), tree_path(ARRAY(path), "msys64"));
+    return 0;
+}
+
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    char* from = fuzz_string(data, size);
+    TCHAR sz[MAX_PATH];
+
+    if (convert_path(ARRAY(sz), &sb, from)) {
+        FUZZ_CHECK(strlen(sz) < MAX_PATH && !strchr(sz, '/'));
+        BOOL quoted = (sz[0] == '"');
+        FUZZ_CHECK(quoted == (strchr(sz, ' ') != NULL));
+        PathUnquoteSpaces(sz);
+        FUZZ_CHECK(PathFileExists(sz));
+    }
+
+    free(from);
+    return 0;
+}
@@ -0,0 +1,68 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Fuzz decode_utf8() against the reference decoder
+ * Note: Built without ASan, as it turns vector code off; output is guarded instead,
+ *       with exact, short and roomy sizes
+ */
+
+
+#include "fuzz.h"
+#include "../libshebang.c"
+#include "ref_utf8.h"
+
+
+#define GUARD       40
+
+
+int LLVMFuzzerInitialize(int* pargc, char*** pargv)
+{
+    (void)pargc;
+    (void)pargv;
+    return 0;
+}
+
+
+// decodes into buffer of given size; aborts on write past it
+static size_t decode_guarded(WCHAR* pw, size_t cchTo, const char* src,
+    DWORD* pdwErrorCode)
+{
+    for (size_t i = 0; i < GUARD; ++i)
+        pw[cchTo + i] = 0x5a5a;
+    size_t cch = decode_utf8(pw, cchTo, src, pdwErrorCode);
+    for (size_t i = 0; i < GUARD; ++i)
+        FUZZ_CHECK(pw[cchTo + i] == 0x5a5a);
+    return cch;
+}
+
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    char* src = fuzz_string(data, size);
+    WCHAR* pwRef = malloc((size + 1) * sizeof(WCHAR));
+    WCHAR* pw = malloc((size + 1 + GUARD) * sizeof(WCHAR));
+    DWORD dwErrorCode = ERROR_SUCCESS;
+
+    // roomy buffer: the same as reference, or malformed
+    size_t cchRef = ref_decode_utf8(pwRef, src);
+    size_t cch = decode_guarded(pw, size + 1, src, &dwErrorCode);
+    FUZZ_CHECK(cch == cchRef);
+    if (cchRef) {
+        FUZZ_CHECK(!memcmp(pw, pwRef, cch * sizeof(WCHAR)));
+
+        // exact buffer fits, any shorter one doesn't
+        FUZZ_CHECK(decode_guarded(pw, cchRef, src, &dwErrorCode) == cchRef);
+        FUZZ_CHECK(!memcmp(pw, pwRef, cch * sizeof(WCHAR)));
+        for (size_t n = cchRef - 1; n; n /= 2) {
+            FUZZ_CHECK(!decode_guarded(pw, n, src, &dwErrorCode));
+            FUZZ_CHECK(dwErrorCode == ERROR_INSUFFICIENT_BUFFER);
+        }
+    } else {
+        FUZZ_CHECK(dwErrorCode == ERROR_NO_UNICODE_TRANSLATION);
+    }
+
+    free(pw);
+    free(pwRef);
+    free(src);
+    return 0;
+}
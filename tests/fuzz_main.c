@@ -0,0 +1,195 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Standalone driver for libFuzzer harnesses: corpus lines first, then their
+ *       random mutations
+ * Note: Usage: fuzz_xxx corpus.txt... runs for FUZZ_TIME seconds (default 10) from
+ *       FUZZ_SEED (default time); input that fails is saved as FUZZ_CRASH (default
+ *       ./crash-fuzz_xxx) and replayed by 'fuzz_xxx -x file'
+ */
+
+
+#include "bench.h"
+#include "fuzz.h"
+#include <signal.h>
+
+
+#define FUZZ_MAX       4096
+
+static const char* pszCrash;
+static uint8_t* pbInput;
+static size_t cbInput;
+static unsigned long long ullState;
+static CORPUS corpus;
+
+
+// saves current input, if any; safe in signal handler
+static void save_input(void)
+{
+    int fd = pbInput ? open(pszCrash, O_WRONLY | O_CREAT | O_TRUNC, 0644) : -1;
+    if (fd >= 0) {
+        (void)!write(fd, pbInput, cbInput);
+        close(fd);
+        (void)!write(STDERR_FILENO, "input saved\n", 12);
+    }
+}
+static void on_signal(int sig)
+{
+    save_input();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+#if defined(__SANITIZE_ADDRESS__)
+void __sanitizer_set_death_callback(void (*callback)(void));
+#endif // __SANITIZE_ADDRESS__
+
+
+// xorshift64* PRNG
+static unsigned next_rand(unsigned n)
+{
+    ullState ^= ullState >> 12;
+    ullState ^= ullState << 25;
+    ullState ^= ullState >> 27;
+    return (unsigned)((ullState * 0x2545f4914f6cdd1dULL) >> 32) % (n ? n : 1);
+}
+
+
+// runs harness on exactly sized copy of input
+static void run_one(const uint8_t* data, size_t size)
+{
+    free(pbInput);
+    pbInput = malloc(size ? size : 1);
+    cbInput = size;
+    if (size)
+        memcpy(pbInput, data, size);
+    LLVMFuzzerTestOneInput(pbInput, cbInput);
+}
+
+
+// mutates buffer in place; returns new size
+static size_t mutate(uint8_t* pb, size_t cb, const CORPUS* pc)
+{
+    // bytes meaningful to the parsers under test
+    static const char special[] = " \t\r\n\"\\/:;=#!.-~";
+    static const uint8_t edge[] = { 0x00, 0x7f, 0x80, 0xbf, 0xc0, 0xc2, 0xe0, 0xed,
+        0xef, 0xf0, 0xf4, 0xf5, 0xff };
+
+    for (unsigned k = 1 + next_rand(4); k; --k) {
+        size_t i = next_rand((unsigned)cb + 1), n = 1 + next_rand(16);
+        switch (next_rand(7)) {
+        case 0: // flip bit
+            if (i < cb)
+                pb[i] ^= (uint8_t)(1 << next_rand(8));
+            break;
+        case 1: // special char
+            if (i < cb)
+                pb[i] = (uint8_t)special[next_rand(sizeof(special) - 1)];
+            break;
+        case 2: // edge byte
+            if (i < cb)
+                pb[i] = edge[next_rand(sizeof(edge))];
+            break;
+        case 3: // insert run of a byte
+            if (cb + n <= FUZZ_MAX) {
+                memmove(pb + i + n, pb + i, cb - i);
+                memset(pb + i, next_rand(2) ? special[next_rand(sizeof(special) - 1)]
+                    : (int)next_rand(256), n);
+                cb += n;
+            }
+            break;
+        case 4: // delete
+            n = (i + n <= cb) ? n : cb - i;
+            memmove(pb + i, pb + i + n, cb - i - n);
+            cb -= n;
+            break;
+        case 5: // duplicate chunk
+            if (i + n <= cb && cb + n <= FUZZ_MAX) {
+                memmove(pb + i + n, pb + i, cb - i);
+                cb += n;
+            }
+            break;
+        default: // splice with another corpus line
+            if (pc->cnt) {
+                size_t j = next_rand((unsigned)pc->cnt);
+                n = (pc->cch[j] < FUZZ_MAX - i) ? pc->cch[j] : FUZZ_MAX - i;
+                memcpy(pb + i, pc->line[j], n);
+                cb = (i + n > cb) ? i + n : cb;
+            }
+            break;
+        }
+    }
+
+    return cb;
+}
+
+
+int main(int argc, char* argv[])
+{
+    static char szCrash[PATH_MAX];
+    const char* name = strrchr(argv[0], '/');
+    name = name ? name + 1 : argv[0];
+    pszCrash = getenv("FUZZ_CRASH");
+    if (!pszCrash) {
+        snprintf(szCrash, sizeof(szCrash), "crash-%s", name);
+        pszCrash = szCrash;
+    }
+    signal(SIGABRT, on_signal);
+    signal(SIGSEGV, on_signal);
+    signal(SIGFPE, on_signal);
+#if defined(__SANITIZE_ADDRESS__)
+    __sanitizer_set_death_callback(save_input);
+#endif // __SANITIZE_ADDRESS__
+    LLVMFuzzerInitialize(&argc, &argv);
+
+    // replay
+    if (argc == 3 && !strcmp(argv[1], "-x")) {
+        static uint8_t ab[FUZZ_MAX];
+        FILE* f = fopen(argv[2], "rb");
+        if (!f) {
+            perror(argv[2]);
+            return 1;
+        }
+        size_t cb = fread(ab, 1, sizeof(ab), f);
+        fclose(f);
+        pszCrash = "/dev/null";
+        run_one(ab, cb);
+        free(pbInput);
+        pbInput = NULL;
+        printf("ok %s replay\n", name);
+        return 0;
+    }
+
+    // corpus as is
+    for (int i = 1; i < argc; ++i)
+        read_corpus(&corpus, argv[i]);
+    for (size_t i = 0; i < corpus.cnt; ++i)
+        run_one((const uint8_t*)corpus.line[i], corpus.cch[i]);
+
+    // mutations
+    const char* psz = getenv("FUZZ_TIME");
+    double limit = (psz ? atof(psz) : 10) * 1e9, t0 = now_ns();
+    psz = getenv("FUZZ_SEED");
+    ullState = psz ? strtoull(psz, NULL, 0) : (unsigned long long)t0;
+    ullState = ullState ? ullState : 1;
+    printf("# %s: seed %llu\n", name, ullState);
+    fflush(stdout);
+
+    static uint8_t ab[FUZZ_MAX];
+    size_t runs = corpus.cnt;
+    do {
+        for (int k = 0; k < 256; ++k, ++runs) {
+            size_t cb = 0;
+            if (corpus.cnt) {
+                size_t j = next_rand((unsigned)corpus.cnt);
+                cb = (corpus.cch[j] < FUZZ_MAX) ? corpus.cch[j] : FUZZ_MAX;
+                memcpy(ab, corpus.line[j], cb);
+            }
+            run_one(ab, mutate(ab, cb, &corpus));
+        }
+    } while (now_ns() - t0 < limit);
+    free(pbInput);
+    pbInput = NULL;
+
+    printf("ok %s\t%zu runs\n", name, runs);
+    return 0;
+}
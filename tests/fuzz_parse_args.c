@@ -0,0 +1,45 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Fuzz nocrt0c.c command line parser against the reference one
+ * Note: Buffers are of the worst case sizes nocrt0c.c claims, so sanitizers catch
+ *       it writing past them
+ */
+
+
+#include "fuzz.h"
+#include <tchar.h>
+#include "parse_args.h"
+#include "ref_argv.h"
+
+
+int LLVMFuzzerInitialize(int* pargc, char*** pargv)
+{
+    (void)pargc;
+    (void)pargv;
+    return 0;
+}
+
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    char* psz = fuzz_string(data, size);
+    size_t cch = strlen(psz);
+    char** argv = malloc(ARGV_MAX(cch) * sizeof(char*));
+    char* pc = malloc(CHARS_MAX(cch));
+    char** ref = malloc((cch + 2) * sizeof(char*));
+    char* pcRef = malloc(2 * cch + 2);
+
+    int argc = parse_args(psz, argv, pc);
+    FUZZ_CHECK(argc == ref_parse_args(psz, ref, pcRef));
+    for (int i = 0; i < argc; ++i)
+        FUZZ_CHECK(!strcmp(argv[i], ref[i]));
+    FUZZ_CHECK(argv[argc] == NULL);
+
+    free(pcRef);
+    free(ref);
+    free(pc);
+    free(argv);
+    free(psz);
+    return 0;
+}
@@ -0,0 +1,70 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Fuzz parse_line() against a plain reading of the shebang line
+ */
+
+
+#include "fuzz.h"
+#include "../libshebang.c"
+
+
+int LLVMFuzzerInitialize(int* pargc, char*** pargv)
+{
+    (void)pargc;
+    (void)pargv;
+    return 0;
+}
+
+
+// the same line split the obvious way: shell up to a space, args after it
+static BOOL ref_parse_line(const char* p, size_t cnt, char* pszShell, char* pszArgs)
+{
+    if (cnt < 2 || p[0] != '#' || p[1] != '!')
+        return FALSE;
+    size_t i = 2;
+    while (i < cnt && p[i] && p[i] != '\r' && p[i] != '\n')
+        ++i;
+    if (i == cnt || !p[i])
+        return FALSE;
+
+    size_t j = 2, n = 0;
+    while (j < i && (p[j] == ' ' || p[j] == '\t'))
+        ++j;
+    if (j == i)
+        return FALSE;
+    while (j < i && p[j] != ' ' && p[j] != '\t')
+        pszShell[n++] = p[j++];
+    pszShell[n] = '\0';
+    for (n = 0, j += (j < i); j < i; ++j)
+        pszArgs[n++] = (p[j] == '\t') ? ' ' : p[j];
+    pszArgs[n] = '\0';
+    return TRUE;
+}
+
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    // note: parse_line gets no terminator, so copy is exactly sized
+    char* line = malloc(size ? size : 1);
+    char* shell = malloc(size + 1);
+    char* args = malloc(size + 1);
+    const char* pc1 = NULL;
+    const char* pc2 = NULL;
+    if (size)
+        memcpy(line, data, size);
+
+    BOOL ok = parse_line(line, size, &pc1, &pc2);
+    FUZZ_CHECK(ok == ref_parse_line((const char*)data, size, shell, args));
+    if (ok) {
+        FUZZ_CHECK(pc1 >= line + 2 && pc1 < line + size);
+        FUZZ_CHECK(!strcmp(pc1, shell));
+        FUZZ_CHECK(pc2 ? (pc2 > pc1 && pc2 < line + size && !strcmp(pc2, args))
+            : !*args);
+    }
+
+    free(args);
+    free(shell);
+    free(line);
+    return 0;
+}
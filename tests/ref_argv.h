@@ -0,0 +1,83 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Reference command line parser per msvcrt.dll rules, written for clarity
+ *       rather than speed; tests compare nocrt0c.c and quote_arg() against it
+ * Note: argv needs room for strlen(cmd) + 2 pointers, pcOut for 2 * strlen(cmd) + 2
+ *       chars
+ */
+
+
+#ifndef TESTS_REF_ARGV_H
+#define TESTS_REF_ARGV_H
+
+#include <string.h>
+
+
+// checks for blank
+static inline int ref_blank(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+
+// splits command line into NULL-terminated argv; returns argc
+static inline int ref_parse_args(const char* cmd, char** argv, char* pcOut)
+{
+    int argc = 0;
+
+    // program name: no escapes, quotes only group
+    argv[argc++] = pcOut;
+    if (*cmd == '"') {
+        const char* end = strchr(cmd + 1, '"');
+        size_t n = end ? (size_t)(end - cmd - 1) : strlen(cmd + 1);
+        memcpy(pcOut, cmd + 1, n);
+        pcOut += n;
+        cmd += 1 + n + (end != NULL);
+    } else {
+        while (*cmd && !ref_blank(*cmd))
+            *pcOut++ = *cmd++;
+    }
+    *pcOut++ = '\0';
+
+    // args
+    for (;;) {
+        while (ref_blank(*cmd))
+            ++cmd;
+        if (!*cmd)
+            break;
+        argv[argc++] = pcOut;
+        for (int quoted = 0; *cmd && (quoted || !ref_blank(*cmd)); ) {
+            size_t n = strspn(cmd, "\\");
+            if (n && cmd[n] != '"') {
+                // backslashes are literal
+                memcpy(pcOut, cmd, n);
+                pcOut += n;
+                cmd += n;
+            } else if (n) {
+                // half of backslashes, and a literal quote if odd
+                memset(pcOut, '\\', n / 2);
+                pcOut += n / 2;
+                cmd += n;
+                if (n % 2)
+                    *pcOut++ = *cmd++;
+            } else if (*cmd == '"' && quoted && cmd[1] == '"') {
+                // doubled quote inside quotes is literal and ends them
+                *pcOut++ = '"';
+                cmd += 2;
+                quoted = 0;
+            } else if (*cmd == '"') {
+                quoted = !quoted;
+                ++cmd;
+            } else {
+                *pcOut++ = *cmd++;
+            }
+        }
+        *pcOut++ = '\0';
+    }
+
+    argv[argc] = NULL;
+    return argc;
+}
+
+#endif // TESTS_REF_ARGV_H
@@ -0,0 +1,73 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Reference UTF-8 decoder per the table of well-formed byte sequences in the
+ *       Unicode standard, written for clarity rather than speed; tests compare
+ *       decode_utf8() against it
+ * Note: pwOut needs room for strlen(src) + 1 chars
+ */
+
+
+#ifndef TESTS_REF_UTF8_H
+#define TESTS_REF_UTF8_H
+
+#include <stddef.h>
+
+
+// well-formed sequences: lead bytes, then allowed range of the second byte; other
+// bytes are all 80..BF
+static const struct {
+    unsigned char lead1, lead2, next1, next2, len;
+} ref_utf8_table[] = {
+    { 0x00, 0x7f, 0, 0, 1 },
+    { 0xc2, 0xdf, 0x80, 0xbf, 2 },
+    { 0xe0, 0xe0, 0xa0, 0xbf, 3 },
+    { 0xe1, 0xec, 0x80, 0xbf, 3 },
+    { 0xed, 0xed, 0x80, 0x9f, 3 },
+    { 0xee, 0xef, 0x80, 0xbf, 3 },
+    { 0xf0, 0xf0, 0x90, 0xbf, 4 },
+    { 0xf1, 0xf3, 0x80, 0xbf, 4 },
+    { 0xf4, 0xf4, 0x80, 0x8f, 4 }
+};
+
+
+// decodes NUL-terminated UTF-8 string to UTF-16; returns number of chars written
+// including terminator or zero if malformed
+static inline size_t ref_decode_utf8(WCHAR* pwOut, const char* src)
+{
+    const unsigned char* cp = (const unsigned char*)src;
+    size_t cch = 0;
+
+    for (;;) {
+        size_t k = 0, n = sizeof(ref_utf8_table) / sizeof(ref_utf8_table[0]);
+        while (k < n && (cp[0] < ref_utf8_table[k].lead1
+            || cp[0] > ref_utf8_table[k].lead2))
+            ++k;
+        if (k == n)
+            return 0;
+        unsigned len = ref_utf8_table[k].len;
+        if (len > 1 && (cp[1] < ref_utf8_table[k].next1
+            || cp[1] > ref_utf8_table[k].next2))
+            return 0;
+        for (unsigned i = 2; i < len; ++i)
+            if (cp[i] < 0x80 || cp[i] > 0xbf)
+                return 0;
+
+        // lead byte keeps 7, 5, 4 or 3 bits, others 6 each
+        unsigned long c = cp[0] & (0xffU >> (len == 1 ? 1 : len + 1));
+        for (unsigned i = 1; i < len; ++i)
+            c = c * 64 + (cp[i] & 0x3f);
+        cp += len;
+
+        if (c > 0xffff) {
+            pwOut[cch++] = (WCHAR)(0xd800 + ((c - 0x10000) >> 10));
+            pwOut[cch++] = (WCHAR)(0xdc00 + ((c - 0x10000) & 0x3ff));
+        } else {
+            pwOut[cch++] = (WCHAR)c;
+            if (!c)
+                return cch;
+        }
+    }
+}
+
+#endif // TESTS_REF_UTF8_H
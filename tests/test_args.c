@@ -0,0 +1,109 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: nocrt0c.c command line parser: msvcrt.dll examples, then every short line of
+ *       blanks, quotes and backslashes against the reference parser
+ * Note: Buffers are of the worst case sizes nocrt0c.c claims, guarded at the end
+ */
+
+
+#include "util.h"
+#include <tchar.h>
+#include "parse_args.h"
+#include "ref_argv.h"
+
+
+#define MAX_LEN     8
+#define GUARD       16
+
+
+// parses line into guarded buffers of the claimed sizes; returns argc or -1 if
+// parser wrote past them
+static int parse_guarded(const char* psz, char** argv, char* pc)
+{
+    size_t cch = strlen(psz);
+    char** ppGuard = argv + ARGV_MAX(cch);
+    char* pcGuard = pc + CHARS_MAX(cch);
+    memset(ppGuard, 0x5a, GUARD * sizeof(char*));
+    memset(pcGuard, 0x5a, GUARD);
+
+    int argc = parse_args(psz, argv, pc);
+    for (int i = 0; i < GUARD; ++i)
+        if (pcGuard[i] != 0x5a || ((unsigned char*)ppGuard)[i] != 0x5a)
+            return -1;
+    return argc;
+}
+
+
+// checks line splits into args given as a single string separated by '|'
+static void check_args(const char* psz, const char* expected)
+{
+    char* argv[64 + GUARD];
+    char pc[256 + GUARD], got[512];
+    int argc = parse_guarded(psz, argv, pc);
+    size_t cch = 0;
+    got[0] = '\0';
+    for (int i = 0; i < argc; ++i)
+        cch += (size_t)snprintf(got + cch, sizeof(got) - cch, "%s%s", i ? "|" : "",
+            argv[i]);
+    if (!CHECK(argc >= 0 && argv[argc] == NULL && !strcmp(got, expected)))
+        fprintf(stderr, "  [%s]: got [%s], expected [%s]\n", psz, got, expected);
+}
+
+
+// checks line against the reference parser
+static void check_ref(const char* psz)
+{
+    static char* argv[ARGV_MAX(MAX_LEN + 2) + GUARD];
+    static char* ref[MAX_LEN + 4];
+    static char pc[CHARS_MAX(MAX_LEN + 2) + GUARD], pcRef[2 * MAX_LEN + 6];
+    int argc = parse_guarded(psz, argv, pc);
+    int cnt = ref_parse_args(psz, ref, pcRef);
+    int ok = (argc == cnt && argv[argc] == NULL);
+    for (int i = 0; ok && i < argc; ++i)
+        ok = !strcmp(argv[i], ref[i]);
+    if (!CHECK(ok))
+        fprintf(stderr, "  [%s]: %d args, expected %d\n", psz, argc, cnt);
+}
+
+
+int main(void)
+{
+    // msvcrt.dll documented examples and their program name rules
+    check_args("prog \"abc\" d e", "prog|abc|d|e");
+    check_args("prog a\\\\\\b d\"e f\"g h", "prog|a\\\\\\b|de fg|h");
+    check_args("prog a\\\\\\\"b c d", "prog|a\\\"b|c|d");
+    check_args("prog a\\\\\\\\\"b c\" d e", "prog|a\\\\b c|d|e");
+    check_args("prog a\"b\"\" c d", "prog|ab\"|c|d");
+    check_args("\"C:\\Program Files\\a.exe\"x y", "C:\\Program Files\\a.exe|x|y");
+    check_args("\"a\\\"b c", "a\\|b|c");
+    check_args("prog \"\" \"\"", "prog||");
+    check_args("prog\t\t", "prog");
+    check_args("", "");
+    check_args(" x", "|x");
+
+    // every line up to MAX_LEN chars, after a program name or as one
+    static const char alphabet[] = "a \t\"\\";
+    const long base = (long)sizeof(alphabet) - 1;
+    char line[MAX_LEN + 3];
+    long lines = 0;
+    for (int len = 0; len <= MAX_LEN && !failed; ++len) {
+        long total = 1;
+        for (int i = 0; i < len; ++i)
+            total *= base;
+        for (long n = 0; n < total && !failed; ++n) {
+            long k = n;
+            for (int i = 0; i < len; ++i, k /= base)
+                line[2 + i] = alphabet[k % base];
+            line[2 + len] = '\0';
+            line[0] = 'p';
+            line[1] = ' ';
+            check_ref(line);
+            check_ref(line + 2);
+            lines += 2;
+        }
+    }
+    CHECK(lines > 700000);
+
+    return done("args");
+}
@@ -0,0 +1,183 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Byte kernels against their obvious loops on random buffers, on every
+ *       alignment and with data ending just before an unmapped page
+ * Note: Built three times: with SSE2 (as by default), with -mavx2 and with -DNOSIMD
+ */
+
+
+#include "util.h"
+#include <sys/mman.h>
+#include "../libshebang.c"
+
+
+#define ROUNDS      200000
+#define MAX_LEN     300
+
+#if defined(NOSIMD)
+#define VARIANT     "bytes/scalar"
+#elif defined(__AVX2__)
+#define VARIANT     "bytes/avx2"
+#else
+#define VARIANT     "bytes/sse2"
+#endif // NOSIMD
+
+static char* pcPageEnd;     // first byte of an unmapped page
+
+
+// sign of a number
+static int sign(int i)
+{
+    return (i > 0) - (i < 0);
+}
+
+
+// fills buffer with random bytes, mostly from a few ones to make matches frequent
+static void random_bytes(char* p, size_t n)
+{
+    static const char some[] = "ab\0\r\n\t\x80\xff";
+    BOOL any = (rand() % 4 == 0);
+    for (size_t i = 0; i < n; ++i)
+        p[i] = (char)(any ? rand() : some[rand() % (int)(sizeof(some) - 1)]);
+}
+
+
+// compares two buffers as memcmp(), but stops after first difference
+static int ref_compare(const char* p1, const char* p2, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        if (p1[i] != p2[i])
+            return (unsigned char)p1[i] - (unsigned char)p2[i];
+    return 0;
+}
+
+
+// checks compare_bytes() of s1 and s2 over n bytes
+static void check_compare(const char* p1, const char* p2, size_t n)
+{
+    int i = compare_bytes(p1, p2, n), ref = ref_compare(p1, p2, n);
+    if (!CHECK(sign(i) == sign(ref)))
+        fprintf(stderr, "  %zu bytes: got %d, expected %d\n", n, i, ref);
+}
+
+
+// checks find_eol() over n bytes
+static void check_find_eol(const char* p, size_t n)
+{
+    size_t i = 0;
+    while (i < n && p[i] && p[i] != '\r' && p[i] != '\n')
+        ++i;
+    size_t eol = find_eol(p, n);
+    if (!CHECK(eol == i))
+        fprintf(stderr, "  %zu bytes: got %zu, expected %zu\n", n, eol, i);
+}
+
+
+// checks replace_byte() over n bytes in place
+static void check_replace_byte(char* p, size_t n, char cTo, char cFrom)
+{
+    char ref[MAX_LEN];
+    for (size_t i = 0; i < n; ++i)
+        ref[i] = (p[i] == cFrom) ? cTo : p[i];
+    replace_byte(p, n, cTo, cFrom);
+    CHECK(!memcmp(p, ref, n));
+}
+
+
+// checks replace_char() over string in place; only its chars may change
+static void check_replace_char(char* psz, char cTo, char cFrom)
+{
+    char ref[MAX_LEN + 1];
+    size_t cch = strlen(psz);
+    for (size_t i = 0; i <= cch; ++i)
+        ref[i] = (psz[i] == cFrom) ? cTo : psz[i];
+    replace_char(psz, cTo, cFrom);
+    if (!CHECK(!memcmp(psz, ref, cch + 1)))
+        fprintf(stderr, "  %zu chars, '\\x%02x' to '\\x%02x'\n", cch,
+            (unsigned char)cFrom, (unsigned char)cTo);
+}
+
+
+// random byte to replace, never NUL
+static char random_from(void)
+{
+    char c = (rand() % 2) ? "ab\r\n\t\x80\xff"[rand() % 7] : (char)rand();
+    return c ? c : 'a';
+}
+
+
+int main(void)
+{
+    static char buf1[MAX_LEN + 64], buf2[MAX_LEN + 64];
+#if defined(__AVX2__)
+    if (!__builtin_cpu_supports("avx2")) {
+        printf("skip " VARIANT "\n");
+        return 0;
+    }
+#endif // __AVX2__
+
+    // a page followed by an unmapped one
+    long cbPage = sysconf(_SC_PAGESIZE);
+    char* pcPage = mmap(NULL, 2 * cbPage, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (!CHECK(pcPage != MAP_FAILED && !mprotect(pcPage + cbPage, cbPage, PROT_NONE)))
+        return done(VARIANT);
+    pcPageEnd = pcPage + cbPage;
+
+    // random lengths and alignments
+    srand(2014);
+    for (int k = 0; k < ROUNDS && !failed; ++k) {
+        size_t n = (size_t)(rand() % MAX_LEN);
+        char* p1 = buf1 + rand() % 64;
+        char* p2 = buf2 + rand() % 64;
+        random_bytes(p1, n);
+        memcpy(p2, p1, n);
+        if (n && rand() % 2)
+            p2[rand() % n] = (char)rand();
+        check_compare(p1, p2, n);
+        check_compare(p2, p1, n);
+        check_find_eol(p1, n);
+        check_replace_byte(p1, n, (char)rand(), random_from());
+        p2[n ? rand() % n : 0] = '\0';
+        check_replace_char(p2, (rand() % 8) ? (char)rand() : '\0', random_from());
+    }
+
+    // difference at every position, high bit set on either side
+    memset(buf1, 'x', MAX_LEN);
+    memset(buf2, 'x', MAX_LEN);
+    for (size_t i = 0; i < 2 * 32 + 1; ++i) {
+        buf2[i] = '\x80';
+        check_compare(buf1, buf2, 2 * 32 + 1);
+        check_compare(buf2, buf1, 2 * 32 + 1);
+        check_compare(buf1, buf2, i);
+        buf2[i] = 'x';
+    }
+
+    // every length ending at unmapped page: vector loads must not cross it
+    for (size_t n = 0; n <= 3 * 32; ++n) {
+        char* p = pcPageEnd - n;
+        random_bytes(p, n);
+        check_find_eol(p, n);
+        check_replace_byte(p, n, '?', n ? p[0] : 'a');
+        for (size_t i = 0; i < n; ++i)
+            p[i] = (char)('a' + i % 3);
+        memcpy(buf1, p, n);
+        check_compare(p, buf1, n);
+        check_compare(buf1, p, n);
+        if (!n)
+            continue;
+
+        // short string against a longer one: comparison stops at its terminator
+        p[n - 1] = '\0';
+        memcpy(buf1, p, n);
+        memset(buf1 + n - 1, 'z', MAX_LEN - n);
+        check_compare(p, buf1, MAX_LEN);
+        check_compare(buf1, p, MAX_LEN);
+        check_compare(p, buf1, n);
+        check_replace_char(p, 'c', 'a');
+        check_replace_char(p, '\0', 'b');
+    }
+
+    return done(VARIANT);
+}
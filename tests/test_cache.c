@@ -0,0 +1,137 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Resolution cache: hits give the same resolution, changes of PATH or script
+ *       miss, and threads sharing the file never see a wrong entry
+ */
+
+
+#include "util.h"
+#define main shebang_main
+#include "../shebang.c"
+#undef main
+#include "../libshebang.c"
+
+
+#define SCRIPTS     300     // more than CACHE_BUCKETS * CACHE_WAYS / 2
+#define THREADS     8
+#define ROUNDS      2000
+
+
+// script name by number
+static void script_name(char* buf, size_t cb, int i)
+{
+    snprintf(buf, cb, "script%03d", i);
+}
+
+
+// releases what open_cache() got
+static void close_cache(CACHE* pc)
+{
+    if (pc->bucket)
+        UnmapViewOfFile(pc->bucket);
+    if (pc->hFile != INVALID_HANDLE_VALUE)
+        CloseHandle(pc->hFile);
+}
+
+
+// looks up script; on miss resolves and stores it like the launcher
+static int lookup_or_store(SHEBANG* psb, RESOLVED* pr, PCTSTR pszName)
+{
+    CACHE c;
+    int hit = cache_lookup(&c, pr, pszName);
+    if (!hit && resolve_script(psb, pr, pszName) == ERROR_SUCCESS)
+        cache_store(&c, pr);
+    close_cache(&c);
+    return hit;
+}
+
+
+// looks up random scripts, storing them on miss; counts wrong resolutions
+static DWORD WINAPI hammer(LPVOID pv)
+{
+    unsigned seed = (unsigned)(INT_PTR)pv;
+    DWORD bad = 0;
+    SHEBANG sb;
+    shebang_init(&sb);
+    for (int k = 0; k < ROUNDS; ++k) {
+        char name[16];
+        RESOLVED r;
+        int i = rand_r(&seed) % SCRIPTS;
+        script_name(ARRAY(name), i);
+        lookup_or_store(&sb, &r, name);
+        bad += (StrCmpI(PathFindFileName(r.szScript), name)
+            || !strstr(r.szShellCmd, (i % 2) ? "bash.exe" : "sh.exe"));
+    }
+    shebang_free(&sb);
+    return bad;
+}
+
+
+int main(void)
+{
+    char path[PATH_MAX], tmp[2 * PATH_MAX];
+    make_tree();
+
+    make_file(tree_path(ARRAY(path), "msys64/usr/bin/sh.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "msys64/usr/bin/bash.exe"), "", 0755);
+    for (int i = 0; i < SCRIPTS; ++i) {
+        char name[16];
+        script_name(ARRAY(name), i);
+        make_file(tree_path(ARRAY(path), "scripts/%s", name),
+            (i % 2) ? "#!/bin/bash\n" : "#!/bin/sh\n", 0755);
+    }
+    snprintf(tmp, sizeof(tmp), "%s/scripts:%s/msys64/usr/bin:/usr/bin:/bin", szTree,
+        szTree);
+    setenv("PATH", tmp, 1);
+    CHECK(!chdir("/"));
+    unsetenv("SHEBANG_SUBST");
+
+    // miss, then hit with the same resolution
+    SHEBANG sb;
+    RESOLVED r, rCached;
+    shebang_init(&sb);
+    CHECK(!lookup_or_store(&sb, &r, "script000"));
+    CHECK(lookup_or_store(&sb, &rCached, "script000"));
+    CHECK(!memcmp(&r, &rCached, sizeof(r)));
+    CHECK(lookup_or_store(&sb, &rCached, "SCRIPT000")); // names are case blind
+
+    // other current directory is another key; note: so is PATH, but environment
+    // block is taken once per process, see test_cache.sh
+    CHECK(!chdir(szTree));
+    CHECK(!lookup_or_store(&sb, &r, "script000"));
+    CHECK(!chdir("/"));
+    CHECK(lookup_or_store(&sb, &r, "script000"));
+
+    // script changed: size and time differ
+    make_file(tree_path(ARRAY(path), "scripts/script000"), "#!/bin/bash -e\n", 0755);
+    CHECK(!lookup_or_store(&sb, &r, "script000"));
+    CHECK(strstr(r.szShellCmd, "bash.exe") != NULL);
+    CHECK(lookup_or_store(&sb, &r, "script000"));
+    make_file(tree_path(ARRAY(path), "scripts/script000"), "#!/bin/sh\n", 0755);
+
+    // shell gone
+    lookup_or_store(&sb, &r, "script001");
+    CHECK(lookup_or_store(&sb, &r, "script001"));
+    tree_path(ARRAY(path), "msys64/usr/bin/bash.exe");
+    snprintf(tmp, sizeof(tmp), "%s.bak", path);
+    rename(path, tmp);
+    CHECK(!lookup_or_store(&sb, &r, "script001"));
+    rename(tmp, path);
+    shebang_free(&sb);
+
+    // threads updating the cache at once
+    HANDLE ah[THREADS];
+    for (int i = 0; i < THREADS; ++i)
+        CHECK((ah[i] = CreateThread(NULL, 0, hammer, (LPVOID)(INT_PTR)(i + 1), 0,
+            NULL)) != NULL);
+    CHECK(WaitForMultipleObjects(THREADS, ah, TRUE, 120000) == WAIT_OBJECT_0);
+    for (int i = 0; i < THREADS; ++i) {
+        DWORD dw = 1;
+        GetExitCodeThread(ah[i], &dw);
+        CHECK(dw == 0);
+        CloseHandle(ah[i]);
+    }
+
+    return done("cache");
+}
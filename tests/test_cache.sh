@@ -0,0 +1,68 @@
+#!/bin/sh
+# Proj: shebang
+# Desc: Launcher takes resolution from cache until PATH or the script changes
+# Note: $SHEBANG is the launcher built over the POSIX platform layer
+
+SHEBANG=${SHEBANG:-build/shebang}
+T=$(mktemp -d "${TMPDIR:-/tmp}/shebang-test-XXXXXX") || exit 1
+trap 'rm -rf "$T"' EXIT
+export TMPDIR=$T
+failed=0
+
+# check name expected actual
+check() {
+    if [ "$2" != "$3" ]; then
+        printf '%s: expected [%s], got [%s]\n' "$1" "$2" "$3" >&2
+        failed=$((failed + 1))
+    fi
+}
+
+# runs script, printing where its resolution came from
+source_of() {
+    rm -f "$T/trace"
+    SHEBANG_TRACE=$T/trace "$@" >/dev/null
+    sed -n 's/.*"source":"\([a-z]*\)".*/\1/p' "$T/trace"
+}
+
+mkdir -p "$T/bin"
+cp "$SHEBANG" "$T/bin/cached.exe"
+printf '#!/bin/sh\nexit 0\n' >"$T/bin/cached"
+export PATH="$T/bin:$PATH"
+
+check "first" resolve "$(source_of cached.exe)"
+check "second" cache "$(source_of cached.exe)"
+check "other PATH" resolve "$(PATH="$PATH:$T/none" source_of cached.exe)"
+check "same PATH" cache "$(source_of cached.exe)"
+check "other dir" resolve "$(cd "$T" && source_of cached.exe)"
+
+# script changes size; then its time only
+printf '#!/bin/sh -e\nexit 0\n' >"$T/bin/cached"
+check "script changed" resolve "$(source_of cached.exe)"
+check "then cached" cache "$(source_of cached.exe)"
+touch -d '2001-01-01' "$T/bin/cached"
+check "script touched" resolve "$(source_of cached.exe)"
+
+# cache file gone or broken
+rm -f "$T/shebang.cache"
+check "no cache" resolve "$(source_of cached.exe)"
+head -c 100000 /dev/urandom >"$T/shebang.cache"
+check "garbage cache" resolve "$(source_of cached.exe)"
+check "repaired cache" cache "$(source_of cached.exe)"
+
+# launches at once, each of its own script
+for i in 1 2 3 4 5 6 7 8; do
+    cp "$SHEBANG" "$T/bin/p$i.exe"
+    printf '#!/bin/sh\necho %s\n' $i >"$T/bin/p$i"
+done
+for i in 1 2 3 4 5 6 7 8; do
+    n=0
+    while [ $n -lt 50 ]; do
+        [ "$(p$i.exe)" = $i ] || echo "p$i: wrong output"
+        n=$((n + 1))
+    done >"$T/par$i" &
+done
+wait
+check "parallel" "" "$(cat "$T"/par*)"
+
+[ $failed = 0 ] && echo "ok cache.sh" || echo "FAIL cache.sh"
+exit $failed
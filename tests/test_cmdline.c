@@ -0,0 +1,120 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Command line builder: quoted args come back the same through the reference
+ *       msvcrt.dll parser, and sizes counted are the sizes written
+ */
+
+
+#include "util.h"
+#include "ref_argv.h"
+#include "../libshebang.c"
+
+
+#define ROUNDS      20000
+#define ARGS        6
+
+// args hard to quote right
+static const char* const tricky[] = {
+    "", "a", "a b", "a\\", "a\\\\", "a\\\"b", "\"", "\"\"", "\\\"", "\\\\\"",
+    "C:\\Program Files\\", "\\\\server\\share\\", "a\tb", "a\nb", "a\vb",
+    "-e", "\"a b\"", "a\"b c\"d", "\\"
+};
+
+
+// quotes args into command line, checking size; returns its length
+static size_t quote_args(char* psz, const char* const* args, int n)
+{
+    size_t cch = 4;
+    memcpy(psz, "prog", 4);
+    for (int i = 0; i < n; ++i) {
+        size_t cchArg = strlen(args[i]), cchNeed = quote_arg(NULL, args[i], cchArg);
+        psz[cch++] = ' ';
+        CHECK(quote_arg(psz + cch, args[i], cchArg) == cchNeed);
+        cch += cchNeed;
+    }
+    psz[cch] = '\0';
+    return cch;
+}
+
+
+// checks that parser gives args back
+static void check_round_trip(const char* const* args, int n)
+{
+    char cmd[4096], out[8192];
+    char* argv[4096];
+    size_t cch = quote_args(cmd, args, n);
+
+    if (!CHECK(ref_parse_args(cmd, argv, out) == n + 1))
+        return;
+    for (int i = 0; i < n; ++i)
+        if (!CHECK(!strcmp(argv[i + 1], args[i])))
+            fprintf(stderr, "  [%s] -> %s\n", args[i], cmd);
+    CHECK(strlen(cmd) == cch);
+}
+
+
+int main(void)
+{
+    // each tricky arg alone and all of them together
+    for (int i = 0; i < (int)COUNT(tricky); ++i)
+        check_round_trip(&tricky[i], 1);
+    check_round_trip(tricky, (int)COUNT(tricky));
+
+    // plain args are left alone
+    char buf[256];
+    CHECK(quote_arg(buf, ARRAY1("C:\\dir\\file")) == COUNT1("C:\\dir\\file"));
+    CHECK(!memcmp(buf, ARRAY1("C:\\dir\\file")));
+
+    // random args over the chars that matter
+    static const char alphabet[] = "ab \\\\\\\"\"\t\v";
+    srand(12345);
+    for (int k = 0; k < ROUNDS; ++k) {
+        char arg[ARGS][24];
+        const char* args[ARGS];
+        int n = 1 + rand() % ARGS;
+        for (int i = 0; i < n; ++i) {
+            int len = rand() % (int)sizeof(arg[i]);
+            for (int j = 0; j < len; ++j)
+                arg[i][j] = alphabet[rand() % (int)COUNT1(alphabet)];
+            arg[i][len] = '\0';
+            args[i] = arg[i];
+        }
+        check_round_trip(args, n);
+    }
+
+    // shebang args go as they are, so quotes in them group words
+    char cmd[64] = "sh";
+    char* argv[16];
+    char out[128];
+    CHECK(append_utf8_args(ARRAY(cmd), "-c \"echo a b\" x"));
+    CHECK(ref_parse_args(cmd, argv, out) == 4);
+    CHECK(!strcmp(argv[1], "-c") && !strcmp(argv[2], "echo a b"));
+    CHECK(!strcmp(argv[3], "x"));
+    strcpy(cmd, "sh");
+    CHECK(append_utf8_args(ARRAY(cmd), "-e\t a\\\"b  c\\"));
+    CHECK(ref_parse_args(cmd, argv, out) == 4);
+    CHECK(!strcmp(argv[1], "-e") && !strcmp(argv[2], "a\"b"));
+    CHECK(!strcmp(argv[3], "c\\"));
+    strcpy(cmd, "sh");
+    CHECK(!append_utf8_args(cmd, 8, "-e -u -x"));
+
+    // whole command line: shell, script with POSIX separators, raw args as is
+    RESOLVED r = {
+        .szScript = "C:\\my dir\\script",
+        .szShellCmd = "\"C:\\msys 64\\usr\\bin\\sh.exe\" -e"
+    };
+    size_t cch = shebang_cmdline(NULL, &r, "a \"b c\" d\\\"");
+    char* pszCmd = malloc(cch);
+    CHECK(shebang_cmdline(pszCmd, &r, "a \"b c\" d\\\"") == cch);
+    CHECK(strlen(pszCmd) + 1 == cch);
+    CHECK(ref_parse_args(pszCmd, argv, out) == 6);
+    CHECK(!strcmp(argv[0], "C:\\msys 64\\usr\\bin\\sh.exe"));
+    CHECK(!strcmp(argv[1], "-e"));
+    CHECK(!strcmp(argv[2], "C:/my dir/script"));
+    CHECK(!strcmp(argv[3], "a") && !strcmp(argv[4], "b c") && !strcmp(argv[5], "d\""));
+    free(pszCmd);
+    CHECK(shebang_cmdline(NULL, &r, NULL) == strlen(r.szShellCmd) + 20);
+
+    return done("cmdline");
+}
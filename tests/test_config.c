@@ -0,0 +1,187 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: shebang.ini: [posix], [environment] and [interpreters] parsed, saved as
+ *       shebang.config and taken from it until shebang.ini changes or the saved
+ *       copy is damaged; pinned root skips discovery on PATH
+ * Note: Runs from a copy in the tree, as shebang.ini is next to the executable
+ */
+
+
+#include "util.h"
+#include "../libshebang.c"
+
+
+// writes shebang.ini next to us with given modification time
+static void write_ini(const char* text, time_t mtime)
+{
+    char path[PATH_MAX];
+    make_file(tree_path(ARRAY(path), "bin/shebang.ini"), text, 0644);
+    struct timespec ts[2] = { { mtime, 0 }, { mtime, 0 } };
+    utimensat(AT_FDCWD, path, ts, 0);
+}
+
+
+// loads configuration, then frees it; returns its layer and copies its root
+static int load_sys(PTSTR pszRoot)
+{
+    const CONFIG* pc = load_config();
+    int sys = pc->sys;
+    StringCchCopy(pszRoot, MAX_PATH, pc->root);
+    if (pc != &noConfig.cfg)
+        HeapFree(GetProcessHeap(), 0, (CONFIG*)pc);
+    return sys;
+}
+
+
+// rewrites saved configuration with other root, so its use can be told; maybe as
+// if saved for other shebang.ini
+static BOOL mark_saved(BOOL other)
+{
+    char path[PATH_MAX];
+    CONFIG* pc = NULL;
+    FILE* f = fopen(tree_path(ARRAY(path), "shebang.config"), "r+b");
+    long cb = (f && !fseek(f, 0, SEEK_END)) ? ftell(f) : 0;
+    if (cb >= (long)sizeof(CONFIG) && (pc = malloc((size_t)cb))
+        && !fseek(f, 0, SEEK_SET) && fread(pc, 1, (size_t)cb, f) == (size_t)cb) {
+        StringCchCopy(ARRAY(pc->root), "C:\\saved");
+        pc->hIni ^= other;
+        pc->hash = hash_bytes(FNV_BASIS, &pc->hash + 1, (size_t)cb - sizeof(DWORD) * 2
+            - sizeof(ULONGLONG));
+        fseek(f, 0, SEEK_SET);
+        fwrite(pc, 1, (size_t)cb, f);
+    }
+    free(pc);
+    return f && !fclose(f) && cb;
+}
+
+
+// flips a byte of saved configuration
+static void damage_saved(long offset)
+{
+    char path[PATH_MAX];
+    FILE* f = fopen(tree_path(ARRAY(path), "shebang.config"), "r+b");
+    if (f && !fseek(f, offset, SEEK_SET)) {
+        int c = fgetc(f);
+        fseek(f, offset, SEEK_SET);
+        fputc(c ^ 1, f);
+    }
+    if (f)
+        fclose(f);
+}
+
+
+// looks for line in NUL-separated list
+static BOOL has_line(PCTSTR pszList, PCTSTR pszLine)
+{
+    for (PCTSTR psz = pszList; *psz; psz += lstrlen(psz) + 1)
+        if (!lstrcmp(psz, pszLine))
+            return TRUE;
+    return FALSE;
+}
+
+
+int main(void)
+{
+    char path[PATH_MAX], ini[4 * PATH_MAX], root[PATH_MAX];
+    TCHAR sz[MAX_PATH];
+    run_from_tree();
+    unsetenv("HOSTNAME"); // before environment is first read
+    make_dir(tree_path(ARRAY(path), "ucrt64"));
+    native(ARRAY(root), path);
+
+    // no shebang.ini: empty configuration, nothing saved
+    CHECK(load_config() == &noConfig.cfg);
+    CHECK(access(tree_path(ARRAY(path), "shebang.config"), F_OK) != 0);
+
+    // all sections
+    snprintf(ARRAY(ini), "; comment\n[posix]\nlayer = UCRT64\nroot = \"%s\"\n"
+        "[environment]\nLANG=C.UTF-8\nCHERE_INVOKING=1\nHOSTNAME=\n"
+        "[interpreters]\n/usr/bin/python=/ucrt64/bin/python3\n", root);
+    write_ini(ini, 1000000000);
+    const CONFIG* pc = load_config();
+    CHECK(pc->sys == POSIX_UCRT64 && !lstrcmp(pc->root, root));
+    CHECK(has_line(CONFIG_ENV(pc), "LANG=C.UTF-8")
+        && has_line(CONFIG_ENV(pc), "HOSTNAME=")
+        && !has_line(CONFIG_ENV(pc), "/usr/bin/python=/ucrt64/bin/python3"));
+    CHECK(has_line(CONFIG_SUBST(pc), "/usr/bin/python=/ucrt64/bin/python3")
+        && !has_line(CONFIG_SUBST(pc), "LANG=C.UTF-8"));
+    CHECK(config_has_env(pc, "HOSTNAME") && config_has_env(pc, "lang")
+        && !config_has_env(pc, "USER"));
+    HeapFree(GetProcessHeap(), 0, (CONFIG*)pc);
+    CHECK(access(tree_path(ARRAY(path), "shebang.config"), F_OK) == 0);
+
+    // saved one is used until shebang.ini is touched
+    CHECK(mark_saved(FALSE));
+    CHECK(load_sys(sz) == POSIX_UCRT64 && !lstrcmp(sz, "C:\\saved"));
+    write_ini(ini, 1000000001);
+    CHECK(load_sys(sz) == POSIX_UCRT64 && !lstrcmp(sz, root));
+
+    // or resized at the same time, or saved copy is damaged or for other one
+    CHECK(mark_saved(FALSE));
+    strcat(ini, ";\n");
+    write_ini(ini, 1000000001);
+    CHECK(load_sys(sz) == POSIX_UCRT64 && !lstrcmp(sz, root));
+    long offsets[] = { 0, offsetof(CONFIG, cb), offsetof(CONFIG, root),
+        sizeof(CONFIG) + 2 };
+    for (int i = 0; i < (int)COUNT(offsets); ++i) {
+        CHECK(mark_saved(FALSE));
+        damage_saved(offsets[i]);
+        if (!CHECK(load_sys(sz) == POSIX_UCRT64 && !lstrcmp(sz, root)))
+            fprintf(stderr, "  damaged at %ld\n", offsets[i]);
+    }
+    CHECK(mark_saved(TRUE));
+    CHECK(load_sys(sz) == POSIX_UCRT64 && !lstrcmp(sz, root));
+    CHECK(mark_saved(FALSE));
+    CHECK(!truncate(tree_path(ARRAY(path), "shebang.config"), sizeof(CONFIG)));
+    CHECK(load_sys(sz) == POSIX_UCRT64 && !lstrcmp(sz, root));
+
+    // both layer and root needed; layer is one of the MSYSTEM values
+    write_ini("[posix]\nlayer=ucrt64\n", 1000000002);
+    CHECK(load_sys(sz) == POSIX_UNKNOWN);
+    snprintf(ARRAY(ini), "[posix]\nroot=%s\n", root);
+    write_ini(ini, 1000000003);
+    CHECK(load_sys(sz) == POSIX_UNKNOWN);
+    snprintf(ARRAY(ini), "[posix]\nlayer=ucrt\nroot=%s\n", root);
+    write_ini(ini, 1000000004);
+    CHECK(load_sys(sz) == POSIX_UNKNOWN);
+    snprintf(ARRAY(ini), "[posix]\nlayer=Cygwin\nroot=%s\n", root);
+    write_ini(ini, 1000000005);
+    CHECK(load_sys(sz) == POSIX_CYGWIN);
+
+    // long section takes more than the first buffer
+    size_t cch = (size_t)snprintf(ARRAY(ini), "[environment]\n");
+    for (int i = 0; i < 300; ++i)
+        cch += (size_t)snprintf(ini + cch, sizeof(ini) - cch, "VAR%03d=%03d\n", i, i);
+    write_ini(ini, 1000000006);
+    pc = load_config();
+    CHECK(pc->cchEnv > 2048 && has_line(CONFIG_ENV(pc), "VAR000=000")
+        && has_line(CONFIG_ENV(pc), "VAR299=299"));
+    HeapFree(GetProcessHeap(), 0, (CONFIG*)pc);
+
+    // pinned root: found without MSYS on PATH, ignored if missing; configured host
+    // name is not looked up
+    SHEBANG sb;
+    RESOLVED r;
+    make_file(tree_path(ARRAY(path), "scripts/script"), "#!/bin/sh\n", 0755);
+    setenv("PATH", tree_path(ARRAY(path), "scripts"), 1);
+    snprintf(ARRAY(ini), "[posix]\nlayer=ucrt64\nroot=%s\n[environment]\n"
+        "HOSTNAME=cfg\n", root);
+    write_ini(ini, 1000000007);
+    shebang_init(&sb);
+    shebang_prefetch(&sb);
+    CHECK(shebang_find(&sb, &r, "script") == ERROR_SUCCESS);
+    CHECK(r.px.sys == POSIX_UCRT64 && !lstrcmp(r.px.root, root));
+    CHECK(shebang_env(&sb, &r, ARRAY(sz)) && has_line(sz, "HOSTNAME=cfg")
+        && has_line(sz, "MSYSTEM=UCRT64"));
+    CHECK(!sb.host);
+    shebang_free(&sb);
+    snprintf(ARRAY(ini), "[posix]\nlayer=ucrt64\nroot=%s\\none\n", root);
+    write_ini(ini, 1000000008);
+    shebang_init(&sb);
+    CHECK(shebang_find(&sb, &r, "script") == ERROR_SUCCESS);
+    CHECK(r.px.sys == POSIX_NATIVE);
+    shebang_free(&sb);
+
+    return done("config");
+}
@@ -0,0 +1,159 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Env shebang: "[-S] [NAME=value]... prog args" is split and prog resolved on
+ *       PATH, then under POSIX root, without running env; quotes, escapes and
+ *       ${VAR} are left up to env
+ */
+
+
+#include "util.h"
+#include "../libshebang.c"
+
+
+// joins NAME=value list with '|'
+static const char* join_list(PCTSTR psz)
+{
+    static char buf[1024];
+    size_t cch = 0;
+    buf[0] = '\0';
+    for ( ; *psz; psz += strlen(psz) + 1)
+        cch += (size_t)snprintf(buf + cch, sizeof(buf) - cch, "%s%s", cch ? "|" : "",
+            psz);
+    return buf;
+}
+
+
+// checks parse_env() result: NULL prog means failure
+static void check_parse(const char* args, const char* prog, const char* env,
+    const char* rest)
+{
+    char szProg[MAX_PATH];
+    TCHAR szEnv[MAX_PATH];
+    const char* cp = parse_env(args, ARRAY(szProg), ARRAY(szEnv));
+    if (!prog) {
+        if (!CHECK(cp == NULL))
+            fprintf(stderr, "  [%s]: got %s\n", args, szProg);
+        return;
+    }
+    if (!CHECK(cp && !strcmp(szProg, prog) && !strcmp(join_list(szEnv), env)
+        && !strcmp(cp, rest)))
+        fprintf(stderr, "  [%s]: got [%s] [%s] [%s]\n", args, cp ? szProg : "",
+            cp ? join_list(szEnv) : "", cp ? cp : "NULL");
+}
+
+
+// checks resolve_env() result: NULL shell means failure
+static void check_resolve(SHEBANG* psb, const char* args, const char* shell,
+    const char* env, const char* rest)
+{
+    TCHAR szShell[MAX_PATH], szEnv[MAX_PATH];
+    const char* cp = args;
+    BOOL ok = resolve_env(ARRAY(szShell), ARRAY(szEnv), psb, &cp);
+    if (!shell) {
+        if (!CHECK(!ok && cp == args && !*szEnv))
+            fprintf(stderr, "  [%s]: got [%s]\n", args, szShell);
+        return;
+    }
+    if (!CHECK(ok && strstr(szShell, shell) && !strcmp(join_list(szEnv), env)
+        && (rest ? cp && !strcmp(cp, rest) : !cp)))
+        fprintf(stderr, "  [%s]: got [%s] [%s] [%s]\n", args, ok ? szShell : "",
+            join_list(szEnv), cp ? cp : "NULL");
+}
+
+
+int main(void)
+{
+    char path[PATH_MAX], tmp[2 * PATH_MAX];
+    make_tree();
+
+    // which shells are env
+    CHECK(is_env("/usr/bin/env"));
+    CHECK(is_env("/bin/env"));
+    CHECK(is_env("env"));
+    CHECK(!is_env("/usr/bin/"));
+    CHECK(!is_env("/usr/bin/envx"));
+    CHECK(!is_env("/opt/env/sh"));
+    CHECK(!is_env(""));
+
+    // splitting
+    check_parse("bash", "bash", "", "");
+    check_parse("  python3 -u x", "python3", "", " -u x");
+    check_parse("-S LANG=C sh -x", "sh", "LANG=C", " -x");
+    check_parse("-SLANG=C sh", "sh", "LANG=C", "");
+    check_parse("--split-string=A=1 awk -f", "awk", "A=1", " -f");
+    check_parse("A=1 B= C=x=y perl", "perl", "A=1|B=|C=x=y", "");
+    check_parse("-S -S sh", "sh", "", "");
+    check_parse("-i sh", NULL, NULL, NULL);
+    check_parse("--ignore-environment sh", NULL, NULL, NULL);
+    check_parse("=x sh", NULL, NULL, NULL);
+    check_parse("A=1", NULL, NULL, NULL);
+    check_parse("-S", NULL, NULL, NULL);
+    check_parse("", NULL, NULL, NULL);
+    check_parse("   ", NULL, NULL, NULL);
+    check_parse("-S sh -c \"echo one two\" x", NULL, NULL, NULL);
+    check_parse("-S sh -c 'echo one two'", NULL, NULL, NULL);
+    check_parse("-S sh -c echo\\ one", NULL, NULL, NULL);
+    check_parse("-S A=${HOME}/x sh", NULL, NULL, NULL);
+    char szProg[8];
+    TCHAR szEnv[8];
+    CHECK(!parse_env("very_long_program", ARRAY(szProg), ARRAY(szEnv)));
+    CHECK(!parse_env("A=1 B=2 C=3 sh", ARRAY(szProg), ARRAY(szEnv)));
+
+    // MSYS tree: mingw64 layer and a tools directory on PATH, usr/bin is not
+    make_file(tree_path(ARRAY(path), "msys64/mingw64/bin/python3.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "msys64/usr/bin/bash.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "msys64/usr/bin/perl.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "msys64/usr/bin/env.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "msys64/opt/ruby/bin/ruby.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "tools/perl.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "tools dir/tclsh.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "scripts/script"),
+        "#!/usr/bin/env -S LANG=C bash -x\n", 0755);
+    snprintf(tmp, sizeof(tmp), "%s/tools:%s/tools dir:%s/msys64/mingw64/bin:"
+        "%s/scripts:/usr/bin:/bin", szTree, szTree, szTree, szTree);
+    setenv("PATH", tmp, 1);
+
+    SHEBANG sb;
+    shebang_init(&sb);
+    RESOLVED r;
+    CHECK(shebang_resolve(&sb, &r, "script") == ERROR_SUCCESS);
+    CHECK(sb.px.sys == POSIX_MINGW64);
+
+    // PATH first, then /usr/bin under root, or path as is
+    check_resolve(&sb, "perl -w", "\\tools\\perl.exe", "", "-w");
+    check_resolve(&sb, "-S A=1 python3 -u -", "\\mingw64\\bin\\python3.exe", "A=1",
+        "-u -");
+    check_resolve(&sb, "bash", "\\msys64\\usr\\bin\\bash.exe", "", NULL);
+    check_resolve(&sb, "tclsh", "tools dir\\tclsh.exe\"", "", NULL);
+    check_resolve(&sb, "/opt/ruby/bin/ruby x", "\\opt\\ruby\\bin\\ruby.exe", "", "x");
+    check_resolve(&sb, "A=1 missing", NULL, NULL, NULL);
+    check_resolve(&sb, "/opt/missing", NULL, NULL, NULL);
+    check_resolve(&sb, "-i bash", NULL, NULL, NULL);
+    check_resolve(&sb, "-S bash -c \"echo one two\"", NULL, NULL, NULL);
+
+    // whole script: no env.exe, assignments go to environment list
+    CHECK(strstr(r.szShellCmd, "\\usr\\bin\\bash.exe -x") != NULL);
+    CHECK(strstr(r.szShellCmd, "env") == NULL);
+    CHECK(!strcmp(r.szEnv, "LANG=C"));
+
+    // quoted -S line: env.exe gets it as written
+    make_file(tree_path(ARRAY(path), "scripts/quoted"),
+        "#!/usr/bin/env -S bash -c \"echo one two\" x\n", 0755);
+    CHECK(shebang_resolve(&sb, &r, "quoted") == ERROR_SUCCESS);
+    CHECK(strstr(r.szShellCmd, "\\usr\\bin\\env.exe -S bash -c \"echo one two\" x")
+        != NULL);
+    CHECK(!r.szEnv[0]);
+    shebang_free(&sb);
+
+    // host's own layer: PATH takes name as is, root adds no .exe
+    shebang_init(&sb);
+    sb.px.sys = POSIX_NATIVE;
+    StringCchCopy(ARRAY(sb.px.root), "C:");
+    check_resolve(&sb, "sh -e", "\\sh", "", "-e");
+    check_resolve(&sb, "python3.exe", "\\mingw64\\bin\\python3.exe", "", NULL);
+    check_resolve(&sb, "nosuch.exe", NULL, NULL, NULL);
+    shebang_free(&sb);
+
+    return done("env");
+}
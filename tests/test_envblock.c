@@ -0,0 +1,198 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Environment block: merging NAME=value list gives the same block as setting
+ *       variables one by one; MSYS variables skip those already set; host name is
+ *       looked up once until reboot
+ */
+
+
+#include "util.h"
+#include <ctype.h>
+#include "../libshebang.c"
+
+
+#define ROUNDS      20000
+#define ENTRIES     24
+
+
+// gets variable name length; "=C:" is a name too
+static size_t ref_name(const char* psz)
+{
+    const char* eq = strchr(psz + 1, '=');
+    return eq ? (size_t)(eq - psz) : strlen(psz);
+}
+
+
+// compares names as Win32 sorts environment: upper case, then code points
+static int ref_compare(const void* pv1, const void* pv2)
+{
+    const char* psz1 = *(const char* const*)pv1;
+    const char* psz2 = *(const char* const*)pv2;
+    size_t cch1 = ref_name(psz1), cch2 = ref_name(psz2);
+    for (size_t i = 0; i < cch1 && i < cch2; ++i) {
+        int c1 = toupper((unsigned char)psz1[i]);
+        int c2 = toupper((unsigned char)psz2[i]);
+        if (c1 != c2)
+            return c1 - c2;
+    }
+    return (cch1 > cch2) - (cch1 < cch2);
+}
+
+
+// sets variables one by one into array of entries, then sorts it into block
+static size_t ref_block(const char* block, const char* list, char* out)
+{
+    const char* entry[2 * ENTRIES + 64];
+    size_t cnt = 0, cch = 0;
+    for (int pass = 0; pass < 2; ++pass) {
+        for (const char* psz = pass ? list : block; psz && *psz;
+            psz += strlen(psz) + 1) {
+            size_t i = 0;
+            while (i < cnt && (ref_name(entry[i]) != ref_name(psz)
+                || strncasecmp(entry[i], psz, ref_name(psz))))
+                ++i;
+            if (i == cnt)
+                ++cnt;
+            entry[i] = psz;
+        }
+    }
+    qsort(entry, cnt, sizeof(entry[0]), ref_compare);
+    for (size_t i = 0; i < cnt; ++i) {
+        if (!strchr(entry[i] + 1, '='))
+            continue; // removed
+        strcpy(out + cch, entry[i]);
+        cch += strlen(entry[i]) + 1;
+    }
+    out[cch++] = '\0';
+    return cch;
+}
+
+
+// gets block size including final NUL
+static size_t block_size(const char* psz)
+{
+    const char* start = psz;
+    while (*psz)
+        psz += strlen(psz) + 1;
+    return (size_t)(psz - start) + 1;
+}
+
+
+// compares merged block with the reference
+static void check_block(const char* block, const char* list)
+{
+    static char ref[64 * 1024];
+    size_t cch = ref_block(block, list, ref);
+    PTSTR psz = shebang_env_block(block, list);
+    if (!CHECK(psz && block_size(psz) == cch && !memcmp(psz, ref, cch))) {
+        fprintf(stderr, "  got:");
+        for (PCTSTR pc = psz; pc && *pc; pc += strlen(pc) + 1)
+            fprintf(stderr, " [%s]", pc);
+        fprintf(stderr, "\n  expected:");
+        for (const char* pc = ref; *pc; pc += strlen(pc) + 1)
+            fprintf(stderr, " [%s]", pc);
+        fprintf(stderr, "\n");
+    }
+    HeapFree(GetProcessHeap(), 0, psz);
+}
+
+
+// makes random list of entries; returns its size
+static size_t random_list(char* buf, int cnt, BOOL remove)
+{
+    static const char alphabet[] = "aAbB_z1";
+    size_t cch = 0;
+    for (int i = 0; i < cnt; ++i) {
+        if (rand() % 8 == 0)
+            buf[cch++] = '=';
+        for (int n = 1 + rand() % 3; n; --n)
+            buf[cch++] = alphabet[rand() % (int)COUNT1(alphabet)];
+        if (!remove || rand() % 4) {
+            buf[cch++] = '=';
+            for (int n = rand() % 4; n; --n)
+                buf[cch++] = "x=;"[rand() % 3];
+        }
+        buf[cch++] = '\0';
+    }
+    buf[cch++] = '\0';
+    return cch;
+}
+
+
+// looks for NAME=value in list
+static BOOL has_entry(PCTSTR pszList, PCTSTR pszEntry)
+{
+    for (PCTSTR psz = pszList; *psz; psz += lstrlen(psz) + 1)
+        if (!lstrcmp(psz, pszEntry))
+            return TRUE;
+    return FALSE;
+}
+
+
+int main(void)
+{
+    char block[1024], list[1024];
+    setenv("HOSTNAME", "preset", 1);
+    setenv("USERNAME", "tester", 1);
+    unsetenv("USER");
+    make_tree();
+
+    // fixed cases
+    check_block(NULL, "");
+    check_block("", "A=1\0");
+    check_block("A=1\0B=2\0", "");
+    check_block("A=1\0B=2\0", "b=3\0");
+    check_block("A=1\0B=2\0", "B\0C\0");
+    check_block("=C:=C:\\x\0A=1\0Path=x\0", "PATH=y\0=D:=D:\\\0");
+    check_block("A_B=1\0AB=2\0A=3\0", "Z=\0a=\0");
+    check_block("X=1\0", "X=2\0X=3\0X\0X=4\0");
+
+    // random blocks and lists
+    srand(2024);
+    for (int k = 0; k < ROUNDS && !failed; ++k) {
+        random_list(block, rand() % ENTRIES, FALSE);
+        random_list(list, rand() % 8, TRUE);
+        check_block(rand() % 16 ? block : NULL, list);
+    }
+
+    // MSYS variables; USER from USERNAME, HOSTNAME is set already
+    SHEBANG sb;
+    RESOLVED r = {0};
+    TCHAR sz[1024];
+    shebang_init(&sb);
+    r.px.sys = POSIX_MINGW64;
+    StringCchCopy(ARRAY(r.px.root), "C:\\msys64");
+    CHECK(shebang_env(&sb, &r, ARRAY(sz)));
+    CHECK(has_entry(sz, "MSYSTEM=MINGW64") && has_entry(sz, "MSYSTEM_PREFIX=/mingw64")
+        && has_entry(sz, "MINGW_PREFIX=/mingw64") && has_entry(sz, "USER=tester"));
+    for (PCTSTR psz = sz; *psz; psz += lstrlen(psz) + 1)
+        CHECK(compare_names(psz, "HOSTNAME"));
+    r.px.sys = POSIX_MSYS;
+    StringCchCopy(ARRAY(r.szEnv), "LANG=C");
+    CHECK(shebang_env(&sb, &r, ARRAY(sz)));
+    CHECK(has_entry(sz, "MSYSTEM=MSYS") && has_entry(sz, "MINGW_PREFIX")
+        && has_entry(sz, "LANG=C"));
+    CHECK(!shebang_env(&sb, &r, sz, 16));
+    r.px.sys = POSIX_NATIVE;
+    CHECK(shebang_env(&sb, &r, ARRAY(sz)) && !lstrcmp(sz, "LANG=C"));
+    shebang_free(&sb);
+
+    // host name: slow lookup once, then saved one until reboot or damage
+    TCHAR szHost[256], szSaved[256];
+    posixHostDelay = 200000;
+    double t = now_ns();
+    CHECK(get_hostname(ARRAY(szHost)) && szHost[0]);
+    CHECK((now_ns() - t) / 1e6 >= 190);
+    t = now_ns();
+    CHECK(get_hostname(ARRAY(szSaved)) && !lstrcmp(szHost, szSaved));
+    CHECK((now_ns() - t) / 1e6 < 100);
+    char path[PATH_MAX];
+    CHECK(!truncate(tree_path(ARRAY(path), "shebang.host"), 8));
+    t = now_ns();
+    CHECK(get_hostname(ARRAY(szSaved)) && !lstrcmp(szHost, szSaved));
+    CHECK((now_ns() - t) / 1e6 >= 190);
+    posixHostDelay = 0;
+
+    return done("envblock");
+}
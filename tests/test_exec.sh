@@ -0,0 +1,129 @@
+#!/bin/sh
+# Proj: shebang
+# Desc: Linux launcher dispatches by name and execs the shell in its place
+# Note: $SHEBANG is the launcher built over the POSIX platform layer
+
+SHEBANG=${SHEBANG:-build/shebang}
+T=$(mktemp -d "${TMPDIR:-/tmp}/shebang-test-XXXXXX") || exit 1
+trap 'rm -rf "$T"' EXIT
+export TMPDIR=$T
+failed=0
+
+# check name expected actual
+check() {
+    if [ "$2" != "$3" ]; then
+        printf '%s: expected [%s], got [%s]\n' "$1" "$2" "$3" >&2
+        failed=$((failed + 1))
+    fi
+}
+
+# launcher copy per script; /proc/self/exe sees through symlinks
+mkdir -p "$T/bin" "$T/scripts"
+for name in args self killed env msys; do
+    cp "$SHEBANG" "$T/bin/$name.exe"
+done
+
+# scripts from a shared tree need no exec bit
+cat >"$T/scripts/args" <<'EOF'
+#!/bin/sh -u
+printf '%s|' "$#" "$@"
+echo "${MSYSTEM-none}"
+exit 7
+EOF
+cat >"$T/scripts/self" <<'EOF'
+#!/bin/sh
+echo $$
+EOF
+cat >"$T/scripts/killed" <<'EOF'
+#!/bin/sh
+kill -TERM $$
+sleep 5
+EOF
+cat >"$T/scripts/env" <<'EOF'
+#!/usr/bin/env -S GREETING=hi sh
+echo "$GREETING"
+EOF
+export PATH="$T/bin:$T/scripts:$PATH"
+
+# native: args as given, exit code as is, no MSYS variables
+out=$(args.exe a "b c" 'd"e' 'f\' '' "g\\\"h")
+check "exit code" 7 $?
+check "args" '6|a|b c|d"e|f\||g\"h|none' "$out"
+
+# exec in place: same process
+out=$(sh -c 'echo $$; exec self.exe')
+check "pid" "$(echo "$out" | sed -n 1p)" "$(echo "$out" | sed -n 2p)"
+
+# signal kills the launcher process itself
+check "signal" 143 "$(sh -c 'killed.exe; echo $?' 2>/dev/null)"
+
+# env shebang without env
+check "env" hi "$(env.exe)"
+
+# quoted -S line is split by env itself
+cp "$SHEBANG" "$T/bin/envq.exe"
+printf '#!/usr/bin/env -S sh -c "echo one  two" x\n' >"$T/scripts/envq"
+check "env quoted" "one two" "$(envq.exe)"
+
+# shebang args go to the shell as written: quotes group words
+cp "$SHEBANG" "$T/bin/quoted.exe"
+printf '#!/bin/sh -c "echo a  b" x\n' >"$T/scripts/quoted"
+check "quoted args" "a b" "$(quoted.exe)"
+
+# [interpreters] of shebang.ini next to the launcher: missing substitute is skipped,
+# SHEBANG_SUBST goes first
+mkdir -p "$T/cfg"
+cp "$SHEBANG" "$T/cfg/subst.exe"
+printf '[interpreters]\n/bin/nosuch=/bin/missing\n/bin/nosuch=/bin/sh\n' \
+    >"$T/cfg/shebang.ini"
+printf '#!/bin/nosuch\ncase $- in *u*) echo u;; *) echo "$0";; esac\n' \
+    >"$T/scripts/subst"
+check "subst ini" "$T/scripts/subst" "$("$T/cfg/subst.exe")"
+check "subst env" u "$(SHEBANG_SUBST='/bin/nosuch=/bin/sh -u' "$T/cfg/subst.exe")"
+out=$(SHEBANG_SUBST='/bin/nosuch=/bin/missing' "$T/cfg/subst.exe" 2>/dev/null)
+check "subst fallback" "$T/scripts/subst" "$out"
+rm "$T/cfg/shebang.ini"
+out=$("$T/cfg/subst.exe" 2>/dev/null)
+check "subst none" 3 $?
+
+# MSYS tree on PATH takes over: MSYSTEM is set, script path is converted
+mkdir -p "$T/msys64/usr/bin"
+ln -s "$(command -v sh)" "$T/msys64/usr/bin/sh.exe"
+cp "$T/scripts/args" "$T/scripts/msys"
+out=$(PATH="$T/msys64/usr/bin:$PATH" msys.exe x)
+check "msys" '1|x|MSYS' "$out"
+
+# --install makes copy that takes resolution from its trailer
+mkdir -p "$T/inst"
+cp "$SHEBANG" "$T/inst/shebang"
+"$T/inst/shebang" --install args
+out=$(SHEBANG_TRACE=$T/trace "$T/inst/args.exe" z)
+check "installed" '1|z|none' "$out"
+check "trailer" trailer "$(sed -n 's/.*"source":"\([a-z]*\)".*/\1/p' "$T/trace")"
+
+# --batch runs every job; after Ctrl+C running jobs finish, the rest never start
+printf '#!/bin/sh\necho "$1" >>"$T/marks"\nsleep ${2:-0}\n' >"$T/scripts/job"
+printf 'job 1\njob 2\njob 3\n' >"$T/jobs"
+T=$T "$T/inst/shebang" --batch "$T/jobs" -j 2 2>/dev/null
+check "batch" 0 $?
+check "batch jobs" 3 "$(wc -l <"$T/marks")"
+rm "$T/marks"
+printf 'job %d 1\n' 1 2 3 4 5 6 >"$T/jobs"
+T=$T "$T/inst/shebang" --batch "$T/jobs" -j 2 2>/dev/null &
+sleep 0.5
+kill -INT $!
+wait $!
+check "batch stopped" 199 $? # ERROR_CANCELLED
+check "batch started" 2 "$(wc -l <"$T/marks")"
+
+# command line over the OS limit fails loudly
+out=$(args.exe "$(printf '%040000d' 0)" 2>&1)
+check "overlong" 206 $?
+check "overlong error" "shebang error:" "$(echo "$out" | cut -c1-14)"
+
+# unknown name
+out=$(cp "$SHEBANG" "$T/bin/none.exe" && none.exe 2>&1)
+check "missing script" 2 $?
+
+[ $failed = 0 ] && echo "ok exec" || echo "FAIL exec"
+exit $failed
@@ -0,0 +1,111 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Single PATH scan: the first directory with the script wins over its
+ *       duplicates, and the first root is found wherever it is relative to the
+ *       script; same with parallel probing
+ * Note: Each case runs in a child, as environment is read once per process
+ */
+
+
+#include "util.h"
+#include <sys/wait.h>
+#include "../libshebang.c"
+
+
+// PATH entries, entry with the script and expected root
+typedef struct {
+    const char* entries[5];
+    const char* scripts;    // indices of entries having the script, "d" a directory
+    int found;              // entry the script is found in
+    int sys;                // layer and entry it is the root of
+    int rootEntry;
+    const char* tail;       // what is not the root in that entry
+} CASE;
+
+static const CASE cases[] = {
+    // root after the script, duplicate script after the root
+    { { "a/s1", "a/msys64/usr/bin", "a/s2" }, "02", 0, POSIX_MSYS, 1, "/usr/bin" },
+    // root before the script, other root after it
+    { { "b/msys64/ucrt64/bin", "b/s1", "b/s2", "b/cygwin64/bin" }, "12", 1,
+        POSIX_UCRT64, 0, "/ucrt64/bin" },
+    // directory named like the script is no match
+    { { "c/d1", "c/s1", "c/msys64/usr/bin" }, "d01", 1, POSIX_MSYS, 2, "/usr/bin" },
+    // first of two roots before the script
+    { { "e/cygwin64/bin", "e/msys64/usr/bin", "e/s1" }, "2", 2, POSIX_CYGWIN, 0,
+        "/bin" },
+    // root after both duplicates
+    { { "f/s1", "f/s2", "f/msys64/mingw64/bin" }, "01", 0, POSIX_MINGW64, 2,
+        "/mingw64/bin" }
+};
+
+
+// resolves case in a child; reports mismatch
+static void check_case(int k, const char* pszProbe)
+{
+    int status;
+    pid_t pid = fork();
+    if (pid) {
+        if (!CHECK(pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status)))
+            return;
+        failed += WEXITSTATUS(status);
+        return;
+    }
+
+    const CASE* pc = &cases[k];
+    char path[PATH_MAX], tmp[PATH_MAX], szPATH[8 * PATH_MAX];
+    size_t cch = 0;
+    for (int i = 0; i < (int)COUNT(pc->entries) && pc->entries[i]; ++i)
+        cch += (size_t)snprintf(szPATH + cch, sizeof(szPATH) - cch, "%s%s/%s",
+            cch ? ":" : "", szTree, pc->entries[i]);
+    setenv("PATH", szPATH, 1);
+    setenv("SHEBANG_PROBE", pszProbe, 1);
+
+    SHEBANG sb;
+    RESOLVED r;
+    shebang_init(&sb);
+    DWORD dw = shebang_find(&sb, &r, "myscript");
+    shebang_free(&sb);
+
+    snprintf(tmp, sizeof(tmp), "%s/%s/myscript", szTree, pc->entries[pc->found]);
+    native(ARRAY(path), tmp);
+    BOOL ok = (dw == ERROR_SUCCESS && !lstrcmp(r.szScript, path));
+    snprintf(tmp, sizeof(tmp), "%s/%s", szTree, pc->entries[pc->rootEntry]);
+    tmp[strlen(tmp) - strlen(pc->tail)] = '\0';
+    native(ARRAY(path), tmp);
+    ok = ok && r.px.sys == pc->sys && !lstrcmp(r.px.root, path);
+    if (!CHECK(ok))
+        fprintf(stderr, "  case %d, SHEBANG_PROBE=%s: %lu, %s, %d %s\n", k, pszProbe,
+            (unsigned long)dw, r.szScript, r.px.sys, r.px.root);
+    _exit(failed);
+}
+
+
+int main(void)
+{
+    char path[PATH_MAX];
+    make_tree();
+    unsetenv("SHEBANG_SUBST");
+
+    for (int k = 0; k < (int)COUNT(cases); ++k) {
+        const CASE* pc = &cases[k];
+        for (int i = 0; i < (int)COUNT(pc->entries) && pc->entries[i]; ++i)
+            make_dir(tree_path(ARRAY(path), "%s", pc->entries[i]));
+        for (const char* p = pc->scripts; *p; ++p) {
+            BOOL dir = (*p == 'd');
+            tree_path(ARRAY(path), "%s/myscript", pc->entries[p[dir] - '0']);
+            if (dir)
+                make_dir(path), ++p;
+            else
+                make_file(path, "#!/bin/sh\n", 0755);
+        }
+    }
+
+    // sequential scan, then parallel probing
+    static const char* const probes[] = { "1", "4" };
+    for (int j = 0; j < (int)COUNT(probes); ++j)
+        for (int k = 0; k < (int)COUNT(cases); ++k)
+            check_case(k, probes[j]);
+
+    return done("find");
+}
@@ -0,0 +1,183 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: fstab mount table: odd lines are parsed as Cygwin does, lookup finds the
+ *       longest mount point, compiled table is reused until fstab changes
+ */
+
+
+#include "util.h"
+#include "../libshebang.c"
+
+
+#define ENTRIES     4096
+#define ROUNDS      20000
+
+
+// starts context over the MSYS root
+static void init_msys(SHEBANG* psb)
+{
+    char path[PATH_MAX];
+    shebang_init(psb);
+    psb->px.sys = POSIX_MSYS;
+    native(ARRAY(psb->px.root), tree_path(ARRAY(path), "msys64"));
+}
+
+
+// checks which mount point path falls under, NULL for none
+static void check_mount(SHEBANG* psb, const char* from, const char* posix,
+    const char* win)
+{
+    const MOUNT* pm = find_mount(psb, from);
+    if (!posix) {
+        if (!CHECK(pm == NULL))
+            fprintf(stderr, "  [%s]: got [%s]\n", from, pm->posix);
+        return;
+    }
+    if (!CHECK(pm && !strcmp(pm->posix, posix) && pm->cch == strlen(posix)
+        && !strcmp(pm->win, win)))
+        fprintf(stderr, "  [%s]: got [%s] [%s]\n", from, pm ? pm->posix : "NULL",
+            pm ? pm->win : "");
+}
+
+
+// finds mount point the plain way: longest one that is a whole prefix, first of
+// equal ones in the file
+static int ref_find(char (*posix)[64], int cnt, const char* from)
+{
+    int found = -1;
+    size_t cchFound = 0;
+    for (int i = 0; i < cnt; ++i) {
+        size_t cch = strlen(posix[i]);
+        if (cch > cchFound && !strncmp(from, posix[i], cch)
+            && (from[cch] == '/' || from[cch] == '\0')) {
+            found = i;
+            cchFound = cch;
+        }
+    }
+    return found;
+}
+
+
+// checks if context took the compiled table
+static BOOL from_saved(const SHEBANG* psb)
+{
+    return psb->pcFstab && ((const MOUNTS*)psb->pcFstab)->magic == MOUNTS_MAGIC;
+}
+
+
+int main(void)
+{
+    char path[PATH_MAX], fstab[PATH_MAX];
+    make_tree();
+    tree_path(ARRAY(fstab), "msys64/etc/fstab");
+
+    // comments, escapes, UNC, trailing slashes, CRLF; no cygdrive, usertemp, root,
+    // relative or incomplete lines
+    make_file(fstab,
+        "# comment\n"
+        "C:/msys64/home /home ntfs binary 0 0\r\n"
+        "  D:\\data\\040x /mnt/my\\040data\tntfs binary 0 0\n"
+        "//server/share /net/share smbfs binary 0 0\n"
+        "none /cygdrive cygdrive binary,posix=0,user 0 0\n"
+        "none /tmp usertemp binary,posix=0 0 0\n"
+        "C:/x /opt/x/// ntfs binary 0 0\n"
+        "C:/root / ntfs binary 0 0\n"
+        "C:/rel rel ntfs binary 0 0\n"
+        "C:/incomplete /incomplete\n"
+        "\n"
+        "C:/xy /opt/x/y ntfs # binary\n"
+        "/opt /opt/slash ntfs binary 0 0\n"
+        "C:/last /last ntfs", 0644);
+    SHEBANG sb;
+    init_msys(&sb);
+    CHECK(load_fstab(&sb) == 6);
+    for (int i = 1; i < sb.cntMount; ++i)
+        CHECK(sb.pm[i - 1].cch >= sb.pm[i].cch);
+    check_mount(&sb, "/home/user/bin/sh", "/home", "C:/msys64/home");
+    check_mount(&sb, "/home", "/home", "C:/msys64/home");
+    check_mount(&sb, "/homer", NULL, NULL);
+    check_mount(&sb, "/mnt/my data/x", "/mnt/my data", "D:\\data x");
+    check_mount(&sb, "/net/share/sh", "/net/share", "//server/share");
+    check_mount(&sb, "/opt/x/y/z", "/opt/x/y", "C:/xy");
+    check_mount(&sb, "/opt/x/yz", "/opt/x", "C:/x");
+    check_mount(&sb, "/opt/x", "/opt/x", "C:/x");
+    check_mount(&sb, "/opt/xx", NULL, NULL);
+    check_mount(&sb, "/opt/slash", NULL, NULL);
+    check_mount(&sb, "/last/sh", "/last", "C:/last");
+    check_mount(&sb, "/cygdrive/c", NULL, NULL);
+    check_mount(&sb, "/tmp/x", NULL, NULL);
+    check_mount(&sb, "/", NULL, NULL);
+    check_mount(&sb, "", NULL, NULL);
+    CHECK(!from_saved(&sb));
+    shebang_free(&sb);
+
+    // compiled table is taken next time
+    init_msys(&sb);
+    CHECK(load_fstab(&sb) == 6 && from_saved(&sb));
+    check_mount(&sb, "/mnt/my data/x", "/mnt/my data", "D:\\data x");
+    check_mount(&sb, "/opt/x/y/z", "/opt/x/y", "C:/xy");
+    shebang_free(&sb);
+
+    // large table of nested mount points against the plain search
+    static char posix[ENTRIES][64];
+    size_t cb = ENTRIES * 96, cch = 0;
+    char* buf = malloc(cb);
+    srand(8088);
+    for (int i = 0; i < ENTRIES; ++i) {
+        size_t n = 0;
+        for (int k = 1 + rand() % 5; k; --k)
+            n += (size_t)snprintf(posix[i] + n, sizeof(posix[i]) - n, "/%c%s",
+                "abcd"[rand() % 4], rand() % 4 ? "" : "x");
+        cch += (size_t)snprintf(buf + cch, cb - cch, "C:/w%05d %s ntfs binary 0 0\n",
+            i, posix[i]);
+    }
+    make_file(fstab, buf, 0644);
+    init_msys(&sb);
+    CHECK(load_fstab(&sb) == ENTRIES && !from_saved(&sb));
+    int hits = 0;
+    for (int k = 0; k < ROUNDS; ++k) {
+        char from[64], win[16];
+        size_t n = 0;
+        for (int j = 1 + rand() % 7; j; --j)
+            n += (size_t)snprintf(from + n, sizeof(from) - n, "/%c%s",
+                "abcde"[rand() % 5], rand() % 4 ? "" : "x");
+        int i = ref_find(posix, ENTRIES, from);
+        if (i >= 0) {
+            snprintf(ARRAY(win), "C:/w%05d", i);
+            ++hits;
+        }
+        check_mount(&sb, from, i >= 0 ? posix[i] : NULL, win);
+        if (failed > 10)
+            break;
+    }
+    CHECK(hits > ROUNDS / 4 && hits < ROUNDS);
+    shebang_free(&sb);
+
+    // damaged compiled table is parsed again
+    init_msys(&sb);
+    CHECK(load_fstab(&sb) == ENTRIES && from_saved(&sb));
+    shebang_free(&sb);
+    tree_path(ARRAY(path), "shebang.mounts");
+    FILE* f = fopen(path, "r+b");
+    fseek(f, -5, SEEK_END);
+    fputc('?', f);
+    fclose(f);
+    init_msys(&sb);
+    CHECK(load_fstab(&sb) == ENTRIES && !from_saved(&sb));
+    shebang_free(&sb);
+
+    // fstab changed
+    buf[cch - 1] = '\0';
+    make_file(fstab, strchr(buf, '\n') + 1, 0644);
+    free(buf);
+    init_msys(&sb);
+    CHECK(load_fstab(&sb) == ENTRIES - 1 && !from_saved(&sb));
+    shebang_free(&sb);
+    CHECK(!unlink(fstab));
+    init_msys(&sb);
+    CHECK(load_fstab(&sb) == 0 && find_mount(&sb, posix[1]) == NULL);
+    shebang_free(&sb);
+
+    return done("fstab");
+}
@@ -0,0 +1,132 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: libshebang contexts: synthetic MSYS tree resolved by parallel threads
+ *       gives the same results as by a single one
+ */
+
+
+#include "util.h"
+#include "../libshebang.c"
+
+
+#define SCRIPTS     24
+#define THREADS     8
+
+static const char* const shebangs[] = {
+    "#!/bin/sh\n",
+    "#!/bin/bash -e\n",
+    "#!/usr/bin/env bash\n",
+    "#!/usr/bin/env -S LANG=C sh -x\n",
+    "#! /usr/bin/sh\r\n",
+    "#!/opt/tool/bin/sh\n"
+};
+
+static RESOLVED expected[SCRIPTS];
+
+
+// script name by number
+static void script_name(char* buf, size_t cb, int i)
+{
+    snprintf(buf, cb, "script%02d", i);
+}
+
+
+// resolves every script through own context, starting from a different one
+static DWORD WINAPI resolve_all(LPVOID pv)
+{
+    int first = (int)(INT_PTR)pv, bad = 0;
+    SHEBANG sb;
+    shebang_init(&sb);
+    for (int k = 0; k < SCRIPTS; ++k) {
+        int i = (first + k) % SCRIPTS;
+        char name[16];
+        RESOLVED r;
+        script_name(ARRAY(name), i);
+        if (shebang_resolve(&sb, &r, name) != ERROR_SUCCESS
+            || strcmp(r.szScript, expected[i].szScript)
+            || strcmp(r.szShellCmd, expected[i].szShellCmd)
+            || strcmp(r.szEnv, expected[i].szEnv))
+            ++bad;
+    }
+    shebang_free(&sb);
+    return (DWORD)bad;
+}
+
+
+int main(void)
+{
+    char path[PATH_MAX], tmp[2 * PATH_MAX];
+    make_tree();
+
+    // MSYS root with /opt mounted elsewhere, scripts in a PATH directory of their own
+    make_file(tree_path(ARRAY(path), "msys64/usr/bin/sh.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "msys64/usr/bin/bash.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "msys64/usr/bin/env.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "tools/bin/sh.exe"), "", 0755);
+    snprintf(tmp, sizeof(tmp), "%s\\tools /opt/tool ntfs binary 0 0\n",
+        native(ARRAY(path), szTree));
+    make_file(tree_path(ARRAY(path), "msys64/etc/fstab"), tmp, 0644);
+    for (int i = 0; i < SCRIPTS; ++i) {
+        char name[16];
+        script_name(ARRAY(name), i);
+        make_file(tree_path(ARRAY(path), "scripts/%s", name),
+            shebangs[i % COUNT(shebangs)], 0755);
+    }
+    snprintf(tmp, sizeof(tmp), "%s/scripts:%s/msys64/usr/bin:/usr/bin:/bin", szTree,
+        szTree);
+    setenv("PATH", tmp, 1);
+    setenv("USERNAME", "tester", 1);
+    unsetenv("HOSTNAME");
+    unsetenv("SHEBANG_SUBST");
+
+    // single thread
+    SHEBANG sb;
+    shebang_init(&sb);
+    for (int i = 0; i < SCRIPTS; ++i) {
+        char name[16];
+        script_name(ARRAY(name), i);
+        CHECK(shebang_resolve(&sb, &expected[i], name) == ERROR_SUCCESS);
+    }
+    CHECK(sb.px.sys == POSIX_MSYS);
+    CHECK(strstr(expected[0].szShellCmd, "\\msys64\\usr\\bin\\sh.exe") != NULL);
+    CHECK(strstr(expected[1].szShellCmd, "bash.exe\" -e") != NULL
+        || strstr(expected[1].szShellCmd, "bash.exe -e") != NULL);
+    CHECK(strstr(expected[2].szShellCmd, "bash.exe") != NULL);
+    CHECK(!strcmp(expected[3].szEnv, "LANG=C"));
+    CHECK(strstr(expected[5].szShellCmd, "\\tools\\bin\\sh.exe") != NULL);
+    CHECK(shebang_check(&expected[0]));
+
+    // environment: MSYS layer, USER from USERNAME, host name looked up
+    TCHAR szList[1024];
+    CHECK(shebang_env(&sb, &expected[3], ARRAY(szList)));
+    const char* psz = szList;
+    int have = 0;
+    for ( ; *psz; psz += strlen(psz) + 1) {
+        have |= !strcmp(psz, "MSYSTEM=MSYS") << 0;
+        have |= !strcmp(psz, "USER=tester") << 1;
+        have |= !strncmp(psz, "HOSTNAME=", 9) << 2;
+        have |= !strcmp(psz, "LANG=C") << 3;
+    }
+    CHECK(have == 15);
+    shebang_free(&sb);
+
+    // parallel contexts
+    HANDLE ah[THREADS];
+    for (int i = 0; i < THREADS; ++i)
+        CHECK((ah[i] = CreateThread(NULL, 0, resolve_all, (LPVOID)(INT_PTR)(i * 3), 0,
+            NULL)) != NULL);
+    CHECK(WaitForMultipleObjects(THREADS, ah, TRUE, 60000) == WAIT_OBJECT_0);
+    for (int i = 0; i < THREADS; ++i) {
+        DWORD dw = 1;
+        GetExitCodeThread(ah[i], &dw);
+        CHECK(dw == 0);
+        CloseHandle(ah[i]);
+    }
+
+    // script changed
+    make_file(tree_path(ARRAY(path), "scripts/script00"), "#!/bin/bash\n", 0755);
+    CHECK(!shebang_check(&expected[0]));
+
+    return done("lib");
+}
@@ -0,0 +1,174 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Memory bound of launch: peak stack and heap of resolution, command line
+ *       and environment stay under fixed limits plus what the inputs take, for
+ *       short and overlong command lines, long PATH and large environment
+ * Note: Stack is measured on a painted thread stack, heap by counting launcher
+ *       allocations; the shim may use more, as Win32 itself does
+ */
+
+
+#include "util.h"
+#include <pthread.h>
+
+#define HEADER      16  // keeps blocks aligned as malloc does
+
+// launcher heap: live and peak bytes
+static size_t cbLive, cbPeak;
+
+// allocates counted block: its size goes before it
+static LPVOID counted_alloc(HANDLE hHeap, DWORD dwFlags, SIZE_T dwBytes)
+{
+    size_t* p = HeapAlloc(hHeap, dwFlags, dwBytes + HEADER);
+    if (!p)
+        return NULL;
+    *p = dwBytes;
+    if ((cbLive += dwBytes) > cbPeak)
+        cbPeak = cbLive;
+    return (char*)p + HEADER;
+}
+
+// frees counted block
+static BOOL counted_free(HANDLE hHeap, DWORD dwFlags, LPVOID lpMem)
+{
+    if (!lpMem)
+        return TRUE;
+    size_t* p = (size_t*)((char*)lpMem - HEADER);
+    cbLive -= *p;
+    return HeapFree(hHeap, dwFlags, p);
+}
+
+#define HeapAlloc   counted_alloc
+#define HeapFree    counted_free
+#define main shebang_main
+#include "../shebang.c"
+#undef main
+#include "../libshebang.c"
+#undef HeapAlloc
+#undef HeapFree
+
+
+#define STACK_SIZE  (1024 * 1024)
+#define STACK_MAX   (32 * 1024)     // launcher stack, any inputs
+#define HEAP_MAX    (8 * 1024)      // launcher heap on top of inputs
+#define PAINT       0xa5
+
+// one launch
+typedef struct {
+    const char* name;   // what is run
+    PCTSTR pszArgs;     // its arguments
+    size_t cbStack;     // peak stack
+    size_t cbHeap;      // peak heap
+    size_t cbInputs;    // command line and environment bytes
+} LAUNCH;
+
+
+// runs launch as _tmain does up to exec
+static void* run_launch(void* pv)
+{
+    LAUNCH* pl = pv;
+    SHEBANG sb;
+    RESOLVED r;
+    CACHE cache = {0};
+    TCHAR szVars[1024];
+    shebang_init(&sb);
+    r.px.sys = POSIX_UNKNOWN;
+    r.szScript[0] = r.szShellCmd[0] = TEXT('\0');
+    if (!cache_lookup(&cache, &r, pl->name)) {
+        if (!CHECK(resolve_script(&sb, &r, pl->name) == ERROR_SUCCESS))
+            return NULL;
+        cache_store(&cache, &r);
+    }
+    size_t cchCmdLine = shebang_cmdline(NULL, &r, pl->pszArgs);
+    PTSTR pszCmdLine = counted_alloc(GetProcessHeap(), 0, cchCmdLine * sizeof(TCHAR));
+    CHECK(pszCmdLine && shebang_cmdline(pszCmdLine, &r, pl->pszArgs) == cchCmdLine);
+    CHECK(shebang_env(&sb, &r, ARRAY(szVars)));
+    PCTSTR pszBlock = get_env_block();
+    PTSTR pszEnvBlock = shebang_env_block(pszBlock, szVars);
+    CHECK(pszEnvBlock != NULL);
+    size_t cchBlock = 0;
+    while (pszBlock[cchBlock])
+        cchBlock += lstrlen(pszBlock + cchBlock) + 1;
+    pl->cbInputs = (cchCmdLine + cchBlock + 1) * sizeof(TCHAR);
+    pl->cbHeap = cbPeak;
+    counted_free(GetProcessHeap(), 0, pszEnvBlock);
+    counted_free(GetProcessHeap(), 0, pszCmdLine);
+    shebang_free(&sb);
+    // note: launcher leaves cache open till exit
+    if (cache.bucket)
+        UnmapViewOfFile(cache.bucket);
+    if (cache.hFile && cache.hFile != INVALID_HANDLE_VALUE)
+        CloseHandle(cache.hFile);
+    return NULL;
+}
+
+
+// launches on painted stack; checks peak stack and heap
+static void check_launch(LAUNCH* pl)
+{
+    static unsigned char stack[STACK_SIZE] __attribute__((aligned(4096)));
+    memset(stack, PAINT, sizeof(stack));
+    cbLive = cbPeak = 0;
+
+    pthread_attr_t attr;
+    pthread_t thread;
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, stack, sizeof(stack));
+    if (!CHECK(!pthread_create(&thread, &attr, run_launch, pl)))
+        return;
+    pthread_join(thread, NULL);
+    pthread_attr_destroy(&attr);
+    size_t cb = 0;
+    while (cb < sizeof(stack) && stack[cb] == PAINT)
+        ++cb;
+    pl->cbStack = sizeof(stack) - cb;
+
+    if (!CHECK(pl->cbStack <= STACK_MAX && pl->cbHeap <= pl->cbInputs + HEAP_MAX))
+        fprintf(stderr, "  %s: stack %zu, heap %zu for %zu bytes of inputs\n",
+            pl->name, pl->cbStack, pl->cbHeap, pl->cbInputs);
+}
+
+
+int main(void)
+{
+    static char szPATH[200 * 64], szArg[30001];
+    char path[PATH_MAX];
+    size_t cch = 0;
+    make_tree();
+    unsetenv("SHEBANG_PROBE");
+    unsetenv("SHEBANG_SUBST");
+
+    // environment of a terminal server session, read once
+    for (int i = 0; i < 200; ++i) {
+        snprintf(ARRAY(path), "SESSION_VAR%03d", i);
+        setenv(path, "C:\\Program Files\\Common Files\\Vendor\\Product", 1);
+    }
+
+    // long PATH, MSYS root, scripts with and without env shebang
+    for (int d = 0; d < 200; ++d) {
+        make_dir(tree_path(ARRAY(path), "p%03d", d));
+        cch += (size_t)snprintf(szPATH + cch, sizeof(szPATH) - cch, "%s:", path);
+    }
+    make_file(tree_path(ARRAY(path), "msys64/usr/bin/bash.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "msys64/usr/bin/env.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "scripts/script"), "#!/bin/bash -e\n", 0755);
+    make_file(tree_path(ARRAY(path), "scripts/envscript"),
+        "#!/usr/bin/env -S LANG=C.UTF-8 TZ=UTC bash\n", 0755);
+    snprintf(szPATH + cch, sizeof(szPATH) - cch, "%s/msys64/usr/bin:%s/scripts",
+        szTree, szTree);
+    setenv("PATH", szPATH, 1);
+    memset(szArg, 'x', sizeof(szArg) - 1);
+
+    LAUNCH launches[] = {
+        { "script", "a b", 0, 0, 0 },
+        { "envscript", "-x \"with space\"", 0, 0, 0 },
+        { "script", szArg, 0, 0, 0 }
+    };
+    for (int i = 0; i < (int)COUNT(launches); ++i)
+        check_launch(&launches[i]);
+    // cache hit is no bigger
+    check_launch(&launches[0]);
+
+    return done("mem");
+}
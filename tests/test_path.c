@@ -0,0 +1,114 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: PATH tokenizer: the same entries as a plain split, and scripts found at the
+ *       end of PATH longer than 32K chars
+ */
+
+
+#include "util.h"
+#include "../libshebang.c"
+
+
+#define ROUNDS      100000
+#define FILLERS     1000    // about 45 chars each
+
+
+// splits list into entries the plain way: at unquoted semicolons, then drops
+// enclosing quotes and empty entries; returns number of entries
+static int ref_split(const char* psz, char (*entry)[256])
+{
+    int n = 0;
+    for (;;) {
+        char tmp[256];
+        size_t cch = 0;
+        int quoted = 0;
+        for ( ; *psz && (quoted || *psz != ';'); ++psz) {
+            quoted ^= (*psz == '"');
+            if (cch + 1 < sizeof(tmp))
+                tmp[cch++] = *psz;
+        }
+        tmp[cch] = '\0';
+        char* cp = tmp;
+        if (cch >= 2 && tmp[0] == '"' && tmp[cch - 1] == '"') {
+            tmp[cch - 1] = '\0';
+            ++cp;
+        }
+        if (*cp)
+            strcpy(entry[n++], cp);
+        if (!*psz++)
+            return n;
+    }
+}
+
+
+// compares tokenizer with the plain split
+static void check_split(const char* psz)
+{
+    static char ref[1024][256];
+    int n = ref_split(psz, ref), i = 0;
+    PCTSTR pszEntry;
+    size_t cch;
+    for (PCTSTR cp = psz; (cch = next_path(&cp, &pszEntry)) != 0; ++i) {
+        if (!CHECK(i < n && cch == strlen(ref[i]) && !memcmp(pszEntry, ref[i], cch)))
+            break;
+        CHECK(pszEntry >= psz && pszEntry + cch <= psz + strlen(psz));
+    }
+    if (!CHECK(i == n))
+        fprintf(stderr, "  [%s]: %d entries, expected %d\n", psz, i, n);
+}
+
+
+int main(void)
+{
+    char path[PATH_MAX];
+    make_tree();
+
+    // empty, quoted and odd entries
+    static const char* const lists[] = {
+        "", ";", ";;;", "a", "a;", ";a", "a;;b", "\"a;b\";c", "\"\";a", "\"a\"\"b\"",
+        "\"unterminated;a", "C:\\x y;\"C:\\Program Files\\z\";", "\"", "a\"b;c\"d;e",
+        "\"\"\"\";\"x\""
+    };
+    for (int i = 0; i < (int)COUNT(lists); ++i)
+        check_split(lists[i]);
+
+    // random lists over chars that matter
+    static const char alphabet[] = "ab;;\"\" ";
+    srand(777);
+    for (int k = 0; k < ROUNDS; ++k) {
+        char buf[64];
+        int len = rand() % (int)sizeof(buf);
+        for (int j = 0; j < len; ++j)
+            buf[j] = alphabet[rand() % (int)COUNT1(alphabet)];
+        buf[len] = '\0';
+        check_split(buf);
+    }
+
+    // PATH over 32K chars: fillers, then a quoted entry with the script, then root
+    make_file(tree_path(ARRAY(path), "msys64/usr/bin/sh.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "my scripts/script"), "#!/bin/sh\n", 0755);
+    size_t cb = FILLERS * 64 + 3 * PATH_MAX, cch = 0;
+    char* psz = malloc(cb);
+    for (int i = 0; i < FILLERS; ++i)
+        cch += (size_t)snprintf(psz + cch, cb - cch, "/nonexistent/filler/dir/%05d::",
+            i);
+    snprintf(psz + cch, cb - cch, "\"%s/my scripts\":%s/msys64/usr/bin:/usr/bin:/bin",
+        szTree, szTree);
+    setenv("PATH", psz, 1);
+    free(psz);
+
+    PCTSTR pszPATH = get_env(ARRAY1("path="));
+    CHECK(pszPATH && strlen(pszPATH) > 32768);
+    CHECK(strstr(pszPATH, ";;") != NULL);
+    SHEBANG sb;
+    RESOLVED r;
+    shebang_init(&sb);
+    CHECK(shebang_resolve(&sb, &r, "script") == ERROR_SUCCESS);
+    CHECK(sb.px.sys == POSIX_MSYS);
+    CHECK(strstr(r.szScript, "my scripts") != NULL);
+    CHECK(strstr(r.szShellCmd, "sh.exe") != NULL);
+    shebang_free(&sb);
+
+    return done("path");
+}
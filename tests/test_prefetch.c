@@ -0,0 +1,117 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Startup phases with simulated latencies: shebang.ini and host name loaded
+ *       by prefetch overlap the PATH scan, which waits for the former only; the
+ *       results are the same as without prefetch
+ * Note: Runs from a copy in the tree, as shebang.ini is next to the executable
+ */
+
+
+#include "util.h"
+#include "../libshebang.c"
+
+
+#define DIRS        20
+#define SCAN_MS     300
+#define HOST_MS     600
+
+
+// removes saved index, mounts and host name, so each run does the same queries
+static void cold(void)
+{
+    static const char* const names[] = { "shebang.index", "shebang.mounts",
+        "shebang.host" };
+    char path[PATH_MAX];
+    for (int i = 0; i < (int)COUNT(names); ++i)
+        unlink(tree_path(ARRAY(path), "%s", names[i]));
+}
+
+
+// resolves script and makes its environment; returns total time in ms, time of
+// resolution and file system queries made
+static double run(BOOL prefetch, RESOLVED* pr, PTSTR pszEnv, size_t cchEnv,
+    double* pmsResolve, LONG* pcnt)
+{
+    SHEBANG sb;
+    cold();
+    shebang_init(&sb);
+    LONG cnt = posixStatCount;
+    double t = now_ns();
+    if (prefetch)
+        shebang_prefetch(&sb);
+    CHECK(shebang_resolve(&sb, pr, "script") == ERROR_SUCCESS);
+    *pmsResolve = (now_ns() - t) / 1e6;
+    CHECK(shebang_env(&sb, pr, pszEnv, cchEnv));
+    t = (now_ns() - t) / 1e6;
+    *pcnt = posixStatCount - cnt;
+    shebang_free(&sb);
+    return t;
+}
+
+
+// compares NUL-separated lists
+static BOOL same_list(PCTSTR psz1, PCTSTR psz2)
+{
+    for (; *psz1 || *psz2; psz1 += lstrlen(psz1) + 1, psz2 += lstrlen(psz2) + 1)
+        if (lstrcmp(psz1, psz2))
+            return FALSE;
+    return TRUE;
+}
+
+
+int main(void)
+{
+    static char szPATH[DIRS * PATH_MAX];
+    char path[PATH_MAX];
+    size_t cch = 0;
+    run_from_tree();
+    unsetenv("HOSTNAME"); // before environment is first read
+    unsetenv("SHEBANG_PROBE");
+    unsetenv("SHEBANG_SUBST");
+
+    // typical PATH with MSYS root and the script at the end
+    for (int d = 0; d < DIRS; ++d) {
+        make_file(tree_path(ARRAY(path), "p%02d/tool.exe", d), "", 0755);
+        cch += (size_t)snprintf(szPATH + cch, sizeof(szPATH) - cch, "%s/p%02d:",
+            szTree, d);
+    }
+    make_file(tree_path(ARRAY(path), "msys64/usr/bin/bash.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "scripts/script"), "#!/bin/bash -e\n", 0755);
+    snprintf(szPATH + cch, sizeof(szPATH) - cch, "%s/msys64/usr/bin:%s/scripts",
+        szTree, szTree);
+    setenv("PATH", szPATH, 1);
+    make_file(tree_path(ARRAY(path), "bin/shebang.ini"),
+        "[environment]\nLANG=C.UTF-8\n", 0644);
+
+    // every query in the tree slowed down for the scan to take SCAN_MS
+    RESOLVED r1, r2;
+    TCHAR sz1[1024], sz2[1024];
+    double ms1, ms2, msResolve1, msResolve2;
+    LONG cnt1, cnt2;
+    run(FALSE, &r1, ARRAY(sz1), &msResolve1, &cnt1);
+    posixStatDelay = (unsigned)(SCAN_MS * 1000 / (cnt1 ? cnt1 : 1));
+    posixStatPrefix = szTree;
+    posixHostDelay = HOST_MS * 1000;
+
+    // same results and queries either way
+    ms1 = run(FALSE, &r1, ARRAY(sz1), &msResolve1, &cnt1);
+    ms2 = run(TRUE, &r2, ARRAY(sz2), &msResolve2, &cnt2);
+    CHECK(!lstrcmp(r1.szScript, r2.szScript) && !lstrcmp(r1.szShellCmd, r2.szShellCmd)
+        && !lstrcmp(r1.szEnv, r2.szEnv));
+    CHECK(r1.px.sys == POSIX_MSYS && r2.px.sys == POSIX_MSYS
+        && !lstrcmp(r1.px.root, r2.px.root));
+    CHECK(same_list(sz1, sz2));
+    for (PCTSTR psz = sz2; *psz; psz += lstrlen(psz) + 1)
+        CHECK(StrCmpNI(psz, ARRAY1("HOSTNAME=")) || psz[COUNT1("HOSTNAME=")]);
+    CHECK(cnt1 == cnt2);
+
+    // one after another without prefetch; with it, the scan does not wait for host
+    // name, so the two overlap
+    if (!CHECK(ms1 >= 0.9 * (SCAN_MS + HOST_MS) && msResolve2 < HOST_MS - 100
+        && ms2 >= 0.95 * HOST_MS && ms2 < ms1 - SCAN_MS / 2))
+        fprintf(stderr, "  sequential %.0f ms, with prefetch %.0f ms (resolved in "
+            "%.0f ms)\n", ms1, ms2, msResolve2);
+
+    return done("prefetch");
+}
@@ -0,0 +1,199 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Parallel PATH probing: lowest matching directory wins whatever the delays,
+ *       probes past it are cancelled, slow ones are skipped after timeout; pool is
+ *       freed by the caller or the last stuck worker
+ */
+
+
+#include "util.h"
+
+// live heap blocks
+static volatile LONG blocks;
+
+// allocates counted block
+static LPVOID counted_alloc(HANDLE hHeap, DWORD dwFlags, SIZE_T dwBytes)
+{
+    LPVOID p = HeapAlloc(hHeap, dwFlags, dwBytes);
+    if (p)
+        InterlockedIncrement(&blocks);
+    return p;
+}
+
+// frees counted block
+static BOOL counted_free(HANDLE hHeap, DWORD dwFlags, LPVOID lpMem)
+{
+    if (lpMem)
+        InterlockedDecrement(&blocks);
+    return HeapFree(hHeap, dwFlags, lpMem);
+}
+
+#define HeapAlloc   counted_alloc
+#define HeapFree    counted_free
+#include "../libshebang.c"
+#undef HeapAlloc
+#undef HeapFree
+
+
+#define JOBS        64
+#define ROUNDS      300
+
+// fake directory: delay before answer and whether file is there
+typedef struct {
+    unsigned ms;
+    BOOL has;
+} FAKE_DIR;
+static FAKE_DIR dir[JOBS];
+static volatile LONG probes;
+
+
+// sleeps for milliseconds
+static void sleep_ms(unsigned ms)
+{
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000 };
+    while (nanosleep(&ts, &ts) && errno == EINTR) ;
+}
+
+
+// probes fake directory "dNN"
+static BOOL probe_fake(PTSTR pszTo, size_t cchTo, PCTSTR pszDir, size_t cchDir,
+    PCTSTR pszName)
+{
+    (void)pszTo;
+    (void)cchTo;
+    (void)cchDir;
+    (void)pszName;
+    int i = atoi(pszDir + 1);
+    InterlockedIncrement(&probes);
+    sleep_ms(dir[i].ms);
+    return dir[i].has;
+}
+
+
+// makes pool over fake directories
+static PROBE_POOL* make_pool(int cnt)
+{
+    static char names[JOBS][16];
+    PROBE_POOL* pp = counted_alloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(PROBE_POOL) + cnt * sizeof(PROBE));
+    pp->pfn = probe_fake;
+    for (int i = 0; i < cnt; ++i) {
+        snprintf(ARRAY(names[i]), "d%02d", i);
+        pp->job[pp->cnt].pszDir = names[i];
+        pp->job[pp->cnt++].cchDir = strlen(names[i]);
+    }
+    probes = 0;
+    return pp;
+}
+
+
+// runs probe over directories set; returns lowest index found and elapsed ms
+static LONG run(int cnt, int nThreads, DWORD dwTimeout, double* pms)
+{
+    PROBE_POOL* pp = make_pool(cnt);
+    double t = now_ns();
+    LONG i = probe_parallel(pp, nThreads, dwTimeout);
+    if (pms)
+        *pms = (now_ns() - t) / 1e6;
+    release_pool(pp);
+    return i;
+}
+
+
+// clears fake directories
+static void clear_dirs(void)
+{
+    memset(dir, 0, sizeof(dir));
+}
+
+
+int main(void)
+{
+    char path[PATH_MAX], tmp[2 * PATH_MAX];
+    double ms;
+    make_tree();
+
+    // first match whatever the delays, any number of threads
+    srand(99);
+    for (int k = 0; k < ROUNDS; ++k) {
+        int cnt = 1 + rand() % 24, expected = cnt;
+        for (int i = 0; i < cnt; ++i) {
+            dir[i].ms = (unsigned)(rand() % 3);
+            dir[i].has = (rand() % 6 == 0);
+            if (dir[i].has && expected == cnt)
+                expected = i;
+        }
+        int nThreads = rand() % 9;
+        LONG i = run(cnt, nThreads, (rand() % 2) ? 0 : 1000, NULL);
+        if (!CHECK(i == expected))
+            fprintf(stderr, "  round %d: %d jobs, %d threads: got %ld, expected %d\n",
+                k, cnt, nThreads, (long)i, expected);
+    }
+
+    // earlier slow match beats later fast one
+    clear_dirs();
+    dir[2] = (FAKE_DIR){ 60, TRUE };
+    dir[5].has = TRUE;
+    CHECK(run(8, 4, 0, &ms) == 2 && ms >= 55);
+    CHECK(run(8, 4, 1000, NULL) == 2);
+
+    // nothing found
+    for (int i = 0; i < JOBS; ++i)
+        dir[i] = (FAKE_DIR){ 0, FALSE };
+    CHECK(run(JOBS, 4, 0, NULL) == JOBS);
+    CHECK(run(JOBS, 0, 0, NULL) == JOBS);
+    CHECK(probes == JOBS);
+
+    // match cancels probes past it
+    for (int i = 0; i < JOBS; ++i)
+        dir[i] = (FAKE_DIR){ 20, FALSE };
+    dir[1] = (FAKE_DIR){ 0, TRUE };
+    CHECK(run(JOBS, 4, 0, &ms) == 1 && ms < 200);
+    sleep_ms(50); // let workers finish
+    CHECK(probes < 12);
+
+    // stuck directory skipped after timeout, or waited for without one
+    clear_dirs();
+    dir[0] = (FAKE_DIR){ 800, TRUE };
+    dir[1].ms = 800;
+    dir[3].has = TRUE;
+    CHECK(run(8, 2, 50, &ms) == 3 && ms < 500);
+    CHECK(run(8, 2, 0, &ms) == 0 && ms >= 790);
+
+    // same with all threads stuck: remaining probes still run
+    for (int i = 0; i < 4; ++i)
+        dir[i] = (FAKE_DIR){ 800, FALSE };
+    dir[6].has = TRUE;
+    CHECK(run(8, 2, 30, &ms) == 6 && ms < 500);
+
+    // pools left to stuck workers are freed as they finish
+    CHECK(blocks > 0);
+    sleep_ms(1000);
+    if (!CHECK(blocks == 0))
+        fprintf(stderr, "  %ld pools not freed\n", (long)blocks);
+
+    // launcher: slow directory on PATH is skipped, script found in the next one
+    make_file(tree_path(ARRAY(path), "msys64/usr/bin/sh.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "slow/x"), "", 0644);
+    make_file(tree_path(ARRAY(path), "scripts/script"), "#!/bin/sh\n", 0755);
+    snprintf(tmp, sizeof(tmp), "%s/slow:%s/scripts:%s/msys64/usr/bin:/usr/bin:/bin",
+        szTree, szTree, szTree);
+    setenv("PATH", tmp, 1);
+    setenv("SHEBANG_PROBE", "4,50", 1);
+    posixStatDelay = 800000;
+    posixStatPrefix = tree_path(ARRAY(path), "slow");
+    SHEBANG sb;
+    RESOLVED r;
+    shebang_init(&sb);
+    double t = now_ns();
+    CHECK(shebang_resolve(&sb, &r, "script") == ERROR_SUCCESS);
+    CHECK((now_ns() - t) / 1e6 < 500);
+    CHECK(strstr(r.szScript, "\\scripts\\script") != NULL);
+    shebang_free(&sb);
+    sleep_ms(1000);
+    CHECK(blocks == 0);
+    posixStatDelay = 0;
+
+    return done("probe");
+}
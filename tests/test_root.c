@@ -0,0 +1,99 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: PATH entry classifier gives the same layer and root as matching entry
+ *       against the glob patterns it replaced, one by one
+ */
+
+
+#include "util.h"
+#include <fnmatch.h>
+#include "../libshebang.c"
+
+
+#define ROUNDS      200000
+
+// patterns in POSIX_* order and the tail each one leaves out of the root
+static const struct {
+    const char* spec;
+    const char* tail;
+} sRoot[] = {
+    { "*\\msys*\\clangarm64\\bin",  "\\clangarm64\\bin" },
+    { "*\\msys*\\mingw32\\bin",     "\\mingw32\\bin" },
+    { "*\\msys*\\mingw64\\bin",     "\\mingw64\\bin" },
+    { "*\\msys*\\ucrt64\\bin",      "\\ucrt64\\bin" },
+    { "*\\msys*\\clang32\\bin",     "\\clang32\\bin" },
+    { "*\\msys*\\clang64\\bin",     "\\clang64\\bin" },
+    { "*\\msys*\\usr\\bin",         "\\usr\\bin" },
+    { "*\\cygwin*\\bin",            "\\bin" }
+};
+
+// path components likely to fool the classifier
+static const char* const part[] = {
+    "C:", "D:", "msys64", "MSYS2", "msys", "Msys32x", "cygwin", "Cygwin64", "cyg",
+    "usr", "USR", "mingw64", "MinGW32", "ucrt64", "clang32", "clang64", "CLANGARM64",
+    "bin", "Bin", "BIN", "msysusr", "usrbin", "x", "", "Program Files", "win", "msy",
+    "cygwinbin", "opt"
+};
+
+
+// classifies entry by the patterns
+static int ref_match_root(const char* psz, size_t* pcchRoot)
+{
+    for (int i = 0; i < (int)COUNT(sRoot); ++i) {
+        if (!fnmatch(sRoot[i].spec, psz, FNM_NOESCAPE | FNM_CASEFOLD)) {
+            *pcchRoot = strlen(psz) - strlen(sRoot[i].tail);
+            return i;
+        }
+    }
+    return POSIX_UNKNOWN;
+}
+
+
+// compares both classifiers on entry; returns the layer
+static int check_entry(const char* psz)
+{
+    size_t cchRoot = 0, cchRef = 0;
+    int sys = match_root(psz, strlen(psz), &cchRoot);
+    int ref = ref_match_root(psz, &cchRef);
+    if (!CHECK(sys == ref && (sys == POSIX_UNKNOWN || cchRoot == cchRef)))
+        fprintf(stderr, "  [%s]: %d/%zu, expected %d/%zu\n", psz, sys, cchRoot, ref,
+            cchRef);
+    return ref;
+}
+
+
+int main(void)
+{
+    // typical entries
+    static const char* const typical[] = {
+        "C:\\msys64\\usr\\bin", "C:\\msys64\\mingw64\\bin", "C:\\MSYS64\\UCRT64\\BIN",
+        "D:\\tools\\msys2\\clangarm64\\bin", "C:\\cygwin64\\bin", "C:\\cygwin\\bin",
+        "C:\\Windows\\system32", "C:\\msys64\\usr\\local\\bin", "C:\\msys64\\bin",
+        "C:\\cygwin64\\usr\\bin", "C:\\msys64\\cygwin\\bin", "C:\\a\\msys\\b\\usr\\bin",
+        "\\msys\\usr\\bin", "msys\\usr\\bin", "C:\\msysusr\\bin", "C:\\cygwinbin",
+        "C:\\msys64\\usr\\bin\\", "C:/msys64/usr/bin", "", "\\bin", "\\cygwin\\bin"
+    };
+    for (int i = 0; i < (int)COUNT(typical); ++i)
+        check_entry(typical[i]);
+
+    // random entries made of tricky components and separators
+    int hits[COUNT(sRoot)] = {0};
+    srand(4242);
+    for (int k = 0; k < ROUNDS; ++k) {
+        char buf[512];
+        size_t cch = 0;
+        for (int n = 1 + rand() % 7; n; --n) {
+            const char* psz = part[rand() % (int)COUNT(part)];
+            cch += (size_t)snprintf(buf + cch, sizeof(buf) - cch, "%s%s", psz,
+                (n > 1 || rand() % 8 == 0) ? (rand() % 16 ? "\\" : "/") : "");
+        }
+        int sys = check_entry(buf);
+        if (sys != POSIX_UNKNOWN)
+            ++hits[sys];
+    }
+    for (int i = 0; i < (int)COUNT(sRoot); ++i)
+        CHECK(hits[i] > 0);
+
+    return done("root");
+}
@@ -0,0 +1,104 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Interpreter substitution: rules are parsed once, the first matching one whose
+ *       substitute exists wins, else the original interpreter is used
+ */
+
+
+#include "util.h"
+#include "../libshebang.c"
+
+
+// resolves script with the shebang line under the rules; returns shell command
+static const char* resolve_with(const char* rules, const char* line)
+{
+    static RESOLVED r;
+    char path[PATH_MAX];
+    make_file(tree_path(ARRAY(path), "scripts/script"), line, 0755);
+    if (rules)
+        setenv("SHEBANG_SUBST", rules, 1);
+    else
+        unsetenv("SHEBANG_SUBST");
+
+    SHEBANG sb;
+    shebang_init(&sb);
+    if (shebang_resolve(&sb, &r, "script") != ERROR_SUCCESS)
+        r.szShellCmd[0] = '\0';
+    shebang_free(&sb);
+    return r.szShellCmd;
+}
+
+
+// checks that shell command ends with the tail
+static void check_subst(const char* rules, const char* line, const char* tail)
+{
+    const char* psz = resolve_with(rules, line);
+    size_t cch = strlen(psz), cchTail = strlen(tail);
+    if (!CHECK(cch >= cchTail && !strcmp(psz + cch - cchTail, tail)))
+        fprintf(stderr, "  [%s] [%.*s]: got [%s]\n", rules ? rules : "NULL",
+            (int)strcspn(line, "\n"), line, psz);
+}
+
+
+int main(void)
+{
+    char path[PATH_MAX], tmp[2 * PATH_MAX];
+    make_tree();
+
+    make_file(tree_path(ARRAY(path), "msys64/usr/bin/sh.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "msys64/usr/bin/bash.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "msys64/usr/bin/dash.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "msys64/opt/busybox/sh.exe"), "", 0755);
+    snprintf(tmp, sizeof(tmp), "%s/scripts:%s/msys64/usr/bin:/usr/bin:/bin", szTree,
+        szTree);
+    setenv("PATH", tmp, 1);
+
+    // parsed once in place: blanks trimmed, bad rules skipped
+    setenv("SHEBANG_SUBST", " /bin/sh  =  /usr/bin/dash ;=x;none;x= ;"
+        "/bin/bash -e*=/usr/bin/dash -e -u;;", 1);
+    SHEBANG sb;
+    const SUBST* ps;
+    shebang_init(&sb);
+    CHECK(load_subst(&sb, &ps) == 2);
+    CHECK(!strcmp(ps[0].from, "/bin/sh") && !ps[0].spec);
+    CHECK(!strcmp(ps[0].to, "/usr/bin/dash") && !ps[0].args);
+    CHECK(!strcmp(ps[1].from, "/bin/bash") && !strcmp(ps[1].spec, "-e*"));
+    CHECK(!strcmp(ps[1].to, "/usr/bin/dash") && !strcmp(ps[1].args, "-e -u"));
+    unsetenv("SHEBANG_SUBST");
+    const SUBST* ps1;
+    CHECK(load_subst(&sb, &ps1) == 2 && ps1 == ps); // not again
+    shebang_free(&sb);
+
+    // mapping
+    check_subst(NULL, "#!/bin/sh\n", "\\msys64\\usr\\bin\\sh.exe");
+    check_subst("/bin/sh=/usr/bin/dash", "#!/bin/sh\n", "\\usr\\bin\\dash.exe");
+    check_subst("/bin/sh=/usr/bin/dash", "#!/bin/sh -x\n", "\\dash.exe -x");
+    check_subst("/bin/sh=/opt/busybox/sh", "#!/bin/sh\n", "\\opt\\busybox\\sh.exe");
+    check_subst("/bin/sh=/usr/bin/dash", "#!/usr/bin/sh\n", "\\usr\\bin\\sh.exe");
+
+    // args pattern and replacement
+    check_subst("/bin/bash -e*=/usr/bin/dash -e", "#!/bin/bash -e\n",
+        "\\dash.exe -e");
+    check_subst("/bin/bash -e*=/usr/bin/dash -e", "#!/bin/bash -eu\n",
+        "\\dash.exe -e");
+    check_subst("/bin/bash -e*=/usr/bin/dash -e", "#!/bin/bash -u\n",
+        "\\bash.exe -u");
+    check_subst("/bin/bash -e*=/usr/bin/dash -e", "#!/bin/bash\n", "\\bash.exe");
+    check_subst("/bin/bash *=/usr/bin/dash", "#!/bin/bash\n", "\\dash.exe");
+    check_subst("/bin/sh=/usr/bin/dash -e", "#!/bin/sh -x\n", "\\dash.exe -e");
+
+    // fallback: next rule, then the original
+    check_subst("/bin/sh=/usr/bin/ash;/bin/sh=/usr/bin/dash", "#!/bin/sh\n",
+        "\\dash.exe");
+    check_subst("/bin/sh=/usr/bin/dash;/bin/sh=/opt/busybox/sh", "#!/bin/sh\n",
+        "\\dash.exe");
+    check_subst("/bin/sh=/usr/bin/ash", "#!/bin/sh -x\n", "\\usr\\bin\\sh.exe -x");
+    check_subst("/bin/bash -u=/usr/bin/dash;/bin/bash=/usr/bin/ash",
+        "#!/bin/bash -e\n", "\\bash.exe -e");
+    CHECK(!unlink(tree_path(ARRAY(path), "msys64/usr/bin/dash.exe")));
+    check_subst("/bin/sh=/usr/bin/dash;/bin/sh=/opt/busybox/sh", "#!/bin/sh\n",
+        "\\opt\\busybox\\sh.exe");
+
+    return done("subst");
+}
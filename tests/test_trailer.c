@@ -0,0 +1,87 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Installed copy trailer: written one is read back, any damage to it or the
+ *       script makes reader fall back to full resolution
+ */
+
+
+#include "util.h"
+#define main shebang_main
+#include "../shebang.c"
+#undef main
+#include "../libshebang.c"
+
+
+int main(void)
+{
+    char path[PATH_MAX], module[PATH_MAX], copy[PATH_MAX], tmp[2 * PATH_MAX];
+    make_tree();
+
+    make_file(tree_path(ARRAY(path), "msys64/usr/bin/bash.exe"), "", 0755);
+    make_file(tree_path(ARRAY(path), "scripts/script"), "#!/bin/bash -e\n", 0755);
+    make_file(tree_path(ARRAY(module), "bin/shebang.exe"), "MZ not really\n", 0755);
+    snprintf(tmp, sizeof(tmp), "%s/msys64/usr/bin:%s/scripts:/usr/bin:/bin", szTree,
+        szTree);
+    setenv("PATH", tmp, 1);
+
+    SHEBANG sb;
+    RESOLVED r = {0};
+    shebang_init(&sb);
+    CHECK(resolve_script(&sb, &r, "script") == ERROR_SUCCESS);
+
+    // plain buffer: good one for the name in any case, not for another name or size
+    TRAILER tr;
+    make_trailer(&tr, &r);
+    CHECK(check_trailer(&tr, sizeof(tr), "script"));
+    CHECK(check_trailer(&tr, sizeof(tr), "SCRIPT"));
+    CHECK(!check_trailer(&tr, sizeof(tr), "scrip"));
+    CHECK(!check_trailer(&tr, sizeof(tr) - 1, "script"));
+    CHECK(!memcmp(&tr.r, &r, sizeof(r)));
+
+    // any bit flipped is caught
+    int missed = 0;
+    for (size_t i = 0; i < sizeof(tr); ++i) {
+        for (int bit = 0; bit < 8; bit += 3) {
+            ((BYTE*)&tr)[i] ^= (BYTE)(1 << bit);
+            missed += check_trailer(&tr, sizeof(tr), "script");
+            ((BYTE*)&tr)[i] ^= (BYTE)(1 << bit);
+        }
+    }
+    CHECK(missed == 0);
+    CHECK(check_trailer(&tr, sizeof(tr), "script"));
+
+    // file: copy gets module contents and trailer at the very end
+    CHECK(install_copy(&sb, native(ARRAY(path), module), "script") == ERROR_SUCCESS);
+    tree_path(ARRAY(copy), "bin/script.exe");
+    RESOLVED rRead;
+    CHECK(read_trailer(native(ARRAY(path), copy), "script", &rRead));
+    CHECK(!memcmp(&rRead, &r, sizeof(r)));
+    struct stat st;
+    CHECK(!stat(copy, &st) && st.st_size == (off_t)(COUNT1("MZ not really\n")
+        + sizeof(TRAILER)));
+    CHECK(!read_trailer(native(ARRAY(path), module), "shebang", &rRead));
+
+    // trailer no longer last
+    FILE* f = fopen(copy, "ab");
+    fputs("junk", f);
+    fclose(f);
+    CHECK(!read_trailer(native(ARRAY(path), copy), "script", &rRead));
+    CHECK(!truncate(copy, st.st_size));
+    CHECK(read_trailer(native(ARRAY(path), copy), "script", &rRead));
+
+    // script or shell changed
+    make_file(tree_path(ARRAY(path), "scripts/script"), "#!/bin/bash -u\n", 0755);
+    CHECK(!read_trailer(native(ARRAY(path), copy), "script", &rRead));
+    CHECK(install_copy(&sb, native(ARRAY(path), module), "script") == ERROR_SUCCESS);
+    CHECK(read_trailer(native(ARRAY(path), copy), "script", &rRead));
+    CHECK(strstr(rRead.szShellCmd, "-u") != NULL);
+    CHECK(!unlink(tree_path(ARRAY(path), "msys64/usr/bin/bash.exe")));
+    CHECK(!read_trailer(native(ARRAY(path), copy), "script", &rRead));
+
+    // no script to install
+    CHECK(install_copy(&sb, native(ARRAY(path), module), "none") != ERROR_SUCCESS);
+    shebang_free(&sb);
+
+    return done("trailer");
+}
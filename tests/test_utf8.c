@@ -0,0 +1,206 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: UTF-8 decoder against the reference one: boundary code points, malformed
+ *       sequences, every short byte string, random text of ASCII runs, exact
+ *       destination sizes and input ending before an unmapped page
+ * Note: Built three times: with SSE2 (as by default), with -mavx2 and with -DNOSIMD
+ */
+
+
+#include "util.h"
+#include <sys/mman.h>
+#include "../libshebang.c"
+#include "ref_utf8.h"
+
+
+#define ROUNDS      100000
+#define MAX_LEN     200
+#define GUARD       40
+
+#if defined(NOSIMD)
+#define VARIANT     "utf8/scalar"
+#elif defined(__AVX2__)
+#define VARIANT     "utf8/avx2"
+#else
+#define VARIANT     "utf8/sse2"
+#endif // NOSIMD
+
+
+// decodes into buffer of given size, guarded past it; returns chars written or
+// zero, also on write past the buffer
+static size_t decode_guarded(WCHAR* pw, size_t cchTo, const char* src,
+    DWORD* pdwErrorCode)
+{
+    for (size_t i = 0; i < GUARD; ++i)
+        pw[cchTo + i] = 0x5a5a;
+    *pdwErrorCode = ERROR_SUCCESS;
+    size_t cch = decode_utf8(pw, cchTo, src, pdwErrorCode);
+    for (size_t i = 0; i < GUARD; ++i)
+        if (!CHECK(pw[cchTo + i] == 0x5a5a))
+            return 0;
+    return cch;
+}
+
+
+// checks decoding against the reference, with exact, one char short and random
+// short buffers
+static void check_decode(const char* src)
+{
+    static WCHAR pwRef[MAX_LEN + 8], pw[MAX_LEN + 8 + GUARD];
+    DWORD dwErrorCode;
+    size_t cchRef = ref_decode_utf8(pwRef, src);
+    size_t cch = decode_guarded(pw, MAX_LEN + 8, src, &dwErrorCode);
+    BOOL ok = cchRef ? (cch == cchRef && !memcmp(pw, pwRef, cch * sizeof(WCHAR)))
+        : (!cch && dwErrorCode == ERROR_NO_UNICODE_TRANSLATION);
+    if (ok && cchRef) {
+        size_t cchShort = (size_t)rand() % cchRef;
+        ok = (decode_guarded(pw, cchRef, src, &dwErrorCode) == cchRef)
+            && !memcmp(pw, pwRef, cch * sizeof(WCHAR))
+            && !decode_guarded(pw, cchRef - 1, src, &dwErrorCode)
+            && dwErrorCode == ERROR_INSUFFICIENT_BUFFER
+            && (!cchShort || (!decode_guarded(pw, cchShort, src, &dwErrorCode)
+            && dwErrorCode == ERROR_INSUFFICIENT_BUFFER));
+    }
+    if (!CHECK(ok)) {
+        fprintf(stderr, "  [");
+        for (const char* cp = src; *cp; ++cp)
+            fprintf(stderr, "\\x%02x", (unsigned char)*cp);
+        fprintf(stderr, "]: got %zu chars, expected %zu\n", cch, cchRef);
+    }
+}
+
+
+// encodes code point as UTF-8; returns its length
+static size_t encode(char* p, unsigned long c)
+{
+    if (c < 0x80)
+        return (p[0] = (char)c), 1;
+    if (c < 0x800)
+        return (p[0] = (char)(0xc0 | c >> 6)), (p[1] = (char)(0x80 | (c & 0x3f))), 2;
+    if (c < 0x10000) {
+        p[0] = (char)(0xe0 | c >> 12);
+        p[1] = (char)(0x80 | ((c >> 6) & 0x3f));
+        p[2] = (char)(0x80 | (c & 0x3f));
+        return 3;
+    }
+    p[0] = (char)(0xf0 | c >> 18);
+    p[1] = (char)(0x80 | ((c >> 12) & 0x3f));
+    p[2] = (char)(0x80 | ((c >> 6) & 0x3f));
+    p[3] = (char)(0x80 | (c & 0x3f));
+    return 4;
+}
+
+
+// appends random piece: ASCII run, code point or any bytes
+static size_t random_piece(char* p)
+{
+    static const unsigned long points[] = { 0x7f, 0x80, 0x7ff, 0x800, 0xd7ff, 0xe000,
+        0xfffd, 0xffff, 0x10000, 0x10ffff, 0x444, 0x4e2d };
+    size_t cch = 0;
+    switch (rand() % 8) {
+    case 0:
+        for (int n = 1 + rand() % 3; n; --n)
+            p[cch++] = (char)(1 + rand() % 255);
+        return cch;
+    case 1:
+    case 2:
+        return encode(p, points[rand() % (int)COUNT(points)]);
+    case 3:
+        return encode(p, 1 + (unsigned long)rand() % 0x10ffff);
+    default:
+        for (int n = rand() % 70; n; --n)
+            p[cch++] = (char)(' ' + rand() % 95);
+        return cch;
+    }
+}
+
+
+int main(void)
+{
+    char src[MAX_LEN + 8];
+#if defined(__AVX2__)
+    if (!__builtin_cpu_supports("avx2")) {
+        printf("skip " VARIANT "\n");
+        return 0;
+    }
+#endif // __AVX2__
+
+    // boundaries and malformed sequences
+    static const char* const fixed[] = {
+        "", "a", "\x7f", "\xc2\x80", "\xdf\xbf", "\xe0\xa0\x80", "\xed\x9f\xbf",
+        "\xee\x80\x80", "\xef\xbf\xbf", "\xf0\x90\x80\x80", "\xf4\x8f\xbf\xbf",
+        "/usr/bin/\xd0\xb1\xd0\xb0\xd1\x88", "\xe4\xb8\xad\xe6\x96\x87 text",
+        "\x80", "\xbf", "\xc0\x80", "\xc1\xbf", "\xe0\x9f\xbf", "\xf0\x8f\xbf\xbf",
+        "\xed\xa0\x80", "\xed\xbf\xbf", "\xf4\x90\x80\x80", "\xf5\x80\x80\x80",
+        "\xff", "\xfe", "\xc2", "\xe1\x80", "\xf1\x80\x80", "\xc2\x41", "\xe1\x80\x41",
+        "a\xc2", "0123456789abcdef0123456789abcdef\x80",
+        "0123456789abcdef0123456789abcdef0123456789abcdef\xe1\x80"
+    };
+    for (size_t i = 0; i < COUNT(fixed); ++i)
+        check_decode(fixed[i]);
+
+    // every string of up to 3 bytes, then of up to 2 bytes after ASCII that takes
+    // vector path
+    for (int pre = 0; pre <= 33; pre += 33) {
+        memset(src, 'x', pre);
+        for (unsigned long n = 1; n < (pre ? 0x10000U : 0x1000000U) && !failed; ++n) {
+            if (((n & 0xff00) && !(n & 0xff)) || ((n & 0xff0000) && !(n & 0xff00)))
+                continue; // NUL inside
+            size_t cch = pre;
+            for (unsigned long k = n; k; k >>= 8)
+                src[cch++] = (char)(k & 0xff);
+            src[cch] = '\0';
+            check_decode(src);
+        }
+    }
+
+    // every 3- and 4-byte lead and second byte, alone and after ASCII
+    for (int lead = 0xe0; lead <= 0xff; ++lead) {
+        for (int next = 0x7f; next <= 0xc0; ++next) {
+            snprintf(ARRAY(src), "%c%c\x80\x80", lead, next);
+            check_decode(src);
+            snprintf(ARRAY(src), "%40s%c%c\x80\x80" "abc", "", lead, next);
+            check_decode(src);
+        }
+    }
+
+    // random text
+    srand(2015);
+    for (int k = 0; k < ROUNDS && !failed; ++k) {
+        size_t cch = 0;
+        while (cch < MAX_LEN - 70 && rand() % 6)
+            cch += random_piece(src + cch);
+        src[cch] = '\0';
+        check_decode(src);
+    }
+
+    // input ending at unmapped page
+    long cbPage = sysconf(_SC_PAGESIZE);
+    char* pcPage = mmap(NULL, 2 * cbPage, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (!CHECK(pcPage != MAP_FAILED && !mprotect(pcPage + cbPage, cbPage, PROT_NONE)))
+        return done(VARIANT);
+    for (size_t n = 1; n <= 100; ++n) {
+        char* p = pcPage + cbPage - n;
+        memset(p, 'y', n - 1);
+        p[n - 1] = '\0';
+        check_decode(p);
+        if (n >= 3) {
+            memcpy(p + n - 3, "\xd1\x88", 2);
+            check_decode(p);
+        }
+    }
+
+    // concat_with_utf8: ANSI code page is UTF-8 here, so valid input comes back
+    TCHAR sz[MAX_PATH];
+    StringCchCopy(ARRAY(sz), "/x/");
+    CHECK(concat_with_utf8(ARRAY(sz), "\xd0\xb1\xd0\xb0\xd1\x88")
+        && !lstrcmp(sz, "/x/\xd0\xb1\xd0\xb0\xd1\x88"));
+    CHECK(!concat_with_utf8(ARRAY(sz), "\xed\xa0\x80")
+        && GetLastError() == ERROR_NO_UNICODE_TRANSLATION);
+    StringCchCopy(ARRAY(sz), "/x/");
+    CHECK(!concat_with_utf8(sz, 8, "abcdef"));
+
+    return done(VARIANT);
+}
@@ -0,0 +1,181 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Helpers for tests run on Linux over the POSIX platform layer
+ * Note: Each test is a program; it prints a line per check failed and exits with
+ *       their count
+ */
+
+
+#ifndef TESTS_UTIL_H
+#define TESTS_UTIL_H
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <windows.h>
+
+
+// checks condition, reporting it if false
+#define CHECK(cond)     check((cond), #cond, __FILE__, __LINE__)
+static int failed;
+static inline int check(int ok, const char* expr, const char* file, int line)
+{
+    if (!ok) {
+        fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+        ++failed;
+    }
+    return ok;
+}
+
+
+// prints result line and exits
+static inline int done(const char* name)
+{
+    printf("%s %s\n", failed ? "FAIL" : "ok", name);
+    return failed;
+}
+
+
+// makes temporary directory and points TMPDIR to it, so that shebang.cache and
+// friends stay inside; removed at exit unless KEEP_TREE is set
+static char szTree[256];
+static inline void remove_tree(void)
+{
+    char cmd[300];
+    if (!getenv("KEEP_TREE") && szTree[0]
+        && snprintf(cmd, sizeof(cmd), "/bin/rm -rf '%s'", szTree) < (int)sizeof(cmd))
+        (void)!system(cmd);
+}
+static inline const char* make_tree(void)
+{
+    const char* tmp = getenv("TMPDIR");
+    snprintf(szTree, sizeof(szTree), "%s/shebang-test-XXXXXX", tmp ? tmp : "/tmp");
+    if (!mkdtemp(szTree)) {
+        perror("mkdtemp");
+        exit(1);
+    }
+    setenv("TMPDIR", szTree, 1);
+    atexit(remove_tree);
+    return szTree;
+}
+
+
+// runs copy of this program from the tree, so that shebang.ini next to it is there
+// too; returns in the copy only, which shares the tree
+static inline void run_from_tree(void)
+{
+    const char* tree = getenv("TESTS_TREE");
+    if (tree) {
+        snprintf(szTree, sizeof(szTree), "%s", tree);
+        return;
+    }
+
+    char exe[PATH_MAX], copy[PATH_MAX + 256], buf[65536];
+    ssize_t cb = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    exe[cb > 0 ? cb : 0] = '\0';
+    make_tree();
+    snprintf(copy, sizeof(copy), "%s/bin", szTree);
+    mkdir(copy, 0777);
+    snprintf(copy, sizeof(copy), "%s/bin/%s", szTree, strrchr(exe, '/') + 1);
+    int fdIn = open(exe, O_RDONLY), fdOut = creat(copy, 0755);
+    while (fdIn >= 0 && fdOut >= 0 && (cb = read(fdIn, buf, sizeof(buf))) > 0
+        && write(fdOut, buf, (size_t)cb) == cb) ;
+    close(fdIn);
+    close(fdOut);
+
+    int status = 1;
+    pid_t pid = fork();
+    if (!pid) {
+        setenv("TESTS_TREE", szTree, 1);
+        execl(copy, copy, (char*)NULL);
+        perror(copy);
+        _exit(1);
+    }
+    if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) {
+        fprintf(stderr, "%s: %s\n", copy, WIFSIGNALED(status)
+            ? strsignal(WTERMSIG(status)) : "not run");
+        exit(1);
+    }
+    exit(WEXITSTATUS(status));
+}
+
+
+// formats path under the tree
+static inline const char* tree_path(char* buf, size_t cb, const char* fmt, ...)
+{
+    va_list va;
+    int n = snprintf(buf, cb, "%s/", szTree);
+    va_start(va, fmt);
+    vsnprintf(buf + n, cb - (size_t)n, fmt, va);
+    va_end(va);
+    return buf;
+}
+
+
+// makes directory with parents
+static inline void make_dir(const char* path)
+{
+    char tmp[PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s", path);
+    for (char* cp = tmp + 1; *cp; ++cp) {
+        if (*cp == '/') {
+            *cp = '\0';
+            mkdir(tmp, 0777);
+            *cp = '/';
+        }
+    }
+    mkdir(tmp, 0777);
+}
+
+
+// makes file with given text and mode, making its directory too
+static inline void make_file(const char* path, const char* text, mode_t mode)
+{
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s", path);
+    *strrchr(dir, '/') = '\0';
+    make_dir(dir);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, mode);
+    if (fd < 0 || write(fd, text, strlen(text)) != (ssize_t)strlen(text)) {
+        perror(path);
+        exit(1);
+    }
+    close(fd);
+    chmod(path, mode);
+}
+
+
+// converts POSIX path to native one, as the platform layer does
+static inline const char* native(char* buf, size_t cb, const char* path)
+{
+    size_t i = 0;
+    if (*path == '/' && cb > 2) {
+        buf[i++] = 'C';
+        buf[i++] = ':';
+    }
+    for ( ; *path && i + 1 < cb; ++path)
+        buf[i++] = (*path == '/') ? '\\' : *path;
+    buf[i] = '\0';
+    return buf;
+}
+
+
+// gets monotonic time in nanoseconds
+static inline double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+#endif // TESTS_UTIL_H
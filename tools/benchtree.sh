@@ -0,0 +1,154 @@
+#!/bin/sh
+#
+# Proj: shebang
+# Auth: matveyt
+# Desc: End-to-end launch benchmark over synthetic PATH trees
+# Note: Run from MSYS2/Cygwin shell, e.g. 'sh tools/benchtree.sh -n 200 shebang.exe',
+#       or on Linux with the launcher built over posix/, e.g. 'make -C tests
+#       build/shebang && sh tools/benchtree.sh tests/build/shebang'; -l needs
+#       build/shebang_test, which has test knobs of the platform layer
+#
+
+SCENARIOS="layout-usr layout-mingw64 layout-ucrt64 layout-cygwin path-10 path-100 \
+path-1000 dirsize-0 dirsize-1000 dirsize-10000 shape-sh shape-args-crlf shape-env \
+shape-env-S"
+
+usage() {
+    echo "usage: $0 [-n runs] [-o dir] [-k] [-l us] [-s scenario]... shebang.exe" >&2
+    echo "    -n runs      launches per scenario (default 100)" >&2
+    echo "    -o dir       work directory (default /tmp/sbench)" >&2
+    echo "    -k           keep resolution cache between launches" >&2
+    echo "    -l us        Linux only: add latency to each file lookup in work" >&2
+    echo "                 directory, as of a network drive" >&2
+    echo "    -s scenario  run only given scenario (repeatable)" >&2
+    echo "scenarios: $SCENARIOS" >&2
+    exit 2
+}
+
+# note: short work directory keeps 1000 filler entries within 32K of PATH
+runs=100
+work=/tmp/sbench
+keep=
+latency=
+only=
+while getopts n:o:kl:s: opt; do
+    case $opt in
+    n) runs=$OPTARG ;;
+    o) work=$OPTARG ;;
+    k) keep=1 ;;
+    l) latency=$OPTARG ;;
+    s) only="$only $OPTARG" ;;
+    *) usage ;;
+    esac
+done
+shift $((OPTIND - 1))
+[ $# -eq 1 ] && [ -f "$1" ] || usage
+shebang=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+tools=$(cd "$(dirname "$0")" && pwd)
+
+# any cheap program will do as a shell; take 'true' along with its runtime DLL;
+# on Linux it is a host program, and the launcher is named after the script anyway
+true_exe=$(command -v true.exe)
+for f in /usr/bin/true /bin/true; do
+    [ -f "$true_exe" ] || true_exe=$f
+done
+[ -f "$true_exe" ] || { echo "$0: no true.exe found" >&2; exit 1; }
+runtime=
+for dll in msys-2.0.dll cygwin1.dll; do
+    [ -f "$(dirname "$true_exe")/$dll" ] && runtime="$(dirname "$true_exe")/$dll"
+done
+
+rm -rf "$work" && mkdir -p "$work" && work=$(cd "$work" && pwd) || exit 1
+cc -O -o "$work/tracestat" "$tools/tracestat.c" || exit 1
+
+# native path of a file; Linux build of the launcher takes POSIX ones
+if command -v cygpath >/dev/null; then
+    native() { cygpath -w "$1"; }
+else
+    native() { echo "$1"; }
+    [ -n "$latency" ] && export POSIX_STAT_DELAY="$latency,$work"
+fi
+
+
+# puts shells into directory
+make_shells() {
+    mkdir -p "$1"
+    for sh in sh bash dash env; do
+        cp "$true_exe" "$1/$sh.exe"
+    done
+    [ -n "$runtime" ] && cp "$runtime" "$1/"
+}
+
+
+# prints $1 filler directories of $2 files each as PATH prefix; reused by scenarios
+make_filler() {
+    i=0
+    while [ $i -lt "$1" ]; do
+        d="$work/f$2/$i"
+        if [ ! -d "$d" ]; then
+            mkdir -p "$d"
+            [ "$2" -gt 0 ] && (cd "$d" && seq -f 'f%05g.exe' 1 "$2" | xargs touch)
+        fi
+        printf '%s:' "$d"
+        i=$((i + 1))
+    done
+}
+
+
+# runs scenario: $1 = name, $2 = layer, $3 = filler dirs, $4 = files each,
+# $5 = shebang line (printf format)
+run() {
+    case " ${only:-$SCENARIOS} " in
+    *" $1 "*) ;;
+    *) return ;;
+    esac
+    printf '%-16s ' "$1" >&2
+
+    # POSIX root with PATH entry of the layer: Cygwin or MSYS /usr/bin + layer/bin
+    t="$work/$1"
+    if [ "$2" = cygwin ]; then
+        bin="$t/cygwin/bin"
+        make_shells "$bin"
+    else
+        bin="$t/msys64/$2/bin"
+        make_shells "$t/msys64/usr/bin"
+        mkdir -p "$bin"
+    fi
+
+    # script and its shebang copy go last on PATH
+    mkdir -p "$t/scripts" "$t/temp"
+    printf "$5" > "$t/scripts/bench"
+    cp "$shebang" "$t/scripts/bench.exe"
+    path="$(make_filler "$3" "$4")$bin:$t/scripts"
+    temp=$(native "$t/temp")
+    trace=$(native "$t/trace")
+
+    i=0
+    while [ $i -lt "$runs" ]; do
+        [ -z "$keep" ] && rm -f "$t/temp/shebang.cache"
+        PATH="$path" TEMP="$temp" TMP="$temp" TMPDIR="$temp" SHEBANG_TRACE="$trace" \
+            "$t/scripts/bench.exe" || { echo "failed" >&2; return; }
+        i=$((i + 1))
+    done
+    echo "done" >&2
+
+    echo "== $1"
+    "$work/tracestat" "$t/trace"
+    echo
+}
+
+
+run layout-usr      usr       50 100   '#!/bin/sh\n'
+run layout-mingw64  mingw64   50 100   '#!/bin/sh\n'
+run layout-ucrt64   ucrt64    50 100   '#!/bin/sh\n'
+run layout-cygwin   cygwin    50 100   '#!/bin/sh\n'
+run path-10         usr       10 0     '#!/bin/sh\n'
+run path-100        usr      100 0     '#!/bin/sh\n'
+run path-1000       usr     1000 0     '#!/bin/sh\n'
+run dirsize-0       usr       10 0     '#!/bin/sh\n'
+run dirsize-1000    usr       10 1000  '#!/bin/sh\n'
+run dirsize-10000   usr       10 10000 '#!/bin/sh\n'
+run shape-sh        usr       50 100   '#!/bin/sh\n'
+run shape-args-crlf usr       50 100   '#!/bin/bash -e -u\r\n'
+run shape-env       usr       50 100   '#!/usr/bin/env sh\n'
+run shape-env-S     usr       50 100   '#!/usr/bin/env -S FOO=1 BAR=2 sh -e\n'
@@ -0,0 +1,174 @@
+/*
+ * Proj: shebang
+ * Auth: matveyt
+ * Desc: Per-phase percentiles and histograms from SHEBANG_TRACE files
+ * Note: Portable C99, e.g. 'cc -O -o tracestat tracestat.c'
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+// macro to facilitate function call
+#define COUNT(a)        (sizeof(a) / sizeof(*a))
+// histogram buckets: 1us << i
+#define BUCKETS         32
+
+
+// samples of one phase
+typedef struct {
+    char name[32];
+    size_t cnt, cap;
+    unsigned long long* us;
+} PHASE;
+
+static PHASE phase[16];
+static size_t phases;
+
+
+// finds or adds phase by name
+static PHASE* get_phase(const char* name, size_t len)
+{
+    for (size_t i = 0; i < phases; ++i)
+        if (strlen(phase[i].name) == len && !memcmp(phase[i].name, name, len))
+            return &phase[i];
+
+    if (phases == COUNT(phase) || len >= sizeof(phase->name))
+        return NULL;
+    memcpy(phase[phases].name, name, len);
+    return &phase[phases++];
+}
+
+
+// adds sample to phase
+static void add_sample(PHASE* pp, unsigned long long us)
+{
+    if (pp->cnt == pp->cap) {
+        pp->cap = pp->cap ? 2 * pp->cap : 256;
+        pp->us = realloc(pp->us, pp->cap * sizeof(*pp->us));
+        if (!pp->us) {
+            perror("tracestat");
+            exit(EXIT_FAILURE);
+        }
+    }
+    pp->us[pp->cnt++] = us;
+}
+
+
+// parses "us":{"phase":n,...} object of a trace line; also sums up "total"
+static int parse_line(const char* line)
+{
+    const char* cp = strstr(line, "\"us\":{");
+    if (!cp)
+        return 0;
+    cp += 6;
+
+    unsigned long long total = 0;
+    while (*cp == '"') {
+        const char* name = ++cp;
+        while (*cp && *cp != '"') ++cp;
+        size_t len = (size_t)(cp - name);
+        if (cp[0] != '"' || cp[1] != ':')
+            return 0;
+        char* end;
+        unsigned long long us = strtoull(cp + 2, &end, 10);
+        if (end == cp + 2)
+            return 0;
+        PHASE* pp = get_phase(name, len);
+        if (pp)
+            add_sample(pp, us);
+        total += us;
+        cp = (*end == ',') ? end + 1 : end;
+    }
+
+    PHASE* pp = get_phase("total", 5);
+    if (pp)
+        add_sample(pp, total);
+    return 1;
+}
+
+
+// sorts samples in ascending order
+static int compare_us(const void* p1, const void* p2)
+{
+    unsigned long long us1 = *(const unsigned long long*)p1;
+    unsigned long long us2 = *(const unsigned long long*)p2;
+    return (us1 > us2) - (us1 < us2);
+}
+
+
+// gets percentile of sorted samples (nearest rank)
+static unsigned long long percentile(const PHASE* pp, unsigned pct)
+{
+    size_t rank = (pp->cnt * pct + 99) / 100;
+    return pp->us[rank ? rank - 1 : 0];
+}
+
+
+// prints percentiles and log2 histogram of each phase
+static void print_stats(void)
+{
+    printf("%-10s %8s %10s %10s %10s %10s\n", "phase", "count", "p50", "p90",
+        "p99", "max");
+    for (size_t i = 0; i < phases; ++i) {
+        PHASE* pp = &phase[i];
+        qsort(pp->us, pp->cnt, sizeof(*pp->us), compare_us);
+        printf("%-10s %8zu %10llu %10llu %10llu %10llu\n", pp->name, pp->cnt,
+            percentile(pp, 50), percentile(pp, 90), percentile(pp, 99),
+            pp->us[pp->cnt - 1]);
+    }
+
+    for (size_t i = 0; i < phases; ++i) {
+        PHASE* pp = &phase[i];
+        size_t hist[BUCKETS] = {0}, most = 0;
+        for (size_t k = 0; k < pp->cnt; ++k) {
+            int b = 0;
+            while (b < BUCKETS - 1 && (pp->us[k] >> b) > 1) ++b;
+            if (++hist[b] > most)
+                most = hist[b];
+        }
+
+        printf("\n%s (us)\n", pp->name);
+        for (int b = 0; b < BUCKETS; ++b) {
+            if (!hist[b])
+                continue;
+            int bar = (int)(hist[b] * 50 / most);
+            printf("%10llu.. %8zu %.*s\n", b ? 1ULL << b : 0ULL, hist[b],
+                bar ? bar : 1, "##################################################");
+        }
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    char line[8192];
+    size_t lines = 0, bad = 0;
+
+    // trace files or stdin
+    for (int i = 1; i < argc || i == 1; ++i) {
+        FILE* fp = (i < argc) ? fopen(argv[i], "r") : stdin;
+        if (!fp) {
+            perror(argv[i]);
+            return EXIT_FAILURE;
+        }
+        while (fgets(line, sizeof(line), fp)) {
+            ++lines;
+            if (!parse_line(line))
+                ++bad;
+        }
+        if (fp != stdin)
+            fclose(fp);
+    }
+
+    if (lines == bad) {
+        fprintf(stderr, "tracestat: no trace lines\n");
+        return EXIT_FAILURE;
+    }
+    if (bad)
+        fprintf(stderr, "tracestat: %zu bad lines skipped\n", bad);
+    print_stats();
+    return EXIT_SUCCESS;
+}